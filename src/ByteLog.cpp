@@ -0,0 +1,175 @@
+/************************************************************************/
+/* ByteLog                                                              */
+/*                                                                      */
+/* ZigBee Terminal - Byte Log                                           */
+/*                                                                      */
+/* ByteLog.cpp                                                          */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ByteLog.h"
+
+ByteLog::ByteLog(size_t max_size) :
+        data_head(0),
+        base(0),
+        max_size(max_size)
+{
+        // nothing
+}
+
+
+ByteLog::~ByteLog()
+{
+        // nothing
+}
+
+
+void ByteLog::append(const char *bytes, size_t count, ByteLogDirection dir)
+{
+        if (count == 0)
+                return;
+                
+        set_direction(dir);
+        data.insert(data.end(), (const uint8_t *)bytes, (const uint8_t *)bytes + count);
+        trim();
+}
+
+
+void ByteLog::append(uint8_t b, ByteLogDirection dir)
+{
+        set_direction(dir);
+        data.push_back(b);
+        trim();
+}
+
+
+void ByteLog::clear()
+{
+        base = get_end();
+        data_head = 0;
+        data.clear();
+        spans.clear();
+}
+
+
+size_t ByteLog::get_begin()
+{
+        return base + data_head;
+}
+
+
+size_t ByteLog::get_end()
+{
+        return base + data.size();
+}
+
+
+size_t ByteLog::get_size()
+{
+        return data.size() - data_head;
+}
+
+
+const uint8_t *ByteLog::get_data(size_t pos)
+{
+        return &data[pos - base];
+}
+
+
+ByteLog::ByteLogDirection ByteLog::get_direction(size_t pos, size_t &run_end)
+{
+        size_t lo = 0;
+        size_t hi = spans.size();
+        
+        // find last span starting at or before pos
+        while (hi - lo > 1)
+        {
+                size_t mid = (lo + hi) / 2;
+                if (spans[mid].begin <= pos)
+                        lo = mid;
+                else
+                        hi = mid;
+        }
+        
+        run_end = hi < spans.size() ? spans[hi].begin : get_end();
+        
+        return (ByteLogDirection)spans[lo].direction;
+}
+
+
+size_t ByteLog::set_max_size(size_t m)
+{
+        max_size = m;
+        trim();
+        return max_size;
+}
+
+
+size_t ByteLog::get_max_size()
+{
+        return max_size;
+}
+
+
+void ByteLog::set_direction(ByteLogDirection dir)
+{
+        if (spans.size() > 0 && spans.back().direction == dir)
+                return;
+                
+        Span s;
+        s.begin = get_end();
+        s.direction = dir;
+        spans.push_back(s);
+}
+
+
+void ByteLog::trim()
+{
+        size_t begin;
+        
+        if (max_size == 0 || get_size() <= max_size + max_size / 4)
+                return;
+                
+        data_head += get_size() - max_size;
+        begin = get_begin();
+        
+        // drop spans that end before the new first byte
+        while (spans.size() > 1 && spans[1].begin <= begin)
+                spans.pop_front();
+                
+        if (spans.size() > 0 && spans.front().begin < begin)
+                spans.front().begin = begin;
+                
+        // release storage of dropped bytes once it makes up half of the array
+        if (data_head >= data.size() / 2)
+        {
+                data.erase(data.begin(), data.begin() + data_head);
+                base += data_head;
+                data_head = 0;
+        }
+}
+
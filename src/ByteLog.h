@@ -0,0 +1,185 @@
+/************************************************************************/
+/* ByteLog                                                              */
+/*                                                                      */
+/* ZigBee Terminal - Byte Log                                           */
+/*                                                                      */
+/* ByteLog.h                                                            */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __BYTE_LOG_H
+#define __BYTE_LOG_H
+
+#include <vector>
+#include <deque>
+#include <stddef.h>
+#include <inttypes.h>
+
+/** Byte Log
+ * 
+ * Compact log of bytes sent and received.  Bytes are stored one per byte
+ * and the direction is kept as a list of spans, one per change of
+ * direction.  Bytes are addressed by their position since the log was
+ * created, which does not change as old bytes are trimmed.  If a size
+ * limit is set, the oldest bytes are dropped in blocks once the log grows
+ * a quarter past the limit, so trimming is amortized O(1) per byte.  
+ */
+class ByteLog
+{
+public:
+        /**
+         * Byte direction.
+         */
+        typedef enum
+        {
+                BLD_RX = 0,
+                BLD_TX = 1,
+        }
+        ByteLogDirection;
+        
+        /**
+         * Create a Byte Log.
+         * @param max_size size limit in bytes, 0 for no limit
+         */
+        ByteLog(size_t max_size = 0);
+        virtual ~ByteLog();
+        
+        /**
+         * Append bytes.
+         * @param bytes pointer to data
+         * @param count number of bytes
+         * @param dir direction
+         */
+        void append(const char *bytes, size_t count, ByteLogDirection dir);
+        
+        /**
+         * Append a byte.
+         * @param b byte
+         * @param dir direction
+         */
+        void append(uint8_t b, ByteLogDirection dir);
+        
+        /**
+         * Drop all bytes.  Positions are not reused.
+         */
+        void clear();
+        
+        /**
+         * Get position of the oldest byte stored.
+         * @return position
+         */
+        size_t get_begin();
+        
+        /**
+         * Get position one past the newest byte stored.
+         * @return position
+         */
+        size_t get_end();
+        
+        /**
+         * Get number of bytes stored.
+         * @return byte count
+         */
+        size_t get_size();
+        
+        /**
+         * Get pointer to stored bytes.  Bytes from pos to get_end() are
+         * contiguous.  Valid until the log is next modified.
+         * @param pos position, get_begin() <= pos < get_end()
+         * @return pointer to byte at pos
+         */
+        const uint8_t *get_data(size_t pos);
+        
+        /**
+         * Get direction of a byte and the extent of its run.
+         * @param pos position, get_begin() <= pos < get_end()
+         * @param run_end return position one past the last byte of the run
+         * @return direction
+         */
+        ByteLogDirection get_direction(size_t pos, size_t &run_end);
+        
+        /**
+         * Set size limit.
+         * @param m size limit in bytes, 0 for no limit
+         * @return size limit
+         */
+        size_t set_max_size(size_t m);
+        
+        /**
+         * Get size limit.
+         * @return size limit in bytes, 0 for no limit
+         */
+        size_t get_max_size();
+        
+protected:
+        /**
+         * Direction span.
+         */
+        struct Span
+        {
+                size_t begin;           ///< Position of first byte
+                uint8_t direction;      ///< ByteLogDirection
+        };
+        
+        /**
+         * Start a new span if the direction changes.
+         * @param dir direction of next byte
+         */
+        void set_direction(ByteLogDirection dir);
+        
+        /**
+         * Drop oldest bytes if the log has grown past the limit.
+         */
+        void trim();
+        
+        /**
+         * Byte storage.
+         */
+        std::vector<uint8_t> data;
+        
+        /**
+         * Number of dropped bytes at the start of data.
+         */
+        size_t data_head;
+        
+        /**
+         * Position of data[0].
+         */
+        size_t base;
+        
+        /**
+         * Direction spans, oldest first.
+         */
+        std::deque<Span> spans;
+        
+        /**
+         * Size limit.
+         */
+        size_t max_size;
+};
+
+#endif //__BYTE_LOG_H
@@ -0,0 +1,671 @@
+/************************************************************************/
+/* CaptureAnalyzer                                                      */
+/*                                                                      */
+/* ZigBee Terminal - Parallel capture decoder                           */
+/*                                                                      */
+/* CaptureAnalyzer.cpp                                                  */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "CaptureAnalyzer.h"
+
+#include <string.h>
+
+CaptureAnalyzer::CaptureAnalyzer() :
+        escaped(false),
+        thread_count(0),
+        chunk_size(4194304),
+        stopping(0),
+        frame_count(0),
+        junk_bytes(0),
+        checksum_errors(0),
+        chunk_count(0),
+        redecode_count(0),
+        quit(false)
+{
+        plan_stream[0] = plan_stream[1] = 0;
+        merged_end[0] = merged_end[1] = 0;
+}
+
+
+CaptureAnalyzer::~CaptureAnalyzer()
+{
+        close();
+}
+
+
+bool CaptureAnalyzer::open(const std::string &filename)
+{
+        if (!reader.open(filename))
+                return false;
+                
+        escaped = reader.get_flags() & CaptureFile::CF_Escaped;
+        
+        return true;
+}
+
+
+void CaptureAnalyzer::close()
+{
+        reader.close();
+}
+
+
+bool CaptureAnalyzer::is_open()
+{
+        return reader.is_open();
+}
+
+
+uint32_t CaptureAnalyzer::get_flags()
+{
+        return reader.get_flags();
+}
+
+
+void CaptureAnalyzer::set_thread_count(int n)
+{
+        thread_count = n > 0 ? n : 0;
+}
+
+
+int CaptureAnalyzer::get_thread_count()
+{
+        return thread_count;
+}
+
+
+void CaptureAnalyzer::set_chunk_size(size_t bytes)
+{
+        chunk_size = bytes > 0 ? bytes : 1;
+}
+
+
+size_t CaptureAnalyzer::get_chunk_size()
+{
+        return chunk_size;
+}
+
+
+void CaptureAnalyzer::set_format_slot(const FormatSlot &slot)
+{
+        format_slot = slot;
+}
+
+
+bool CaptureAnalyzer::run()
+{
+        int n = thread_count > 0 ? thread_count : Thread::get_cpu_count();
+        std::deque<Chunk *> pending;
+        bool planned = false;
+        bool stopped;
+        Chunk *c;
+        size_t i;
+        
+        if (!reader.is_open())
+                return false;
+                
+        reader.rewind();
+        plan_stream[0] = plan_stream[1] = 0;
+        merged_end[0] = merged_end[1] = 0;
+        carries.clear();
+        frame_count = 0;
+        junk_bytes = 0;
+        checksum_errors = 0;
+        chunk_count = 0;
+        redecode_count = 0;
+        Thread::atomic_set(&stopping, 0);
+        quit = false;
+        
+        for (int t = 0; n > 1 && t < n; t++)
+        {
+                Thread *thread = Thread::create( sigc::mem_fun(*this, &CaptureAnalyzer::worker) );
+                
+                if (thread)
+                        threads.push_back(thread);
+        }
+        
+        while (!Thread::atomic_get(&stopping))
+        {
+                // one chunk queued behind each busy thread, so no thread waits on the merge
+                while (!planned && pending.size() < threads.size() * 2 + 1)
+                {
+                        c = new Chunk();
+                        
+                        if (!plan_chunk(*c))
+                        {
+                                delete c;
+                                planned = true;
+                                break;
+                        }
+                        
+                        pending.push_back(c);
+                        
+                        if (!threads.empty())
+                        {
+                                Mutex::Lock lock(mutex);
+                                jobs.push_back(c);
+                                job_cond.signal();
+                        }
+                }
+                
+                if (pending.empty())
+                        break;
+                        
+                c = pending.front();
+                pending.pop_front();
+                
+                if (threads.empty())
+                {
+                        decode_chunk(*c, 0);
+                }
+                else
+                {
+                        Mutex::Lock lock(mutex);
+                        
+                        while (!c->done)
+                                done_cond.wait(mutex);
+                }
+                
+                merge_chunk(*c);
+                delete c;
+        }
+        
+        {
+                Mutex::Lock lock(mutex);
+                
+                quit = true;
+                jobs.clear();
+                job_cond.broadcast();
+        }
+        
+        for (i = 0; i < threads.size(); i++)
+                threads[i]->join();
+                
+        threads.clear();
+        
+        for (i = 0; i < pending.size(); i++)
+                delete pending[i];
+        
+        stopped = Thread::atomic_get(&stopping);
+        
+        // frames cut off by the end of the file are never finished, the rest are due
+        if (!stopped && !carries.empty())
+        {
+                out.clear();
+                
+                for (i = 0; i < carries.size(); i++)
+                {
+                        Carry &carry = carries[i];
+                        Frame f;
+                        
+                        f.timestamp = carry.frame.timestamp;
+                        f.direction = (CaptureFile::CaptureDirection)carry.frame.direction;
+                        f.view.set(carry.payload.empty() ? 0 : &carry.payload[0], carry.payload.size());
+                        f.text = carry.text.data();
+                        f.text_length = carry.text.size();
+                        out.push_back(f);
+                }
+                
+                frame_count += out.size();
+                m_signal_frames.emit(out);
+        }
+        
+        carries.clear();
+        
+        return !stopped;
+}
+
+
+void CaptureAnalyzer::stop()
+{
+        Thread::atomic_set(&stopping, 1);
+}
+
+
+uint64_t CaptureAnalyzer::get_frame_count()
+{
+        return frame_count;
+}
+
+
+uint64_t CaptureAnalyzer::get_junk_bytes()
+{
+        return junk_bytes;
+}
+
+
+uint64_t CaptureAnalyzer::get_checksum_errors()
+{
+        return checksum_errors;
+}
+
+
+uint64_t CaptureAnalyzer::get_chunk_count()
+{
+        return chunk_count;
+}
+
+
+uint64_t CaptureAnalyzer::get_redecode_count()
+{
+        return redecode_count;
+}
+
+
+sigc::signal<void, const std::vector<CaptureAnalyzer::Frame>&> CaptureAnalyzer::signal_frames()
+{
+        return m_signal_frames;
+}
+
+
+bool CaptureAnalyzer::plan_chunk(Chunk &c)
+{
+        CaptureFile::Record rec;
+        size_t bytes = 0;
+        
+        c.position = reader.get_position();
+        c.stream_start[0] = plan_stream[0];
+        c.stream_start[1] = plan_stream[1];
+        
+        // only the record headers are read here
+        while (bytes < chunk_size && reader.read_record(rec))
+        {
+                plan_stream[rec.direction] += rec.length;
+                bytes += rec.length;
+        }
+        
+        c.end_position = reader.get_position();
+        
+        if (c.end_position == c.position)
+                return false;
+                
+        c.stream_end[0] = plan_stream[0];
+        c.stream_end[1] = plan_stream[1];
+        c.carry_start = 0;
+        c.junk_bytes = 0;
+        c.checksum_errors = 0;
+        c.done = false;
+        
+        return true;
+}
+
+
+void CaptureAnalyzer::decode_chunk(Chunk &c, const uint64_t *starts)
+{
+        ZigBeeFrameParser parsers[2];
+        CaptureFile::Record rec;
+        uint64_t stream[2];
+        uint64_t pos = c.position;
+        uint64_t key;
+        int d;
+        
+        for (d = 0; d < 2; d++)
+        {
+                parsers[d].set_escaped(escaped);
+                c.start[d] = starts ? starts[d] : find_start(c, d, parsers[d].get_buffer().get_capacity());
+                stream[d] = c.stream_start[d];
+        }
+        
+        while (pos < c.end_position)
+        {
+                key = pos;
+                
+                if (!reader.read_record_at(pos, rec))
+                        break;
+                        
+                d = rec.direction;
+                
+                if (stream[d] + rec.length > c.start[d])
+                {
+                        size_t skip = stream[d] < c.start[d] ? c.start[d] - stream[d] : 0;
+                        
+                        parse(c, parsers[d], rec, key, rec.data + skip, rec.length - skip);
+                }
+                
+                stream[d] += rec.length;
+        }
+        
+        c.carry_start = c.frames.size();
+        
+        for (d = 0; d < 2; d++)
+        {
+                c.end[d] = c.start[d] > c.stream_end[d] ? c.start[d] : c.stream_end[d];
+                
+                if (!parsers[d].is_idle())
+                        finish_chunk(c, parsers[d], d);
+                        
+                c.junk_bytes += parsers[d].get_junk_bytes();
+                c.checksum_errors += parsers[d].get_checksum_errors();
+        }
+}
+
+
+uint64_t CaptureAnalyzer::find_start(const Chunk &c, int dir, size_t capacity)
+{
+        std::vector<uint8_t> window;
+        ZigBeePacket pkt;
+        uint64_t pos = c.position;
+        uint64_t base = c.stream_start[dir];
+        const uint8_t *hit;
+        size_t length;
+        size_t num;
+        size_t k = 0;
+        
+        while (true)
+        {
+                if (k >= window.size())
+                {
+                        // nothing in the window could start a frame
+                        base += window.size();
+                        window.clear();
+                        k = 0;
+                        
+                        if (!fill_window(window, pos, dir, 1))
+                                return base + window.size();
+                }
+                
+                hit = (const uint8_t *)memchr(&window[k], ZIGBEE_IDENTIFIER, window.size() - k);
+                
+                if (!hit)
+                {
+                        k = window.size();
+                        continue;
+                }
+                
+                k = hit - &window[0];
+                
+                // a start byte is always escaped inside a frame
+                if (escaped)
+                        return base + k;
+                        
+                // a parser reaching a frame cut off by the end of the file waits there for good
+                if (!fill_window(window, pos, dir, k + 3))
+                        return base + k;
+                        
+                length = ((size_t)window[k + 1] << 8) | window[k + 2];
+                
+                if (length + 4 <= capacity)
+                {
+                        if (!fill_window(window, pos, dir, k + length + 4))
+                                return base + k;
+                                
+                        if (pkt.read_packet(&window[k], length + 4, num))
+                                return base + k;
+                }
+                
+                // stray start byte, resync after it
+                k++;
+        }
+}
+
+
+bool CaptureAnalyzer::fill_window(std::vector<uint8_t> &window, uint64_t &position, int dir, size_t need)
+{
+        CaptureFile::Record rec;
+        
+        while (window.size() < need)
+        {
+                if (!reader.read_record_at(position, rec))
+                        return false;
+                        
+                if (rec.direction == dir)
+                        window.insert(window.end(), rec.data, rec.data + rec.length);
+        }
+        
+        return true;
+}
+
+
+void CaptureAnalyzer::parse(Chunk &c, ZigBeeFrameParser &parser, const CaptureFile::Record &rec, uint64_t key, const uint8_t *data, size_t count)
+{
+        const uint8_t *frame;
+        size_t len;
+        size_t num;
+        
+        while (count > 0)
+        {
+                num = parser.get_buffer().write(data, count);
+                
+                while (parser.read_frame(frame, len))
+                        add_frame(c, rec, key, frame, len);
+                        
+                if (num == 0)
+                {
+                        // parser made no room, should not happen
+                        parser.reset();
+                }
+                
+                data += num;
+                count -= num;
+        }
+}
+
+
+void CaptureAnalyzer::finish_chunk(Chunk &c, ZigBeeFrameParser &parser, int dir)
+{
+        CaptureFile::Record rec;
+        uint64_t pos = c.end_position;
+        uint64_t stream = c.stream_end[dir];
+        uint64_t key;
+        const uint8_t *frame;
+        size_t len;
+        size_t i;
+        
+        while (true)
+        {
+                key = pos;
+                
+                if (!reader.read_record_at(pos, rec))
+                        break;
+                        
+                if (rec.direction != dir)
+                        continue;
+                        
+                for (i = 0; i < rec.length; i++)
+                {
+                        // the next chunk resyncs on this start byte, stop short of it
+                        if (escaped && rec.data[i] == ZIGBEE_IDENTIFIER)
+                        {
+                                c.junk_bytes += parser.get_buffer().get_size();
+                                c.end[dir] = stream;
+                                return;
+                        }
+                        
+                        if (parser.get_buffer().write(rec.data + i, 1) == 0)
+                        {
+                                parser.reset();
+                                parser.get_buffer().write(rec.data + i, 1);
+                        }
+                        
+                        stream++;
+                        
+                        // a bad checksum can leave whole frames buffered behind it
+                        while (parser.read_frame(frame, len))
+                                add_frame(c, rec, key, frame, len);
+                                
+                        if (parser.is_idle())
+                        {
+                                c.end[dir] = stream;
+                                return;
+                        }
+                }
+        }
+        
+        // cut off by the end of the file
+        c.end[dir] = stream;
+}
+
+
+void CaptureAnalyzer::add_frame(Chunk &c, const CaptureFile::Record &rec, uint64_t key, const uint8_t *payload, size_t length)
+{
+        ChunkFrame f;
+        
+        f.timestamp = rec.timestamp;
+        f.key = key;
+        f.direction = rec.direction;
+        f.offset = c.bytes.size();
+        f.length = length;
+        f.text_offset = c.text.size();
+        
+        c.bytes.insert(c.bytes.end(), payload, payload + length);
+        
+        if (!format_slot.empty())
+                format_slot(rec.direction, ZigBeePacketView(payload, length), c.text);
+                
+        f.text_length = c.text.size() - f.text_offset;
+        
+        c.frames.push_back(f);
+}
+
+
+void CaptureAnalyzer::merge_chunk(Chunk &c)
+{
+        const uint8_t *bytes;
+        size_t emitted = 0;
+        size_t i;
+        int d;
+        
+        // resynced inside a frame the previous chunk finished, decode again from where it did
+        if (c.start[0] < merged_end[0] || c.start[1] < merged_end[1])
+        {
+                uint64_t starts[2];
+                
+                for (d = 0; d < 2; d++)
+                        starts[d] = c.start[d] > merged_end[d] ? c.start[d] : merged_end[d];
+                        
+                c.frames.clear();
+                c.bytes.clear();
+                c.text.clear();
+                c.junk_bytes = 0;
+                c.checksum_errors = 0;
+                
+                decode_chunk(c, starts);
+                redecode_count++;
+        }
+        
+        chunk_count++;
+        
+        // a single parser would have skipped the bytes up to the resync point
+        for (d = 0; d < 2; d++)
+        {
+                junk_bytes += c.start[d] - merged_end[d];
+                merged_end[d] = c.end[d];
+        }
+        
+        junk_bytes += c.junk_bytes;
+        checksum_errors += c.checksum_errors;
+        
+        bytes = c.bytes.empty() ? 0 : &c.bytes[0];
+        out.clear();
+        
+        for (i = 0; i <= c.carry_start; i++)
+        {
+                // frames finished here for earlier chunks go in the order they ended
+                uint64_t key = i < c.carry_start ? c.frames[i].key : c.end_position;
+                
+                while (emitted < carries.size() && (carries[emitted].frame.key < key ||
+                        (i < c.carry_start && carries[emitted].frame.key == key)))
+                {
+                        Carry &carry = carries[emitted++];
+                        Frame f;
+                        
+                        f.timestamp = carry.frame.timestamp;
+                        f.direction = (CaptureFile::CaptureDirection)carry.frame.direction;
+                        f.view.set(carry.payload.empty() ? 0 : &carry.payload[0], carry.payload.size());
+                        f.text = carry.text.data();
+                        f.text_length = carry.text.size();
+                        out.push_back(f);
+                }
+                
+                if (i < c.carry_start)
+                {
+                        const ChunkFrame &cf = c.frames[i];
+                        Frame f;
+                        
+                        f.timestamp = cf.timestamp;
+                        f.direction = (CaptureFile::CaptureDirection)cf.direction;
+                        f.view.set(bytes + cf.offset, cf.length);
+                        f.text = c.text.data() + cf.text_offset;
+                        f.text_length = cf.text_length;
+                        out.push_back(f);
+                }
+        }
+        
+        frame_count += out.size();
+        
+        if (!out.empty())
+                m_signal_frames.emit(out);
+        
+        carries.erase(carries.begin(), carries.begin() + emitted);
+        
+        // keep frames finished past this chunk, in the order they ended
+        for (i = c.carry_start; i < c.frames.size(); i++)
+        {
+                const ChunkFrame &cf = c.frames[i];
+                std::deque<Carry>::iterator it = carries.begin();
+                
+                while (it != carries.end() && it->frame.key <= cf.key)
+                        ++it;
+                        
+                it = carries.insert(it, Carry());
+                it->frame = cf;
+                it->payload.assign(bytes + cf.offset, bytes + cf.offset + cf.length);
+                it->text.assign(c.text, cf.text_offset, cf.text_length);
+        }
+}
+
+
+void CaptureAnalyzer::worker()
+{
+        Chunk *c;
+        
+        while (true)
+        {
+                {
+                        Mutex::Lock lock(mutex);
+                        
+                        while (jobs.empty() && !quit)
+                                job_cond.wait(mutex);
+                                
+                        if (quit)
+                                return;
+                                
+                        c = jobs.front();
+                        jobs.pop_front();
+                }
+                
+                decode_chunk(*c, 0);
+                
+                {
+                        Mutex::Lock lock(mutex);
+                        
+                        c->done = true;
+                        done_cond.signal();
+                }
+        }
+}
@@ -0,0 +1,424 @@
+/************************************************************************/
+/* CaptureAnalyzer                                                      */
+/*                                                                      */
+/* ZigBee Terminal - Parallel capture decoder                           */
+/*                                                                      */
+/* CaptureAnalyzer.h                                                    */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __CAPTURE_ANALYZER_H
+#define __CAPTURE_ANALYZER_H
+
+#include "CaptureFile.h"
+#include "CaptureReader.h"
+#include "ZigBeePacketView.h"
+#include "ZigBeeFrameParser.h"
+#include "Thread.h"
+#include "Mutex.h"
+
+#include <sigc++/sigc++.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <stddef.h>
+#include <inttypes.h>
+
+/** Capture Analyzer
+ * Decodes a whole capture file on a pool of threads.  The mapped file is
+ * cut into chunks of records, and each chunk is framed, and optionally
+ * formatted, by whichever thread is free.  Frames are handed back in
+ * capture order, one chunk at a time, on the thread that called run(), so
+ * logs, indexes, statistics and exporters can be fed as if the file had
+ * been decoded front to back.  
+ * A chunk usually starts part way through a frame.  Each direction of a
+ * chunk is resynced on the first start delimiter that begins a frame
+ * with a sane length and a good checksum, the same test
+ * ZigBeePacket::read_packet() makes, and in escaped mode on the first
+ * start delimiter, which can never appear inside a frame.  A frame still
+ * open at the end of a chunk is finished by reading on into the next.
+ * Since a parser that skips junk stops at exactly those delimiters, the
+ * frames found are the ones a single parser would find, provided the
+ * previous chunk finished before the resync point.  The rare chunk that
+ * resynced inside a frame is decoded again from where the previous one
+ * finished.  
+ * @see CaptureReader
+ */
+class CaptureAnalyzer
+{
+public:
+        /**
+         * Decoded frame.
+         */
+        struct Frame
+        {
+                uint64_t timestamp;                     ///< Timestamp of the record the frame ended in
+                CaptureFile::CaptureDirection direction;        ///< Direction
+                ZigBeePacketView view;                  ///< Frame payload
+                const char *text;                       ///< Text from the format slot, not terminated
+                size_t text_length;                     ///< Text length
+        };
+        
+        /**
+         * Format slot, called on a pool thread for every frame to append
+         * its text to a string.  Must not touch state shared with other
+         * threads.
+         * @par Prototype:
+         * <tt>void on_my_%format(CaptureFile::CaptureDirection dir, const ZigBeePacketView &frame, std::string &text)</tt>
+         */
+        typedef sigc::slot<void, CaptureFile::CaptureDirection, const ZigBeePacketView&, std::string&> FormatSlot;
+        
+        /**
+         * Create a Capture Analyzer.
+         */
+        CaptureAnalyzer();
+        virtual ~CaptureAnalyzer();
+        
+        /**
+         * Map a capture file.  Closes any capture already open.
+         * @param filename file name
+         * @return true on success
+         */
+        bool open(const std::string &filename);
+        
+        /**
+         * Close the capture file.
+         */
+        void close();
+        
+        /**
+         * Check if a capture file is open.
+         * @return true if open
+         */
+        bool is_open();
+        
+        /**
+         * Get header flags.
+         * @return flags, see CaptureFile::CaptureFlag
+         */
+        uint32_t get_flags();
+        
+        /**
+         * Set number of threads.  With one thread, chunks are decoded on
+         * the thread calling run().
+         * @param n thread count, 0 for one per processor (default)
+         */
+        void set_thread_count(int n);
+        
+        /**
+         * Get number of threads.
+         * @return thread count, 0 for one per processor
+         */
+        int get_thread_count();
+        
+        /**
+         * Set chunk size.  Chunks end at the first record boundary after
+         * this many data bytes.
+         * @param bytes chunk size (default 4 MiB)
+         */
+        void set_chunk_size(size_t bytes);
+        
+        /**
+         * Get chunk size.
+         * @return chunk size in bytes
+         */
+        size_t get_chunk_size();
+        
+        /**
+         * Set format slot.
+         * @param slot slot, or an empty slot for no text
+         */
+        void set_format_slot(const FormatSlot &slot);
+        
+        /**
+         * Decode the whole file, emitting signal_frames() for each chunk in
+         * order.  Returns when the file is done or stop() is called.
+         * @return true if the whole file was decoded
+         */
+        bool run();
+        
+        /**
+         * Stop run() after the current chunk.  May be called from a
+         * signal_frames() handler.
+         */
+        void stop();
+        
+        /**
+         * Get number of frames decoded by the last run().
+         * @return frames
+         */
+        uint64_t get_frame_count();
+        
+        /**
+         * Get bytes skipped looking for frames by the last run().
+         * @return bytes
+         */
+        uint64_t get_junk_bytes();
+        
+        /**
+         * Get frames dropped for a bad checksum by the last run().
+         * @return frames
+         */
+        uint64_t get_checksum_errors();
+        
+        /**
+         * Get number of chunks decoded by the last run().
+         * @return chunks
+         */
+        uint64_t get_chunk_count();
+        
+        /**
+         * Get number of chunks that resynced inside a frame and were
+         * decoded again by the last run().
+         * @return chunks
+         */
+        uint64_t get_redecode_count();
+        
+        /**
+         * Frames signal.  Emitted for each chunk with its frames in capture
+         * order.  The views and text are only valid during the signal.
+         * @par Prototype:
+         * <tt>void on_my_%frames(const std::vector<CaptureAnalyzer::Frame> &frames)</tt>
+         */
+        sigc::signal<void, const std::vector<Frame>&> signal_frames();
+        
+protected:
+        /**
+         * Frame held by a chunk.
+         */
+        struct ChunkFrame
+        {
+                uint64_t timestamp;             ///< Record timestamp
+                uint64_t key;                   ///< File offset of the record the frame ended in
+                uint8_t direction;              ///< Direction
+                size_t offset;                  ///< Payload offset in chunk bytes
+                size_t length;                  ///< Payload length
+                size_t text_offset;             ///< Text offset in chunk text
+                size_t text_length;             ///< Text length
+        };
+        
+        /**
+         * Chunk of records, and frames decoded from it.
+         */
+        struct Chunk
+        {
+                uint64_t position;              ///< File offset of first record
+                uint64_t end_position;          ///< File offset after last record
+                uint64_t stream_start[2];       ///< Stream offset of the first byte, by direction
+                uint64_t stream_end[2];         ///< Stream offset after the last byte, by direction
+                uint64_t start[2];              ///< Stream offset decoding started at, by direction
+                uint64_t end[2];                ///< Stream offset decoding finished at, by direction
+                size_t carry_start;             ///< Index of the first frame ended past the chunk
+                uint64_t junk_bytes;            ///< Bytes skipped
+                uint64_t checksum_errors;       ///< Bad checksums
+                std::vector<ChunkFrame> frames; ///< Frames, in the order they ended
+                std::vector<uint8_t> bytes;     ///< Payloads
+                std::string text;               ///< Formatted text
+                bool done;                      ///< Set when decoded
+        };
+        
+        /**
+         * Frame that ended past its chunk, kept until the next chunks are
+         * merged.
+         */
+        struct Carry
+        {
+                ChunkFrame frame;               ///< Frame, offsets into payload and text
+                std::vector<uint8_t> payload;   ///< Payload
+                std::string text;               ///< Text
+        };
+        
+        /**
+         * Cut the next chunk off the file.
+         * @param c chunk to fill in
+         * @return false at end of file
+         */
+        bool plan_chunk(Chunk &c);
+        
+        /**
+         * Decode a chunk.
+         * @param c chunk
+         * @param starts stream offsets to start at by direction, or 0 to
+         * resync
+         */
+        void decode_chunk(Chunk &c, const uint64_t *starts);
+        
+        /**
+         * Find the first frame start at or after the start of a chunk.
+         * @param c chunk
+         * @param dir direction
+         * @param capacity parser buffer size, longer frames are not frames
+         * @return stream offset, end of stream if none
+         */
+        uint64_t find_start(const Chunk &c, int dir, size_t capacity);
+        
+        /**
+         * Append data of one direction to a resync window.
+         * @param window window
+         * @param position offset of next record, advanced past the records read
+         * @param dir direction
+         * @param need window size wanted
+         * @return true if the window holds need bytes, false at end of file
+         */
+        bool fill_window(std::vector<uint8_t> &window, uint64_t &position, int dir, size_t need);
+        
+        /**
+         * Keep a frame, and format it if there is a format slot.
+         * @param c chunk
+         * @param rec record the frame ended in
+         * @param key file offset of record
+         * @param payload frame payload
+         * @param length payload length
+         */
+        void add_frame(Chunk &c, const CaptureFile::Record &rec, uint64_t key, const uint8_t *payload, size_t length);
+        
+        /**
+         * Write data to a parser and keep the frames it returns.
+         * @param c chunk
+         * @param parser parser
+         * @param rec record the data is from
+         * @param key file offset of record
+         * @param data pointer to data
+         * @param count number of bytes
+         */
+        void parse(Chunk &c, ZigBeeFrameParser &parser, const CaptureFile::Record &rec, uint64_t key, const uint8_t *data, size_t count);
+        
+        /**
+         * Finish a frame left open at the end of a chunk, one byte at a
+         * time so decoding stops exactly where the frame ends.
+         * @param c chunk
+         * @param parser parser, not idle
+         * @param dir direction
+         */
+        void finish_chunk(Chunk &c, ZigBeeFrameParser &parser, int dir);
+        
+        /**
+         * Hand a decoded chunk on, in order.
+         * @param c chunk
+         */
+        void merge_chunk(Chunk &c);
+        
+        /**
+         * Pool thread.
+         */
+        void worker();
+        
+        /**
+         * Capture file.
+         */
+        CaptureReader reader;
+        
+        /**
+         * Escaped mode, from the header.
+         */
+        bool escaped;
+        
+        /**
+         * Thread count, 0 for one per processor.
+         */
+        int thread_count;
+        
+        /**
+         * Chunk size.
+         */
+        size_t chunk_size;
+        
+        /**
+         * Format slot.
+         */
+        FormatSlot format_slot;
+        
+        /**
+         * Stop flag.
+         */
+        volatile int stopping;
+        
+        /**
+         * Stream offset of the next byte to plan, by direction.
+         */
+        uint64_t plan_stream[2];
+        
+        /**
+         * Stream offset the last merged chunk finished at, by direction.
+         */
+        uint64_t merged_end[2];
+        
+        /**
+         * Frames that ended past their chunk, oldest first.
+         */
+        std::deque<Carry> carries;
+        
+        /**
+         * Frames handed to signal_frames(), reused.
+         */
+        std::vector<Frame> out;
+        
+        // totals of the last run()
+        uint64_t frame_count;
+        uint64_t junk_bytes;
+        uint64_t checksum_errors;
+        uint64_t chunk_count;
+        uint64_t redecode_count;
+        
+        /**
+         * Pool threads.
+         */
+        std::vector<Thread *> threads;
+        
+        /**
+         * Chunks waiting for a thread.
+         */
+        std::deque<Chunk *> jobs;
+        
+        /**
+         * Protects jobs, quit and Chunk::done.
+         */
+        Mutex mutex;
+        
+        /**
+         * Signalled when a job is queued or the pool should quit.
+         */
+        Cond job_cond;
+        
+        /**
+         * Signalled when a chunk is done.
+         */
+        Cond done_cond;
+        
+        /**
+         * Set to stop the pool threads.
+         */
+        bool quit;
+        
+        /**
+         * Frames signal.
+         */
+        sigc::signal<void, const std::vector<Frame>&> m_signal_frames;
+};
+
+#endif //__CAPTURE_ANALYZER_H
@@ -0,0 +1,108 @@
+/************************************************************************/
+/* CaptureFile                                                          */
+/*                                                                      */
+/* ZigBee Terminal - Capture File Format                                */
+/*                                                                      */
+/* CaptureFile.cpp                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "CaptureFile.h"
+
+#ifdef __unix__
+#include <sys/time.h>
+#elif defined _WIN32
+#include <windows.h>
+#endif
+
+uint64_t CaptureFile::get_timestamp()
+{
+        #ifdef __unix__
+        
+        struct timeval tv;
+        
+        gettimeofday(&tv, 0);
+        
+        return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+        
+        #elif defined _WIN32
+        
+        FILETIME ft;
+        uint64_t t;
+        
+        GetSystemTimeAsFileTime(&ft);
+        
+        // 100 ns intervals since 1601
+        t = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+        
+        return t / 10 - 11644473600000000ULL;
+        
+        #endif
+}
+
+
+uint16_t CaptureFile::read_uint16(const uint8_t *ptr)
+{
+        return (uint16_t)ptr[0] | ((uint16_t)ptr[1] << 8);
+}
+
+
+uint32_t CaptureFile::read_uint32(const uint8_t *ptr)
+{
+        return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) |
+                ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+
+uint64_t CaptureFile::read_uint64(const uint8_t *ptr)
+{
+        return (uint64_t)read_uint32(ptr) | ((uint64_t)read_uint32(ptr + 4) << 32);
+}
+
+
+void CaptureFile::write_uint16(uint8_t *ptr, uint16_t v)
+{
+        ptr[0] = v;
+        ptr[1] = v >> 8;
+}
+
+
+void CaptureFile::write_uint32(uint8_t *ptr, uint32_t v)
+{
+        ptr[0] = v;
+        ptr[1] = v >> 8;
+        ptr[2] = v >> 16;
+        ptr[3] = v >> 24;
+}
+
+
+void CaptureFile::write_uint64(uint8_t *ptr, uint64_t v)
+{
+        write_uint32(ptr, v);
+        write_uint32(ptr + 4, v >> 32);
+}
+
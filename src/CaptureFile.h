@@ -0,0 +1,148 @@
+/************************************************************************/
+/* CaptureFile                                                          */
+/*                                                                      */
+/* ZigBee Terminal - Capture File Format                                */
+/*                                                                      */
+/* CaptureFile.h                                                        */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __CAPTURE_FILE_H
+#define __CAPTURE_FILE_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#define CAPTURE_MAGIC "ZBTCAP\r\n"
+#define CAPTURE_VERSION 1
+#define CAPTURE_HEADER_SIZE 16
+#define CAPTURE_RECORD_HEADER_SIZE 16
+
+/** Capture File
+ * 
+ * Definitions for the binary capture file format.  All integers are
+ * little endian.  
+ * 
+ * The file starts with a 16 byte header:
+ * @li 8 bytes magic, CAPTURE_MAGIC
+ * @li 4 bytes format version, CAPTURE_VERSION
+ * @li 4 bytes flags, see CaptureFlag
+ * 
+ * The header is followed by records, one per chunk of data sent or
+ * received, each with a 16 byte header:
+ * @li 8 bytes timestamp, microseconds since the epoch
+ * @li 4 bytes data length
+ * @li 1 byte direction, see CaptureDirection
+ * @li 3 bytes reserved, zero
+ * 
+ * and then the data bytes as they appeared on the wire.  Records are only
+ * ever appended, so a capture still being written can be read up to its
+ * last complete record.  
+ */
+class CaptureFile
+{
+public:
+        /**
+         * Record direction.
+         */
+        typedef enum
+        {
+                CD_RX = 0,
+                CD_TX = 1,
+        }
+        CaptureDirection;
+        
+        /**
+         * Header flags.
+         */
+        typedef enum
+        {
+                CF_Escaped = 0x0001,    ///< Data is in API mode 2 (escaped) format
+        }
+        CaptureFlag;
+        
+        /**
+         * Capture record.  Data is not owned by the record.
+         */
+        struct Record
+        {
+                uint64_t timestamp;             ///< Microseconds since the epoch
+                CaptureDirection direction;     ///< Direction
+                const uint8_t *data;            ///< Pointer to data
+                size_t length;                  ///< Data length
+        };
+        
+        /**
+         * Get current time.
+         * @return microseconds since the epoch
+         */
+        static uint64_t get_timestamp();
+        
+        /**
+         * Read little endian 16 bit integer.
+         * @param ptr pointer to bytes
+         * @return value
+         */
+        static uint16_t read_uint16(const uint8_t *ptr);
+        
+        /**
+         * Read little endian 32 bit integer.
+         * @param ptr pointer to bytes
+         * @return value
+         */
+        static uint32_t read_uint32(const uint8_t *ptr);
+        
+        /**
+         * Read little endian 64 bit integer.
+         * @param ptr pointer to bytes
+         * @return value
+         */
+        static uint64_t read_uint64(const uint8_t *ptr);
+        
+        /**
+         * Write little endian 16 bit integer.
+         * @param ptr pointer to bytes
+         * @param v value
+         */
+        static void write_uint16(uint8_t *ptr, uint16_t v);
+        
+        /**
+         * Write little endian 32 bit integer.
+         * @param ptr pointer to bytes
+         * @param v value
+         */
+        static void write_uint32(uint8_t *ptr, uint32_t v);
+        
+        /**
+         * Write little endian 64 bit integer.
+         * @param ptr pointer to bytes
+         * @param v value
+         */
+        static void write_uint64(uint8_t *ptr, uint64_t v);
+};
+
+#endif //__CAPTURE_FILE_H
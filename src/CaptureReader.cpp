@@ -0,0 +1,260 @@
+/************************************************************************/
+/* CaptureReader                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Capture File Reader                                */
+/*                                                                      */
+/* CaptureReader.cpp                                                    */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "CaptureReader.h"
+
+#include <iostream>
+#include <string.h>
+
+#ifdef __unix__
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+CaptureReader::CaptureReader() :
+        map(0),
+        map_size(0),
+        pos(0),
+        flags(0)
+{
+        #ifdef __unix__
+        
+        fd = -1;
+        
+        #elif defined _WIN32
+        
+        h_file = INVALID_HANDLE_VALUE;
+        h_mapping = NULL;
+        
+        #endif
+}
+
+
+CaptureReader::~CaptureReader()
+{
+        close();
+}
+
+
+bool CaptureReader::open(const std::string &filename)
+{
+        close();
+        
+        #ifdef __unix__
+        
+        struct stat st;
+        void *ptr;
+        
+        fd = ::open(filename.c_str(), O_RDONLY);
+        
+        if (fd < 0)
+        {
+                std::cerr << "[CaptureReader] Unable to open " << filename << std::endl;
+                return false;
+        }
+        
+        if (fstat(fd, &st) < 0 || st.st_size < CAPTURE_HEADER_SIZE)
+        {
+                std::cerr << "[CaptureReader] Not a capture file: " << filename << std::endl;
+                close();
+                return false;
+        }
+        
+        map_size = st.st_size;
+        ptr = mmap(0, map_size, PROT_READ, MAP_SHARED, fd, 0);
+        
+        if (ptr == MAP_FAILED)
+        {
+                std::cerr << "[CaptureReader] Unable to map " << filename << std::endl;
+                map_size = 0;
+                close();
+                return false;
+        }
+        
+        // records are read front to back
+        madvise(ptr, map_size, MADV_SEQUENTIAL);
+        
+        map = (const uint8_t *)ptr;
+        
+        #elif defined _WIN32
+        
+        LARGE_INTEGER li;
+        
+        h_file = CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+        
+        if (h_file == INVALID_HANDLE_VALUE)
+        {
+                std::cerr << "[CaptureReader] Unable to open " << filename << std::endl;
+                return false;
+        }
+        
+        if (!GetFileSizeEx(h_file, &li) || li.QuadPart < CAPTURE_HEADER_SIZE)
+        {
+                std::cerr << "[CaptureReader] Not a capture file: " << filename << std::endl;
+                close();
+                return false;
+        }
+        
+        map_size = li.QuadPart;
+        h_mapping = CreateFileMapping(h_file, 0, PAGE_READONLY, 0, 0, 0);
+        
+        if (h_mapping)
+                map = (const uint8_t *)MapViewOfFile(h_mapping, FILE_MAP_READ, 0, 0, 0);
+                
+        if (!map)
+        {
+                std::cerr << "[CaptureReader] Unable to map " << filename << std::endl;
+                close();
+                return false;
+        }
+        
+        #endif
+        
+        if (memcmp(map, CAPTURE_MAGIC, 8) != 0 || CaptureFile::read_uint32(map + 8) != CAPTURE_VERSION)
+        {
+                std::cerr << "[CaptureReader] Not a capture file: " << filename << std::endl;
+                close();
+                return false;
+        }
+        
+        flags = CaptureFile::read_uint32(map + 12);
+        pos = CAPTURE_HEADER_SIZE;
+        
+        return true;
+}
+
+
+void CaptureReader::close()
+{
+        #ifdef __unix__
+        
+        if (map)
+                munmap((void *)map, map_size);
+                
+        if (fd >= 0)
+                ::close(fd);
+                
+        fd = -1;
+        
+        #elif defined _WIN32
+        
+        if (map)
+                UnmapViewOfFile(map);
+                
+        if (h_mapping)
+                CloseHandle(h_mapping);
+                
+        if (h_file != INVALID_HANDLE_VALUE)
+                CloseHandle(h_file);
+                
+        h_mapping = NULL;
+        h_file = INVALID_HANDLE_VALUE;
+        
+        #endif
+        
+        map = 0;
+        map_size = 0;
+        pos = 0;
+        flags = 0;
+}
+
+
+bool CaptureReader::is_open()
+{
+        return map != 0;
+}
+
+
+uint32_t CaptureReader::get_flags()
+{
+        return flags;
+}
+
+
+uint64_t CaptureReader::get_size()
+{
+        return map_size;
+}
+
+
+uint64_t CaptureReader::get_position()
+{
+        return pos;
+}
+
+
+bool CaptureReader::read_record(CaptureFile::Record &rec)
+{
+        uint64_t next = pos;
+        
+        if (!read_record_at(next, rec))
+                return false;
+                
+        pos = next;
+        
+        return true;
+}
+
+
+bool CaptureReader::read_record_at(uint64_t &position, CaptureFile::Record &rec) const
+{
+        size_t len;
+        
+        if (!map || position > map_size || map_size - position < CAPTURE_RECORD_HEADER_SIZE)
+                return false;
+                
+        len = CaptureFile::read_uint32(map + position + 8);
+        
+        if (map_size - position - CAPTURE_RECORD_HEADER_SIZE < len)
+                return false;
+                
+        rec.timestamp = CaptureFile::read_uint64(map + position);
+        rec.direction = map[position + 12] == CaptureFile::CD_TX ? CaptureFile::CD_TX : CaptureFile::CD_RX;
+        rec.data = map + position + CAPTURE_RECORD_HEADER_SIZE;
+        rec.length = len;
+        
+        position += CAPTURE_RECORD_HEADER_SIZE + len;
+        
+        return true;
+}
+
+
+void CaptureReader::rewind()
+{
+        if (map)
+                pos = CAPTURE_HEADER_SIZE;
+}
+
@@ -0,0 +1,159 @@
+/************************************************************************/
+/* CaptureReader                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Capture File Reader                                */
+/*                                                                      */
+/* CaptureReader.h                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __CAPTURE_READER_H
+#define __CAPTURE_READER_H
+
+#include "CaptureFile.h"
+
+#include <string>
+#include <stddef.h>
+#include <inttypes.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/** Capture Reader
+ * 
+ * Reads a capture file through a read-only memory map.  Records point
+ * straight into the mapping, so even very large captures can be read
+ * without loading them into memory.  
+ * @see CaptureFile
+ */
+class CaptureReader
+{
+public:
+        /**
+         * Create a Capture Reader.
+         */
+        CaptureReader();
+        virtual ~CaptureReader();
+        
+        /**
+         * Map a capture file and check its header.  Closes any capture
+         * already open.
+         * @param filename file name
+         * @return true on success
+         */
+        bool open(const std::string &filename);
+        
+        /**
+         * Unmap and close the capture file.
+         */
+        void close();
+        
+        /**
+         * Check if a capture file is open.
+         * @return true if open
+         */
+        bool is_open();
+        
+        /**
+         * Get header flags.
+         * @return flags, see CaptureFile::CaptureFlag
+         */
+        uint32_t get_flags();
+        
+        /**
+         * Get file size.
+         * @return size in bytes
+         */
+        uint64_t get_size();
+        
+        /**
+         * Get read position.
+         * @return offset of next record
+         */
+        uint64_t get_position();
+        
+        /**
+         * Read next record.  Record data stays valid until the file is
+         * closed.
+         * @param rec return record
+         * @return true if a record was read, false at end of file or at an
+         * incomplete record
+         */
+        bool read_record(CaptureFile::Record &rec);
+        
+        /**
+         * Read the record at a position, without moving the read position.
+         * Only reads the mapping, so several threads may read records at
+         * once.
+         * @param position offset of record, advanced to the next record
+         * @param rec return record
+         * @return true if a record was read, false at end of file or at an
+         * incomplete record
+         * @see get_position()
+         */
+        bool read_record_at(uint64_t &position, CaptureFile::Record &rec) const;
+        
+        /**
+         * Go back to the first record.
+         */
+        void rewind();
+        
+protected:
+        /**
+         * Start of mapping.
+         */
+        const uint8_t *map;
+        
+        /**
+         * Mapping size.
+         */
+        size_t map_size;
+        
+        /**
+         * Read position.
+         */
+        size_t pos;
+        
+        /**
+         * Header flags.
+         */
+        uint32_t flags;
+        
+        #ifdef __unix__
+        
+        int fd;
+        
+        #elif defined _WIN32
+        
+        HANDLE h_file;
+        HANDLE h_mapping;
+        
+        #endif
+};
+
+#endif //__CAPTURE_READER_H
@@ -0,0 +1,156 @@
+/************************************************************************/
+/* CaptureReplay                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Capture Replay                                     */
+/*                                                                      */
+/* CaptureReplay.cpp                                                    */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "CaptureReplay.h"
+
+const size_t CaptureReplay::max_run_bytes;
+
+CaptureReplay::CaptureReplay() :
+        have_next(false),
+        started(false),
+        time_offset(0),
+        realtime(true)
+{
+        // nothing
+}
+
+
+CaptureReplay::~CaptureReplay()
+{
+        // nothing
+}
+
+
+bool CaptureReplay::open(const std::string &filename)
+{
+        close();
+        
+        if (!reader.open(filename))
+                return false;
+                
+        have_next = reader.read_record(next);
+        
+        return true;
+}
+
+
+void CaptureReplay::close()
+{
+        reader.close();
+        have_next = false;
+        started = false;
+}
+
+
+bool CaptureReplay::is_open()
+{
+        return reader.is_open();
+}
+
+
+bool CaptureReplay::set_realtime(bool r)
+{
+        if (r && !realtime)
+        {
+                // pick up the original timing from the next record
+                started = false;
+        }
+        
+        realtime = r;
+        return realtime;
+}
+
+
+bool CaptureReplay::get_realtime()
+{
+        return realtime;
+}
+
+
+uint32_t CaptureReplay::get_flags()
+{
+        return reader.get_flags();
+}
+
+
+int CaptureReplay::run(uint64_t now)
+{
+        size_t bytes = 0;
+        
+        if (!have_next)
+        {
+                close();
+                return -1;
+        }
+        
+        if (!started)
+        {
+                time_offset = (int64_t)(now - next.timestamp);
+                started = true;
+        }
+        
+        while (have_next)
+        {
+                if (realtime)
+                {
+                        int64_t wait = (int64_t)(next.timestamp + time_offset - now);
+                        
+                        if (wait > 0)
+                        {
+                                // round up so we don't wake up early, and
+                                // check back now and then during long gaps
+                                wait = (wait + 999) / 1000;
+                                return wait < 500 ? wait : 500;
+                        }
+                }
+                else if (bytes >= max_run_bytes)
+                {
+                        return 0;
+                }
+                
+                m_signal_replay_data.emit(next.direction, (const char *)next.data, next.length);
+                bytes += next.length;
+                
+                have_next = reader.read_record(next);
+        }
+        
+        close();
+        return -1;
+}
+
+
+sigc::signal<void, CaptureFile::CaptureDirection, const char*, size_t> CaptureReplay::signal_replay_data()
+{
+        return m_signal_replay_data;
+}
+
@@ -0,0 +1,159 @@
+/************************************************************************/
+/* CaptureReplay                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Capture Replay                                     */
+/*                                                                      */
+/* CaptureReplay.h                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __CAPTURE_REPLAY_H
+#define __CAPTURE_REPLAY_H
+
+#include "CaptureFile.h"
+#include "CaptureReader.h"
+
+#include <sigc++/sigc++.h>
+
+#include <string>
+#include <stddef.h>
+#include <inttypes.h>
+
+/** Capture Replay
+ * 
+ * Plays back the records of a capture file, either with the original
+ * timing or as fast as possible.  The replay is driven by calling run()
+ * from a timer; it emits the records that are due and returns how long to
+ * wait before calling it again.  
+ */
+class CaptureReplay
+{
+public:
+        /**
+         * Create a Capture Replay.
+         */
+        CaptureReplay();
+        virtual ~CaptureReplay();
+        
+        /**
+         * Open a capture file for replay.
+         * @param filename file name
+         * @return true on success
+         */
+        bool open(const std::string &filename);
+        
+        /**
+         * Stop the replay and close the file.
+         */
+        void close();
+        
+        /**
+         * Check if a replay is in progress.
+         * @return true if open
+         */
+        bool is_open();
+        
+        /**
+         * Set original speed mode.  If enabled, records are replayed with the
+         * time between them that they were captured with.  Otherwise they
+         * are replayed as fast as possible.
+         * @param r original speed mode
+         * @return original speed mode
+         */
+        bool set_realtime(bool r);
+        
+        /**
+         * Get original speed mode.
+         * @return original speed mode
+         */
+        bool get_realtime();
+        
+        /**
+         * Get header flags of the capture being replayed.
+         * @return flags, see CaptureFile::CaptureFlag
+         */
+        uint32_t get_flags();
+        
+        /**
+         * Replay records that are due.  In fast mode at most max_run_bytes
+         * of data are replayed per call.
+         * @param now current time in microseconds
+         * @return milliseconds to wait before the next call, or -1 when the
+         * replay has finished
+         */
+        int run(uint64_t now);
+        
+        /**
+         * Replay data signal.
+         * @par Prototype:
+         * <tt>void on_my_%replay_data(CaptureFile::CaptureDirection dir, const char *data, size_t n)</tt>
+         */
+        sigc::signal<void, CaptureFile::CaptureDirection, const char*, size_t> signal_replay_data();
+        
+        /**
+         * Maximum amount of data replayed per call to run().
+         */
+        static const size_t max_run_bytes = 65536;
+        
+protected:
+        /**
+         * Capture reader.
+         */
+        CaptureReader reader;
+        
+        /**
+         * Next record to replay.
+         */
+        CaptureFile::Record next;
+        
+        /**
+         * Next record is valid.
+         */
+        bool have_next;
+        
+        /**
+         * Replay started, time_offset is valid.
+         */
+        bool started;
+        
+        /**
+         * Difference between replay time and capture time.
+         */
+        int64_t time_offset;
+        
+        /**
+         * Original speed mode.
+         */
+        bool realtime;
+        
+        /**
+         * Replay data signal.
+         */
+        sigc::signal<void, CaptureFile::CaptureDirection, const char*, size_t> m_signal_replay_data;
+};
+
+#endif //__CAPTURE_REPLAY_H
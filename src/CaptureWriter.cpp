@@ -0,0 +1,147 @@
+/************************************************************************/
+/* CaptureWriter                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Capture File Writer                                */
+/*                                                                      */
+/* CaptureWriter.cpp                                                    */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "CaptureWriter.h"
+
+#include <iostream>
+#include <string.h>
+
+CaptureWriter::CaptureWriter() :
+        file(0),
+        size(0)
+{
+        // nothing
+}
+
+
+CaptureWriter::~CaptureWriter()
+{
+        close();
+}
+
+
+bool CaptureWriter::open(const std::string &filename, uint32_t flags)
+{
+        uint8_t header[CAPTURE_HEADER_SIZE];
+        
+        close();
+        
+        file = fopen(filename.c_str(), "wb");
+        
+        if (!file)
+        {
+                std::cerr << "[CaptureWriter] Unable to open " << filename << std::endl;
+                return false;
+        }
+        
+        setvbuf(file, 0, _IOFBF, 65536);
+        
+        memcpy(header, CAPTURE_MAGIC, 8);
+        CaptureFile::write_uint32(header + 8, CAPTURE_VERSION);
+        CaptureFile::write_uint32(header + 12, flags);
+        
+        size = 0;
+        
+        if (fwrite(header, 1, CAPTURE_HEADER_SIZE, file) != CAPTURE_HEADER_SIZE)
+        {
+                std::cerr << "[CaptureWriter] Error writing header" << std::endl;
+                close();
+                return false;
+        }
+        
+        size = CAPTURE_HEADER_SIZE;
+        
+        return true;
+}
+
+
+void CaptureWriter::close()
+{
+        if (!file)
+                return;
+                
+        fclose(file);
+        file = 0;
+}
+
+
+bool CaptureWriter::is_open()
+{
+        return file != 0;
+}
+
+
+bool CaptureWriter::write(CaptureFile::CaptureDirection dir, const char *data, size_t count)
+{
+        return write(CaptureFile::get_timestamp(), dir, data, count);
+}
+
+
+bool CaptureWriter::write(uint64_t timestamp, CaptureFile::CaptureDirection dir, const char *data, size_t count)
+{
+        uint8_t header[CAPTURE_RECORD_HEADER_SIZE];
+        
+        if (!file)
+                return false;
+                
+        memset(header, 0, CAPTURE_RECORD_HEADER_SIZE);
+        CaptureFile::write_uint64(header, timestamp);
+        CaptureFile::write_uint32(header + 8, count);
+        header[12] = dir;
+        
+        if (fwrite(header, 1, CAPTURE_RECORD_HEADER_SIZE, file) != CAPTURE_RECORD_HEADER_SIZE ||
+                fwrite(data, 1, count, file) != count)
+        {
+                std::cerr << "[CaptureWriter] Error writing record" << std::endl;
+                close();
+                return false;
+        }
+        
+        size += CAPTURE_RECORD_HEADER_SIZE + count;
+        
+        return true;
+}
+
+
+void CaptureWriter::flush()
+{
+        if (file)
+                fflush(file);
+}
+
+
+uint64_t CaptureWriter::get_size()
+{
+        return size;
+}
+
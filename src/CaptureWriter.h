@@ -0,0 +1,121 @@
+/************************************************************************/
+/* CaptureWriter                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Capture File Writer                                */
+/*                                                                      */
+/* CaptureWriter.h                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __CAPTURE_WRITER_H
+#define __CAPTURE_WRITER_H
+
+#include "CaptureFile.h"
+
+#include <string>
+#include <stdio.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+/** Capture Writer
+ * 
+ * Appends records to a capture file.  Writes go through a stdio buffer, so
+ * recording a chunk costs a copy and, now and then, a write call.  
+ * @see CaptureFile
+ */
+class CaptureWriter
+{
+public:
+        /**
+         * Create a Capture Writer.
+         */
+        CaptureWriter();
+        virtual ~CaptureWriter();
+        
+        /**
+         * Create a capture file and write the file header.  Closes any
+         * capture already open.  Overwrites an existing file.
+         * @param filename file name
+         * @param flags header flags, see CaptureFile::CaptureFlag
+         * @return true on success
+         */
+        bool open(const std::string &filename, uint32_t flags = 0);
+        
+        /**
+         * Flush and close the capture file.
+         */
+        void close();
+        
+        /**
+         * Check if a capture file is open.
+         * @return true if open
+         */
+        bool is_open();
+        
+        /**
+         * Append a record timestamped with the current time.
+         * @param dir direction
+         * @param data pointer to data
+         * @param count number of bytes
+         * @return true on success
+         */
+        bool write(CaptureFile::CaptureDirection dir, const char *data, size_t count);
+        
+        /**
+         * Append a record.
+         * @param timestamp microseconds since the epoch
+         * @param dir direction
+         * @param data pointer to data
+         * @param count number of bytes
+         * @return true on success
+         */
+        bool write(uint64_t timestamp, CaptureFile::CaptureDirection dir, const char *data, size_t count);
+        
+        /**
+         * Flush buffered records to the file.
+         */
+        void flush();
+        
+        /**
+         * Get number of bytes written, including headers.
+         * @return file size
+         */
+        uint64_t get_size();
+        
+protected:
+        /**
+         * File.
+         */
+        FILE *file;
+        
+        /**
+         * Bytes written.
+         */
+        uint64_t size;
+};
+
+#endif //__CAPTURE_WRITER_H
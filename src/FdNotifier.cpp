@@ -0,0 +1,81 @@
+/************************************************************************/
+/* FdNotifier                                                           */
+/*                                                                      */
+/* ZigBee Terminal - File Descriptor Notifier                           */
+/*                                                                      */
+/* FdNotifier.cpp                                                       */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "FdNotifier.h"
+
+#include <iostream>
+#include <errno.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/eventfd.h>
+
+FdNotifier::FdNotifier()
+{
+        fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        
+        if (fd < 0)
+                std::cerr << "[FdNotifier] Unable to create eventfd (errno " << errno << ")" << std::endl;
+}
+
+
+FdNotifier::~FdNotifier()
+{
+        if (fd >= 0)
+                close(fd);
+}
+
+
+void FdNotifier::notify()
+{
+        uint64_t v = 1;
+        
+        if (write(fd, &v, sizeof(v)) < 0 && errno != EAGAIN)
+                std::cerr << "[FdNotifier] Error signaling eventfd (errno " << errno << ")" << std::endl;
+}
+
+
+int FdNotifier::get_fd()
+{
+        return fd;
+}
+
+
+void FdNotifier::dispatch()
+{
+        uint64_t v;
+        
+        // reading resets the counter, coalescing all notifies so far
+        if (read(fd, &v, sizeof(v)) == sizeof(v))
+                m_signal_notify.emit();
+}
+
@@ -0,0 +1,75 @@
+/************************************************************************/
+/* FdNotifier                                                           */
+/*                                                                      */
+/* ZigBee Terminal - File Descriptor Notifier                           */
+/*                                                                      */
+/* FdNotifier.h                                                         */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __FD_NOTIFIER_H
+#define __FD_NOTIFIER_H
+
+#include "Notifier.h"
+
+/** File Descriptor Notifier
+ * 
+ * Notifier for main loops built on poll or select.  notify() makes a file
+ * descriptor readable; the main loop polls it and calls dispatch() when it
+ * is.  Unix only.  
+ */
+class FdNotifier : public Notifier
+{
+public:
+        /**
+         * Create a File Descriptor Notifier.
+         */
+        FdNotifier();
+        virtual ~FdNotifier();
+        
+        virtual void notify();
+        
+        /**
+         * Get file descriptor to poll for reading.
+         * @return file descriptor
+         */
+        int get_fd();
+        
+        /**
+         * Clear the file descriptor and emit the notify signal.  Call from
+         * the main loop when the file descriptor is readable.
+         */
+        void dispatch();
+        
+protected:
+        /**
+         * eventfd.
+         */
+        int fd;
+};
+
+#endif //__FD_NOTIFIER_H
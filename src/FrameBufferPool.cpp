@@ -0,0 +1,119 @@
+/************************************************************************/
+/* FrameBufferPool                                                      */
+/*                                                                      */
+/* ZigBee Terminal - Frame Buffer Pool                                  */
+/*                                                                      */
+/* FrameBufferPool.cpp                                                  */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "FrameBufferPool.h"
+
+FrameBufferPool::FrameBufferPool(size_t buffer_size, size_t max_free) :
+        allocated(0),
+        buffer_size(buffer_size),
+        max_free(max_free)
+{
+        free.reserve(max_free);
+}
+
+
+FrameBufferPool::~FrameBufferPool()
+{
+        for (size_t i = 0; i < free.size(); i++)
+                delete free[i];
+}
+
+
+FrameBufferPool::Buffer *FrameBufferPool::acquire(size_t size)
+{
+        Buffer *buf = 0;
+        
+        {
+                Mutex::Lock lock(mutex);
+                
+                if (!free.empty())
+                {
+                        buf = free.back();
+                        free.pop_back();
+                }
+                else
+                {
+                        allocated++;
+                }
+        }
+        
+        if (!buf)
+        {
+                buf = new Buffer();
+                buf->data.resize(buffer_size);
+        }
+        
+        // grows once per buffer for oversized frames, then stays
+        if (buf->data.size() < size)
+                buf->data.resize(size);
+                
+        buf->length = 0;
+        
+        return buf;
+}
+
+
+void FrameBufferPool::release(Buffer *buf)
+{
+        if (!buf)
+                return;
+                
+        {
+                Mutex::Lock lock(mutex);
+                
+                if (free.size() < max_free)
+                {
+                        free.push_back(buf);
+                        return;
+                }
+                
+                allocated--;
+        }
+        
+        delete buf;
+}
+
+
+size_t FrameBufferPool::get_free_count()
+{
+        Mutex::Lock lock(mutex);
+        return free.size();
+}
+
+
+size_t FrameBufferPool::get_allocated_count()
+{
+        Mutex::Lock lock(mutex);
+        return allocated;
+}
+
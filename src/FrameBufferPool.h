@@ -0,0 +1,124 @@
+/************************************************************************/
+/* FrameBufferPool                                                      */
+/*                                                                      */
+/* ZigBee Terminal - Frame Buffer Pool                                  */
+/*                                                                      */
+/* FrameBufferPool.h                                                    */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __FRAME_BUFFER_POOL_H
+#define __FRAME_BUFFER_POOL_H
+
+#include "Mutex.h"
+
+#include <vector>
+#include <inttypes.h>
+#include <stddef.h>
+
+/** Frame Buffer Pool
+ * 
+ * Pool of reusable byte buffers for encoded frames.  Released buffers keep
+ * their storage and go back on a free list, so once the pool has warmed up
+ * acquiring and releasing a buffer never touches the allocator.  Safe to
+ * use from several threads.  
+ */
+class FrameBufferPool
+{
+public:
+        /**
+         * Frame buffer.
+         */
+        struct Buffer
+        {
+                std::vector<uint8_t> data;      ///< Storage, at least the size asked for
+                size_t length;                  ///< Bytes in use
+        };
+        
+        /**
+         * Create a Frame Buffer Pool.
+         * @param buffer_size initial size of new buffers
+         * @param max_free maximum number of free buffers kept
+         */
+        FrameBufferPool(size_t buffer_size = 256, size_t max_free = 64);
+        virtual ~FrameBufferPool();
+        
+        /**
+         * Get a buffer.
+         * @param size minimum size
+         * @return buffer, data holds at least size bytes and length is 0
+         * @see release()
+         */
+        Buffer *acquire(size_t size);
+        
+        /**
+         * Return a buffer to the pool.
+         * @param buf buffer from acquire()
+         * @see acquire()
+         */
+        void release(Buffer *buf);
+        
+        /**
+         * Get number of free buffers.
+         * @return free buffers
+         */
+        size_t get_free_count();
+        
+        /**
+         * Get number of buffers allocated and not yet deleted.
+         * @return allocated buffers
+         */
+        size_t get_allocated_count();
+        
+protected:
+        /**
+         * Protects free and allocated.
+         */
+        Mutex mutex;
+        
+        /**
+         * Free buffers.  Reserved up front so releasing never allocates.
+         */
+        std::vector<Buffer *> free;
+        
+        /**
+         * Buffers allocated and not yet deleted.
+         */
+        size_t allocated;
+        
+        /**
+         * Initial size of new buffers.
+         */
+        size_t buffer_size;
+        
+        /**
+         * Maximum number of free buffers kept.
+         */
+        size_t max_free;
+};
+
+#endif //__FRAME_BUFFER_POOL_H
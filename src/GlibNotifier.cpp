@@ -0,0 +1,58 @@
+/************************************************************************/
+/* GlibNotifier                                                         */
+/*                                                                      */
+/* ZigBee Terminal - Glib Main Loop Notifier                            */
+/*                                                                      */
+/* GlibNotifier.cpp                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "GlibNotifier.h"
+
+GlibNotifier::GlibNotifier()
+{
+        dispatcher.connect( sigc::mem_fun(*this, &GlibNotifier::on_dispatch) );
+}
+
+
+GlibNotifier::~GlibNotifier()
+{
+        // nothing
+}
+
+
+void GlibNotifier::notify()
+{
+        dispatcher.emit();
+}
+
+
+void GlibNotifier::on_dispatch()
+{
+        m_signal_notify.emit();
+}
+
@@ -0,0 +1,69 @@
+/************************************************************************/
+/* GlibNotifier                                                         */
+/*                                                                      */
+/* ZigBee Terminal - Glib Main Loop Notifier                            */
+/*                                                                      */
+/* GlibNotifier.h                                                       */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __GLIB_NOTIFIER_H
+#define __GLIB_NOTIFIER_H
+
+#include <gtkmm.h>
+
+#include "Notifier.h"
+
+/** Glib Notifier
+ * 
+ * Notifier for the Glib main loop, built on Glib::Dispatcher.  Must be
+ * created on the thread running the main loop.  
+ */
+class GlibNotifier : public Notifier
+{
+public:
+        /**
+         * Create a Glib Notifier.
+         */
+        GlibNotifier();
+        virtual ~GlibNotifier();
+        
+        virtual void notify();
+        
+protected:
+        /**
+         * Dispatcher event handler.
+         */
+        void on_dispatch();
+        
+        /**
+         * Dispatcher.
+         */
+        Glib::Dispatcher dispatcher;
+};
+
+#endif //__GLIB_NOTIFIER_H
@@ -0,0 +1,270 @@
+/************************************************************************/
+/* HexCodec                                                             */
+/*                                                                      */
+/* ZigBee Terminal - Hex Codec                                          */
+/*                                                                      */
+/* HexCodec.cpp                                                         */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "HexCodec.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+        (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define HEX_CODEC_SSSE3
+#include <tmmintrin.h>
+#endif
+
+// digit pairs for every byte value
+static const char hex_pairs[513] =
+        "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+        "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+        "404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+        "606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+        "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+        "a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+        "c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+        "e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+// digit values, -1 for anything else
+static const signed char hex_values[256] = {
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+         0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+        -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+#ifdef HEX_CODEC_SSSE3
+
+// format 8 bytes at a time, spaced, while more than 8 are left so the
+// trailing space of each block still lands inside the output
+__attribute__((target("ssse3")))
+static size_t encode_spaced_ssse3(const uint8_t *data, size_t count, char *out)
+{
+        const __m128i mask = _mm_set1_epi8(0x0f);
+        const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+        // digit pairs to "hh " groups, -1 lanes are zeroed then set to space
+        const __m128i shuf_lo = _mm_setr_epi8(0, 1, -1, 2, 3, -1, 4, 5, -1, 6, 7, -1, 8, 9, -1, 10);
+        const __m128i shuf_hi = _mm_setr_epi8(11, -1, 12, 13, -1, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i space_lo = _mm_setr_epi8(0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0);
+        const __m128i space_hi = _mm_setr_epi8(0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, 0, 0, 0, 0, 0, 0);
+        size_t done = 0;
+        
+        while (count - done > 8)
+        {
+                __m128i v = _mm_loadl_epi64((const __m128i *)(data + done));
+                __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+                __m128i lo = _mm_and_si128(v, mask);
+                __m128i hex = _mm_shuffle_epi8(digits, _mm_unpacklo_epi8(hi, lo));
+                
+                _mm_storeu_si128((__m128i *)out, _mm_or_si128(_mm_shuffle_epi8(hex, shuf_lo), space_lo));
+                _mm_storel_epi64((__m128i *)(out + 16), _mm_or_si128(_mm_shuffle_epi8(hex, shuf_hi), space_hi));
+                
+                out += 24;
+                done += 8;
+        }
+        
+        return done;
+}
+
+// checked once, true if the CPU has SSSE3
+static bool have_ssse3()
+{
+        static int have = -1;
+        
+        if (have < 0)
+        {
+                __builtin_cpu_init();
+                have = __builtin_cpu_supports("ssse3") ? 1 : 0;
+        }
+        
+        return have != 0;
+}
+
+#endif
+
+size_t HexCodec::get_encoded_length(size_t count, bool spaced)
+{
+        if (count == 0)
+                return 0;
+        
+        return spaced ? count * 3 - 1 : count * 2;
+}
+
+
+char *HexCodec::encode(const uint8_t *data, size_t count, char *out, bool spaced)
+{
+        size_t i = 0;
+        
+        if (count == 0)
+                return out;
+        
+        if (!spaced)
+        {
+                for (; i < count; i++)
+                {
+                        memcpy(out, hex_pairs + data[i] * 2, 2);
+                        out += 2;
+                }
+                
+                return out;
+        }
+        
+        #ifdef HEX_CODEC_SSSE3
+        
+        if (count > 8 && have_ssse3())
+        {
+                i = encode_spaced_ssse3(data, count, out);
+                out += i * 3;
+        }
+        
+        #endif
+        
+        for (; i < count - 1; i++)
+        {
+                memcpy(out, hex_pairs + data[i] * 2, 2);
+                out[2] = ' ';
+                out += 3;
+        }
+        
+        memcpy(out, hex_pairs + data[i] * 2, 2);
+        
+        return out + 2;
+}
+
+
+void HexCodec::append(std::string &out, const uint8_t *data, size_t count, bool spaced)
+{
+        size_t pos = out.size();
+        
+        if (count == 0)
+                return;
+        
+        out.resize(pos + get_encoded_length(count, spaced));
+        encode(data, count, &out[pos], spaced);
+}
+
+
+std::string HexCodec::encode(const uint8_t *data, size_t count, bool spaced)
+{
+        std::string out;
+        
+        append(out, data, count, spaced);
+        
+        return out;
+}
+
+
+size_t HexCodec::decode(const char *text, size_t len, uint8_t *out)
+{
+        const char *p = text;
+        const char *end = text + len;
+        uint8_t *start = out;
+        uint64_t v;
+        
+        while (p < end)
+        {
+                int hi = hex_values[(uint8_t)p[0]];
+                int lo = p + 1 < end ? hex_values[(uint8_t)p[1]] : -1;
+                
+                // plain digit pairs, the common case
+                if (hi >= 0 && lo >= 0)
+                {
+                        *out++ = (hi << 4) | lo;
+                        p += 2;
+                        continue;
+                }
+                
+                if (!read_hex(p, end, 2, v))
+                        break;
+                
+                *out++ = v;
+        }
+        
+        return out - start;
+}
+
+
+void HexCodec::decode(const std::string &text, std::vector<uint8_t> &out)
+{
+        out.resize((text.size() + 1) / 2);
+        
+        if (text.empty())
+                return;
+        
+        out.resize(decode(text.data(), text.size(), &out[0]));
+}
+
+
+bool HexCodec::read_hex(const char *&p, const char *end, int max_digits, uint64_t &value)
+{
+        int n = 0;
+        int d;
+        
+        // skip to the first digit, dropping any 0x before it
+        while (p < end && hex_values[(uint8_t)*p] < 0)
+                p++;
+        
+        if (p + 2 < end && p[0] == '0' && (p[1] | 0x20) == 'x' && hex_values[(uint8_t)p[2]] >= 0)
+                p += 2;
+        
+        if (p >= end)
+                return false;
+        
+        value = 0;
+        
+        while (p < end && n < max_digits && (d = hex_values[(uint8_t)*p]) >= 0)
+        {
+                value = (value << 4) | d;
+                p++;
+                n++;
+        }
+        
+        return true;
+}
+
+
+int HexCodec::get_digit_value(char c)
+{
+        return hex_values[(uint8_t)c];
+}
+
@@ -0,0 +1,126 @@
+/************************************************************************/
+/* HexCodec                                                             */
+/*                                                                      */
+/* ZigBee Terminal - Hex Codec                                          */
+/*                                                                      */
+/* HexCodec.h                                                           */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __HEX_CODEC_H
+#define __HEX_CODEC_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <inttypes.h>
+
+/** Hex Codec
+ * 
+ * Table driven hex formatting and parsing, shared by the packet text,
+ * the logs, the builder and debug output.  Bytes are formatted as lower
+ * case digit pairs, optionally separated by spaces ("7e 00 05"), straight
+ * into a caller's buffer; on x86 with SSSE3 the spaced form is built 8
+ * bytes at a time with byte shuffles.  Parsing takes digit pairs and
+ * treats anything else, including 0x prefixes, as a separator, so a
+ * lone digit between separators is a byte of its own.  
+ */
+class HexCodec
+{
+public:
+        /**
+         * Get formatted length.
+         * @param count number of bytes
+         * @param spaced true for a space between bytes
+         * @return number of characters
+         */
+        static size_t get_encoded_length(size_t count, bool spaced = true);
+        
+        /**
+         * Format bytes.  Does not add a terminating nul.
+         * @param data bytes
+         * @param count number of bytes
+         * @param out buffer of at least get_encoded_length() characters
+         * @param spaced true for a space between bytes
+         * @return pointer past the last character written
+         */
+        static char *encode(const uint8_t *data, size_t count, char *out, bool spaced = true);
+        
+        /**
+         * Format bytes onto the end of a string.
+         * @param out string
+         * @param data bytes
+         * @param count number of bytes
+         * @param spaced true for a space between bytes
+         */
+        static void append(std::string &out, const uint8_t *data, size_t count, bool spaced = true);
+        
+        /**
+         * Format bytes.
+         * @param data bytes
+         * @param count number of bytes
+         * @param spaced true for a space between bytes
+         * @return string
+         */
+        static std::string encode(const uint8_t *data, size_t count, bool spaced = true);
+        
+        /**
+         * Parse bytes.
+         * @param text text
+         * @param len text length
+         * @param out buffer of at least (len + 1) / 2 bytes
+         * @return number of bytes written
+         */
+        static size_t decode(const char *text, size_t len, uint8_t *out);
+        
+        /**
+         * Parse bytes.
+         * @param text text
+         * @param out return bytes
+         */
+        static void decode(const std::string &text, std::vector<uint8_t> &out);
+        
+        /**
+         * Parse the next number of up to a number of hex digits.  Skips
+         * separators and 0x prefixes ahead of it.
+         * @param p position in text, moved past the number
+         * @param end end of text
+         * @param max_digits digits per number, up to 16
+         * @param value return value
+         * @return false if no digits are left
+         */
+        static bool read_hex(const char *&p, const char *end, int max_digits, uint64_t &value);
+        
+        /**
+         * Get value of a hex digit.
+         * @param c character
+         * @return 0 to 15, or -1 if not a hex digit
+         */
+        static int get_digit_value(char c);
+};
+
+#endif //__HEX_CODEC_H
@@ -0,0 +1,175 @@
+/************************************************************************/
+/* LatencyHistogram                                                     */
+/*                                                                      */
+/* ZigBee Terminal - Latency Histogram                                  */
+/*                                                                      */
+/* LatencyHistogram.cpp                                                 */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "LatencyHistogram.h"
+#include "Thread.h"
+
+const int LatencyHistogram::bucket_count;
+
+// index of the highest set bit, v must not be 0
+static int msb(uint64_t v)
+{
+        #ifdef __GNUC__
+        
+        return 63 - __builtin_clzll(v);
+        
+        #else
+        
+        int n = 0;
+        while (v >>= 1)
+                n++;
+        return n;
+        
+        #endif
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+        reset();
+}
+
+
+LatencyHistogram::~LatencyHistogram()
+{
+        // nothing
+}
+
+
+void LatencyHistogram::record(uint64_t ns)
+{
+        Thread::atomic_add(&buckets[get_bucket_index(ns)], 1);
+        Thread::atomic_add(&count, 1);
+        Thread::atomic_add(&sum, (int64_t)ns);
+}
+
+
+void LatencyHistogram::reset()
+{
+        for (int i = 0; i < bucket_count; i++)
+                Thread::atomic_set(&buckets[i], 0);
+        
+        Thread::atomic_add(&count, -Thread::atomic_get(&count));
+        Thread::atomic_add(&sum, -Thread::atomic_get(&sum));
+}
+
+
+uint64_t LatencyHistogram::get_count() const
+{
+        return Thread::atomic_get((volatile int64_t *)&count);
+}
+
+
+uint64_t LatencyHistogram::get_mean() const
+{
+        int64_t n = Thread::atomic_get((volatile int64_t *)&count);
+        
+        if (n <= 0)
+                return 0;
+        
+        return Thread::atomic_get((volatile int64_t *)&sum) / n;
+}
+
+
+uint64_t LatencyHistogram::get_percentile(double p) const
+{
+        uint64_t total = 0;
+        uint64_t seen = 0;
+        uint64_t target;
+        
+        // total from the buckets themselves, so it matches what is scanned
+        for (int i = 0; i < bucket_count; i++)
+                total += get_bucket(i);
+        
+        if (total == 0)
+                return 0;
+        
+        target = (uint64_t)(total * p / 100.0 + 0.5);
+        if (target < 1)
+                target = 1;
+        if (target > total)
+                target = total;
+        
+        for (int i = 0; i < bucket_count; i++)
+        {
+                seen += get_bucket(i);
+                
+                if (seen >= target)
+                        return get_bucket_high(i);
+        }
+        
+        return get_bucket_high(bucket_count - 1);
+}
+
+
+uint32_t LatencyHistogram::get_bucket(int index) const
+{
+        if (index < 0 || index >= bucket_count)
+                return 0;
+        
+        return Thread::atomic_get((volatile int *)&buckets[index]);
+}
+
+
+int LatencyHistogram::get_bucket_index(uint64_t ns)
+{
+        int e;
+        
+        if (ns < 16)
+                return ns;
+        
+        // 8 buckets per power of two, by the three bits below the top one
+        e = msb(ns);
+        return 16 + (e - 4) * 8 + (int)((ns >> (e - 3)) & 7);
+}
+
+
+uint64_t LatencyHistogram::get_bucket_low(int index)
+{
+        int e;
+        
+        if (index < 16)
+                return index;
+        
+        e = (index - 16) / 8 + 4;
+        return (uint64_t)(8 + (index - 16) % 8) << (e - 3);
+}
+
+
+uint64_t LatencyHistogram::get_bucket_high(int index)
+{
+        if (index >= bucket_count - 1)
+                return ~(uint64_t)0;
+        
+        return get_bucket_low(index + 1) - 1;
+}
+
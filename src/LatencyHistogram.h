@@ -0,0 +1,140 @@
+/************************************************************************/
+/* LatencyHistogram                                                     */
+/*                                                                      */
+/* ZigBee Terminal - Latency Histogram                                  */
+/*                                                                      */
+/* LatencyHistogram.h                                                   */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __LATENCY_HISTOGRAM_H
+#define __LATENCY_HISTOGRAM_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+/** Latency Histogram
+ * 
+ * Log-linear histogram of durations in nanoseconds, in the style of HDR
+ * histograms: values below 16 ns get a bucket each, then every power of
+ * two is split into 8 buckets, so any value is known to within 12.5%
+ * from 1 ns up to the full 64-bit range in a fixed 496 buckets.
+ * Recording is a bit scan and two atomic adds, with no locks, so one
+ * thread can record while others read.  Reads are not a snapshot; counts
+ * recorded during a read may or may not be seen.  
+ */
+class LatencyHistogram
+{
+public:
+        /**
+         * Number of buckets.
+         */
+        static const int bucket_count = 496;
+        
+        /**
+         * Create a Latency Histogram.
+         */
+        LatencyHistogram();
+        virtual ~LatencyHistogram();
+        
+        /**
+         * Record a duration.
+         * @param ns duration in nanoseconds
+         */
+        void record(uint64_t ns);
+        
+        /**
+         * Clear all counts.
+         */
+        void reset();
+        
+        /**
+         * Get number of durations recorded.
+         * @return count
+         */
+        uint64_t get_count() const;
+        
+        /**
+         * Get mean duration.
+         * @return mean in nanoseconds, 0 if empty
+         */
+        uint64_t get_mean() const;
+        
+        /**
+         * Get a percentile.
+         * @param p percentile, 0 to 100
+         * @return highest duration in the bucket holding the percentile,
+         * in nanoseconds, 0 if empty
+         */
+        uint64_t get_percentile(double p) const;
+        
+        /**
+         * Get bucket count.
+         * @param index bucket index
+         * @return durations recorded in the bucket
+         */
+        uint32_t get_bucket(int index) const;
+        
+        /**
+         * Get bucket of a duration.
+         * @param ns duration in nanoseconds
+         * @return bucket index
+         */
+        static int get_bucket_index(uint64_t ns);
+        
+        /**
+         * Get lowest duration in a bucket.
+         * @param index bucket index
+         * @return duration in nanoseconds
+         */
+        static uint64_t get_bucket_low(int index);
+        
+        /**
+         * Get highest duration in a bucket.
+         * @param index bucket index
+         * @return duration in nanoseconds
+         */
+        static uint64_t get_bucket_high(int index);
+        
+protected:
+        /**
+         * Counts by bucket.
+         */
+        volatile int buckets[bucket_count];
+        
+        /**
+         * Number of durations recorded.
+         */
+        volatile int64_t count;
+        
+        /**
+         * Sum of durations recorded.
+         */
+        volatile int64_t sum;
+};
+
+#endif //__LATENCY_HISTOGRAM_H
@@ -0,0 +1,651 @@
+/************************************************************************/
+/* LoadGenerator                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Load Generator                                     */
+/*                                                                      */
+/* LoadGenerator.cpp                                                    */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "LoadGenerator.h"
+#include "Metrics.h"
+
+#include <sstream>
+#include <iomanip>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+// names, in LoadPattern order
+static const char *pattern_names[LoadGenerator::LGP_Count] = {
+        "template", "counter", "increment", "random"
+};
+
+LoadGenerator::Sweep::Sweep() :
+        window(255),
+        pattern(LGP_Template),
+        payload_length(0),
+        count(1000),
+        rate(0),
+        timeout(5000)
+{
+        // nothing
+}
+
+
+LoadGenerator::LoadGenerator() :
+        zb_int(0),
+        length(0),
+        seed(0),
+        batch_count(0),
+        batch_bytes(0),
+        response(0),
+        pending(0),
+        run(0),
+        saved_window(1),
+        dispatching(false),
+        next(0),
+        succeeded(0),
+        failed(0),
+        timed_out(0),
+        start_time(0),
+        end_time(0),
+        running(false)
+{
+        // nothing
+}
+
+
+LoadGenerator::~LoadGenerator()
+{
+        set_zigbee_interface(0);
+}
+
+
+void LoadGenerator::set_zigbee_interface(ZigBeeInterface *zb)
+{
+        stop();
+        
+        c_write_space.disconnect();
+        
+        zb_int = zb;
+        
+        if (!zb_int)
+                return;
+        
+        c_write_space = zb_int->signal_write_space().connect( sigc::mem_fun(*this, &LoadGenerator::on_write_space) );
+}
+
+
+bool LoadGenerator::prepare(const ZigBeePacket &t, const Sweep &s, bool escaped, std::string &error)
+{
+        ZigBeePacket pkt;
+        std::vector<uint8_t> scratch;
+        size_t off = 0;
+        
+        stop();
+        
+        batch.clear();
+        offsets.clear();
+        batch_count = 0;
+        batch_bytes = 0;
+        
+        tmpl = t;
+        if (!tmpl.set_layout())
+        {
+                error = "Unknown frame type";
+                return false;
+        }
+        
+        if (s.count == 0)
+        {
+                error = "No frames to send";
+                return false;
+        }
+        
+        if (s.window > 255)
+        {
+                error = "Window is more than 255 frames";
+                return false;
+        }
+        
+        sweep = s;
+        
+        // frames are only matched when the type has a status response
+        response = ZigBeePacket::get_response_identifier(tmpl.identifier);
+        if (s.window == 0)
+                response = 0;
+        
+        tmpl_data = t.data;
+        length = s.payload_length ? s.payload_length : t.data.size();
+        if (tmpl_data.empty() && length > 0 && s.pattern == LGP_Template)
+                tmpl_data.assign(1, 0);
+        
+        seed = 0x2545f491;
+        
+        if (!response)
+                offsets.reserve(s.count + 1);
+        
+        for (size_t i = 0; i < s.count; i++)
+        {
+                if (!build_frame(i, pkt))
+                {
+                        error = "Unable to build frame";
+                        batch.clear();
+                        offsets.clear();
+                        return false;
+                }
+                
+                // requests are built again as they are sent, only count them
+                if (response)
+                {
+                        scratch.resize(pkt.get_max_encoded_length(escaped));
+                        batch_bytes += pkt.encode(&scratch[0], scratch.size(), escaped);
+                        continue;
+                }
+                
+                offsets.push_back(off);
+                
+                batch.resize(off + pkt.get_max_encoded_length(escaped));
+                off += pkt.encode(&batch[off], batch.size() - off, escaped);
+        }
+        
+        if (!response)
+        {
+                offsets.push_back(off);
+                batch.resize(off);
+                batch_bytes = off;
+        }
+        
+        batch_count = s.count;
+        
+        return true;
+}
+
+
+bool LoadGenerator::build_frame(size_t index, ZigBeePacket &pkt)
+{
+        pkt = tmpl;
+        
+        if (!sweep.destinations.empty())
+        {
+                const Destination &d = sweep.destinations[index % sweep.destinations.size()];
+                
+                pkt.set_field_value(ZigBeePacket::ZBPF_Dest64, d.addr64);
+                pkt.set_field_value(ZigBeePacket::ZBPF_Dest16, d.addr16);
+        }
+        
+        // send_request() gives requests their frame ID
+        pkt.set_field_value(ZigBeePacket::ZBPF_FrameID, response ? 1 : 0);
+        
+        pkt.data.resize(length);
+        
+        switch (sweep.pattern)
+        {
+                case LGP_Template:
+                        for (size_t j = 0; j < length; j++)
+                                pkt.data[j] = tmpl_data[j % tmpl_data.size()];
+                        break;
+                case LGP_Counter:
+                        for (size_t j = 0; j < length; j++)
+                        {
+                                if (j < 4)
+                                        pkt.data[j] = index >> (24 - j * 8);
+                                else
+                                        pkt.data[j] = j < tmpl_data.size() ? tmpl_data[j] : 0;
+                        }
+                        break;
+                case LGP_Increment:
+                        for (size_t j = 0; j < length; j++)
+                                pkt.data[j] = index + j;
+                        break;
+                default:
+                        // xorshift, fixed seed so runs can be compared
+                        for (size_t j = 0; j < length; j++)
+                        {
+                                seed ^= seed << 13;
+                                seed ^= seed >> 17;
+                                seed ^= seed << 5;
+                                pkt.data[j] = seed;
+                        }
+                        break;
+        }
+        
+        return pkt.build_packet();
+}
+
+
+uint64_t LoadGenerator::get_dest64(size_t index)
+{
+        if (sweep.destinations.empty())
+                return tmpl.dest64;
+        
+        return sweep.destinations[index % sweep.destinations.size()].addr64;
+}
+
+
+bool LoadGenerator::start()
+{
+        if (!zb_int || !zb_int->is_connected() || batch_count == 0)
+                return false;
+        
+        stop();
+        
+        pending = 0;
+        run++;
+        
+        // the interface window is what paces the requests
+        if (response)
+        {
+                saved_window = zb_int->get_window();
+                zb_int->set_window(sweep.window);
+                seed = 0x2545f491;
+        }
+        
+        next = 0;
+        succeeded = 0;
+        failed = 0;
+        timed_out = 0;
+        latency.reset();
+        
+        start_time = Metrics::now();
+        end_time = 0;
+        running = true;
+        
+        dispatch();
+        
+        return true;
+}
+
+
+void LoadGenerator::stop()
+{
+        if (!running)
+                return;
+        
+        if (response && zb_int)
+                zb_int->set_window(saved_window);
+        
+        pending = 0;
+        
+        running = false;
+        end_time = Metrics::now();
+}
+
+
+bool LoadGenerator::is_running()
+{
+        return running;
+}
+
+
+int LoadGenerator::dispatch()
+{
+        uint64_t now;
+        uint64_t wait = 0;
+        int expire;
+        bool held = false;
+        NetworkTopology *topology;
+        
+        if (!running || dispatching)
+                return running ? idle_interval : -1;
+        
+        now = Metrics::now();
+        
+        if (!zb_int->is_connected())
+        {
+                finish(now);
+                return -1;
+        }
+        
+        dispatching = true;
+        
+        topology = zb_int->get_topology();
+        
+        // expire requests in flight, and find the next to expire
+        expire = zb_int->check_timeouts();
+        if (expire >= 0)
+                wait = (uint64_t)expire * 1000000;
+        
+        // queue what is due while the port keeps up, requests a frame at a
+        // time while the window has room, others a slice at a time
+        while (running && next < batch_count && !held)
+        {
+                size_t due = batch_count;
+                size_t first = next;
+                
+                if (zb_int->is_write_blocked())
+                {
+                        held = true;
+                        break;
+                }
+                
+                if (sweep.rate > 0)
+                        due = std::min(batch_count, (size_t)((now - start_time) * sweep.rate / 1e9) + 1);
+                
+                if (next >= due)
+                        break;
+                
+                if (response)
+                {
+                        // a request left queued means the window is full
+                        if (zb_int->get_queued_request_count() > 0)
+                        {
+                                held = true;
+                                break;
+                        }
+                        
+                        if (!build_frame(next, request_pkt) ||
+                                !zb_int->send_request(request_pkt, sigc::bind(sigc::mem_fun(*this, &LoadGenerator::on_request_done), run, now), sweep.timeout))
+                        {
+                                dispatching = false;
+                                finish(now);
+                                return -1;
+                        }
+                        
+                        pending++;
+                        next++;
+                        continue;
+                }
+                
+                while (next < due && (next == first || offsets[next + 1] - offsets[first] <= max_chunk))
+                {
+                        // a route the radio lacks goes out just ahead of
+                        // the frame, requests get theirs from send_packet()
+                        if (topology && topology->get_source_route(tmpl.identifier, get_dest64(next), route_pkt))
+                        {
+                                if (next > first && !zb_int->send_encoded(&batch[offsets[first]], offsets[next] - offsets[first]))
+                                {
+                                        dispatching = false;
+                                        finish(now);
+                                        return -1;
+                                }
+                                
+                                zb_int->send_packet(route_pkt);
+                                first = next;
+                        }
+                        
+                        next++;
+                }
+                
+                if (!zb_int->send_encoded(&batch[offsets[first]], offsets[next] - offsets[first]))
+                {
+                        dispatching = false;
+                        finish(now);
+                        return -1;
+                }
+        }
+        
+        dispatching = false;
+        
+        if (!running)
+                return -1;
+        
+        // done once the last frame is answered, or written if there is no
+        // status to wait for
+        if (next >= batch_count && pending == 0)
+        {
+                if (zb_int->get_queued_write_count() == 0)
+                {
+                        finish(now);
+                        return -1;
+                }
+                
+                return drain_interval;
+        }
+        
+        // held frames go on write space or completion, not on a timer
+        if (sweep.rate > 0 && next < batch_count && !held)
+        {
+                uint64_t due_at = start_time + (uint64_t)(next * 1e9 / sweep.rate);
+                
+                if (due_at > now && (wait == 0 || due_at - now < wait))
+                        wait = due_at - now;
+        }
+        
+        if (wait == 0)
+                return idle_interval;
+        
+        return std::min<uint64_t>(idle_interval, (wait + 999999) / 1000000);
+}
+
+
+void LoadGenerator::on_request_done(ZigBeeInterface::RequestStatus status, const ZigBeePacket &pkt, unsigned int run_id, uint64_t sent)
+{
+        uint8_t result;
+        
+        if (!running || run_id != run)
+                return;
+        
+        pending--;
+        
+        switch (status)
+        {
+                case ZigBeeInterface::RS_Success:
+                        latency.record(Metrics::now() - sent);
+                        
+                        // S2 transmit status reports delivery separately
+                        result = pkt.identifier == ZigBeePacket::ZBPID_TxStatusS2 ? pkt.delivery_status : pkt.status;
+                        if (result == 0)
+                                succeeded++;
+                        else
+                                failed++;
+                        break;
+                case ZigBeeInterface::RS_Timeout:
+                        timed_out++;
+                        break;
+                default:
+                        // port closed, dispatch() ends the run
+                        break;
+        }
+        
+        // room in the window may let held frames go
+        dispatch();
+}
+
+
+void LoadGenerator::on_write_space()
+{
+        if (running)
+                dispatch();
+}
+
+
+void LoadGenerator::finish(uint64_t now)
+{
+        stop();
+        
+        end_time = now;
+        
+        m_signal_finished.emit();
+}
+
+
+size_t LoadGenerator::get_batch_count()
+{
+        return batch_count;
+}
+
+
+size_t LoadGenerator::get_batch_bytes()
+{
+        return batch_bytes;
+}
+
+
+size_t LoadGenerator::get_sent()
+{
+        return next;
+}
+
+
+size_t LoadGenerator::get_succeeded()
+{
+        return succeeded;
+}
+
+
+size_t LoadGenerator::get_failed()
+{
+        return failed;
+}
+
+
+size_t LoadGenerator::get_timed_out()
+{
+        return timed_out;
+}
+
+
+uint64_t LoadGenerator::get_elapsed()
+{
+        if (start_time == 0)
+                return 0;
+        
+        return (running ? Metrics::now() : end_time) - start_time;
+}
+
+
+double LoadGenerator::get_rate()
+{
+        uint64_t elapsed = get_elapsed();
+        
+        return elapsed ? next * 1e9 / elapsed : 0;
+}
+
+
+const LatencyHistogram &LoadGenerator::get_latency()
+{
+        return latency;
+}
+
+
+std::string LoadGenerator::get_report()
+{
+        std::ostringstream s;
+        size_t answered = succeeded + failed;
+        
+        s << std::fixed << std::setprecision(1);
+        
+        s << std::left << std::setw(24) << "batch" << batch_count << " frames, " << batch_bytes << " bytes" << std::endl;
+        s << std::left << std::setw(24) << "sent" << next << " frames in " << std::setprecision(3) << get_elapsed() / 1e9 << std::setprecision(1) << " s" << std::endl;
+        s << std::left << std::setw(24) << "rate" << get_rate() << " frames/s" << std::endl;
+        
+        if (!response)
+                return s.str();
+        
+        s << std::left << std::setw(24) << "status" << succeeded << " ok, " << failed << " failed, " << timed_out << " timed out" << std::endl;
+        
+        if (answered + timed_out > 0)
+                s << std::left << std::setw(24) << "success rate" << succeeded * 100.0 / (answered + timed_out) << " %" << std::endl;
+        
+        s << std::left << std::setw(24) << "queue to status" << "n=" << latency.get_count();
+        
+        if (latency.get_count() > 0)
+        {
+                s << " mean=" << Metrics::format_duration(latency.get_mean())
+                        << " p50=" << Metrics::format_duration(latency.get_percentile(50))
+                        << " p90=" << Metrics::format_duration(latency.get_percentile(90))
+                        << " p99=" << Metrics::format_duration(latency.get_percentile(99))
+                        << " max=" << Metrics::format_duration(latency.get_percentile(100));
+        }
+        
+        s << std::endl;
+        
+        return s.str();
+}
+
+
+bool LoadGenerator::parse_destinations(const std::string &str, std::vector<Destination> &dests, std::string &error)
+{
+        const char *p = str.c_str();
+        
+        dests.clear();
+        
+        while (*p)
+        {
+                Destination d;
+                char *end;
+                
+                if (*p == ',' || *p == ' ' || *p == '\t' || *p == '\n')
+                {
+                        p++;
+                        continue;
+                }
+                
+                d.addr64 = strtoull(p, &end, 16);
+                d.addr16 = 0xfffe;
+                
+                if (end != p && *end == ':')
+                {
+                        p = end + 1;
+                        d.addr16 = strtoul(p, &end, 16);
+                }
+                
+                if (end == p || (*end && *end != ',' && *end != ' ' && *end != '\t' && *end != '\n'))
+                {
+                        error = "Bad destination: " + std::string(p, strcspn(p, ", \t\n"));
+                        return false;
+                }
+                
+                dests.push_back(d);
+                p = end;
+        }
+        
+        return true;
+}
+
+
+bool LoadGenerator::parse_pattern(const std::string &str, LoadPattern &pattern)
+{
+        for (int i = 0; i < LGP_Count; i++)
+        {
+                if (str == pattern_names[i])
+                {
+                        pattern = (LoadPattern)i;
+                        return true;
+                }
+        }
+        
+        return false;
+}
+
+
+const char *LoadGenerator::get_pattern_name(LoadPattern pattern)
+{
+        if (pattern < 0 || pattern >= LGP_Count)
+                return "";
+        
+        return pattern_names[pattern];
+}
+
+
+sigc::signal<void> LoadGenerator::signal_finished()
+{
+        return m_signal_finished;
+}
+
@@ -0,0 +1,425 @@
+/************************************************************************/
+/* LoadGenerator                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Load Generator                                     */
+/*                                                                      */
+/* LoadGenerator.h                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __LOAD_GENERATOR_H
+#define __LOAD_GENERATOR_H
+
+#include <sigc++/sigc++.h>
+
+#include "ZigBeePacket.h"
+#include "ZigBeePacketView.h"
+#include "ZigBeeInterface.h"
+#include "LatencyHistogram.h"
+
+#include <string>
+#include <vector>
+#include <inttypes.h>
+
+/** Load Generator
+ * 
+ * Bulk transmit for soak testing.  A template frame is swept over a list
+ * of destinations and payload patterns, and sent either as fast as the
+ * port takes it or at a fixed rate.  With a window, each frame is sent
+ * with ZigBeeInterface::send_request(), which gives it a frame ID and
+ * matches its status response, and the window is the number of frames
+ * awaiting status at once; the completions give the success rate and the
+ * time from queueing to status.  Without one, the whole batch is encoded
+ * up front so that sending is only copying slices of it into the
+ * asynchronous transmit queue; when the interface has a topology, the
+ * source routes it has for the destinations are sent between slices.  Runs on the main loop: dispatch() is
+ * called when the delay it returns runs out and on write space.  
+ */
+class LoadGenerator : public sigc::trackable
+{
+public:
+        /**
+         * Payload patterns.
+         */
+        typedef enum
+        {
+                LGP_Template = 0,               ///< Template data, repeated to the payload length
+                LGP_Counter = 1,                ///< Template data led by a 32-bit big endian sequence number
+                LGP_Increment = 2,              ///< Bytes counting up from the sequence number
+                LGP_Random = 3,                 ///< Pseudo random bytes, the same every run
+                LGP_Count
+        }
+        LoadPattern;
+        
+        /**
+         * Destination addresses.
+         */
+        struct Destination
+        {
+                uint64_t addr64;                ///< 64-bit address
+                uint16_t addr16;                ///< 16-bit address
+        };
+        
+        /**
+         * Sweep definition.
+         */
+        struct Sweep
+        {
+                std::vector<Destination> destinations;  ///< Destinations taken in turn, empty for the template's
+                size_t window;                          ///< Frames awaiting status at once, 1 to 255, 0 for no status
+                LoadPattern pattern;                    ///< Payload pattern
+                size_t payload_length;                  ///< Data bytes, 0 for the template's
+                size_t count;                           ///< Frames to send
+                double rate;                            ///< Frames per second, 0 for as fast as possible
+                unsigned int timeout;                   ///< Status timeout in ms
+                
+                /**
+                 * Create a sweep of 1000 frames with a window of 255 at
+                 * full speed with the template payload and a 5 s timeout.
+                 */
+                Sweep();
+        };
+        
+        /**
+         * Create a Load Generator.
+         */
+        LoadGenerator();
+        virtual ~LoadGenerator();
+        
+        /**
+         * Set ZigBee interface to send through.  Stops any run.
+         * @param zb ZigBee interface, 0 for none
+         */
+        void set_zigbee_interface(ZigBeeInterface *zb);
+        
+        /**
+         * Prepare a batch, encoding it unless it waits for status.  Stops
+         * any run.
+         * @param tmpl template frame
+         * @param sweep sweep definition
+         * @param escaped encode for API mode 2
+         * @param error return reason if not prepared
+         * @return true if prepared
+         */
+        bool prepare(const ZigBeePacket &tmpl, const Sweep &sweep, bool escaped, std::string &error);
+        
+        /**
+         * Start sending the prepared batch.  Clears the results.  With a
+         * window, the window of the ZigBee interface is set to it until
+         * the run ends.
+         * @return true if started
+         * @see dispatch()
+         */
+        bool start();
+        
+        /**
+         * Stop sending.  Frames in flight are no longer tracked and are
+         * left to time out in the ZigBee interface.
+         */
+        void stop();
+        
+        /**
+         * Check running.
+         * @return true while frames are left to send or in flight
+         */
+        bool is_running();
+        
+        /**
+         * Send frames that are due and expire frames in flight.  Also
+         * called on write space and on request completion.
+         * @return ms until dispatch() should be called again, or -1 once
+         * not running
+         */
+        int dispatch();
+        
+        /**
+         * Get frames in the prepared batch.
+         * @return frames
+         */
+        size_t get_batch_count();
+        
+        /**
+         * Get bytes in the prepared batch, with frame ID 1 for frames
+         * that wait for status.
+         * @return bytes
+         */
+        size_t get_batch_bytes();
+        
+        /**
+         * Get frames queued.
+         * @return frames
+         */
+        size_t get_sent();
+        
+        /**
+         * Get status responses with success status.
+         * @return responses
+         */
+        size_t get_succeeded();
+        
+        /**
+         * Get status responses with failure status.
+         * @return responses
+         */
+        size_t get_failed();
+        
+        /**
+         * Get frames that timed out without a status.
+         * @return frames
+         */
+        size_t get_timed_out();
+        
+        /**
+         * Get time since start, up to the end of the run.
+         * @return time in ns
+         */
+        uint64_t get_elapsed();
+        
+        /**
+         * Get achieved rate.
+         * @return frames queued per second
+         */
+        double get_rate();
+        
+        /**
+         * Get queue to status latencies.
+         * @return histogram
+         */
+        const LatencyHistogram &get_latency();
+        
+        /**
+         * Get results as text, one item per line.
+         * @return report
+         */
+        std::string get_report();
+        
+        /**
+         * Parse a destination list.  Destinations are separated by commas
+         * or spaces, each a hex 64-bit address with an optional hex 16-bit
+         * address after a colon, fffe if left out.
+         * @param str text
+         * @param dests return destinations
+         * @param error return reason if not parsed
+         * @return true if parsed
+         */
+        static bool parse_destinations(const std::string &str, std::vector<Destination> &dests, std::string &error);
+        
+        /**
+         * Parse a pattern name.
+         * @param str template, counter, increment or random
+         * @param pattern return pattern
+         * @return true if known
+         */
+        static bool parse_pattern(const std::string &str, LoadPattern &pattern);
+        
+        /**
+         * Get pattern name.
+         * @param pattern pattern
+         * @return name
+         */
+        static const char *get_pattern_name(LoadPattern pattern);
+        
+        /**
+         * Finished signal, emitted once every frame has been written and
+         * answered or timed out.
+         * @par Prototype:
+         * <tt>void on_my_%finished()</tt>
+         */
+        sigc::signal<void> signal_finished();
+        
+protected:
+        /**
+         * Build a frame of the batch.  Frames must be built in order, the
+         * random pattern carries on from one frame to the next.
+         * @param index frame index
+         * @param pkt return frame, built
+         * @return true if built
+         */
+        bool build_frame(size_t index, ZigBeePacket &pkt);
+        
+        /**
+         * Get the destination of a frame of the batch.
+         * @param index frame index
+         * @return 64-bit address
+         */
+        uint64_t get_dest64(size_t index);
+        
+        /**
+         * Request completion handler.
+         * @param status completion status
+         * @param pkt status response, or the frame if not answered
+         * @param run_id run the frame was sent in
+         * @param sent queue time in ns
+         */
+        void on_request_done(ZigBeeInterface::RequestStatus status, const ZigBeePacket &pkt, unsigned int run_id, uint64_t sent);
+        
+        /**
+         * Write space event handler.
+         */
+        void on_write_space();
+        
+        /**
+         * End the run.
+         * @param now time in ns
+         */
+        void finish(uint64_t now);
+        
+        /**
+         * ZigBee interface, not owned.
+         */
+        ZigBeeInterface *zb_int;
+        
+        /**
+         * Write space signal connection.
+         */
+        sigc::connection c_write_space;
+        
+        /**
+         * Template frame, laid out.
+         */
+        ZigBeePacket tmpl;
+        
+        /**
+         * Template data the payload patterns are made from.
+         */
+        std::vector<uint8_t> tmpl_data;
+        
+        /**
+         * Data bytes per frame.
+         */
+        size_t length;
+        
+        /**
+         * Random pattern state.
+         */
+        uint32_t seed;
+        
+        /**
+         * Encoded frames, back to back.  Empty for a batch that waits for
+         * status, those frames are built as they are sent.
+         */
+        std::vector<uint8_t> batch;
+        
+        /**
+         * Offset of each frame in batch, and the end.
+         */
+        std::vector<size_t> offsets;
+        
+        /**
+         * Frames and bytes in the prepared batch.
+         */
+        size_t batch_count;
+        size_t batch_bytes;
+        
+        /**
+         * Sweep of the prepared batch.
+         */
+        Sweep sweep;
+        
+        /**
+         * Status response identifier, 0 if the batch does not wait for
+         * status.
+         */
+        int response;
+        
+        /**
+         * Frame being sent as a request.
+         */
+        ZigBeePacket request_pkt;
+        
+        /**
+         * Create Source Route frame sent ahead of a pre-encoded frame.
+         */
+        ZigBeePacket route_pkt;
+        
+        /**
+         * Requests sent in this run and not yet completed.
+         */
+        size_t pending;
+        
+        /**
+         * Run number, so completions of a stopped run are ignored.
+         */
+        unsigned int run;
+        
+        /**
+         * Window of the ZigBee interface before the run.
+         */
+        size_t saved_window;
+        
+        /**
+         * Set while dispatch() runs, completions it causes do not call it
+         * again.
+         */
+        bool dispatching;
+        
+        /**
+         * Index of the next frame to send.
+         */
+        size_t next;
+        
+        // results of the current or last run
+        size_t succeeded;
+        size_t failed;
+        size_t timed_out;
+        uint64_t start_time;
+        uint64_t end_time;
+        
+        /**
+         * Queue to status latencies.
+         */
+        LatencyHistogram latency;
+        
+        /**
+         * Running flag.
+         */
+        bool running;
+        
+        /**
+         * Most bytes queued per write, so the write limit is checked often.
+         */
+        static const size_t max_chunk = 16384;
+        
+        /**
+         * Longest wait returned by dispatch(), in ms.  Frames held for
+         * write space or a status are sent from those events, this only
+         * bounds how late the caller's timer gets back.
+         */
+        static const int idle_interval = 100;
+        
+        /**
+         * Wait between checks for the transmit queue to drain, in ms.
+         */
+        static const int drain_interval = 10;
+        
+        /**
+         * Finished signal.
+         */
+        sigc::signal<void> m_signal_finished;
+};
+
+#endif //__LOAD_GENERATOR_H
@@ -0,0 +1,274 @@
+/************************************************************************/
+/* LoadTestDialog                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Load Test Dialog                                   */
+/*                                                                      */
+/* LoadTestDialog.cpp                                                   */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "LoadTestDialog.h"
+
+LoadTestDialog::LoadTestDialog() :
+        spin_window(1.0, 0),
+        spin_payload(1.0, 0),
+        spin_count(100.0, 0),
+        spin_rate(10.0, 1),
+        spin_timeout(100.0, 0),
+        zb_int(0)
+{
+        LoadGenerator::Sweep sweep;
+        
+        set_title("Load Test");
+        set_border_width(5);
+        set_default_size(520, 480);
+        
+        btn_start = add_button(Gtk::Stock::MEDIA_PLAY, Gtk::RESPONSE_NONE);
+        btn_start->signal_clicked().connect( sigc::mem_fun(*this, &LoadTestDialog::on_start_click) );
+        btn_stop = add_button(Gtk::Stock::MEDIA_STOP, Gtk::RESPONSE_NONE);
+        btn_stop->signal_clicked().connect( sigc::mem_fun(*this, &LoadTestDialog::on_stop_click) );
+        btn_stop->set_sensitive(false);
+        btn_close = add_button(Gtk::Stock::CLOSE, Gtk::RESPONSE_CLOSE);
+        btn_close->signal_clicked().connect( sigc::mem_fun(*this, &LoadTestDialog::on_close_click) );
+        
+        frame.set_label("Sweep");
+        get_vbox()->pack_start(frame, false, false, 0);
+        
+        table.resize(8, 2);
+        table.set_col_spacings(10);
+        table.set_row_spacings(5);
+        table.set_border_width(5);
+        frame.add(table);
+        
+        lbl_template.set_label("Frame:");
+        table.attach(lbl_template, 0, 1, 0, 1);
+        lbl_template_desc.set_alignment(Gtk::ALIGN_LEFT, Gtk::ALIGN_CENTER);
+        table.attach(lbl_template_desc, 1, 2, 0, 1);
+        
+        lbl_dest.set_label("Destinations:");
+        table.attach(lbl_dest, 0, 1, 1, 2);
+        ent_dest.set_tooltip_text("64-bit[:16-bit] hex addresses, comma separated; empty for the frame's own");
+        table.attach(ent_dest, 1, 2, 1, 2);
+        
+        lbl_window.set_label("Window:");
+        table.attach(lbl_window, 0, 1, 2, 3);
+        spin_window.set_range(0, 255);
+        spin_window.set_increments(1, 16);
+        spin_window.set_value(sweep.window);
+        spin_window.set_tooltip_text("Frames awaiting status at once, 0 to send without waiting for status");
+        table.attach(spin_window, 1, 2, 2, 3);
+        
+        lbl_pattern.set_label("Payload:");
+        table.attach(lbl_pattern, 0, 1, 3, 4);
+        for (int i = 0; i < LoadGenerator::LGP_Count; i++)
+                cmbt_pattern.append_text(LoadGenerator::get_pattern_name((LoadGenerator::LoadPattern)i));
+        cmbt_pattern.set_active(sweep.pattern);
+        table.attach(cmbt_pattern, 1, 2, 3, 4);
+        
+        lbl_payload.set_label("Payload bytes:");
+        table.attach(lbl_payload, 0, 1, 4, 5);
+        spin_payload.set_range(0, 255);
+        spin_payload.set_increments(1, 16);
+        spin_payload.set_value(sweep.payload_length);
+        spin_payload.set_tooltip_text("0 for the frame's own data");
+        table.attach(spin_payload, 1, 2, 4, 5);
+        
+        lbl_count.set_label("Frames:");
+        table.attach(lbl_count, 0, 1, 5, 6);
+        spin_count.set_range(1, 10000000);
+        spin_count.set_increments(100, 1000);
+        spin_count.set_value(sweep.count);
+        table.attach(spin_count, 1, 2, 5, 6);
+        
+        lbl_rate.set_label("Frames/s:");
+        table.attach(lbl_rate, 0, 1, 6, 7);
+        spin_rate.set_range(0, 100000);
+        spin_rate.set_increments(10, 100);
+        spin_rate.set_value(sweep.rate);
+        spin_rate.set_tooltip_text("0 for as fast as the port takes them");
+        table.attach(spin_rate, 1, 2, 6, 7);
+        
+        lbl_timeout.set_label("Timeout (ms):");
+        table.attach(lbl_timeout, 0, 1, 7, 8);
+        spin_timeout.set_range(10, 600000);
+        spin_timeout.set_increments(100, 1000);
+        spin_timeout.set_value(sweep.timeout);
+        table.attach(spin_timeout, 1, 2, 7, 8);
+        
+        tv_report.modify_font(Pango::FontDescription("monospace"));
+        tv_report.set_editable(false);
+        sw_report.add(tv_report);
+        sw_report.set_shadow_type(Gtk::SHADOW_ETCHED_IN);
+        sw_report.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        get_vbox()->pack_start(sw_report, true, true, 5);
+        
+        generator.signal_finished().connect( sigc::mem_fun(*this, &LoadTestDialog::on_generator_finished) );
+        
+        show_all_children();
+}
+
+
+LoadTestDialog::~LoadTestDialog()
+{
+        c_dispatch_timeout.disconnect();
+        c_report_timeout.disconnect();
+        generator.set_zigbee_interface(0);
+}
+
+
+void LoadTestDialog::set_zigbee_interface(ZigBeeInterface *zb)
+{
+        c_dispatch_timeout.disconnect();
+        
+        zb_int = zb;
+        generator.set_zigbee_interface(zb);
+        
+        update_report();
+}
+
+
+void LoadTestDialog::set_template(const ZigBeePacket &pkt)
+{
+        tmpl = pkt;
+        
+        lbl_template_desc.set_text(tmpl.get_type_desc() + " (" + Glib::ustring::format(tmpl.data.size()) + " data bytes)");
+}
+
+
+bool LoadTestDialog::read_sweep(LoadGenerator::Sweep &sweep, std::string &error)
+{
+        if (!LoadGenerator::parse_destinations(ent_dest.get_text(), sweep.destinations, error))
+                return false;
+        
+        sweep.window = spin_window.get_value_as_int();
+        sweep.pattern = (LoadGenerator::LoadPattern)cmbt_pattern.get_active_row_number();
+        sweep.payload_length = spin_payload.get_value_as_int();
+        sweep.count = spin_count.get_value_as_int();
+        sweep.rate = spin_rate.get_value();
+        sweep.timeout = spin_timeout.get_value_as_int();
+        
+        return true;
+}
+
+
+void LoadTestDialog::on_start_click()
+{
+        LoadGenerator::Sweep sweep;
+        std::string error;
+        
+        c_report_timeout.disconnect();
+        
+        if (!zb_int || !zb_int->is_connected())
+        {
+                tv_report.get_buffer()->set_text("Port not open");
+                return;
+        }
+        
+        // the whole batch is encoded before the first frame goes out
+        if (!read_sweep(sweep, error) || !generator.prepare(tmpl, sweep, zb_int->get_escaped(), error))
+        {
+                tv_report.get_buffer()->set_text(error);
+                return;
+        }
+        
+        if (!generator.start())
+        {
+                tv_report.get_buffer()->set_text("Unable to start");
+                return;
+        }
+        
+        c_report_timeout = Glib::signal_timeout().connect( sigc::mem_fun(*this, &LoadTestDialog::on_report_timeout), report_interval );
+        
+        if (generator.is_running())
+                schedule_dispatch(0);
+        
+        update_report();
+}
+
+
+void LoadTestDialog::on_stop_click()
+{
+        c_dispatch_timeout.disconnect();
+        c_report_timeout.disconnect();
+        generator.stop();
+        
+        update_report();
+}
+
+
+void LoadTestDialog::on_close_click()
+{
+        on_stop_click();
+        
+        hide();
+}
+
+
+void LoadTestDialog::schedule_dispatch(int ms)
+{
+        c_dispatch_timeout.disconnect();
+        
+        if (ms >= 0)
+                c_dispatch_timeout = Glib::signal_timeout().connect( sigc::mem_fun(*this, &LoadTestDialog::on_dispatch_timeout), ms );
+}
+
+
+bool LoadTestDialog::on_dispatch_timeout()
+{
+        schedule_dispatch(generator.dispatch());
+        
+        return false;
+}
+
+
+bool LoadTestDialog::on_report_timeout()
+{
+        update_report();
+        
+        return generator.is_running();
+}
+
+
+void LoadTestDialog::on_generator_finished()
+{
+        c_dispatch_timeout.disconnect();
+        
+        update_report();
+}
+
+
+void LoadTestDialog::update_report()
+{
+        bool running = generator.is_running();
+        
+        if (generator.get_batch_count() > 0)
+                tv_report.get_buffer()->set_text(generator.get_report());
+        
+        btn_start->set_sensitive(!running && zb_int != 0);
+        btn_stop->set_sensitive(running);
+}
+
@@ -0,0 +1,179 @@
+/************************************************************************/
+/* LoadTestDialog                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Load Test Dialog                                   */
+/*                                                                      */
+/* LoadTestDialog.h                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __LOAD_TEST_DIALOG_H
+#define __LOAD_TEST_DIALOG_H
+
+#include "LoadGenerator.h"
+#include "ZigBeeInterface.h"
+#include "ZigBeePacket.h"
+
+#include <gtkmm.h>
+
+/** Load Test Dialog
+ * 
+ * Non-modal dialog that sends a sweep of the packet builder frame through
+ * the load generator and shows its results as it runs.  
+ */
+class LoadTestDialog : public Gtk::Dialog
+{
+public:
+        /**
+         * Create a new Load Test dialog.
+         */
+        LoadTestDialog();
+        virtual ~LoadTestDialog();
+        
+        /**
+         * Set ZigBee interface to send through.
+         * @param zb ZigBee interface, not owned
+         */
+        void set_zigbee_interface(ZigBeeInterface *zb);
+        
+        /**
+         * Set template frame for the next run.
+         * @param pkt template frame
+         */
+        void set_template(const ZigBeePacket &pkt);
+        
+protected:
+        //Signal handlers:
+        /**
+         * Start button click signal handler.
+         */
+        void on_start_click();
+        
+        /**
+         * Stop button click signal handler.
+         */
+        void on_stop_click();
+        
+        /**
+         * Close button click signal handler.
+         */
+        void on_close_click();
+        
+        /**
+         * Generator dispatch timeout.
+         * @return false, the timeout is rearmed with the delay returned by
+         * LoadGenerator::dispatch()
+         */
+        bool on_dispatch_timeout();
+        
+        /**
+         * Results refresh timeout.
+         * @return true while running
+         */
+        bool on_report_timeout();
+        
+        /**
+         * Generator finished signal handler.
+         */
+        void on_generator_finished();
+        
+        /**
+         * Read sweep from the widgets.
+         * @param sweep return sweep
+         * @param error return reason if not read
+         * @return true if read
+         */
+        bool read_sweep(LoadGenerator::Sweep &sweep, std::string &error);
+        
+        /**
+         * Schedule the next dispatch.
+         * @param ms delay from LoadGenerator::dispatch()
+         */
+        void schedule_dispatch(int ms);
+        
+        /**
+         * Show results and update the buttons.
+         */
+        void update_report();
+        
+        //Child widgets:
+        Gtk::Button *btn_start;
+        Gtk::Button *btn_stop;
+        Gtk::Button *btn_close;
+        Gtk::Frame frame;
+        Gtk::Table table;
+        Gtk::Label lbl_template;
+        Gtk::Label lbl_template_desc;
+        Gtk::Label lbl_dest;
+        Gtk::Entry ent_dest;
+        Gtk::Label lbl_window;
+        Gtk::SpinButton spin_window;
+        Gtk::Label lbl_pattern;
+        Gtk::ComboBoxText cmbt_pattern;
+        Gtk::Label lbl_payload;
+        Gtk::SpinButton spin_payload;
+        Gtk::Label lbl_count;
+        Gtk::SpinButton spin_count;
+        Gtk::Label lbl_rate;
+        Gtk::SpinButton spin_rate;
+        Gtk::Label lbl_timeout;
+        Gtk::SpinButton spin_timeout;
+        Gtk::ScrolledWindow sw_report;
+        Gtk::TextView tv_report;
+        
+        /**
+         * ZigBee interface, not owned.
+         */
+        ZigBeeInterface *zb_int;
+        
+        /**
+         * Template frame.
+         */
+        ZigBeePacket tmpl;
+        
+        /**
+         * Load generator.
+         */
+        LoadGenerator generator;
+        
+        /**
+         * Dispatch timeout connection.
+         */
+        sigc::connection c_dispatch_timeout;
+        
+        /**
+         * Report timeout connection.
+         */
+        sigc::connection c_report_timeout;
+        
+        /**
+         * Results refresh interval, in ms.
+         */
+        static const unsigned int report_interval = 500;
+};
+
+#endif //__LOAD_TEST_DIALOG_H
@@ -0,0 +1,195 @@
+/************************************************************************/
+/* Metrics                                                              */
+/*                                                                      */
+/* ZigBee Terminal - Metrics                                            */
+/*                                                                      */
+/* Metrics.cpp                                                          */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "Metrics.h"
+#include "Thread.h"
+
+#include <sstream>
+#include <iomanip>
+
+#ifdef __unix__
+#include <time.h>
+#elif defined _WIN32
+#include <windows.h>
+#endif
+
+// names, in MetricCounter order
+static const char *counter_names[Metrics::MC_Count] = {
+        "reads", "bytes read", "frames parsed", "checksum errors", "junk bytes",
+        "frames delivered", "receive overflows", "tx queue bytes", "tx queue max"
+};
+
+// names, in MetricStage order
+static const char *stage_names[Metrics::MS_Count] = {
+        "read to parsed", "parsed to delivered", "delivered to rendered"
+};
+
+Metrics::Metrics()
+{
+        for (int i = 0; i < MC_Count; i++)
+                counters[i] = 0;
+}
+
+
+Metrics::~Metrics()
+{
+        // nothing
+}
+
+
+void Metrics::add(MetricCounter c, int64_t v)
+{
+        Thread::atomic_add(&counters[c], v);
+}
+
+
+void Metrics::set(MetricCounter c, int64_t v)
+{
+        Thread::atomic_add(&counters[c], v - Thread::atomic_get(&counters[c]));
+}
+
+
+int64_t Metrics::get(MetricCounter c) const
+{
+        return Thread::atomic_get((volatile int64_t *)&counters[c]);
+}
+
+
+void Metrics::record(MetricStage s, uint64_t ns)
+{
+        stages[s].record(ns);
+}
+
+
+const LatencyHistogram &Metrics::get_histogram(MetricStage s) const
+{
+        return stages[s];
+}
+
+
+void Metrics::reset()
+{
+        for (int i = 0; i < MC_Count; i++)
+                set((MetricCounter)i, 0);
+        
+        for (int i = 0; i < MS_Count; i++)
+                stages[i].reset();
+}
+
+
+std::string Metrics::get_report() const
+{
+        std::ostringstream s;
+        
+        for (int i = 0; i < MC_Count; i++)
+                s << std::left << std::setw(24) << counter_names[i] << get((MetricCounter)i) << std::endl;
+        
+        for (int i = 0; i < MS_Count; i++)
+        {
+                const LatencyHistogram &h = stages[i];
+                
+                s << std::left << std::setw(24) << stage_names[i] << "n=" << h.get_count();
+                
+                if (h.get_count() > 0)
+                {
+                        s << " mean=" << format_duration(h.get_mean())
+                                << " p50=" << format_duration(h.get_percentile(50))
+                                << " p90=" << format_duration(h.get_percentile(90))
+                                << " p99=" << format_duration(h.get_percentile(99))
+                                << " p99.9=" << format_duration(h.get_percentile(99.9))
+                                << " max=" << format_duration(h.get_percentile(100));
+                }
+                
+                s << std::endl;
+        }
+        
+        return s.str();
+}
+
+
+const char *Metrics::get_counter_name(MetricCounter c)
+{
+        if (c < 0 || c >= MC_Count)
+                return "";
+        
+        return counter_names[c];
+}
+
+
+const char *Metrics::get_stage_name(MetricStage s)
+{
+        if (s < 0 || s >= MS_Count)
+                return "";
+        
+        return stage_names[s];
+}
+
+
+std::string Metrics::format_duration(uint64_t ns)
+{
+        std::ostringstream s;
+        
+        // a unit that keeps three or so digits
+        if (ns < 10000)
+                s << ns << " ns";
+        else if (ns < 10000000)
+                s << std::fixed << std::setprecision(1) << ns / 1000.0 << " us";
+        else
+                s << std::fixed << std::setprecision(1) << ns / 1000000.0 << " ms";
+        
+        return s.str();
+}
+
+
+uint64_t Metrics::now()
+{
+        #ifdef __unix__
+        
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        
+        #elif defined _WIN32
+        
+        static LARGE_INTEGER freq;
+        LARGE_INTEGER c;
+        
+        if (freq.QuadPart == 0)
+                QueryPerformanceFrequency(&freq);
+        QueryPerformanceCounter(&c);
+        return (uint64_t)(c.QuadPart / freq.QuadPart) * 1000000000ULL +
+                (uint64_t)(c.QuadPart % freq.QuadPart) * 1000000000ULL / freq.QuadPart;
+        
+        #endif
+}
+
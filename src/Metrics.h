@@ -0,0 +1,173 @@
+/************************************************************************/
+/* Metrics                                                              */
+/*                                                                      */
+/* ZigBee Terminal - Metrics                                            */
+/*                                                                      */
+/* Metrics.h                                                            */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __METRICS_H
+#define __METRICS_H
+
+#include "LatencyHistogram.h"
+
+#include <string>
+#include <inttypes.h>
+
+/** Metrics
+ * 
+ * Counters and stage latency histograms for the receive path.  Counters
+ * are atomic and histograms lock free, so they are cheap enough to leave
+ * on and can be read from any thread while the I/O thread updates them.
+ * Times come from now(), a monotonic clock in nanoseconds.  
+ */
+class Metrics
+{
+public:
+        /**
+         * Counters.
+         */
+        typedef enum
+        {
+                MC_Reads = 0,
+                MC_BytesRead = 1,
+                MC_FramesParsed = 2,
+                MC_ChecksumErrors = 3,
+                MC_JunkBytes = 4,
+                MC_FramesDelivered = 5,
+                MC_ReceiveOverflows = 6,
+                MC_TxQueueBytes = 7,
+                MC_TxQueueMax = 8,
+                MC_Count = 9
+        }
+        MetricCounter;
+        
+        /**
+         * Latency stages.
+         */
+        typedef enum
+        {
+                MS_ReadToParsed = 0,
+                MS_ParsedToDelivered = 1,
+                MS_DeliveredToRendered = 2,
+                MS_Count = 3
+        }
+        MetricStage;
+        
+        /**
+         * Create a Metrics object, all zero.
+         */
+        Metrics();
+        virtual ~Metrics();
+        
+        /**
+         * Add to a counter.
+         * @param c counter
+         * @param v value to add
+         */
+        void add(MetricCounter c, int64_t v = 1);
+        
+        /**
+         * Set a counter, for gauges filled in by their owner.
+         * @param c counter
+         * @param v value
+         */
+        void set(MetricCounter c, int64_t v);
+        
+        /**
+         * Read a counter.
+         * @param c counter
+         * @return value
+         */
+        int64_t get(MetricCounter c) const;
+        
+        /**
+         * Record a stage latency.
+         * @param s stage
+         * @param ns latency in nanoseconds
+         */
+        void record(MetricStage s, uint64_t ns);
+        
+        /**
+         * Get a stage histogram.
+         * @param s stage
+         * @return histogram
+         */
+        const LatencyHistogram &get_histogram(MetricStage s) const;
+        
+        /**
+         * Clear all counters and histograms.
+         */
+        void reset();
+        
+        /**
+         * Make a text report of all counters and stage percentiles.
+         * @return report, one line per counter or stage
+         */
+        std::string get_report() const;
+        
+        /**
+         * Get counter name.
+         * @param c counter
+         * @return name
+         */
+        static const char *get_counter_name(MetricCounter c);
+        
+        /**
+         * Get stage name.
+         * @param s stage
+         * @return name
+         */
+        static const char *get_stage_name(MetricStage s);
+        
+        /**
+         * Format a duration for reports.
+         * @param ns duration in nanoseconds
+         * @return duration in ns, us or ms
+         */
+        static std::string format_duration(uint64_t ns);
+        
+        /**
+         * Read the monotonic clock.
+         * @return time in nanoseconds
+         */
+        static uint64_t now();
+        
+protected:
+        /**
+         * Counters.
+         */
+        volatile int64_t counters[MC_Count];
+        
+        /**
+         * Stage histograms.
+         */
+        LatencyHistogram stages[MS_Count];
+};
+
+#endif //__METRICS_H
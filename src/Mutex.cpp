@@ -0,0 +1,156 @@
+/************************************************************************/
+/* Mutex                                                                */
+/*                                                                      */
+/* ZigBee Terminal - Mutex and Condition                                */
+/*                                                                      */
+/* Mutex.cpp                                                            */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "Mutex.h"
+
+Mutex::Mutex()
+{
+        #ifdef __unix__
+        
+        pthread_mutex_init(&mutex, 0);
+        
+        #elif defined _WIN32
+        
+        InitializeCriticalSection(&mutex);
+        
+        #endif
+}
+
+
+Mutex::~Mutex()
+{
+        #ifdef __unix__
+        
+        pthread_mutex_destroy(&mutex);
+        
+        #elif defined _WIN32
+        
+        DeleteCriticalSection(&mutex);
+        
+        #endif
+}
+
+
+void Mutex::lock()
+{
+        #ifdef __unix__
+        
+        pthread_mutex_lock(&mutex);
+        
+        #elif defined _WIN32
+        
+        EnterCriticalSection(&mutex);
+        
+        #endif
+}
+
+
+void Mutex::unlock()
+{
+        #ifdef __unix__
+        
+        pthread_mutex_unlock(&mutex);
+        
+        #elif defined _WIN32
+        
+        LeaveCriticalSection(&mutex);
+        
+        #endif
+}
+
+
+Cond::Cond()
+{
+        #ifdef __unix__
+        
+        pthread_cond_init(&cond, 0);
+        
+        #elif defined _WIN32
+        
+        InitializeConditionVariable(&cond);
+        
+        #endif
+}
+
+
+Cond::~Cond()
+{
+        #ifdef __unix__
+        
+        pthread_cond_destroy(&cond);
+        
+        #endif
+}
+
+
+void Cond::signal()
+{
+        #ifdef __unix__
+        
+        pthread_cond_signal(&cond);
+        
+        #elif defined _WIN32
+        
+        WakeConditionVariable(&cond);
+        
+        #endif
+}
+
+
+void Cond::broadcast()
+{
+        #ifdef __unix__
+        
+        pthread_cond_broadcast(&cond);
+        
+        #elif defined _WIN32
+        
+        WakeAllConditionVariable(&cond);
+        
+        #endif
+}
+
+
+void Cond::wait(Mutex &m)
+{
+        #ifdef __unix__
+        
+        pthread_cond_wait(&cond, &m.mutex);
+        
+        #elif defined _WIN32
+        
+        SleepConditionVariableCS(&cond, &m.mutex, INFINITE);
+        
+        #endif
+}
+
@@ -0,0 +1,155 @@
+/************************************************************************/
+/* Mutex                                                                */
+/*                                                                      */
+/* ZigBee Terminal - Mutex and Condition                                */
+/*                                                                      */
+/* Mutex.h                                                              */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __MUTEX_H
+#define __MUTEX_H
+
+#ifdef __unix__
+#include <pthread.h>
+#elif defined _WIN32
+#include <windows.h>
+#endif
+
+/** Mutex
+ * 
+ * Cross-platform mutex, with the same interface as Glib::Mutex so that the
+ * core classes do not need glib.  
+ */
+class Mutex
+{
+public:
+        /** Mutex Lock
+         * 
+         * Scoped lock.  Locks the mutex on construction and unlocks it on
+         * destruction.  
+         */
+        class Lock
+        {
+        public:
+                /**
+                 * Lock a mutex.
+                 * @param m mutex
+                 */
+                explicit Lock(Mutex &m) : mutex(m) { mutex.lock(); }
+                ~Lock() { mutex.unlock(); }
+                
+        protected:
+                Mutex &mutex;
+                
+        private:
+                Lock(const Lock &);
+                Lock &operator=(const Lock &);
+        };
+        
+        /**
+         * Create a Mutex.
+         */
+        Mutex();
+        virtual ~Mutex();
+        
+        /**
+         * Lock the mutex, blocking until it is available.
+         */
+        void lock();
+        
+        /**
+         * Unlock the mutex.
+         */
+        void unlock();
+        
+protected:
+        friend class Cond;
+        
+        #ifdef __unix__
+        
+        pthread_mutex_t mutex;
+        
+        #elif defined _WIN32
+        
+        CRITICAL_SECTION mutex;
+        
+        #endif
+        
+private:
+        Mutex(const Mutex &);
+        Mutex &operator=(const Mutex &);
+};
+
+/** Condition
+ * 
+ * Cross-platform condition variable, with the same interface as
+ * Glib::Cond.  
+ */
+class Cond
+{
+public:
+        /**
+         * Create a Condition.
+         */
+        Cond();
+        virtual ~Cond();
+        
+        /**
+         * Wake one waiting thread.
+         */
+        void signal();
+        
+        /**
+         * Wake all waiting threads.
+         */
+        void broadcast();
+        
+        /**
+         * Wait for the condition.  The mutex must be locked; it is unlocked
+         * while waiting and locked again before returning.
+         * @param m mutex
+         */
+        void wait(Mutex &m);
+        
+protected:
+        #ifdef __unix__
+        
+        pthread_cond_t cond;
+        
+        #elif defined _WIN32
+        
+        CONDITION_VARIABLE cond;
+        
+        #endif
+        
+private:
+        Cond(const Cond &);
+        Cond &operator=(const Cond &);
+};
+
+#endif //__MUTEX_H
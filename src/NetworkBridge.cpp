@@ -0,0 +1,646 @@
+/************************************************************************/
+/* NetworkBridge                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Serial to Network Bridge                           */
+/*                                                                      */
+/* NetworkBridge.cpp                                                    */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "NetworkBridge.h"
+
+#ifdef __unix__
+
+#include <errno.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#endif
+
+#include <iostream>
+#include <string.h>
+
+// epoll events handled per dispatch
+#define BRIDGE_MAX_EVENTS 32
+
+// backlog segments gathered into one sendmsg()
+#define BRIDGE_IOV_MAX 64
+
+// key of the listening socket, client keys start at 1
+#define BRIDGE_LISTEN_KEY 0
+
+NetworkBridge::NetworkBridge() :
+        zb_int(0),
+        listen_fd(-1),
+        epoll_fd(-1),
+        next_key(1),
+        reading(true),
+        escaped(false),
+        client_limit(1 << 20),
+        frames_out(0),
+        frames_in(0),
+        clients_dropped(0)
+{
+        // nothing
+}
+
+
+NetworkBridge::~NetworkBridge()
+{
+        close();
+        set_zigbee_interface(0);
+}
+
+
+void NetworkBridge::set_zigbee_interface(ZigBeeInterface *zb)
+{
+        c_receive_frames.disconnect();
+        c_write_space.disconnect();
+        
+        zb_int = zb;
+        
+        if (!zb_int)
+                return;
+                
+        c_receive_frames = zb_int->signal_receive_frames().connect( sigc::mem_fun(*this, &NetworkBridge::on_receive_frames) );
+        c_write_space = zb_int->signal_write_space().connect( sigc::mem_fun(*this, &NetworkBridge::on_write_space) );
+}
+
+
+bool NetworkBridge::set_escaped(bool e)
+{
+        escaped = e;
+        
+        for (size_t i = 0; i < clients.size(); i++)
+                clients[i]->parser.set_escaped(escaped);
+                
+        return escaped;
+}
+
+
+bool NetworkBridge::get_escaped()
+{
+        return escaped;
+}
+
+
+bool NetworkBridge::listen(const std::string &address, std::string &error)
+{
+        #ifdef __unix__
+        
+        struct addrinfo hints;
+        struct addrinfo *res;
+        struct addrinfo *ai;
+        struct epoll_event ev;
+        std::string host;
+        std::string service;
+        std::string::size_type colon;
+        int one = 1;
+        int err;
+        
+        close();
+        
+        colon = address.rfind(':');
+        
+        if (colon == std::string::npos)
+        {
+                service = address;
+        }
+        else
+        {
+                host = address.substr(0, colon);
+                service = address.substr(colon + 1);
+                
+                if (host.size() >= 2 && host[0] == '[' && host[host.size() - 1] == ']')
+                        host = host.substr(1, host.size() - 2);
+        }
+        
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        
+        err = getaddrinfo(host.empty() ? 0 : host.c_str(), service.c_str(), &hints, &res);
+        
+        if (err != 0)
+        {
+                error = "Unable to resolve " + address + ": " + gai_strerror(err);
+                return false;
+        }
+        
+        for (ai = res; ai; ai = ai->ai_next)
+        {
+                listen_fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+                
+                if (listen_fd < 0)
+                        continue;
+                        
+                setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                
+                if (bind(listen_fd, ai->ai_addr, ai->ai_addrlen) == 0 && ::listen(listen_fd, 16) == 0)
+                        break;
+                        
+                ::close(listen_fd);
+                listen_fd = -1;
+        }
+        
+        freeaddrinfo(res);
+        
+        if (listen_fd < 0)
+        {
+                error = "Unable to listen on " + address + ": " + strerror(errno);
+                return false;
+        }
+        
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u64 = BRIDGE_LISTEN_KEY;
+        
+        if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0)
+        {
+                error = std::string("Unable to poll listening socket: ") + strerror(errno);
+                close();
+                return false;
+        }
+        
+        reading = true;
+        
+        return true;
+        
+        #else
+        
+        error = "Network bridge is only supported on unix";
+        return false;
+        
+        #endif
+}
+
+
+void NetworkBridge::close()
+{
+        #ifdef __unix__
+        
+        while (!clients.empty())
+                drop_client(clients.size() - 1);
+                
+        if (listen_fd >= 0)
+                ::close(listen_fd);
+        listen_fd = -1;
+        
+        if (epoll_fd >= 0)
+                ::close(epoll_fd);
+        epoll_fd = -1;
+        
+        #endif
+}
+
+
+bool NetworkBridge::is_listening()
+{
+        return listen_fd >= 0;
+}
+
+
+int NetworkBridge::get_fd()
+{
+        return epoll_fd;
+}
+
+
+void NetworkBridge::dispatch()
+{
+        #ifdef __unix__
+        
+        struct epoll_event evs[BRIDGE_MAX_EVENTS];
+        int n;
+        
+        if (epoll_fd < 0)
+                return;
+                
+        // level triggered, anything left over wakes the main loop again
+        n = epoll_wait(epoll_fd, evs, BRIDGE_MAX_EVENTS, 0);
+        
+        for (int i = 0; i < n; i++)
+        {
+                if (evs[i].data.u64 == BRIDGE_LISTEN_KEY)
+                {
+                        accept_clients();
+                        continue;
+                }
+                
+                // clients dropped earlier in the batch are not found
+                size_t j;
+                for (j = 0; j < clients.size(); j++)
+                {
+                        if (clients[j]->key == evs[i].data.u64)
+                                break;
+                }
+                
+                if (j == clients.size())
+                        continue;
+                        
+                Client *c = clients[j];
+                bool ok = true;
+                
+                if (evs[i].events & EPOLLOUT)
+                        ok = flush_client(c);
+                        
+                if (ok && (evs[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+                        ok = reading ? read_client(c) : !(evs[i].events & (EPOLLERR | EPOLLHUP));
+                        
+                if (!ok)
+                        drop_client(j);
+        }
+        
+        #endif
+}
+
+
+void NetworkBridge::accept_clients()
+{
+        #ifdef __unix__
+        
+        struct sockaddr_storage addr;
+        socklen_t len;
+        char name[NI_MAXHOST];
+        char serv[NI_MAXSERV];
+        int one = 1;
+        int fd;
+        
+        while (true)
+        {
+                len = sizeof(addr);
+                fd = accept4(listen_fd, (struct sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                
+                if (fd < 0)
+                {
+                        if (errno == EINTR || errno == ECONNABORTED)
+                                continue;
+                                
+                        if (errno != EAGAIN)
+                                std::cerr << "[NetworkBridge] Error accepting client (errno " << errno << ")" << std::endl;
+                        break;
+                }
+                
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                
+                Client *c = new Client();
+                c->fd = fd;
+                c->key = next_key++;
+                c->backlog_bytes = 0;
+                c->wait_out = false;
+                c->parser.set_escaped(escaped);
+                
+                if (getnameinfo((struct sockaddr *)&addr, len, name, sizeof(name), serv, sizeof(serv), NI_NUMERICHOST | NI_NUMERICSERV) == 0)
+                        c->peer = std::string(name) + ":" + serv;
+                        
+                struct epoll_event ev;
+                memset(&ev, 0, sizeof(ev));
+                ev.events = reading ? (uint32_t)EPOLLIN : 0;
+                ev.data.u64 = c->key;
+                
+                // never announced, so closed without a disconnect signal
+                if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+                {
+                        std::cerr << "[NetworkBridge] Error polling client (errno " << errno << ")" << std::endl;
+                        ::close(fd);
+                        delete c;
+                        continue;
+                }
+                
+                clients.push_back(c);
+                
+                m_signal_client_connected.emit(c->peer);
+        }
+        
+        #endif
+}
+
+
+bool NetworkBridge::read_client(Client *c)
+{
+        #ifdef __unix__
+        
+        ReceiveBuffer &buf = c->parser.get_buffer();
+        const uint8_t *payload;
+        size_t length;
+        size_t space;
+        ssize_t num;
+        
+        while (reading)
+        {
+                uint8_t *ptr = buf.get_write_ptr();
+                space = buf.get_write_space();
+                
+                if (space == 0)
+                {
+                        // a partial frame filled the buffer, it is junk
+                        c->parser.reset();
+                        continue;
+                }
+                
+                num = recv(c->fd, ptr, space, 0);
+                
+                if (num < 0)
+                {
+                        if (errno == EINTR)
+                                continue;
+                                
+                        return errno == EAGAIN;
+                }
+                
+                if (num == 0)
+                        return false;
+                        
+                buf.commit(num);
+                
+                // only whole frames go to the radio, so clients never
+                // interleave inside a frame
+                while (c->parser.read_frame(payload, length))
+                {
+                        if (!zb_int || !zb_int->is_connected())
+                                continue;
+                                
+                        if (zb_int->send_frame(ZigBeePacketView(payload, length)))
+                                frames_in++;
+                }
+                
+                if (zb_int && zb_int->is_connected() && zb_int->is_write_blocked())
+                {
+                        // leave the rest in the socket until the radio
+                        // catches up
+                        reading = false;
+                        for (size_t i = 0; i < clients.size(); i++)
+                                arm_client(clients[i]);
+                }
+                
+                if ((size_t)num < space)
+                        break;
+        }
+        
+        #endif
+        
+        return true;
+}
+
+
+bool NetworkBridge::flush_client(Client *c)
+{
+        #ifdef __unix__
+        
+        struct iovec iov[BRIDGE_IOV_MAX];
+        struct msghdr msg;
+        size_t n;
+        size_t len;
+        size_t rem;
+        ssize_t num;
+        bool blocked = false;
+        
+        while (!c->backlog.empty())
+        {
+                len = 0;
+                for (n = 0; n < BRIDGE_IOV_MAX && n < c->backlog.size(); n++)
+                {
+                        Segment &s = c->backlog[n];
+                        iov[n].iov_base = &(*s.block)[s.offset];
+                        iov[n].iov_len = s.length;
+                        len += s.length;
+                }
+                
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_iov = iov;
+                msg.msg_iovlen = n;
+                
+                // a closed peer is an error here, not SIGPIPE
+                num = sendmsg(c->fd, &msg, MSG_NOSIGNAL);
+                
+                if (num < 0)
+                {
+                        if (errno == EINTR)
+                                continue;
+                                
+                        if (errno == EAGAIN)
+                        {
+                                blocked = true;
+                                break;
+                        }
+                        
+                        return false;
+                }
+                
+                c->backlog_bytes -= num;
+                
+                // retire what was sent, the last reference frees a block
+                rem = num;
+                while (rem > 0)
+                {
+                        Segment &s = c->backlog.front();
+                        
+                        if (rem < s.length)
+                        {
+                                s.offset += rem;
+                                s.length -= rem;
+                                break;
+                        }
+                        
+                        rem -= s.length;
+                        c->backlog.pop_front();
+                }
+                
+                // short write, socket is full
+                if ((size_t)num < len)
+                {
+                        blocked = true;
+                        break;
+                }
+        }
+        
+        if (blocked != c->wait_out)
+        {
+                c->wait_out = blocked;
+                arm_client(c);
+        }
+        
+        #endif
+        
+        return true;
+}
+
+
+void NetworkBridge::arm_client(Client *c)
+{
+        #ifdef __unix__
+        
+        struct epoll_event ev;
+        
+        memset(&ev, 0, sizeof(ev));
+        ev.events = (reading ? (uint32_t)EPOLLIN : 0) | (c->wait_out ? (uint32_t)EPOLLOUT : 0);
+        ev.data.u64 = c->key;
+        
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+        
+        #endif
+}
+
+
+void NetworkBridge::drop_client(size_t i)
+{
+        Client *c = clients[i];
+        
+        #ifdef __unix__
+        
+        struct epoll_event ev;
+        
+        memset(&ev, 0, sizeof(ev));
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, &ev);
+        ::close(c->fd);
+        
+        #endif
+        
+        clients.erase(clients.begin() + i);
+        
+        m_signal_client_disconnected.emit(c->peer);
+        
+        delete c;
+}
+
+
+void NetworkBridge::on_receive_frames(const std::vector<ZigBeePacketView> &frames)
+{
+        size_t size = 0;
+        size_t len = 0;
+        
+        if (clients.empty() || frames.empty())
+                return;
+                
+        for (size_t i = 0; i < frames.size(); i++)
+                size += frames[i].get_max_encoded_length(escaped);
+                
+        // one copy of the batch, whatever the number of clients
+        Block block(new std::vector<uint8_t>(size));
+        
+        for (size_t i = 0; i < frames.size(); i++)
+                len += frames[i].encode(&(*block)[len], size - len, escaped);
+                
+        frames_out += frames.size();
+        
+        // back to front, a client may be dropped
+        for (size_t i = clients.size(); i-- > 0; )
+        {
+                Client *c = clients[i];
+                Segment s;
+                
+                s.block = block;
+                s.offset = 0;
+                s.length = len;
+                
+                c->backlog.push_back(s);
+                c->backlog_bytes += len;
+                
+                // a client already waiting is written when it has room
+                if (!c->wait_out && !flush_client(c))
+                {
+                        drop_client(i);
+                        continue;
+                }
+                
+                if (c->backlog_bytes > client_limit)
+                {
+                        std::cerr << "[NetworkBridge] Dropping " << c->peer << ", " << c->backlog_bytes << " bytes behind" << std::endl;
+                        clients_dropped++;
+                        drop_client(i);
+                }
+        }
+}
+
+
+void NetworkBridge::on_write_space()
+{
+        if (reading)
+                return;
+                
+        reading = true;
+        
+        for (size_t i = 0; i < clients.size(); i++)
+                arm_client(clients[i]);
+}
+
+
+size_t NetworkBridge::get_client_count()
+{
+        return clients.size();
+}
+
+
+size_t NetworkBridge::set_client_limit(size_t l)
+{
+        client_limit = l > 0 ? l : 1;
+        return client_limit;
+}
+
+
+size_t NetworkBridge::get_client_limit()
+{
+        return client_limit;
+}
+
+
+uint64_t NetworkBridge::get_frames_out()
+{
+        return frames_out;
+}
+
+
+uint64_t NetworkBridge::get_frames_in()
+{
+        return frames_in;
+}
+
+
+uint64_t NetworkBridge::get_clients_dropped()
+{
+        return clients_dropped;
+}
+
+
+sigc::signal<void, std::string> NetworkBridge::signal_client_connected()
+{
+        return m_signal_client_connected;
+}
+
+
+sigc::signal<void, std::string> NetworkBridge::signal_client_disconnected()
+{
+        return m_signal_client_disconnected;
+}
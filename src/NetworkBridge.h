@@ -0,0 +1,329 @@
+/************************************************************************/
+/* NetworkBridge                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Serial to Network Bridge                           */
+/*                                                                      */
+/* NetworkBridge.h                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __NETWORK_BRIDGE_H
+#define __NETWORK_BRIDGE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <tr1/memory>
+#include <stddef.h>
+#include <inttypes.h>
+#include <sigc++/sigc++.h>
+
+#include "ZigBeeInterface.h"
+#include "ZigBeePacketView.h"
+#include "ZigBeeFrameParser.h"
+
+/** Network Bridge
+ * 
+ * Shares one radio with any number of TCP clients.  Every frame received
+ * from the radio goes to every client, and every whole frame a client
+ * sends goes to the radio, so clients never see or cause a frame cut in
+ * half.  Each batch of received frames is encoded once into a shared
+ * block; clients queue references into the block and send them with
+ * scatter/gather writes, so nothing is copied per client.  A client that
+ * falls more than the client limit behind is dropped rather than holding
+ * memory for the others.  Clients speak the API mode set with
+ * set_escaped() and share the frame ID space, so responses are seen by all
+ * of them.  Sockets are non-blocking and driven from the main loop: call
+ * dispatch() when the descriptor from get_fd() is readable.  Only
+ * implemented on unix.  
+ * @see SocketTransport
+ */
+class NetworkBridge
+{
+public:
+        /**
+         * Create a Network Bridge.
+         */
+        NetworkBridge();
+        virtual ~NetworkBridge();
+        
+        /**
+         * Set ZigBee interface of the radio.
+         * @param zb ZigBee interface, or 0 to detach
+         */
+        void set_zigbee_interface(ZigBeeInterface *zb);
+        
+        /**
+         * Set escaped mode spoken to clients.
+         * @param e API mode 2 (escaped)
+         * @return escaped mode
+         */
+        bool set_escaped(bool e);
+        
+        /**
+         * Get escaped mode spoken to clients.
+         * @return escaped mode
+         */
+        bool get_escaped();
+        
+        /**
+         * Listen for clients.
+         * @param address [host:]port, all interfaces if no host is given
+         * @param error return error message
+         * @return true if listening
+         */
+        bool listen(const std::string &address, std::string &error);
+        
+        /**
+         * Stop listening and drop all clients.
+         */
+        void close();
+        
+        /**
+         * Check listening.
+         * @return true if listening
+         */
+        bool is_listening();
+        
+        /**
+         * Get event descriptor.
+         * @return descriptor to poll for reading, -1 if not listening
+         */
+        int get_fd();
+        
+        /**
+         * Accept clients, read their frames and write data they are
+         * waiting for.
+         */
+        void dispatch();
+        
+        /**
+         * Get number of connected clients.
+         * @return clients
+         */
+        size_t get_client_count();
+        
+        /**
+         * Set client limit.  A client with more than this many bytes
+         * waiting to be sent to it is dropped.
+         * @param l limit in bytes
+         * @return limit
+         */
+        size_t set_client_limit(size_t l);
+        
+        /**
+         * Get client limit.
+         * @return limit in bytes
+         */
+        size_t get_client_limit();
+        
+        /**
+         * Get number of frames sent to clients, counted once per frame.
+         * @return frames
+         */
+        uint64_t get_frames_out();
+        
+        /**
+         * Get number of frames from clients sent to the radio.
+         * @return frames
+         */
+        uint64_t get_frames_in();
+        
+        /**
+         * Get number of clients dropped for falling behind.
+         * @return clients
+         */
+        uint64_t get_clients_dropped();
+        
+        /**
+         * Client connected signal.
+         * @par Prototype:
+         * <tt>void on_my_%client_connected(std::string peer)</tt>
+         */
+        sigc::signal<void, std::string> signal_client_connected();
+        
+        /**
+         * Client disconnected signal.
+         * @par Prototype:
+         * <tt>void on_my_%client_disconnected(std::string peer)</tt>
+         */
+        sigc::signal<void, std::string> signal_client_disconnected();
+        
+protected:
+        /**
+         * Block of encoded frames shared by every client.
+         */
+        typedef std::tr1::shared_ptr<std::vector<uint8_t> > Block;
+        
+        /**
+         * Part of a block waiting to be sent to a client.
+         */
+        struct Segment
+        {
+                Block block;                    ///< Shared block
+                size_t offset;                  ///< First byte not yet sent
+                size_t length;                  ///< Bytes not yet sent
+        };
+        
+        /**
+         * Connected client.
+         */
+        struct Client
+        {
+                int fd;                         ///< Socket
+                uint64_t key;                   ///< epoll key
+                std::string peer;               ///< Peer address
+                ZigBeeFrameParser parser;       ///< Frames from the client
+                std::deque<Segment> backlog;    ///< Data waiting to be sent
+                size_t backlog_bytes;           ///< Bytes in backlog
+                bool wait_out;                  ///< Waiting for the socket to take more
+                
+                Client() : parser(8192) {}
+        };
+        
+        /**
+         * Receive frames handler.  Encodes the batch once and queues it to
+         * every client.
+         * @param frames frames
+         */
+        void on_receive_frames(const std::vector<ZigBeePacketView> &frames);
+        
+        /**
+         * Write space handler.  Resumes reading clients.
+         */
+        void on_write_space();
+        
+        /**
+         * Accept waiting clients.
+         */
+        void accept_clients();
+        
+        /**
+         * Read a client and forward its frames to the radio.
+         * @param c client
+         * @return false if the client is gone
+         */
+        bool read_client(Client *c);
+        
+        /**
+         * Send a client's backlog.
+         * @param c client
+         * @return false on a write error
+         */
+        bool flush_client(Client *c);
+        
+        /**
+         * Set the socket events polled for a client.
+         * @param c client
+         */
+        void arm_client(Client *c);
+        
+        /**
+         * Disconnect a client.
+         * @param i index in clients
+         */
+        void drop_client(size_t i);
+        
+        /**
+         * ZigBee interface of the radio.
+         */
+        ZigBeeInterface *zb_int;
+        
+        /**
+         * Receive frames signal connection.
+         */
+        sigc::connection c_receive_frames;
+        
+        /**
+         * Write space signal connection.
+         */
+        sigc::connection c_write_space;
+        
+        /**
+         * Clients.
+         */
+        std::vector<Client *> clients;
+        
+        /**
+         * Listening socket, -1 if not listening.
+         */
+        int listen_fd;
+        
+        /**
+         * epoll instance for the listening socket and all clients.
+         */
+        int epoll_fd;
+        
+        /**
+         * Next client epoll key.  Keys are not reused, so stale events for
+         * a dropped client are ignored.
+         */
+        uint64_t next_key;
+        
+        /**
+         * Clients are read.  Cleared while the radio is write blocked so
+         * clients are held back by TCP instead of queueing without bound.
+         */
+        bool reading;
+        
+        /**
+         * Escaped mode.
+         */
+        bool escaped;
+        
+        /**
+         * Client limit in bytes.
+         */
+        size_t client_limit;
+        
+        /**
+         * Frames sent to clients.
+         */
+        uint64_t frames_out;
+        
+        /**
+         * Frames sent to the radio.
+         */
+        uint64_t frames_in;
+        
+        /**
+         * Clients dropped for falling behind.
+         */
+        uint64_t clients_dropped;
+        
+        /**
+         * Client connected signal.
+         */
+        sigc::signal<void, std::string> m_signal_client_connected;
+        
+        /**
+         * Client disconnected signal.
+         */
+        sigc::signal<void, std::string> m_signal_client_disconnected;
+};
+
+#endif //__NETWORK_BRIDGE_H
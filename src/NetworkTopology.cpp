@@ -0,0 +1,320 @@
+/************************************************************************/
+/* NetworkTopology                                                      */
+/*                                                                      */
+/* ZigBee Terminal - Network Topology                                   */
+/*                                                                      */
+/* NetworkTopology.cpp                                                  */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "NetworkTopology.h"
+
+#include <algorithm>
+
+const long NetworkTopology::link_local;
+const long NetworkTopology::link_unknown;
+const size_t NetworkTopology::max_hops;
+
+// join notification status of a device leaving
+static const int join_status_left = 0x02;
+
+// transmit status discovery status bit for a route discovery
+static const int discovery_route = 0x02;
+
+NetworkTopology::NetworkTopology() :
+        sent_count(0),
+        stamp(0)
+{
+        // nothing
+}
+
+
+NetworkTopology::~NetworkTopology()
+{
+        // nothing
+}
+
+
+void NetworkTopology::add(const ZigBeePacketView &frame)
+{
+        long index;
+        
+        switch (frame.get_identifier())
+        {
+                case ZigBeePacket::ZBPID_RouteRecord:
+                        {
+                                index = find_node(frame.get_src64(), frame.get_src16());
+                                if (index < 0)
+                                        return;
+                                
+                                nodes[index].flags |= NF_RouteRecord;
+                                
+                                // hops are listed from the neighbour of the
+                                // source on, so each one links to the next
+                                // and the last is a neighbour of ours
+                                size_t n = std::min(frame.get_route_record_count(), max_hops);
+                                long prev = index;
+                                for (size_t i = 0; i < n; i++)
+                                {
+                                        long hop = find_node(NodeAddressMap::addr64_unknown, frame.get_route_record(i));
+                                        if (hop < 0)
+                                                return;
+                                        
+                                        set_link(prev, hop);
+                                        prev = hop;
+                                }
+                                set_link(prev, link_local);
+                        }
+                        return;
+                        
+                case ZigBeePacket::ZBPID_ManyToOneRouteRequest:
+                        index = find_node(frame.get_src64(), frame.get_src16());
+                        if (index >= 0)
+                                nodes[index].flags |= NF_Concentrator;
+                        return;
+                        
+                case ZigBeePacket::ZBPID_JoinNotificationStatus:
+                        {
+                                index = find_node(frame.get_field_value(ZigBeePacket::ZBPF_New64),
+                                        frame.get_field_value(ZigBeePacket::ZBPF_New16));
+                                if (index < 0)
+                                        return;
+                                
+                                if (frame.get_status() == join_status_left)
+                                {
+                                        set_link(index, link_unknown);
+                                        return;
+                                }
+                                
+                                // join notifications come from the
+                                // coordinator, parent 0x0000 is us
+                                uint16_t parent16 = frame.get_field_value(ZigBeePacket::ZBPF_Parent16);
+                                long parent = link_local;
+                                if (parent16 != 0x0000)
+                                {
+                                        parent = find_node(NodeAddressMap::addr64_unknown, parent16);
+                                        if (parent < 0 || parent == index)
+                                                return;
+                                }
+                                
+                                nodes[index].flags |= NF_Joined;
+                                set_link(index, parent);
+                        }
+                        return;
+                        
+                case ZigBeePacket::ZBPID_NodeIdentification:
+                        // the remote node and the node that relayed it
+                        find_node(frame.get_src64(), frame.get_src16());
+                        find_node(frame.get_field_value(ZigBeePacket::ZBPF_Sender64),
+                                frame.get_field_value(ZigBeePacket::ZBPF_Sender16));
+                        return;
+                        
+                case ZigBeePacket::ZBPID_TxStatusS2:
+                        {
+                                // the radio did not have the route we sent
+                                // or we never sent one, send it again
+                                if (!(frame.get_field_value(ZigBeePacket::ZBPF_DiscoveryStatus) & discovery_route))
+                                        return;
+                                
+                                index = addresses.find16(frame.get_dest16());
+                                if (index < 0)
+                                        return;
+                                
+                                nodes[index].sent_stamp = stamp - 1;
+                                nodes[index].sent_hash = 0;
+                        }
+                        return;
+                        
+                default:
+                        break;
+        }
+        
+        // anything else with both addresses keeps the aliases current
+        if (frame.has_field(ZigBeePacket::ZBPF_Src64) && frame.has_field(ZigBeePacket::ZBPF_Src16))
+                find_node(frame.get_src64(), frame.get_src16());
+}
+
+
+void NetworkTopology::clear()
+{
+        nodes.clear();
+        addresses.clear();
+        stamp++;
+}
+
+
+size_t NetworkTopology::get_count() const
+{
+        return nodes.size();
+}
+
+
+const NetworkTopology::Node &NetworkTopology::get_node(size_t index) const
+{
+        return nodes[index];
+}
+
+
+const NodeAddressMap &NetworkTopology::get_addresses() const
+{
+        return addresses;
+}
+
+
+long NetworkTopology::find(uint64_t addr64) const
+{
+        return addresses.find64(addr64);
+}
+
+
+bool NetworkTopology::get_route(size_t index, std::vector<uint16_t> &hops) const
+{
+        long link = nodes[index].link;
+        
+        hops.clear();
+        
+        while (link >= 0)
+        {
+                uint16_t addr16 = addresses.get_addr16(link);
+                
+                if (hops.size() >= max_hops || addr16 == NodeAddressMap::addr16_unknown)
+                        return false;
+                
+                hops.push_back(addr16);
+                link = nodes[link].link;
+        }
+        
+        return link == link_local;
+}
+
+
+bool NetworkTopology::get_source_route(int identifier, uint64_t dest64, ZigBeePacket &pkt)
+{
+        switch (identifier)
+        {
+                case ZigBeePacket::ZBPID_TxRequest:
+                case ZigBeePacket::ZBPID_EATxRequest:
+                case ZigBeePacket::ZBPID_RemoteATCommand:
+                        break;
+                default:
+                        return false;
+        }
+        
+        long index = find(dest64);
+        if (index < 0 || dest64 == NodeAddressMap::addr64_unknown || dest64 == NodeAddressMap::addr64_broadcast)
+                return false;
+        
+        // nothing changed since the last check
+        Node &node = nodes[index];
+        if (node.sent_stamp == stamp)
+                return false;
+        node.sent_stamp = stamp;
+        
+        // neighbours are reached without a route discovery
+        uint16_t addr16 = addresses.get_addr16(index);
+        if (addr16 == NodeAddressMap::addr16_unknown || !get_route(index, route) || route.empty())
+                return false;
+        
+        uint32_t hash = 2166136261U;
+        hash = (hash ^ addr16) * 16777619U;
+        for (size_t i = 0; i < route.size(); i++)
+                hash = (hash ^ route[i]) * 16777619U;
+        if (hash == 0)
+                hash = 1;
+        
+        if (hash == node.sent_hash)
+                return false;
+        
+        pkt.zero();
+        pkt.identifier = ZigBeePacket::ZBPID_CreateSourceRoute;
+        pkt.dest64 = dest64;
+        pkt.dest16 = addr16;
+        pkt.route_records = route;
+        
+        if (!pkt.build_packet())
+                return false;
+        
+        node.sent_hash = hash;
+        sent_count++;
+        
+        return true;
+}
+
+
+void NetworkTopology::reset_sent_routes()
+{
+        for (size_t i = 0; i < nodes.size(); i++)
+                nodes[i].sent_hash = 0;
+        
+        stamp++;
+}
+
+
+size_t NetworkTopology::get_sent_count() const
+{
+        return sent_count;
+}
+
+
+uint32_t NetworkTopology::get_stamp() const
+{
+        return stamp;
+}
+
+
+long NetworkTopology::find_node(uint64_t addr64, uint16_t addr16)
+{
+        bool changed16 = false;
+        long index = addresses.add(addr64, addr16, changed16);
+        
+        if (index >= 0 && (size_t)index == nodes.size())
+        {
+                Node node;
+                node.flags = 0;
+                node.link = link_unknown;
+                node.sent_stamp = stamp;
+                node.sent_hash = 0;
+                nodes.push_back(node);
+        }
+        
+        // routes through a node change with its 16-bit address, links
+        // are node indexes and follow it
+        if (changed16)
+                stamp++;
+        
+        return index;
+}
+
+
+void NetworkTopology::set_link(long index, long link)
+{
+        if (nodes[index].link == link)
+                return;
+        
+        nodes[index].link = link;
+        stamp++;
+}
@@ -0,0 +1,229 @@
+/************************************************************************/
+/* NetworkTopology                                                      */
+/*                                                                      */
+/* ZigBee Terminal - Network Topology                                   */
+/*                                                                      */
+/* NetworkTopology.h                                                    */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __NETWORK_TOPOLOGY_H
+#define __NETWORK_TOPOLOGY_H
+
+#include "ZigBeePacket.h"
+#include "ZigBeePacketView.h"
+#include "NodeAddressMap.h"
+
+#include <vector>
+#include <stddef.h>
+#include <inttypes.h>
+
+/** Network Topology
+ * 
+ * Routes from the local radio to the nodes of a mesh, learned from the
+ * frames a concentrator (AR set) receives.  Every node keeps a single
+ * link, its next hop toward the local radio, so the links form a tree
+ * rooted at the local radio and the route to a node is found by walking
+ * up from it.  A Route Record Indicator sets the links of every node on
+ * the path it reports, a Join Notification Status links a joining node
+ * to its parent, and any frame carrying both addresses of a node keeps
+ * the 16-bit alias map up to date.  Links are node indexes, so a router
+ * taking a new 16-bit address moves every route through it at no cost.
+ * Nodes are found by address through a NodeAddressMap.  Adding a frame
+ * is O(path length).
+ * 
+ * get_source_route() builds the Create Source Route frame to send ahead
+ * of a transmit request, so the radio uses the known route instead of
+ * discovering one.  Each node remembers a hash of the route last sent
+ * for it, and a route is only sent again once a change to the topology
+ * gives a different route, the radio reports that it had to discover a
+ * route anyway, or reset_sent_routes() is called.
+ */
+class NetworkTopology
+{
+public:
+        /**
+         * Link values other than node indexes.
+         */
+        static const long link_local = -1;      ///< Direct neighbour of the local radio
+        static const long link_unknown = -2;    ///< No route known
+        
+        /**
+         * Longest route followed.  Stale links could otherwise form a
+         * loop.
+         */
+        static const size_t max_hops = 40;
+        
+        /**
+         * Node flags.
+         */
+        typedef enum
+        {
+                NF_Concentrator = 0x01,         ///< Sent a many-to-one route request
+                NF_RouteRecord = 0x02,          ///< Link reported by a route record
+                NF_Joined = 0x04                ///< Link to parent from a join notification
+        }
+        NodeFlags;
+        
+        /**
+         * Node.  The node's addresses are in get_addresses().
+         */
+        struct Node
+        {
+                uint8_t flags;                  ///< Node flags, see NodeFlags
+                long link;                      ///< Next hop toward the local radio, node index or link_local / link_unknown
+                uint32_t sent_stamp;            ///< Change stamp the sent route was last checked at
+                uint32_t sent_hash;             ///< Hash of the route last sent, 0 for none
+        };
+        
+        /**
+         * Create a Network Topology.
+         */
+        NetworkTopology();
+        virtual ~NetworkTopology();
+        
+        /**
+         * Add a received frame.
+         * @param frame frame view
+         */
+        void add(const ZigBeePacketView &frame);
+        
+        /**
+         * Drop all nodes.
+         */
+        void clear();
+        
+        /**
+         * Get number of nodes.
+         * @return node count
+         */
+        size_t get_count() const;
+        
+        /**
+         * Get node.
+         * @param index node index, in order first seen
+         * @return node
+         */
+        const Node &get_node(size_t index) const;
+        
+        /**
+         * Get node addresses.
+         * @return addresses, by node index
+         */
+        const NodeAddressMap &get_addresses() const;
+        
+        /**
+         * Find a node by 64-bit address.
+         * @param addr64 64-bit address
+         * @return node index, -1 if not known
+         */
+        long find(uint64_t addr64) const;
+        
+        /**
+         * Get the route to a node.
+         * @param index node index
+         * @param hops returns the 16-bit addresses of the hops, the
+         * neighbour of the node first, the order Create Source Route uses
+         * @return true if the route is known
+         */
+        bool get_route(size_t index, std::vector<uint16_t> &hops) const;
+        
+        /**
+         * Get the source route to send ahead of a transmit request.  Only
+         * ZigBee requests addressed to a known node more than one hop away
+         * get one, and only when the route differs from the one last sent
+         * for that node.
+         * @param identifier identifier of the request
+         * @param dest64 destination 64-bit address of the request
+         * @param pkt returns the Create Source Route frame, built
+         * @return true if pkt should be sent first
+         */
+        bool get_source_route(int identifier, uint64_t dest64, ZigBeePacket &pkt);
+        
+        /**
+         * Forget which routes were sent, for instance when the radio has
+         * been reset and lost them.
+         */
+        void reset_sent_routes();
+        
+        /**
+         * Get number of Create Source Route frames built.
+         * @return count
+         */
+        size_t get_sent_count() const;
+        
+        /**
+         * Get change stamp.  Bumped by every frame that changes a link or
+         * an address.
+         * @return stamp
+         */
+        uint32_t get_stamp() const;
+        
+protected:
+        /**
+         * Find or add a node.
+         * @param addr64 64-bit address, 0xffffffffffffffff if not known
+         * @param addr16 16-bit address, 0xfffe if not known
+         * @return node index, -1 for broadcast or no address
+         */
+        long find_node(uint64_t addr64, uint16_t addr16);
+        
+        /**
+         * Set the link of a node.
+         * @param index node index
+         * @param link next hop
+         */
+        void set_link(long index, long link);
+        
+        /**
+         * Nodes, in order first seen.
+         */
+        std::vector<Node> nodes;
+        
+        /**
+         * Node addresses, by node index.
+         */
+        NodeAddressMap addresses;
+        
+        /**
+         * Route being checked by get_source_route(), kept to reuse its
+         * storage.
+         */
+        std::vector<uint16_t> route;
+        
+        /**
+         * Create Source Route frames built.
+         */
+        size_t sent_count;
+        
+        /**
+         * Change stamp.
+         */
+        uint32_t stamp;
+};
+
+#endif //__NETWORK_TOPOLOGY_H
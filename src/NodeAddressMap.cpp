@@ -0,0 +1,175 @@
+/************************************************************************/
+/* NodeAddressMap                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Node Address Map                                   */
+/*                                                                      */
+/* NodeAddressMap.cpp                                                   */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "NodeAddressMap.h"
+
+const uint64_t NodeAddressMap::addr64_unknown;
+const uint64_t NodeAddressMap::addr64_broadcast;
+const uint16_t NodeAddressMap::addr16_unknown;
+const uint16_t NodeAddressMap::addr16_broadcast;
+
+NodeAddressMap::NodeAddressMap()
+{
+        // nothing
+}
+
+
+NodeAddressMap::~NodeAddressMap()
+{
+        // nothing
+}
+
+
+long NodeAddressMap::add(uint64_t addr64, uint16_t addr16, bool &changed16)
+{
+        bool has64 = addr64 != addr64_unknown;
+        bool has16 = addr16 != addr16_unknown && addr16 != addr16_broadcast;
+        long index = -1;
+        
+        if (addr64 == addr64_broadcast || (!has64 && !has16))
+                return -1;
+        
+        if (has64)
+        {
+                std::tr1::unordered_map<uint64_t, size_t>::iterator it = by_addr64.find(addr64);
+                if (it != by_addr64.end())
+                {
+                        index = it->second;
+                }
+                else if (has16)
+                {
+                        // first 64-bit address for a node so far only
+                        // known by its 16-bit address takes over its entry
+                        std::tr1::unordered_map<uint16_t, size_t>::iterator it16 = by_addr16.find(addr16);
+                        if (it16 != by_addr16.end() && entries[it16->second].addr64 == node_key16(addr16))
+                        {
+                                index = it16->second;
+                                by_addr64.erase(node_key16(addr16));
+                                entries[index].addr64 = addr64;
+                                by_addr64[addr64] = index;
+                        }
+                }
+        }
+        else
+        {
+                std::tr1::unordered_map<uint16_t, size_t>::iterator it16 = by_addr16.find(addr16);
+                if (it16 != by_addr16.end())
+                        index = it16->second;
+                else
+                        addr64 = node_key16(addr16);
+        }
+        
+        if (index < 0)
+        {
+                Entry entry;
+                entry.addr64 = addr64;
+                entry.addr16 = addr16_unknown;
+                
+                index = entries.size();
+                entries.push_back(entry);
+                by_addr64[addr64] = index;
+        }
+        
+        // 16-bit addresses change when a node rejoins, and may be handed
+        // on to another node
+        if (has16 && entries[index].addr16 != addr16)
+        {
+                std::tr1::unordered_map<uint16_t, size_t>::iterator it16 = by_addr16.find(addr16);
+                if (it16 != by_addr16.end() && (long)it16->second != index)
+                        entries[it16->second].addr16 = addr16_unknown;
+                
+                if (entries[index].addr16 != addr16_unknown)
+                        by_addr16.erase(entries[index].addr16);
+                
+                entries[index].addr16 = addr16;
+                by_addr16[addr16] = index;
+                changed16 = true;
+        }
+        
+        return index;
+}
+
+
+void NodeAddressMap::clear()
+{
+        entries.clear();
+        by_addr64.clear();
+        by_addr16.clear();
+}
+
+
+size_t NodeAddressMap::get_count() const
+{
+        return entries.size();
+}
+
+
+long NodeAddressMap::find64(uint64_t addr64) const
+{
+        std::tr1::unordered_map<uint64_t, size_t>::const_iterator it = by_addr64.find(addr64);
+        
+        return it != by_addr64.end() ? (long)it->second : -1;
+}
+
+
+long NodeAddressMap::find16(uint16_t addr16) const
+{
+        std::tr1::unordered_map<uint16_t, size_t>::const_iterator it = by_addr16.find(addr16);
+        
+        return it != by_addr16.end() ? (long)it->second : -1;
+}
+
+
+uint64_t NodeAddressMap::get_addr64(size_t index) const
+{
+        return entries[index].addr64;
+}
+
+
+uint16_t NodeAddressMap::get_addr16(size_t index) const
+{
+        return entries[index].addr16;
+}
+
+
+bool NodeAddressMap::is_key16(size_t index) const
+{
+        return (entries[index].addr64 & 0xffffffffffff0000ULL) == node_key16(0);
+}
+
+
+uint64_t NodeAddressMap::node_key16(uint16_t addr16)
+{
+        return 0xffffffffffff0000ULL | addr16;
+}
+
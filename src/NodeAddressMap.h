@@ -0,0 +1,159 @@
+/************************************************************************/
+/* NodeAddressMap                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Node Address Map                                   */
+/*                                                                      */
+/* NodeAddressMap.h                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __NODE_ADDRESS_MAP_H
+#define __NODE_ADDRESS_MAP_H
+
+#include <vector>
+#include <tr1/unordered_map>
+#include <stddef.h>
+#include <inttypes.h>
+
+/** Node Address Map
+ * 
+ * The 64-bit and 16-bit addresses of the nodes of a network, shared by
+ * the tables that keep something per node.  Nodes are numbered in the
+ * order they were first seen, so the owner keeps its own per node data
+ * in a vector alongside, and found by 64-bit address through a hash map.
+ * Nodes heard only by 16-bit address are keyed by node_key16() until a
+ * frame ties the two addresses together, when the 64-bit address takes
+ * over the entry.  A 16-bit address seen on a new node is taken away
+ * from whichever node had it before, as happens when a node rejoins.  
+ */
+class NodeAddressMap
+{
+public:
+        /**
+         * Unknown and broadcast addresses.
+         */
+        static const uint64_t addr64_unknown = 0xffffffffffffffffULL;
+        static const uint64_t addr64_broadcast = 0x000000000000ffffULL;
+        static const uint16_t addr16_unknown = 0xfffe;
+        static const uint16_t addr16_broadcast = 0xffff;
+        
+        /**
+         * Create a Node Address Map.
+         */
+        NodeAddressMap();
+        virtual ~NodeAddressMap();
+        
+        /**
+         * Find or add a node.  A new node gets index get_count() - 1.
+         * @param addr64 64-bit address, addr64_unknown if not known
+         * @param addr16 16-bit address, addr16_unknown if not known
+         * @param changed16 set true if a 16-bit address moved to or
+         * from a node, left alone otherwise
+         * @return node index, -1 for broadcast or no address
+         */
+        long add(uint64_t addr64, uint16_t addr16, bool &changed16);
+        
+        /**
+         * Drop all nodes.
+         */
+        void clear();
+        
+        /**
+         * Get number of nodes.
+         * @return node count
+         */
+        size_t get_count() const;
+        
+        /**
+         * Find a node by 64-bit address.
+         * @param addr64 64-bit address or node_key16()
+         * @return node index, -1 if not known
+         */
+        long find64(uint64_t addr64) const;
+        
+        /**
+         * Find a node by 16-bit address.
+         * @param addr16 16-bit address
+         * @return node index, -1 if not known
+         */
+        long find16(uint16_t addr16) const;
+        
+        /**
+         * Get 64-bit address of a node.
+         * @param index node index
+         * @return 64-bit address, node_key16() if unknown
+         */
+        uint64_t get_addr64(size_t index) const;
+        
+        /**
+         * Get 16-bit address of a node.
+         * @param index node index
+         * @return 16-bit address, addr16_unknown if unknown
+         */
+        uint16_t get_addr16(size_t index) const;
+        
+        /**
+         * Check for a node known only by 16-bit address.
+         * @param index node index
+         * @return true if the 64-bit address is not known
+         */
+        bool is_key16(size_t index) const;
+        
+        /**
+         * Make the key of a node known only by 16-bit address.
+         * @param addr16 16-bit address
+         * @return key
+         */
+        static uint64_t node_key16(uint16_t addr16);
+        
+protected:
+        /**
+         * Node addresses.
+         */
+        struct Entry
+        {
+                uint64_t addr64;                ///< 64-bit address, node_key16() if unknown
+                uint16_t addr16;                ///< 16-bit address, addr16_unknown if unknown
+        };
+        
+        /**
+         * Nodes, in order first seen.
+         */
+        std::vector<Entry> entries;
+        
+        /**
+         * Node index by 64-bit address or node_key16().
+         */
+        std::tr1::unordered_map<uint64_t, size_t> by_addr64;
+        
+        /**
+         * Node index by 16-bit address.
+         */
+        std::tr1::unordered_map<uint16_t, size_t> by_addr16;
+};
+
+#endif //__NODE_ADDRESS_MAP_H
@@ -0,0 +1,210 @@
+/************************************************************************/
+/* NodeTable                                                            */
+/*                                                                      */
+/* ZigBee Terminal - Node Table                                         */
+/*                                                                      */
+/* NodeTable.cpp                                                        */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "NodeTable.h"
+
+#include <string.h>
+#include <time.h>
+
+const int NodeTable::rssi_bins;
+
+NodeTable::NodeTable() :
+        stamp(0)
+{
+        for (int i = 0; i < 256; i++)
+                pending[i] = -1;
+}
+
+
+NodeTable::~NodeTable()
+{
+        // nothing
+}
+
+
+void NodeTable::add(const ZigBeePacketView &frame, PacketLogStore::PacketLogDirection dir, uint32_t time)
+{
+        if (time == 0)
+                time = ::time(0);
+        
+        int id = frame.get_identifier();
+        
+        if (dir == PacketLogStore::PLD_TX)
+        {
+                switch (id)
+                {
+                        case ZigBeePacket::ZBPID_TxRequest64:
+                        case ZigBeePacket::ZBPID_TxRequest16:
+                        case ZigBeePacket::ZBPID_TxRequest:
+                        case ZigBeePacket::ZBPID_EATxRequest:
+                        case ZigBeePacket::ZBPID_RemoteATCommand:
+                                break;
+                        default:
+                                return;
+                }
+                
+                long index = find_node(frame.has_field(ZigBeePacket::ZBPF_Dest64) ? frame.get_dest64() : NodeAddressMap::addr64_unknown,
+                        frame.has_field(ZigBeePacket::ZBPF_Dest16) ? frame.get_dest16() : NodeAddressMap::addr16_unknown, time);
+                
+                // broadcasts get a transmit status too, but it says
+                // nothing about any one node
+                uint8_t frame_id = frame.get_frame_id();
+                if (frame_id != 0)
+                        pending[frame_id] = index;
+                
+                if (index < 0)
+                        return;
+                
+                Node &node = nodes[index];
+                node.tx_frames++;
+                node.tx_bytes += frame.get_payload_length();
+                stamp++;
+                return;
+        }
+        
+        if (id == ZigBeePacket::ZBPID_TxStatusS1 || id == ZigBeePacket::ZBPID_TxStatusS2)
+        {
+                uint8_t frame_id = frame.get_frame_id();
+                if (frame_id == 0 || pending[frame_id] < 0)
+                        return;
+                
+                Node &node = nodes[pending[frame_id]];
+                pending[frame_id] = -1;
+                
+                node.tx_status++;
+                if (id == ZigBeePacket::ZBPID_TxStatusS2)
+                {
+                        node.retries += frame.get_field_value(ZigBeePacket::ZBPF_TransmitRetries);
+                        if (frame.get_field_value(ZigBeePacket::ZBPF_DeliveryStatus) != 0)
+                                node.failures++;
+                }
+                else if (frame.get_status() != 0)
+                {
+                        node.failures++;
+                }
+                stamp++;
+                return;
+        }
+        
+        // anything else is charged to its source, if it has one
+        long index = find_node(frame.has_field(ZigBeePacket::ZBPF_Src64) ? frame.get_src64() : NodeAddressMap::addr64_unknown,
+                frame.has_field(ZigBeePacket::ZBPF_Src16) ? frame.get_src16() : NodeAddressMap::addr16_unknown, time);
+        
+        if (index < 0)
+                return;
+        
+        Node &node = nodes[index];
+        node.rx_frames++;
+        node.rx_bytes += frame.get_payload_length();
+        node.last_seen = time;
+        
+        if (frame.has_field(ZigBeePacket::ZBPF_RSSI))
+        {
+                uint8_t rssi = frame.get_field_value(ZigBeePacket::ZBPF_RSSI);
+                
+                // moving average over roughly the last 8 readings, in
+                // 1/16 dB so small changes are not rounded away
+                if (node.rssi_count == 0)
+                        node.rssi_avg = rssi * 16;
+                else
+                        node.rssi_avg = ((int32_t)node.rssi_avg * 7 + rssi * 16 + 4) / 8;
+                
+                node.rssi_count++;
+                node.rssi_hist[get_rssi_bin(rssi)]++;
+        }
+        
+        stamp++;
+}
+
+
+void NodeTable::clear()
+{
+        nodes.clear();
+        addresses.clear();
+        
+        for (int i = 0; i < 256; i++)
+                pending[i] = -1;
+        
+        stamp++;
+}
+
+
+size_t NodeTable::get_count() const
+{
+        return nodes.size();
+}
+
+
+const NodeTable::Node &NodeTable::get_node(size_t index) const
+{
+        return nodes[index];
+}
+
+
+const NodeAddressMap &NodeTable::get_addresses() const
+{
+        return addresses;
+}
+
+
+uint32_t NodeTable::get_stamp() const
+{
+        return stamp;
+}
+
+
+int NodeTable::get_rssi_bin(uint8_t rssi)
+{
+        if (rssi < 40)
+                return 0;
+        if (rssi >= 100)
+                return rssi_bins - 1;
+        return (rssi - 30) / 10;
+}
+
+
+long NodeTable::find_node(uint64_t addr64, uint16_t addr16, uint32_t time)
+{
+        bool changed16 = false;
+        long index = addresses.add(addr64, addr16, changed16);
+        
+        if (index >= 0 && (size_t)index == nodes.size())
+        {
+                Node node;
+                memset(&node, 0, sizeof(node));
+                node.first_seen = time;
+                nodes.push_back(node);
+        }
+        
+        return index;
+}
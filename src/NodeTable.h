@@ -0,0 +1,166 @@
+/************************************************************************/
+/* NodeTable                                                            */
+/*                                                                      */
+/* ZigBee Terminal - Node Table                                         */
+/*                                                                      */
+/* NodeTable.h                                                          */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __NODE_TABLE_H
+#define __NODE_TABLE_H
+
+#include "ZigBeePacketView.h"
+#include "PacketLogStore.h"
+#include "NodeAddressMap.h"
+
+#include <vector>
+#include <stddef.h>
+#include <inttypes.h>
+
+/** Node Table
+ * 
+ * Per node statistics, updated as each frame is decoded.  Nodes are kept
+ * in a vector in the order they were first seen, alongside a
+ * NodeAddressMap that finds them by address, so adding a frame is a
+ * couple of lookups and a few counter updates.  
+ * Transmit status frames only carry a frame ID, so the destination of
+ * each transmit request is remembered by frame ID to charge retries and
+ * delivery failures to the right node.  
+ */
+class NodeTable
+{
+public:
+        /**
+         * Number of RSSI histogram bins.
+         */
+        static const int rssi_bins = 8;
+        
+        /**
+         * Node statistics.  The node's addresses are in get_addresses().
+         */
+        struct Node
+        {
+                uint32_t rx_frames;             ///< Frames received from node
+                uint32_t tx_frames;             ///< Frames sent to node
+                uint64_t rx_bytes;              ///< Payload bytes received from node
+                uint64_t tx_bytes;              ///< Payload bytes sent to node
+                uint32_t rssi_count;            ///< Number of RSSI readings
+                uint32_t rssi_avg;              ///< RSSI moving average, -dBm * 16
+                uint32_t rssi_hist[rssi_bins];  ///< RSSI histogram, see get_rssi_bin()
+                uint32_t tx_status;             ///< Transmit status frames
+                uint32_t retries;               ///< Transmit retries
+                uint32_t failures;              ///< Delivery failures
+                uint32_t first_seen;            ///< Time of first frame, seconds
+                uint32_t last_seen;             ///< Time of last frame received, seconds
+        };
+        
+        /**
+         * Create a Node Table.
+         */
+        NodeTable();
+        virtual ~NodeTable();
+        
+        /**
+         * Add a frame.
+         * @param frame frame view
+         * @param dir direction
+         * @param time time in seconds, 0 for now
+         */
+        void add(const ZigBeePacketView &frame, PacketLogStore::PacketLogDirection dir, uint32_t time = 0);
+        
+        /**
+         * Drop all nodes.
+         */
+        void clear();
+        
+        /**
+         * Get number of nodes.
+         * @return node count
+         */
+        size_t get_count() const;
+        
+        /**
+         * Get node.
+         * @param index node index, in order first seen
+         * @return node
+         */
+        const Node &get_node(size_t index) const;
+        
+        /**
+         * Get node addresses.
+         * @return addresses, by node index
+         */
+        const NodeAddressMap &get_addresses() const;
+        
+        /**
+         * Get change stamp.  Bumped by every frame that changes a node.
+         * @return stamp
+         */
+        uint32_t get_stamp() const;
+        
+        /**
+         * Get RSSI histogram bin of a reading.  Bin 0 is stronger than
+         * -40 dBm, then 10 dB per bin down to the last, -100 dBm or weaker.
+         * @param rssi RSSI, -dBm
+         * @return bin
+         */
+        static int get_rssi_bin(uint8_t rssi);
+        
+protected:
+        /**
+         * Find or add a node.
+         * @param addr64 64-bit address, 0xffffffffffffffff if not known
+         * @param addr16 16-bit address, 0xfffe if not known
+         * @param time time in seconds
+         * @return node index, -1 for broadcast or no address
+         */
+        long find_node(uint64_t addr64, uint16_t addr16, uint32_t time);
+        
+        /**
+         * Nodes, in order first seen.
+         */
+        std::vector<Node> nodes;
+        
+        /**
+         * Node addresses, by node index.
+         */
+        NodeAddressMap addresses;
+        
+        /**
+         * Node index of the destination of each outstanding transmit
+         * request, by frame ID, -1 for none.
+         */
+        long pending[256];
+        
+        /**
+         * Change stamp.
+         */
+        uint32_t stamp;
+};
+
+#endif //__NODE_TABLE_H
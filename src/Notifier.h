@@ -0,0 +1,72 @@
+/************************************************************************/
+/* Notifier                                                             */
+/*                                                                      */
+/* ZigBee Terminal - Main Loop Notifier                                 */
+/*                                                                      */
+/* Notifier.h                                                           */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __NOTIFIER_H
+#define __NOTIFIER_H
+
+#include <sigc++/sigc++.h>
+
+/** Notifier
+ * 
+ * Wakes up the thread running the main loop.  I/O threads call notify()
+ * and the main loop emits signal_notify() in response, so that the core
+ * classes can hand work to whatever main loop the application runs.  
+ * @see GlibNotifier
+ * @see FdNotifier
+ */
+class Notifier
+{
+public:
+        virtual ~Notifier();
+        
+        /**
+         * Request a notify signal on the main loop.  May be called from
+         * any thread.  Several calls may result in a single signal.
+         */
+        virtual void notify() = 0;
+        
+        /**
+         * Notify signal.  Emitted on the main loop.
+         * @par Prototype:
+         * <tt>void on_my_%notify()</tt>
+         */
+        sigc::signal<void> signal_notify();
+        
+protected:
+        /**
+         * Notify signal.
+         */
+        sigc::signal<void> m_signal_notify;
+};
+
+#endif //__NOTIFIER_H
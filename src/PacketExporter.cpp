@@ -0,0 +1,455 @@
+/************************************************************************/
+/* PacketExporter                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Columnar packet exporter                           */
+/*                                                                      */
+/* PacketExporter.cpp                                                   */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "PacketExporter.h"
+#include "HexCodec.h"
+
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+
+// longest CSV line without its data
+#define CSV_LINE_SIZE 96
+
+// fixed size columns of one columnar row
+#define COLUMNAR_ROW_SIZE 28
+
+static const char *csv_header = "timestamp,direction,identifier,addr64,addr16,rssi,cluster,profile,length,data\n";
+
+// address fields, first present wins
+static const ZigBeePacket::ZBP_Field addr64_fields[] = {
+        ZigBeePacket::ZBPF_Src64,
+        ZigBeePacket::ZBPF_Dest64,
+        ZigBeePacket::ZBPF_Sender64,
+        ZigBeePacket::ZBPF_New64,
+        ZigBeePacket::ZBPF_None
+};
+
+static const ZigBeePacket::ZBP_Field addr16_fields[] = {
+        ZigBeePacket::ZBPF_Src16,
+        ZigBeePacket::ZBPF_Dest16,
+        ZigBeePacket::ZBPF_Sender16,
+        ZigBeePacket::ZBPF_New16,
+        ZigBeePacket::ZBPF_None
+};
+
+// hex digits of the low bytes of v, most significant first
+static char *encode_hex(char *p, uint64_t v, int bytes)
+{
+        uint8_t b[8];
+        int i;
+        
+        for (i = bytes - 1; i >= 0; i--, v >>= 8)
+                b[i] = v;
+                
+        return HexCodec::encode(b, bytes, p, false);
+}
+
+PacketExporter::PacketExporter() :
+        file(0),
+        format(EF_Csv),
+        row_group_size(4096),
+        row_count(0),
+        offset(0)
+{
+        // nothing
+}
+
+
+PacketExporter::~PacketExporter()
+{
+        close();
+}
+
+
+// Static
+bool PacketExporter::parse_format(const std::string &name, ExportFormat &format)
+{
+        if (name == "csv")
+                format = EF_Csv;
+        else if (name == "columnar")
+                format = EF_Columnar;
+        else
+                return false;
+                
+        return true;
+}
+
+
+bool PacketExporter::open(const std::string &filename, ExportFormat format)
+{
+        close();
+        
+        file = fopen(filename.c_str(), "wb");
+        
+        if (!file)
+        {
+                std::cerr << "[PacketExporter] Unable to open " << filename << std::endl;
+                return false;
+        }
+        
+        // row groups are written whole, stdio only needs to batch the small writes
+        setvbuf(file, 0, _IOFBF, 65536);
+        
+        this->format = format;
+        row_count = 0;
+        offset = 0;
+        group_offsets.clear();
+        out.clear();
+        
+        if (format == EF_Csv)
+        {
+                out.insert(out.end(), csv_header, csv_header + strlen(csv_header));
+        }
+        else
+        {
+                out.resize(EXPORT_HEADER_SIZE);
+                memcpy(&out[0], EXPORT_MAGIC, 8);
+                CaptureFile::write_uint32(&out[8], EXPORT_VERSION);
+                CaptureFile::write_uint32(&out[12], 0);
+        }
+        
+        if (!write_out())
+        {
+                std::cerr << "[PacketExporter] Error writing header" << std::endl;
+                return false;
+        }
+        
+        return true;
+}
+
+
+void PacketExporter::close()
+{
+        size_t pos;
+        
+        if (!file)
+                return;
+                
+        if (get_pending() > 0)
+                write_row_group();
+        
+        if (file && format == EF_Columnar)
+        {
+                out.resize(group_offsets.size() * 8 + EXPORT_TRAILER_SIZE);
+                
+                for (pos = 0; pos < group_offsets.size(); pos++)
+                        CaptureFile::write_uint64(&out[pos * 8], group_offsets[pos]);
+                
+                pos *= 8;
+                CaptureFile::write_uint32(&out[pos], group_offsets.size());
+                CaptureFile::write_uint32(&out[pos + 4], 0);
+                memcpy(&out[pos + 8], EXPORT_MAGIC, 8);
+                
+                if (!write_out())
+                        std::cerr << "[PacketExporter] Error writing trailer" << std::endl;
+        }
+        
+        if (file)
+        {
+                fclose(file);
+                file = 0;
+        }
+        
+        group_offsets.clear();
+}
+
+
+bool PacketExporter::is_open()
+{
+        return file != 0;
+}
+
+
+void PacketExporter::set_row_group_size(size_t rows)
+{
+        row_group_size = rows > 0 ? rows : 1;
+}
+
+
+size_t PacketExporter::get_row_group_size()
+{
+        return row_group_size;
+}
+
+
+bool PacketExporter::add(uint64_t timestamp, CaptureFile::CaptureDirection dir, const ZigBeePacketView &frame)
+{
+        uint8_t present = 0;
+        uint64_t addr64 = 0;
+        uint16_t addr16 = 0;
+        const uint8_t *data;
+        size_t count;
+        int id;
+        int i;
+        
+        if (!file)
+                return false;
+                
+        for (i = 0; addr64_fields[i] != ZigBeePacket::ZBPF_None; i++)
+        {
+                if (frame.has_field(addr64_fields[i]))
+                {
+                        addr64 = frame.get_field_value(addr64_fields[i]);
+                        present |= EC_Addr64;
+                        break;
+                }
+        }
+        
+        for (i = 0; addr16_fields[i] != ZigBeePacket::ZBPF_None; i++)
+        {
+                if (frame.has_field(addr16_fields[i]))
+                {
+                        addr16 = frame.get_field_value(addr16_fields[i]);
+                        present |= EC_Addr16;
+                        break;
+                }
+        }
+        
+        if (frame.has_field(ZigBeePacket::ZBPF_RSSI))
+                present |= EC_RSSI;
+        if (frame.has_field(ZigBeePacket::ZBPF_ClusterID))
+                present |= EC_Cluster;
+        if (frame.has_field(ZigBeePacket::ZBPF_ProfileID))
+                present |= EC_Profile;
+        
+        data = frame.get_data(count);
+        
+        if (data)
+                present |= EC_Data;
+        
+        id = frame.get_identifier();
+        
+        col_timestamp.push_back(timestamp);
+        col_direction.push_back(dir);
+        col_identifier.push_back(id < 0 ? 0 : id);
+        col_present.push_back(present);
+        col_addr64.push_back(addr64);
+        col_addr16.push_back(addr16);
+        col_rssi.push_back(frame.get_field_value(ZigBeePacket::ZBPF_RSSI));
+        col_cluster.push_back(frame.get_field_value(ZigBeePacket::ZBPF_ClusterID));
+        col_profile.push_back(frame.get_field_value(ZigBeePacket::ZBPF_ProfileID));
+        col_data_length.push_back(count);
+        
+        if (count > 0)
+                col_data.insert(col_data.end(), data, data + count);
+        
+        row_count++;
+        
+        if (get_pending() >= row_group_size)
+                return write_row_group();
+                
+        return true;
+}
+
+
+bool PacketExporter::flush()
+{
+        if (!file)
+                return false;
+                
+        if (get_pending() > 0 && !write_row_group())
+                return false;
+        
+        fflush(file);
+        
+        return true;
+}
+
+
+uint64_t PacketExporter::get_row_count()
+{
+        return row_count;
+}
+
+
+bool PacketExporter::write_row_group()
+{
+        uint64_t start = offset;
+        bool ok;
+        
+        if (format == EF_Csv)
+                encode_csv();
+        else
+                encode_columnar();
+        
+        ok = write_out();
+        
+        if (ok && format == EF_Columnar)
+                group_offsets.push_back(start);
+        
+        if (!ok)
+                std::cerr << "[PacketExporter] Error writing row group" << std::endl;
+        
+        col_timestamp.clear();
+        col_direction.clear();
+        col_identifier.clear();
+        col_present.clear();
+        col_addr64.clear();
+        col_addr16.clear();
+        col_rssi.clear();
+        col_cluster.clear();
+        col_profile.clear();
+        col_data_length.clear();
+        col_data.clear();
+        
+        return ok;
+}
+
+
+void PacketExporter::encode_csv()
+{
+        size_t n = get_pending();
+        const uint8_t *data = col_data.empty() ? 0 : &col_data[0];
+        char *start;
+        char *p;
+        size_t i;
+        
+        // sized for the worst case once, then trimmed
+        out.resize(n * CSV_LINE_SIZE + col_data.size() * 2);
+        start = p = (char *)&out[0];
+        
+        for (i = 0; i < n; i++)
+        {
+                uint8_t present = col_present[i];
+                
+                p += sprintf(p, "%lu.%06u,%s,",
+                        (unsigned long)(col_timestamp[i] / 1000000), (unsigned int)(col_timestamp[i] % 1000000),
+                        col_direction[i] == CaptureFile::CD_TX ? "TX" : "RX");
+                p = encode_hex(p, col_identifier[i], 1);
+                *p++ = ',';
+                
+                if (present & EC_Addr64)
+                        p = encode_hex(p, col_addr64[i], 8);
+                *p++ = ',';
+                
+                if (present & EC_Addr16)
+                        p = encode_hex(p, col_addr16[i], 2);
+                *p++ = ',';
+                
+                if (present & EC_RSSI)
+                        p += sprintf(p, "%u", col_rssi[i]);
+                *p++ = ',';
+                
+                if (present & EC_Cluster)
+                        p = encode_hex(p, col_cluster[i], 2);
+                *p++ = ',';
+                
+                if (present & EC_Profile)
+                        p = encode_hex(p, col_profile[i], 2);
+                *p++ = ',';
+                
+                if (present & EC_Data)
+                {
+                        p += sprintf(p, "%u,", col_data_length[i]);
+                        p = HexCodec::encode(data, col_data_length[i], p, false);
+                }
+                else
+                {
+                        *p++ = ',';
+                }
+                
+                *p++ = '\n';
+                data += col_data_length[i];
+        }
+        
+        out.resize(p - start);
+}
+
+
+void PacketExporter::encode_columnar()
+{
+        size_t n = get_pending();
+        size_t body = n * COLUMNAR_ROW_SIZE + col_data.size();
+        uint8_t *p;
+        size_t i;
+        
+        out.resize(EXPORT_GROUP_HEADER_SIZE + body);
+        p = &out[0];
+        
+        CaptureFile::write_uint32(p, n);
+        CaptureFile::write_uint32(p + 4, body);
+        p += EXPORT_GROUP_HEADER_SIZE;
+        
+        for (i = 0; i < n; i++, p += 8)
+                CaptureFile::write_uint64(p, col_timestamp[i]);
+        
+        memcpy(p, &col_direction[0], n);
+        p += n;
+        memcpy(p, &col_identifier[0], n);
+        p += n;
+        memcpy(p, &col_present[0], n);
+        p += n;
+        
+        for (i = 0; i < n; i++, p += 8)
+                CaptureFile::write_uint64(p, col_addr64[i]);
+        for (i = 0; i < n; i++, p += 2)
+                CaptureFile::write_uint16(p, col_addr16[i]);
+        
+        memcpy(p, &col_rssi[0], n);
+        p += n;
+        
+        for (i = 0; i < n; i++, p += 2)
+                CaptureFile::write_uint16(p, col_cluster[i]);
+        for (i = 0; i < n; i++, p += 2)
+                CaptureFile::write_uint16(p, col_profile[i]);
+        for (i = 0; i < n; i++, p += 2)
+                CaptureFile::write_uint16(p, col_data_length[i]);
+        
+        if (!col_data.empty())
+                memcpy(p, &col_data[0], col_data.size());
+}
+
+
+bool PacketExporter::write_out()
+{
+        if (out.empty())
+                return true;
+                
+        if (fwrite(&out[0], 1, out.size(), file) != out.size())
+        {
+                fclose(file);
+                file = 0;
+                return false;
+        }
+        
+        offset += out.size();
+        
+        return true;
+}
+
+
+size_t PacketExporter::get_pending()
+{
+        return col_timestamp.size();
+}
@@ -0,0 +1,265 @@
+/************************************************************************/
+/* PacketExporter                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Columnar packet exporter                           */
+/*                                                                      */
+/* PacketExporter.h                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __PACKET_EXPORTER_H
+#define __PACKET_EXPORTER_H
+
+#include "CaptureFile.h"
+#include "ZigBeePacketView.h"
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+#define EXPORT_MAGIC "ZBTCOL\r\n"
+#define EXPORT_VERSION 1
+#define EXPORT_HEADER_SIZE 16
+#define EXPORT_GROUP_HEADER_SIZE 8
+#define EXPORT_TRAILER_SIZE 16
+
+/** Packet Exporter
+ * Streams decoded frames to a file for analysis elsewhere.  Fields are
+ * read straight from frame views into one column per field, so frames
+ * are never decoded into ZigBeePacket objects.  When a row group's worth
+ * of rows has been collected it is written out in one go and the columns
+ * are cleared.  Columns are:
+ * timestamp, direction, identifier, 64-bit address, 16-bit address,
+ * RSSI, cluster ID, profile ID, data length and data.  The addresses are
+ * the first of the source, destination, sender or new address fields in
+ * the frame.  Fields a frame type does not have are left empty.  
+ * Two formats are written:
+ * @li EF_Csv, one line per frame with a header line, integers in decimal
+ * and addresses, IDs and data in hex
+ * @li EF_Columnar, a compact binary file
+ * 
+ * The columnar file starts with a 16 byte header:
+ * @li 8 bytes magic, EXPORT_MAGIC
+ * @li 4 bytes format version, EXPORT_VERSION
+ * @li 4 bytes flags, zero
+ * 
+ * followed by row groups, each an 8 byte header:
+ * @li 4 bytes row count, n
+ * @li 4 bytes length of the columns that follow
+ * 
+ * and then the columns one after another, each n values long: 8 byte
+ * timestamp, 1 byte direction, 1 byte identifier, 1 byte present mask
+ * (see ExportColumn), 8 byte 64-bit address, 2 byte 16-bit address, 1 byte
+ * RSSI, 2 byte cluster ID, 2 byte profile ID, 2 byte data length, and
+ * last the data of all rows run together.  Missing fields are zero with
+ * their present bit clear.  After the last row group come the file
+ * offsets of every row group, 8 bytes each, and a 16 byte trailer:
+ * @li 4 bytes row group count
+ * @li 4 bytes reserved, zero
+ * @li 8 bytes magic, EXPORT_MAGIC
+ * 
+ * so a reader can find any row group from the end of the file.  All
+ * integers are little endian.  A file without a trailer was not closed;
+ * its row groups can still be read from the front.  
+ * @see CaptureFile
+ */
+class PacketExporter
+{
+public:
+        /**
+         * Output format.
+         */
+        typedef enum
+        {
+                EF_Csv = 0,
+                EF_Columnar = 1,
+        }
+        ExportFormat;
+        
+        /**
+         * Present mask bits, one per optional column.
+         */
+        typedef enum
+        {
+                EC_Addr64 = 0x01,
+                EC_Addr16 = 0x02,
+                EC_RSSI = 0x04,
+                EC_Cluster = 0x08,
+                EC_Profile = 0x10,
+                EC_Data = 0x20,
+        }
+        ExportColumn;
+        
+        /**
+         * Create a Packet Exporter.
+         */
+        PacketExporter();
+        virtual ~PacketExporter();
+        
+        /**
+         * Parse a format name.
+         * @param name csv or columnar
+         * @param format return format
+         * @return true if known
+         */
+        static bool parse_format(const std::string &name, ExportFormat &format);
+        
+        /**
+         * Create an export file and write its header.  Closes any file
+         * already open.  Overwrites an existing file.
+         * @param filename file name
+         * @param format output format
+         * @return true on success
+         */
+        bool open(const std::string &filename, ExportFormat format);
+        
+        /**
+         * Write the rows still pending, finish and close the file.
+         */
+        void close();
+        
+        /**
+         * Check if an export file is open.
+         * @return true if open
+         */
+        bool is_open();
+        
+        /**
+         * Set rows per row group.  Takes effect at the next row group.
+         * @param rows rows, at least 1 (default 4096)
+         */
+        void set_row_group_size(size_t rows);
+        
+        /**
+         * Get rows per row group.
+         * @return rows
+         */
+        size_t get_row_group_size();
+        
+        /**
+         * Add a frame.  Writes a row group when it fills up.
+         * @param timestamp microseconds since the epoch
+         * @param dir direction
+         * @param frame frame, only read during the call
+         * @return true on success
+         */
+        bool add(uint64_t timestamp, CaptureFile::CaptureDirection dir, const ZigBeePacketView &frame);
+        
+        /**
+         * Write the pending rows as a row group, even if it is not full,
+         * and flush the file.
+         * @return true on success
+         */
+        bool flush();
+        
+        /**
+         * Get number of rows added since the file was opened.
+         * @return rows
+         */
+        uint64_t get_row_count();
+        
+protected:
+        /**
+         * Write pending rows and clear the columns.
+         * @return true on success
+         */
+        bool write_row_group();
+        
+        /**
+         * Encode pending rows as CSV lines into out.
+         */
+        void encode_csv();
+        
+        /**
+         * Encode pending rows as a columnar row group into out.
+         */
+        void encode_columnar();
+        
+        /**
+         * Write out to the file.
+         * @return true on success
+         */
+        bool write_out();
+        
+        /**
+         * Get number of pending rows.
+         * @return rows
+         */
+        size_t get_pending();
+        
+        /**
+         * File.
+         */
+        FILE *file;
+        
+        /**
+         * Output format.
+         */
+        ExportFormat format;
+        
+        /**
+         * Rows per row group.
+         */
+        size_t row_group_size;
+        
+        /**
+         * Rows added since open.
+         */
+        uint64_t row_count;
+        
+        /**
+         * Bytes written since open.
+         */
+        uint64_t offset;
+        
+        /**
+         * File offsets of the row groups written, columnar only.
+         */
+        std::vector<uint64_t> group_offsets;
+        
+        // columns of the pending rows
+        std::vector<uint64_t> col_timestamp;
+        std::vector<uint8_t> col_direction;
+        std::vector<uint8_t> col_identifier;
+        std::vector<uint8_t> col_present;
+        std::vector<uint64_t> col_addr64;
+        std::vector<uint16_t> col_addr16;
+        std::vector<uint8_t> col_rssi;
+        std::vector<uint16_t> col_cluster;
+        std::vector<uint16_t> col_profile;
+        std::vector<uint16_t> col_data_length;
+        std::vector<uint8_t> col_data;
+        
+        /**
+         * Encoded row group, reused.
+         */
+        std::vector<uint8_t> out;
+};
+
+#endif //__PACKET_EXPORTER_H
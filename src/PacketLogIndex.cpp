@@ -0,0 +1,410 @@
+/************************************************************************/
+/* PacketLogIndex                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Packet Log Index                                   */
+/*                                                                      */
+/* PacketLogIndex.cpp                                                   */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "PacketLogIndex.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+const uint32_t PacketLogIndex::time_bucket;
+
+// query keys, in PacketLogKey order
+static const char *key_names[PacketLogIndex::PLK_Count] = {
+        "type", "src64", "src16", "dest64", "dest16", "cluster", "profile", "port"
+};
+
+PacketLogIndex::PacketLogIndex() :
+        first_seq(0),
+        total(0),
+        stale(0)
+{
+        // nothing
+}
+
+
+PacketLogIndex::~PacketLogIndex()
+{
+        // nothing
+}
+
+
+void PacketLogIndex::add(size_t seq, const ZigBeePacketView &frame, int port, uint32_t time)
+{
+        uint64_t value;
+        Kept k;
+        
+        if (kept.empty())
+                first_seq = seq;
+                
+        k.time = time;
+        k.postings = 1;
+                
+        for (int i = 0; i < PLK_Count; i++)
+        {
+                if (get_key_value((PacketLogKey)i, frame, port, value))
+                {
+                        postings[i][value].push_back(seq);
+                        k.postings++;
+                }
+        }
+        
+        time_postings[time / time_bucket].push_back(seq);
+        
+        kept.push_back(k);
+        total += k.postings;
+}
+
+
+void PacketLogIndex::drop_before(size_t seq)
+{
+        while (first_seq < seq && !kept.empty())
+        {
+                stale += kept.front().postings;
+                kept.pop_front();
+                first_seq++;
+        }
+        
+        first_seq = seq;
+        
+        // queries skip dropped postings, sweep once they are half the index
+        if (stale > 1024 && stale >= total / 2)
+                sweep();
+}
+
+
+void PacketLogIndex::clear()
+{
+        for (int k = 0; k < PLK_Count; k++)
+                postings[k].clear();
+        time_postings.clear();
+        kept.clear();
+        total = 0;
+        stale = 0;
+}
+
+
+void PacketLogIndex::find(const Query &q, std::vector<size_t> &seqs)
+{
+        std::vector<uint64_t> values[PLK_Count];
+        std::vector<uint64_t> buckets;
+        std::vector<size_t> storage[PLK_Count + 1];
+        std::vector<Span> spans;
+        Span s;
+        
+        seqs.clear();
+        
+        for (size_t i = 0; i < q.terms.size(); i++)
+                values[q.terms[i].key].push_back(q.terms[i].value);
+                
+        for (int k = 0; k < PLK_Count; k++)
+        {
+                if (values[k].empty())
+                        continue;
+                        
+                s = get_span(postings[k], values[k], storage[k]);
+                
+                if (s.begin == s.end)
+                        return;
+                        
+                spans.push_back(s);
+        }
+        
+        if (q.time_from != 0 || q.time_to != 0)
+        {
+                uint32_t to = q.time_to == 0 ? 0xffffffff : q.time_to;
+                
+                // only look at buckets that exist, a wide range may hold few
+                for (Postings::iterator it = time_postings.begin(); it != time_postings.end(); ++it)
+                {
+                        if (it->first >= q.time_from / time_bucket && it->first <= to / time_bucket)
+                                buckets.push_back(it->first);
+                }
+                
+                s = get_span(time_postings, buckets, storage[PLK_Count]);
+                
+                if (s.begin == s.end)
+                        return;
+                        
+                spans.push_back(s);
+        }
+        
+        if (spans.empty())
+        {
+                // everything kept
+                for (size_t i = 0; i < kept.size(); i++)
+                        seqs.push_back(first_seq + i);
+                return;
+        }
+        
+        // walk the shortest list and look the rest up, each search starts
+        // where the last one left off
+        for (size_t i = 1; i < spans.size(); i++)
+        {
+                if (spans[i].end - spans[i].begin < spans[0].end - spans[0].begin)
+                        std::swap(spans[0], spans[i]);
+        }
+        
+        for (const size_t *p = std::lower_bound(spans[0].begin, spans[0].end, first_seq); p < spans[0].end; p++)
+        {
+                bool match = true;
+                
+                for (size_t i = 1; i < spans.size() && match; i++)
+                {
+                        spans[i].begin = std::lower_bound(spans[i].begin, spans[i].end, *p);
+                        match = spans[i].begin < spans[i].end && *spans[i].begin == *p;
+                }
+                
+                if (match)
+                        seqs.push_back(*p);
+        }
+        
+        // time buckets are matched by minute, trim to the exact range
+        if (!buckets.empty())
+        {
+                size_t n = 0;
+                
+                for (size_t i = 0; i < seqs.size(); i++)
+                {
+                        uint32_t t = kept[seqs[i] - first_seq].time;
+                        
+                        if (t >= q.time_from && (q.time_to == 0 || t <= q.time_to))
+                                seqs[n++] = seqs[i];
+                }
+                
+                seqs.resize(n);
+        }
+}
+
+
+bool PacketLogIndex::matches(const Query &q, const ZigBeePacketView &frame, int port, uint32_t time)
+{
+        uint64_t value;
+        bool has[PLK_Count];
+        bool found[PLK_Count];
+        
+        if ((q.time_from != 0 && time < q.time_from) || (q.time_to != 0 && time > q.time_to))
+                return false;
+                
+        memset(has, 0, sizeof(has));
+        memset(found, 0, sizeof(found));
+        
+        for (size_t i = 0; i < q.terms.size(); i++)
+        {
+                const Term &t = q.terms[i];
+                
+                has[t.key] = true;
+                
+                if (!found[t.key] && get_key_value(t.key, frame, port, value) && value == t.value)
+                        found[t.key] = true;
+        }
+        
+        for (int k = 0; k < PLK_Count; k++)
+        {
+                if (has[k] && !found[k])
+                        return false;
+        }
+        
+        return true;
+}
+
+
+bool PacketLogIndex::parse_query(const std::string &text, Query &q, std::string &error)
+{
+        std::istringstream in(text);
+        std::string token;
+        
+        q = Query();
+        
+        while (in >> token)
+        {
+                size_t eq = token.find('=');
+                std::string name = token.substr(0, eq);
+                std::string arg = eq == std::string::npos ? "" : token.substr(eq + 1);
+                const char *str = arg.c_str();
+                char *end;
+                int k;
+                
+                if (arg.empty())
+                {
+                        error = "Expected key=value: " + token;
+                        return false;
+                }
+                
+                if (name == "last")
+                {
+                        unsigned long secs = strtoul(str, &end, 10);
+                        
+                        if (*end != 0)
+                        {
+                                error = "Bad number of seconds: " + arg;
+                                return false;
+                        }
+                        
+                        q.time_from = ::time(0) - secs;
+                        continue;
+                }
+                
+                for (k = 0; k < PLK_Count; k++)
+                {
+                        if (name == key_names[k])
+                                break;
+                }
+                
+                if (k == PLK_Count)
+                {
+                        error = "Unknown key: " + name;
+                        return false;
+                }
+                
+                Term t;
+                t.key = (PacketLogKey)k;
+                t.value = strtoull(str, &end, k == PLK_Port ? 10 : 16);
+                
+                if (*end != 0)
+                {
+                        error = "Bad value for " + name + ": " + arg;
+                        return false;
+                }
+                
+                q.terms.push_back(t);
+        }
+        
+        return true;
+}
+
+
+// Static
+bool PacketLogIndex::get_key_value(PacketLogKey key, const ZigBeePacketView &frame, int port, uint64_t &value)
+{
+        static const ZigBeePacket::ZBP_Field fields[PLK_Count] = {
+                ZigBeePacket::ZBPF_None,
+                ZigBeePacket::ZBPF_Src64,
+                ZigBeePacket::ZBPF_Src16,
+                ZigBeePacket::ZBPF_Dest64,
+                ZigBeePacket::ZBPF_Dest16,
+                ZigBeePacket::ZBPF_ClusterID,
+                ZigBeePacket::ZBPF_ProfileID,
+                ZigBeePacket::ZBPF_None
+        };
+        
+        switch (key)
+        {
+                case PLK_Identifier:
+                        value = frame.get_identifier();
+                        return frame.get_payload_length() > 0;
+                case PLK_Port:
+                        value = port;
+                        return true;
+                default:
+                        if (!frame.has_field(fields[key]))
+                                return false;
+                        value = frame.get_field_value(fields[key]);
+                        return true;
+        }
+}
+
+
+PacketLogIndex::Span PacketLogIndex::get_span(Postings &p, const std::vector<uint64_t> &values, std::vector<size_t> &storage)
+{
+        Postings::iterator it;
+        Span s;
+        
+        s.begin = s.end = 0;
+        
+        if (values.size() == 1)
+        {
+                it = p.find(values[0]);
+                
+                if (it != p.end() && !it->second.empty())
+                {
+                        s.begin = &it->second[0];
+                        s.end = s.begin + it->second.size();
+                }
+                
+                return s;
+        }
+        
+        // lists of different values never share a packet, so they only
+        // need sorting, not merging with duplicates removed
+        for (size_t i = 0; i < values.size(); i++)
+        {
+                it = p.find(values[i]);
+                
+                if (it != p.end())
+                        storage.insert(storage.end(), it->second.begin(), it->second.end());
+        }
+        
+        std::sort(storage.begin(), storage.end());
+        
+        if (!storage.empty())
+        {
+                s.begin = &storage[0];
+                s.end = s.begin + storage.size();
+        }
+        
+        return s;
+}
+
+
+void PacketLogIndex::sweep()
+{
+        Postings *all[PLK_Count + 1];
+        
+        for (int k = 0; k < PLK_Count; k++)
+                all[k] = &postings[k];
+        all[PLK_Count] = &time_postings;
+        
+        for (int k = 0; k <= PLK_Count; k++)
+        {
+                Postings::iterator it = all[k]->begin();
+                
+                while (it != all[k]->end())
+                {
+                        std::vector<size_t> &v = it->second;
+                        
+                        v.erase(v.begin(), std::lower_bound(v.begin(), v.end(), first_seq));
+                        
+                        if (v.empty())
+                                it = all[k]->erase(it);
+                        else
+                                ++it;
+                }
+        }
+        
+        total -= stale;
+        stale = 0;
+}
+
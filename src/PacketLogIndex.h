@@ -0,0 +1,247 @@
+/************************************************************************/
+/* PacketLogIndex                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Packet Log Index                                   */
+/*                                                                      */
+/* PacketLogIndex.h                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __PACKET_LOG_INDEX_H
+#define __PACKET_LOG_INDEX_H
+
+#include "ZigBeePacketView.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <tr1/unordered_map>
+#include <stddef.h>
+#include <inttypes.h>
+
+/** Packet Log Index
+ * 
+ * Inverted index over the packets in a PacketLogStore.  For each key
+ * (frame type, addresses, cluster, profile, port and time bucket) it keeps
+ * the sequence numbers of the packets with each value, in append order.
+ * A query ANDs keys together and ORs values given for the same key, and is
+ * answered by intersecting the posting lists starting from the shortest,
+ * so a rare address in millions of packets only costs a few searches.
+ * Postings of dropped packets are skipped by queries and swept out once
+ * they make up half of the index.  
+ */
+class PacketLogIndex
+{
+public:
+        /**
+         * Indexed keys.
+         */
+        typedef enum
+        {
+                PLK_Identifier = 0,
+                PLK_Src64 = 1,
+                PLK_Src16 = 2,
+                PLK_Dest64 = 3,
+                PLK_Dest16 = 4,
+                PLK_ClusterID = 5,
+                PLK_ProfileID = 6,
+                PLK_Port = 7,
+                PLK_Count = 8
+        }
+        PacketLogKey;
+        
+        /**
+         * Query term.
+         */
+        struct Term
+        {
+                PacketLogKey key;       ///< Key
+                uint64_t value;         ///< Value to match
+        };
+        
+        /**
+         * Query.  Terms with different keys must all match; terms with the
+         * same key match any of their values.  
+         */
+        struct Query
+        {
+                std::vector<Term> terms;        ///< Terms
+                uint32_t time_from;             ///< Earliest time, 0 for any
+                uint32_t time_to;               ///< Latest time, 0 for any
+                
+                Query() : time_from(0), time_to(0) {}
+                
+                /**
+                 * Check if the query matches everything.
+                 * @return true if empty
+                 */
+                bool empty() const { return terms.empty() && time_from == 0 && time_to == 0; }
+        };
+        
+        /**
+         * Create a Packet Log Index.
+         */
+        PacketLogIndex();
+        virtual ~PacketLogIndex();
+        
+        /**
+         * Index a packet.  Sequence numbers must follow on from the last
+         * packet added, or from the argument to drop_before().
+         * @param seq sequence number
+         * @param frame frame view
+         * @param port port ID
+         * @param time time in seconds
+         */
+        void add(size_t seq, const ZigBeePacketView &frame, int port, uint32_t time);
+        
+        /**
+         * Note that packets before a sequence number were dropped.
+         * @param first_seq sequence number of the oldest packet kept
+         */
+        void drop_before(size_t first_seq);
+        
+        /**
+         * Drop all postings.
+         */
+        void clear();
+        
+        /**
+         * Find the packets matching a query.
+         * @param q query
+         * @param seqs return sequence numbers, in increasing order
+         */
+        void find(const Query &q, std::vector<size_t> &seqs);
+        
+        /**
+         * Check if a packet matches a query, without using the index.
+         * @param q query
+         * @param frame frame view
+         * @param port port ID
+         * @param time time in seconds
+         * @return true if it matches
+         */
+        static bool matches(const Query &q, const ZigBeePacketView &frame, int port, uint32_t time);
+        
+        /**
+         * Parse a query.  The text is a list of key=value terms separated
+         * by spaces.  Keys are type, src64, src16, dest64, dest16, cluster
+         * and profile, with hex values, port with a decimal value, and last
+         * with a number of seconds back from now.
+         * @param text query text
+         * @param q return query
+         * @param error return description of what failed to parse
+         * @return true if parsed
+         */
+        static bool parse_query(const std::string &text, Query &q, std::string &error);
+        
+        /**
+         * Time bucket size in seconds.
+         */
+        static const uint32_t time_bucket = 60;
+        
+protected:
+        /**
+         * Posting lists for one key, by value.
+         */
+        typedef std::tr1::unordered_map<uint64_t, std::vector<size_t> > Postings;
+        
+        /**
+         * Sorted run of sequence numbers.
+         */
+        struct Span
+        {
+                const size_t *begin;    ///< First sequence number
+                const size_t *end;      ///< One past the last
+        };
+        
+        /**
+         * Get the value of a key for a packet.
+         * @param key key
+         * @param frame frame view
+         * @param port port ID
+         * @param value return value
+         * @return false if the packet has no such field
+         */
+        static bool get_key_value(PacketLogKey key, const ZigBeePacketView &frame, int port, uint64_t &value);
+        
+        /**
+         * Make a span of the postings for values of one key.  A single
+         * value points into the index; several are merged into storage.
+         * @param postings posting lists
+         * @param values values
+         * @param storage space for a merged list
+         * @return span
+         */
+        Span get_span(Postings &postings, const std::vector<uint64_t> &values, std::vector<size_t> &storage);
+        
+        /**
+         * Remove postings of dropped packets.
+         */
+        void sweep();
+        
+        /**
+         * Postings by key.
+         */
+        Postings postings[PLK_Count];
+        
+        /**
+         * Postings by time bucket.
+         */
+        Postings time_postings;
+        
+        /**
+         * Oldest sequence number kept.
+         */
+        size_t first_seq;
+        
+        /**
+         * Number of postings, live or dropped.
+         */
+        size_t total;
+        
+        /**
+         * Number of postings of dropped packets.
+         */
+        size_t stale;
+        
+        /**
+         * Packet kept.
+         */
+        struct Kept
+        {
+                uint32_t time;          ///< Time in seconds
+                uint8_t postings;       ///< Postings added for the packet
+        };
+        
+        /**
+         * Packets kept, oldest first.  Sequence numbers are contiguous, so
+         * kept[0] is first_seq.
+         */
+        std::deque<Kept> kept;
+};
+
+#endif //__PACKET_LOG_INDEX_H
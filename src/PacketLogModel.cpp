@@ -0,0 +1,469 @@
+/************************************************************************/
+/* PacketLogModel                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Packet Log Tree Model                              */
+/*                                                                      */
+/* PacketLogModel.cpp                                                   */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "PacketLogModel.h"
+#include "HexCodec.h"
+
+#include <string>
+#include <algorithm>
+
+const size_t PacketLogModel::max_data_bytes;
+
+PacketLogModel::PacketLogModel(size_t max_packets) :
+        Glib::ObjectBase(typeid(PacketLogModel)),
+        Glib::Object(),
+        store(max_packets),
+        stamp(1),
+        filtered(false)
+{
+        // nothing
+}
+
+
+PacketLogModel::~PacketLogModel()
+{
+        // nothing
+}
+
+
+Glib::RefPtr<PacketLogModel> PacketLogModel::create(size_t max_packets)
+{
+        return Glib::RefPtr<PacketLogModel>(new PacketLogModel(max_packets));
+}
+
+
+const PacketLogModel::Columns &PacketLogModel::get_columns()
+{
+        return columns;
+}
+
+
+void PacketLogModel::append(PacketLogStore::PacketLogDirection dir, const ZigBeePacket &pkt)
+{
+        const uint8_t *payload = pkt.payload.size() > 0 ? &pkt.payload[0] : 0;
+        
+        append(dir, payload, pkt.payload.size());
+}
+
+
+void PacketLogModel::append(PacketLogStore::PacketLogDirection dir, const uint8_t *payload, size_t count, uint32_t time)
+{
+        // the GUI drives a single port
+        rows_dropped(store.append(dir, payload, count, 0, time));
+        row_appended();
+}
+
+
+void PacketLogModel::append(PacketLogStore::PacketLogDirection dir, const std::vector<ZigBeePacket> &pkts)
+{
+        for (size_t i = 0; i < pkts.size(); i++)
+                append(dir, pkts[i]);
+}
+
+
+void PacketLogModel::append(PacketLogStore::PacketLogDirection dir, const std::vector<ZigBeePacketView> &frames)
+{
+        for (size_t i = 0; i < frames.size(); i++)
+                append(dir, frames[i].get_payload(), frames[i].get_payload_length());
+}
+
+
+void PacketLogModel::clear()
+{
+        size_t count = get_row_count();
+        
+        // rows must be gone before they are reported deleted
+        store.clear();
+        rows.clear();
+        stamp++;
+        
+        // delete from the end so the remaining paths stay put
+        while (count > 0)
+        {
+                count--;
+                Path path;
+                path.push_back(count);
+                row_deleted(path);
+        }
+}
+
+
+size_t PacketLogModel::get_count()
+{
+        return store.get_count();
+}
+
+
+size_t PacketLogModel::set_filter(const PacketLogIndex::Query &q)
+{
+        std::vector<size_t> seqs;
+        
+        filter = q;
+        filtered = !q.empty();
+        rows.clear();
+        
+        if (filtered)
+        {
+                store.find(filter, seqs);
+                rows.assign(seqs.begin(), seqs.end());
+        }
+        
+        stamp++;
+        
+        return get_row_count();
+}
+
+
+bool PacketLogModel::is_filtered()
+{
+        return filtered;
+}
+
+
+ZigBeePacket PacketLogModel::get_packet(const iterator &iter)
+{
+        size_t index;
+        
+        if (!get_index(iter, index))
+                return ZigBeePacket();
+                
+        return store.get_packet(index);
+}
+
+
+PacketLogModel::Path PacketLogModel::get_last_path()
+{
+        Path path;
+        
+        if (get_row_count() > 0)
+                path.push_back(get_row_count() - 1);
+                
+        return path;
+}
+
+
+void PacketLogModel::rows_dropped(size_t count)
+{
+        if (filtered)
+        {
+                // only rows shown go away
+                count = 0;
+                while (!rows.empty() && rows.front() < store.get_first_seq())
+                {
+                        rows.pop_front();
+                        count++;
+                }
+        }
+        
+        for (size_t i = 0; i < count; i++)
+        {
+                Path path;
+                path.push_back(0);
+                row_deleted(path);
+        }
+}
+
+
+void PacketLogModel::row_appended()
+{
+        iterator iter;
+        size_t index = store.get_count() - 1;
+        
+        if (filtered)
+        {
+                if (!store.matches(filter, index))
+                        return;
+                        
+                rows.push_back(store.get_first_seq() + index);
+        }
+        
+        Path path;
+        path.push_back(get_row_count() - 1);
+        set_iter(index, iter);
+        row_inserted(path, iter);
+}
+
+
+size_t PacketLogModel::get_row_count() const
+{
+        return filtered ? rows.size() : store.get_count();
+}
+
+
+size_t PacketLogModel::get_row_index(size_t row) const
+{
+        return filtered ? rows[row] - store.get_first_seq() : row;
+}
+
+
+bool PacketLogModel::get_index_row(size_t index, size_t &row) const
+{
+        if (!filtered)
+        {
+                row = index;
+                return true;
+        }
+        
+        size_t seq = store.get_first_seq() + index;
+        std::deque<size_t>::const_iterator it = std::lower_bound(rows.begin(), rows.end(), seq);
+        
+        if (it == rows.end() || *it != seq)
+                return false;
+                
+        row = it - rows.begin();
+        return true;
+}
+
+
+bool PacketLogModel::get_index(const iterator &iter, size_t &index) const
+{
+        size_t seq;
+        
+        if (iter.get_stamp() != stamp)
+                return false;
+                
+        seq = GPOINTER_TO_SIZE(iter.gobj()->user_data);
+        
+        if (!store.has_seq(seq))
+                return false;
+                
+        index = seq - store.get_first_seq();
+        return true;
+}
+
+
+void PacketLogModel::set_iter(size_t index, iterator &iter) const
+{
+        iter.set_stamp(stamp);
+        iter.gobj()->user_data = GSIZE_TO_POINTER(store.get_first_seq() + index);
+}
+
+
+Glib::ustring PacketLogModel::format_data(size_t index) const
+{
+        const uint8_t *payload = store.get_payload(index);
+        size_t len = store.get_length(index);
+        size_t shown = len < max_data_bytes ? len : max_data_bytes;
+        uint8_t header[3] = {0x7e, (uint8_t)(len >> 8), (uint8_t)len};
+        uint8_t sum = 0xff;
+        std::string out;
+        
+        out.reserve((shown + 4) * 3 + 3);
+        
+        // same format as ZigBeePacket::get_hex_packet()
+        HexCodec::append(out, header, 3);
+        
+        if (shown > 0)
+        {
+                out += ' ';
+                HexCodec::append(out, payload, shown);
+        }
+        
+        if (shown < len)
+        {
+                out += " ...";
+        }
+        else
+        {
+                for (size_t i = 0; i < len; i++)
+                        sum -= payload[i];
+                
+                out += ' ';
+                HexCodec::append(out, &sum, 1);
+        }
+        
+        return out;
+}
+
+
+Gtk::TreeModelFlags PacketLogModel::get_flags_vfunc() const
+{
+        return Gtk::TREE_MODEL_LIST_ONLY | Gtk::TREE_MODEL_ITERS_PERSIST;
+}
+
+
+int PacketLogModel::get_n_columns_vfunc() const
+{
+        return columns.size();
+}
+
+
+GType PacketLogModel::get_column_type_vfunc(int index) const
+{
+        if (index < 0 || index >= (int)columns.size())
+                return G_TYPE_INVALID;
+                
+        return columns.types()[index];
+}
+
+
+void PacketLogModel::get_value_vfunc(const iterator &iter, int column, Glib::ValueBase &value) const
+{
+        size_t index;
+        
+        if (!get_index(iter, index))
+                return;
+                
+        if (column == columns.Size.index())
+        {
+                Glib::Value<int> v;
+                v.init(Glib::Value<int>::value_type());
+                v.set(store.get_length(index) + 4);
+                value.init(Glib::Value<int>::value_type());
+                value = v;
+        }
+        else if (column >= 0 && column < (int)columns.size())
+        {
+                Glib::Value<Glib::ustring> v;
+                v.init(Glib::Value<Glib::ustring>::value_type());
+                
+                if (column == columns.Direction.index())
+                {
+                        v.set(store.get_direction(index) == PacketLogStore::PLD_TX ? "TX" : "RX");
+                }
+                else if (column == columns.Type.index())
+                {
+                        const uint8_t *payload = store.get_payload(index);
+                        
+                        v.set(ZigBeePacket::get_type_desc(store.get_length(index) > 0 ? payload[0] : 0));
+                }
+                else if (column == columns.Data.index())
+                {
+                        v.set(format_data(index));
+                }
+                
+                value.init(Glib::Value<Glib::ustring>::value_type());
+                value = v;
+        }
+}
+
+
+bool PacketLogModel::iter_next_vfunc(const iterator &iter, iterator &iter_next) const
+{
+        size_t index;
+        size_t row;
+        
+        if (get_index(iter, index) && get_index_row(index, row) && row + 1 < get_row_count())
+        {
+                set_iter(get_row_index(row + 1), iter_next);
+                return true;
+        }
+        
+        iter_next = iterator();
+        return false;
+}
+
+
+bool PacketLogModel::iter_children_vfunc(const iterator &parent, iterator &iter) const
+{
+        // list only
+        iter = iterator();
+        return false;
+}
+
+
+bool PacketLogModel::iter_has_child_vfunc(const iterator &iter) const
+{
+        return false;
+}
+
+
+int PacketLogModel::iter_n_children_vfunc(const iterator &iter) const
+{
+        return 0;
+}
+
+
+int PacketLogModel::iter_n_root_children_vfunc() const
+{
+        return get_row_count();
+}
+
+
+bool PacketLogModel::iter_nth_child_vfunc(const iterator &parent, int n, iterator &iter) const
+{
+        iter = iterator();
+        return false;
+}
+
+
+bool PacketLogModel::iter_nth_root_child_vfunc(int n, iterator &iter) const
+{
+        if (n >= 0 && (size_t)n < get_row_count())
+        {
+                set_iter(get_row_index(n), iter);
+                return true;
+        }
+        
+        iter = iterator();
+        return false;
+}
+
+
+bool PacketLogModel::iter_parent_vfunc(const iterator &child, iterator &iter) const
+{
+        iter = iterator();
+        return false;
+}
+
+
+PacketLogModel::Path PacketLogModel::get_path_vfunc(const iterator &iter) const
+{
+        size_t index;
+        size_t row;
+        Path path;
+        
+        if (get_index(iter, index) && get_index_row(index, row))
+                path.push_back(row);
+                
+        return path;
+}
+
+
+bool PacketLogModel::get_iter_vfunc(const Path &path, iterator &iter) const
+{
+        if (path.size() == 1)
+                return iter_nth_root_child_vfunc(path[0], iter);
+                
+        iter = iterator();
+        return false;
+}
+
+
+bool PacketLogModel::iter_is_valid(const iterator &iter) const
+{
+        size_t index;
+        
+        return get_index(iter, index);
+}
+
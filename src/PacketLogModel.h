@@ -0,0 +1,271 @@
+/************************************************************************/
+/* PacketLogModel                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Packet Log Tree Model                              */
+/*                                                                      */
+/* PacketLogModel.h                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __PACKET_LOG_MODEL_H
+#define __PACKET_LOG_MODEL_H
+
+#include <gtkmm.h>
+
+#include "PacketLogStore.h"
+#include "ZigBeePacket.h"
+#include "ZigBeePacketView.h"
+
+#include <vector>
+#include <deque>
+
+/** Packet Log Model
+ * 
+ * List tree model for the packet log, backed by a PacketLogStore.  No
+ * strings are stored; column values are formatted when the view asks for
+ * them, which with a fixed height tree view is only for visible rows.
+ * Iterators hold the packet sequence number, so they stay valid until the
+ * packet is dropped from the store.  A filter limits the rows to the
+ * packets matching a query, looked up in the store's index; rows stay
+ * virtual, only their sequence numbers are kept.  
+ */
+class PacketLogModel : public Glib::Object, public Gtk::TreeModel
+{
+public:
+        /**
+         * Tree model columns.
+         */
+        class Columns : public Gtk::TreeModel::ColumnRecord
+        {
+        public:
+                Columns()
+                { add(Direction); add(Type); add(Size); add(Data); }
+                
+                Gtk::TreeModelColumn<Glib::ustring> Direction;
+                Gtk::TreeModelColumn<Glib::ustring> Type;
+                Gtk::TreeModelColumn<int> Size;
+                Gtk::TreeModelColumn<Glib::ustring> Data;
+        };
+        
+        /**
+         * Create a Packet Log Model.
+         * @param max_packets maximum number of packets kept
+         * @return new model
+         */
+        static Glib::RefPtr<PacketLogModel> create(size_t max_packets = 100000);
+        virtual ~PacketLogModel();
+        
+        /**
+         * Get model columns.
+         * @return column record
+         */
+        const Columns &get_columns();
+        
+        /**
+         * Append a packet.
+         * @param dir direction
+         * @param pkt packet, payload must be built
+         */
+        void append(PacketLogStore::PacketLogDirection dir, const ZigBeePacket &pkt);
+        
+        /**
+         * Append a frame payload.
+         * @param dir direction
+         * @param payload pointer to frame payload (identifier through data)
+         * @param count payload length
+         * @param time time in seconds since the epoch, 0 for now
+         */
+        void append(PacketLogStore::PacketLogDirection dir, const uint8_t *payload, size_t count, uint32_t time = 0);
+        
+        /**
+         * Append packets.
+         * @param dir direction
+         * @param pkts packets, payloads must be built
+         */
+        void append(PacketLogStore::PacketLogDirection dir, const std::vector<ZigBeePacket> &pkts);
+        
+        /**
+         * Append frames.
+         * @param dir direction
+         * @param frames frame views
+         */
+        void append(PacketLogStore::PacketLogDirection dir, const std::vector<ZigBeePacketView> &frames);
+        
+        /**
+         * Drop all packets.
+         */
+        void clear();
+        
+        /**
+         * Get number of packets.
+         * @return packet count
+         */
+        size_t get_count();
+        
+        /**
+         * Set filter.  Only packets matching the query are shown, and
+         * packets appended later are shown if they match.  All iterators
+         * are invalidated and no row signals are emitted, so the model
+         * should be detached from its views while the filter is changed.
+         * @param q query, empty to show all packets
+         * @return number of rows shown
+         * @see PacketLogIndex::parse_query()
+         */
+        size_t set_filter(const PacketLogIndex::Query &q);
+        
+        /**
+         * Check if a filter is set.
+         * @return true if filtered
+         */
+        bool is_filtered();
+        
+        /**
+         * Decode the packet for a row.
+         * @param iter row
+         * @return decoded packet
+         */
+        ZigBeePacket get_packet(const iterator &iter);
+        
+        /**
+         * Get path of the last row.  Returns an empty path if the model is
+         * empty.
+         * @return path
+         */
+        Path get_last_path();
+        
+        /**
+         * Maximum number of payload bytes shown in the Data column.
+         */
+        static const size_t max_data_bytes = 128;
+        
+protected:
+        PacketLogModel(size_t max_packets);
+        
+        /**
+         * Emit row deleted for packets dropped from the front of the store.
+         * @param count number of packets
+         */
+        void rows_dropped(size_t count);
+        
+        /**
+         * Emit row inserted for the last packet in the store.
+         */
+        void row_appended();
+        
+        /**
+         * Get number of rows shown.
+         * @return rows
+         */
+        size_t get_row_count() const;
+        
+        /**
+         * Get store index of a row.
+         * @param row row
+         * @return store index
+         */
+        size_t get_row_index(size_t row) const;
+        
+        /**
+         * Get row of a store index.
+         * @param index store index
+         * @param row return row
+         * @return false if the packet is filtered out
+         */
+        bool get_index_row(size_t index, size_t &row) const;
+        
+        /**
+         * Get index into the store for an iterator.
+         * @param iter iterator
+         * @param index return index
+         * @return true if iterator is valid
+         */
+        bool get_index(const iterator &iter, size_t &index) const;
+        
+        /**
+         * Set an iterator to point at a store index.
+         * @param index store index
+         * @param iter iterator to set
+         */
+        void set_iter(size_t index, iterator &iter) const;
+        
+        /**
+         * Format the Data column for a packet.
+         * @param index store index
+         * @return hex string
+         */
+        Glib::ustring format_data(size_t index) const;
+        
+        // Gtk::TreeModel overrides
+        virtual Gtk::TreeModelFlags get_flags_vfunc() const;
+        virtual int get_n_columns_vfunc() const;
+        virtual GType get_column_type_vfunc(int index) const;
+        virtual void get_value_vfunc(const iterator &iter, int column, Glib::ValueBase &value) const;
+        virtual bool iter_next_vfunc(const iterator &iter, iterator &iter_next) const;
+        virtual bool iter_children_vfunc(const iterator &parent, iterator &iter) const;
+        virtual bool iter_has_child_vfunc(const iterator &iter) const;
+        virtual int iter_n_children_vfunc(const iterator &iter) const;
+        virtual int iter_n_root_children_vfunc() const;
+        virtual bool iter_nth_child_vfunc(const iterator &parent, int n, iterator &iter) const;
+        virtual bool iter_nth_root_child_vfunc(int n, iterator &iter) const;
+        virtual bool iter_parent_vfunc(const iterator &child, iterator &iter) const;
+        virtual Path get_path_vfunc(const iterator &iter) const;
+        virtual bool get_iter_vfunc(const Path &path, iterator &iter) const;
+        virtual bool iter_is_valid(const iterator &iter) const;
+        
+        /**
+         * Packet storage.  Mutable since the store accessors are not const.
+         */
+        mutable PacketLogStore store;
+        
+        /**
+         * Columns.
+         */
+        Columns columns;
+        
+        /**
+         * Iterator stamp, changed when the model is cleared or filtered.
+         */
+        int stamp;
+        
+        /**
+         * Filter query.
+         * @see set_filter()
+         */
+        PacketLogIndex::Query filter;
+        
+        /**
+         * Filter set.
+         */
+        bool filtered;
+        
+        /**
+         * Sequence numbers of the rows shown while filtered.
+         */
+        std::deque<size_t> rows;
+};
+
+#endif //__PACKET_LOG_MODEL_H
@@ -0,0 +1,209 @@
+/************************************************************************/
+/* PacketLogStore                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Packet Log Store                                   */
+/*                                                                      */
+/* PacketLogStore.cpp                                                   */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "PacketLogStore.h"
+
+#include <time.h>
+
+PacketLogStore::PacketLogStore(size_t max_packets, size_t max_bytes) :
+        data_base(0),
+        data_head(0),
+        first_seq(0),
+        max_packets(max_packets > 0 ? max_packets : 1),
+        max_bytes(max_bytes > 65535 ? max_bytes : 65535)
+{
+        // nothing
+}
+
+
+PacketLogStore::~PacketLogStore()
+{
+        // nothing
+}
+
+
+size_t PacketLogStore::append(PacketLogDirection dir, const uint8_t *payload, size_t count, int port, uint32_t time)
+{
+        Entry e;
+        size_t dropped = 0;
+        
+        if (count > 65535)
+                count = 65535;
+                
+        while (entries.size() > 0 &&
+                (entries.size() >= max_packets || data.size() - data_head + count > max_bytes))
+        {
+                drop_oldest();
+                dropped++;
+        }
+        
+        // drop storage of old packets once it makes up half of the array
+        if (data_head > 0 && data_head >= data.size() / 2)
+        {
+                data.erase(data.begin(), data.begin() + data_head);
+                data_base += data_head;
+                data_head = 0;
+        }
+        
+        e.offset = data_base + data.size();
+        e.length = count;
+        e.direction = dir;
+        e.port = port;
+        e.time = time != 0 ? time : ::time(0);
+        
+        data.insert(data.end(), payload, payload + count);
+        entries.push_back(e);
+        
+        pkt_index.add(first_seq + entries.size() - 1, ZigBeePacketView(payload, count), port, e.time);
+        
+        return dropped;
+}
+
+
+void PacketLogStore::clear()
+{
+        first_seq += entries.size();
+        data_base += data.size();
+        data_head = 0;
+        entries.clear();
+        data.clear();
+        pkt_index.clear();
+}
+
+
+size_t PacketLogStore::get_count()
+{
+        return entries.size();
+}
+
+
+size_t PacketLogStore::get_first_seq()
+{
+        return first_seq;
+}
+
+
+bool PacketLogStore::has_seq(size_t seq)
+{
+        return seq >= first_seq && seq - first_seq < entries.size();
+}
+
+
+PacketLogStore::PacketLogDirection PacketLogStore::get_direction(size_t index)
+{
+        return (PacketLogDirection)entries[index].direction;
+}
+
+
+int PacketLogStore::get_port(size_t index)
+{
+        return entries[index].port;
+}
+
+
+uint32_t PacketLogStore::get_time(size_t index)
+{
+        return entries[index].time;
+}
+
+
+const uint8_t *PacketLogStore::get_payload(size_t index)
+{
+        if (data.empty())
+                return 0;
+        return &data[0] + (entries[index].offset - data_base);
+}
+
+
+size_t PacketLogStore::get_length(size_t index)
+{
+        return entries[index].length;
+}
+
+
+ZigBeePacket PacketLogStore::get_packet(size_t index)
+{
+        ZigBeePacket pkt;
+        
+        pkt.set_payload(get_payload(index), get_length(index));
+        pkt.decode_packet();
+        
+        return pkt;
+}
+
+
+void PacketLogStore::find(const PacketLogIndex::Query &q, std::vector<size_t> &seqs)
+{
+        pkt_index.find(q, seqs);
+}
+
+
+bool PacketLogStore::matches(const PacketLogIndex::Query &q, size_t i)
+{
+        const Entry &e = entries[i];
+        
+        return PacketLogIndex::matches(q, ZigBeePacketView(get_payload(i), e.length), e.port, e.time);
+}
+
+
+size_t PacketLogStore::set_max_packets(size_t m)
+{
+        max_packets = m > 0 ? m : 1;
+        
+        while (entries.size() > max_packets)
+                drop_oldest();
+                
+        return max_packets;
+}
+
+
+size_t PacketLogStore::get_max_packets()
+{
+        return max_packets;
+}
+
+
+size_t PacketLogStore::get_max_bytes()
+{
+        return max_bytes;
+}
+
+
+void PacketLogStore::drop_oldest()
+{
+        data_head += entries.front().length;
+        entries.pop_front();
+        first_seq++;
+        pkt_index.drop_before(first_seq);
+}
+
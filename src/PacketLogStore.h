@@ -0,0 +1,251 @@
+/************************************************************************/
+/* PacketLogStore                                                       */
+/*                                                                      */
+/* ZigBee Terminal - Packet Log Store                                   */
+/*                                                                      */
+/* PacketLogStore.h                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __PACKET_LOG_STORE_H
+#define __PACKET_LOG_STORE_H
+
+#include "ZigBeePacket.h"
+#include "PacketLogIndex.h"
+
+#include <vector>
+#include <deque>
+#include <stddef.h>
+#include <inttypes.h>
+
+/** Packet Log Store
+ * 
+ * Compact, bounded storage for logged packets.  Only the direction, port,
+ * time and frame payload of each packet are kept, with the payloads stored
+ * back to back in a single byte array.  Once either the packet limit or the
+ * byte limit is reached, the oldest packets are dropped.  Every packet gets
+ * a sequence number that does not change as older packets are dropped.
+ * Packets are indexed as they are appended, so find() does not scan.  
+ * @see PacketLogIndex
+ */
+class PacketLogStore
+{
+public:
+        /**
+         * Packet direction.
+         */
+        typedef enum
+        {
+                PLD_RX = 0,
+                PLD_TX = 1,
+        }
+        PacketLogDirection;
+        
+        /**
+         * Create a Packet Log Store.
+         * @param max_packets maximum number of packets kept
+         * @param max_bytes maximum number of payload bytes kept
+         */
+        PacketLogStore(size_t max_packets = 100000, size_t max_bytes = 16777216);
+        virtual ~PacketLogStore();
+        
+        /**
+         * Append a packet.  Drops old packets as needed to stay within the
+         * limits.
+         * @param dir direction
+         * @param payload pointer to frame payload (identifier through data)
+         * @param count payload length
+         * @param port port ID the packet was seen on
+         * @param time time in seconds since the epoch, 0 for now
+         * @return number of old packets dropped
+         */
+        size_t append(PacketLogDirection dir, const uint8_t *payload, size_t count, int port = 0, uint32_t time = 0);
+        
+        /**
+         * Drop all packets.  Sequence numbers are not reused.
+         */
+        void clear();
+        
+        /**
+         * Get number of packets stored.
+         * @return packet count
+         */
+        size_t get_count();
+        
+        /**
+         * Get sequence number of the oldest packet stored.
+         * @return sequence number
+         */
+        size_t get_first_seq();
+        
+        /**
+         * Check if a packet is still stored.
+         * @param seq sequence number
+         * @return true if stored
+         */
+        bool has_seq(size_t seq);
+        
+        /**
+         * Get packet direction.
+         * @param index packet index, 0 is the oldest packet stored
+         * @return direction
+         */
+        PacketLogDirection get_direction(size_t index);
+        
+        /**
+         * Get port ID the packet was seen on.
+         * @param index packet index
+         * @return port ID
+         * @see PortManager
+         */
+        int get_port(size_t index);
+        
+        /**
+         * Get time the packet was logged.
+         * @param index packet index
+         * @return time in seconds since the epoch
+         */
+        uint32_t get_time(size_t index);
+        
+        /**
+         * Get packet payload.  Valid until the next call to append() or
+         * clear().
+         * @param index packet index
+         * @return pointer to payload
+         */
+        const uint8_t *get_payload(size_t index);
+        
+        /**
+         * Get packet payload length.
+         * @param index packet index
+         * @return payload length
+         */
+        size_t get_length(size_t index);
+        
+        /**
+         * Decode a stored packet.
+         * @param index packet index
+         * @return decoded packet
+         */
+        ZigBeePacket get_packet(size_t index);
+        
+        /**
+         * Find the packets matching a query.
+         * @param q query
+         * @param seqs return sequence numbers, in increasing order
+         * @see PacketLogIndex::parse_query()
+         */
+        void find(const PacketLogIndex::Query &q, std::vector<size_t> &seqs);
+        
+        /**
+         * Check if a stored packet matches a query.
+         * @param q query
+         * @param index packet index
+         * @return true if it matches
+         */
+        bool matches(const PacketLogIndex::Query &q, size_t index);
+        
+        /**
+         * Set packet limit.
+         * @param m maximum number of packets
+         * @return packet limit
+         */
+        size_t set_max_packets(size_t m);
+        
+        /**
+         * Get packet limit.
+         * @return maximum number of packets
+         */
+        size_t get_max_packets();
+        
+        /**
+         * Get payload byte limit.
+         * @return maximum number of payload bytes
+         */
+        size_t get_max_bytes();
+        
+protected:
+        /**
+         * Stored packet.
+         */
+        struct Entry
+        {
+                size_t offset;          ///< Payload offset, counted from the first byte ever stored
+                uint16_t length;        ///< Payload length
+                uint8_t direction;      ///< PacketLogDirection
+                uint8_t port;           ///< Port ID
+                uint32_t time;          ///< Time in seconds since the epoch
+        };
+        
+        /**
+         * Drop oldest packet.
+         */
+        void drop_oldest();
+        
+        /**
+         * Stored packets, oldest first.
+         */
+        std::deque<Entry> entries;
+        
+        /**
+         * Index of stored packets.
+         */
+        PacketLogIndex pkt_index;
+        
+        /**
+         * Payload storage.
+         */
+        std::vector<uint8_t> data;
+        
+        /**
+         * Offset of data[0], counted from the first byte ever stored.
+         */
+        size_t data_base;
+        
+        /**
+         * Number of bytes at the start of data belonging to dropped
+         * packets.
+         */
+        size_t data_head;
+        
+        /**
+         * Sequence number of entries[0].
+         */
+        size_t first_seq;
+        
+        /**
+         * Packet limit.
+         */
+        size_t max_packets;
+        
+        /**
+         * Payload byte limit.
+         */
+        size_t max_bytes;
+};
+
+#endif //__PACKET_LOG_STORE_H
@@ -55,7 +55,7 @@ PortConfig::PortConfig()
         
         get_vbox()->pack_start(frame, TRUE, TRUE, 0);
         
-        table.resize(4, 3);
+        table.resize(6, 3);
         table.set_col_spacings(10);
         table.set_row_spacings(5);
         table.set_border_width(5);
@@ -65,7 +65,8 @@ PortConfig::PortConfig()
         label1.set_label("Port:");
         table.attach(label1, 0, 1, 0, 1);
         
-        refresh_ports();
+        // the port list is filled in by on_show(), so creating the
+        // dialog does not scan for ports
         
         table.attach(cmbtPort, 0, 1, 1, 2);
         
@@ -82,6 +83,9 @@ PortConfig::PortConfig()
         cmbtSpeed.append_text("38400");
         cmbtSpeed.append_text("57600");
         cmbtSpeed.append_text("115200");
+        cmbtSpeed.append_text("230400");
+        cmbtSpeed.append_text("460800");
+        cmbtSpeed.append_text("921600");
         
         cmbtSpeed.set_active(0);
         
@@ -131,12 +135,40 @@ PortConfig::PortConfig()
         
         table.attach(cmbtFlowControl, 2, 3, 3, 4);
         
+        label7.set_label("Read Minimum:");
+        table.attach(label7, 0, 1, 4, 5);
+        
+        spnReadMin.set_range(1, 255);
+        spnReadMin.set_increments(1, 16);
+        spnReadMin.set_digits(0);
+        spnReadMin.set_tooltip_text("Bytes to collect before reading; fewer wake ups, more latency");
+        
+        table.attach(spnReadMin, 0, 1, 5, 6);
+        
+        label8.set_label("Read Timeout (ms):");
+        table.attach(label8, 1, 2, 4, 5);
+        
+        spnReadTimeout.set_range(1, 1000);
+        spnReadTimeout.set_increments(1, 10);
+        spnReadTimeout.set_digits(0);
+        spnReadTimeout.set_tooltip_text("Time to wait for the rest of a frame before passing on what has arrived");
+        
+        table.attach(spnReadTimeout, 1, 2, 5, 6);
+        
+        chkLowLatency.set_label("Low latency");
+        chkLowLatency.set_tooltip_text("Set ASYNC_LOW_LATENCY, e.g. 1 ms FTDI latency timer");
+        
+        table.attach(chkLowLatency, 2, 3, 5, 6);
+        
         port = cmbtPort.get_active_text();
         baud = 115200;
         parity = SerialInterface::SP_None;
         bits = 8;
         stop_bits = 1;
         flow_control = SerialInterface::SF_None;
+        low_latency = false;
+        read_min = 1;
+        read_timeout = 20;
         
         show_all_children();
 }
@@ -150,7 +182,7 @@ void PortConfig::refresh_ports()
 {
         int ind = -1;
         int i = 0;
-        std::vector<std::string> ports = SerialInterface::enumerate_ports();
+        std::vector<std::string> ports = registry ? registry->get_ports() : SerialInterface::enumerate_ports();
         std::vector<std::string>::iterator it;
         
         Gtk::TreeModel::Row row;
@@ -178,6 +210,27 @@ void PortConfig::refresh_ports()
         select_port(port);
 }
 
+void PortConfig::set_port_registry(std::tr1::shared_ptr<PortRegistry> reg)
+{
+        registry = reg;
+        registry->signal_port_added().connect( sigc::mem_fun(*this, &PortConfig::on_registry_change) );
+        registry->signal_port_removed().connect( sigc::mem_fun(*this, &PortConfig::on_registry_change) );
+}
+
+void PortConfig::on_registry_change(std::string p)
+{
+        Glib::ustring sel;
+        
+        if (!is_visible())
+                return;
+        
+        // keep what the user picked if it is still there
+        sel = cmbtPort.get_active_text();
+        refresh_ports();
+        if (sel != "")
+                select_port(sel);
+}
+
 void PortConfig::on_show()
 {
         refresh_ports();
@@ -188,6 +241,9 @@ void PortConfig::on_show()
         select_bits(bits);
         select_stop_bits(stop_bits);
         select_flow_control(flow_control);
+        chkLowLatency.set_active(low_latency);
+        spnReadMin.set_value(read_min);
+        spnReadTimeout.set_value(read_timeout);
         
         Gtk::Dialog::on_show();
 }
@@ -195,7 +251,10 @@ void PortConfig::on_show()
 void PortConfig::on_ok_click()
 {
         port = cmbtPort.get_active_text();
-        baud = atol(cmbtSpeed.get_active_text().c_str());
+        
+        // any rate can be typed in
+        if (atol(cmbtSpeed.get_active_text().c_str()) > 0)
+                baud = atol(cmbtSpeed.get_active_text().c_str());
         
         switch (cmbtParity.get_active_row_number())
         {
@@ -249,6 +308,10 @@ void PortConfig::on_ok_click()
                         break;
         }
         
+        low_latency = chkLowLatency.get_active();
+        read_min = spnReadMin.get_value_as_int();
+        read_timeout = spnReadTimeout.get_value_as_int();
+        
         hide();
 }
 
@@ -287,6 +350,24 @@ void PortConfig::set_flow_control(SerialInterface::SerialFlow f)
         flow_control = select_flow_control(f);
 }
 
+void PortConfig::set_low_latency(bool l)
+{
+        low_latency = l;
+        chkLowLatency.set_active(l);
+}
+
+void PortConfig::set_read_min(int m)
+{
+        read_min = m;
+        spnReadMin.set_value(m);
+}
+
+void PortConfig::set_read_timeout(int t)
+{
+        read_timeout = t;
+        spnReadTimeout.set_value(t);
+}
+
 Glib::ustring PortConfig::get_port()
 {
         return port;
@@ -317,6 +398,21 @@ SerialInterface::SerialFlow PortConfig::get_flow_control()
         return flow_control;
 }
 
+bool PortConfig::get_low_latency()
+{
+        return low_latency;
+}
+
+int PortConfig::get_read_min()
+{
+        return read_min;
+}
+
+int PortConfig::get_read_timeout()
+{
+        return read_timeout;
+}
+
 Glib::ustring PortConfig::select_port(Glib::ustring p)
 {
         if (p.length() > 0)
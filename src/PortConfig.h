@@ -35,8 +35,10 @@
 #define __PORTCONFIG_H
 
 #include "SerialInterface.h"
+#include "PortRegistry.h"
 
 #include <string>
+#include <tr1/memory>
 
 #include <gtkmm.h>
 
@@ -59,6 +61,13 @@ public:
          */
         void refresh_ports();
         
+        /**
+         * Set port registry.  The port list is taken from the registry
+         * instead of scanning, and follows hotplug events while shown.
+         * @param reg port registry
+         */
+        void set_port_registry(std::tr1::shared_ptr<PortRegistry> reg);
+        
         /**
          * Set serial port.
          * @param p port
@@ -131,6 +140,45 @@ public:
          */
         int get_stop_bits();
         
+        /**
+         * Set low latency mode.
+         * @param l low latency mode
+         * @see SerialInterface::set_low_latency()
+         */
+        void set_low_latency(bool l);
+        
+        /**
+         * Get low latency mode.
+         * @return low latency mode
+         */
+        bool get_low_latency();
+        
+        /**
+         * Set read minimum.
+         * @param m bytes
+         * @see SerialInterface::set_read_min()
+         */
+        void set_read_min(int m);
+        
+        /**
+         * Get read minimum.
+         * @return bytes
+         */
+        int get_read_min();
+        
+        /**
+         * Set read timeout.
+         * @param t timeout in ms
+         * @see SerialInterface::set_read_timeout()
+         */
+        void set_read_timeout(int t);
+        
+        /**
+         * Get read timeout.
+         * @return timeout in ms
+         */
+        int get_read_timeout();
+        
 protected:
         //Signal handlers:
         
@@ -149,6 +197,12 @@ protected:
          */
         void on_cancel_click();
         
+        /**
+         * Registry port added or removed signal handler
+         * @param p port
+         */
+        void on_registry_change(std::string p);
+        
         /**
          * Select port in combo box
          * @param p port
@@ -203,12 +257,19 @@ protected:
         Gtk::Label label4;
         Gtk::Label label5;
         Gtk::Label label6;
+        Gtk::Label label7;
+        Gtk::Label label8;
         Gtk::ComboBoxText cmbtPort;
-        Gtk::ComboBoxText cmbtSpeed;
+        Gtk::ComboBoxEntryText cmbtSpeed;
         Gtk::ComboBoxText cmbtParity;
         Gtk::ComboBoxText cmbtBits;
         Gtk::ComboBoxText cmbtStopBits;
         Gtk::ComboBoxText cmbtFlowControl;
+        Gtk::SpinButton spnReadMin;
+        Gtk::SpinButton spnReadTimeout;
+        Gtk::CheckButton chkLowLatency;
+        
+        std::tr1::shared_ptr<PortRegistry> registry;
         
         Glib::ustring port;
         unsigned long baud;
@@ -216,6 +277,9 @@ protected:
         int bits;
         int stop_bits;
         SerialInterface::SerialFlow flow_control;
+        bool low_latency;
+        int read_min;
+        int read_timeout;
 };
 
 // Prototypes
@@ -0,0 +1,303 @@
+/************************************************************************/
+/* PortManager                                                          */
+/*                                                                      */
+/* ZigBee Terminal - Port Manager                                       */
+/*                                                                      */
+/* PortManager.cpp                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "PortManager.h"
+
+#include <iostream>
+
+PortManager::PortManager(std::tr1::shared_ptr<Notifier> n) :
+        notifier(n),
+        io_loop(new SerialIoLoop()),
+        reconnect(false)
+{
+        // nothing
+}
+
+
+PortManager::~PortManager()
+{
+        c_registry_port_added.disconnect();
+        close_ports();
+        
+        for (size_t i = 0; i < ports.size(); i++)
+        {
+                ports[i].zb_int->clear_transport();
+                delete ports[i].zb_int;
+        }
+}
+
+
+int PortManager::add_port(std::string port, unsigned long baud, bool escaped)
+{
+        Port p;
+        int id = ports.size();
+        
+        if (SocketTransport::is_address(port))
+        {
+                p.transport = std::tr1::shared_ptr<Transport>(new SocketTransport());
+        }
+        else
+        {
+                p.ser_int = std::tr1::shared_ptr<SerialInterface>(new SerialInterface());
+                p.ser_int->set_baud(baud);
+                p.transport = p.ser_int;
+        }
+        
+        p.transport->set_notifier(notifier);
+        p.transport->set_io_loop(io_loop);
+        p.transport->set_port(port);
+        p.transport->port_opened().connect( sigc::bind(sigc::mem_fun(*this, &PortManager::on_port_opened), id) );
+        p.transport->port_closed().connect( sigc::bind(sigc::mem_fun(*this, &PortManager::on_port_closed), id) );
+        
+        p.zb_int = new ZigBeeInterface();
+        p.zb_int->set_transport(p.transport);
+        p.zb_int->set_escaped(escaped);
+        p.zb_int->signal_receive_frames().connect( sigc::bind(sigc::mem_fun(*this, &PortManager::on_receive_frames), id) );
+        p.zb_int->signal_receive_raw_data().connect( sigc::bind(sigc::mem_fun(*this, &PortManager::on_receive_raw_data), id) );
+        p.zb_int->signal_error().connect( sigc::bind(sigc::mem_fun(*this, &PortManager::on_error), id) );
+        
+        ports.push_back(p);
+        
+        return id;
+}
+
+
+size_t PortManager::get_port_count()
+{
+        return ports.size();
+}
+
+
+std::tr1::shared_ptr<Transport> PortManager::get_transport(int id)
+{
+        if (id < 0 || id >= (int)ports.size())
+                return std::tr1::shared_ptr<Transport>();
+                
+        return ports[id].transport;
+}
+
+
+std::tr1::shared_ptr<SerialInterface> PortManager::get_serial_interface(int id)
+{
+        if (id < 0 || id >= (int)ports.size())
+                return std::tr1::shared_ptr<SerialInterface>();
+                
+        return ports[id].ser_int;
+}
+
+
+ZigBeeInterface *PortManager::get_zigbee_interface(int id)
+{
+        if (id < 0 || id >= (int)ports.size())
+                return 0;
+                
+        return ports[id].zb_int;
+}
+
+
+std::tr1::shared_ptr<SerialIoLoop> PortManager::get_io_loop()
+{
+        return io_loop;
+}
+
+
+void PortManager::set_port_registry(std::tr1::shared_ptr<PortRegistry> reg)
+{
+        c_registry_port_added.disconnect();
+        
+        registry = reg;
+        
+        if (registry)
+                c_registry_port_added = registry->signal_port_added().connect( sigc::mem_fun(*this, &PortManager::on_registry_port_added) );
+}
+
+
+std::tr1::shared_ptr<PortRegistry> PortManager::get_port_registry()
+{
+        return registry;
+}
+
+
+void PortManager::set_reconnect(bool r)
+{
+        reconnect = r;
+}
+
+
+bool PortManager::get_reconnect()
+{
+        return reconnect;
+}
+
+
+int PortManager::open_ports()
+{
+        int failed = 0;
+        
+        for (size_t i = 0; i < ports.size(); i++)
+        {
+                if (ports[i].transport->is_open())
+                        continue;
+                        
+                if (ports[i].transport->open_port() != Transport::SS_Success)
+                {
+                        std::cerr << "[PortManager] Unable to open " << ports[i].transport->get_port() << std::endl;
+                        failed++;
+                }
+        }
+        
+        return failed;
+}
+
+
+void PortManager::close_ports()
+{
+        for (size_t i = 0; i < ports.size(); i++)
+                ports[i].transport->close_port();
+}
+
+
+size_t PortManager::get_open_count()
+{
+        size_t count = 0;
+        
+        for (size_t i = 0; i < ports.size(); i++)
+        {
+                if (ports[i].transport->is_open())
+                        count++;
+        }
+        
+        return count;
+}
+
+
+int PortManager::check_timeouts()
+{
+        int timeout = -1;
+        int t;
+        
+        for (size_t i = 0; i < ports.size(); i++)
+        {
+                t = ports[i].zb_int->check_timeouts();
+                
+                if (t >= 0 && (timeout < 0 || t < timeout))
+                        timeout = t;
+        }
+        
+        return timeout;
+}
+
+
+void PortManager::on_receive_frames(const std::vector<ZigBeePacketView> &frames, int id)
+{
+        m_signal_receive_frames.emit(id, frames);
+}
+
+
+void PortManager::on_receive_raw_data(const char *data, size_t len, int id)
+{
+        m_signal_receive_raw_data.emit(id, data, len);
+}
+
+
+void PortManager::on_error(int id)
+{
+        m_signal_error.emit(id);
+}
+
+
+void PortManager::on_port_opened(int id)
+{
+        m_signal_port_opened.emit(id);
+}
+
+
+void PortManager::on_port_closed(int id)
+{
+        m_signal_port_closed.emit(id);
+}
+
+
+void PortManager::on_registry_port_added(std::string port)
+{
+        PortRegistry::PortInfo info;
+        
+        if (!reconnect || !registry->find_port(port, info))
+                return;
+        
+        for (size_t i = 0; i < ports.size(); i++)
+        {
+                // sockets are not in the registry
+                if (!ports[i].ser_int)
+                        continue;
+                        
+                std::string name = ports[i].ser_int->get_port();
+                
+                if (ports[i].ser_int->is_open() || (name != info.port && name != info.by_id))
+                        continue;
+                
+                if (ports[i].ser_int->open_port() != SerialInterface::SS_Success)
+                        std::cerr << "[PortManager] Unable to reopen " << name << std::endl;
+        }
+}
+
+
+sigc::signal<void, int, const std::vector<ZigBeePacketView>&> PortManager::signal_receive_frames()
+{
+        return m_signal_receive_frames;
+}
+
+
+sigc::signal<void, int, const char*, size_t> PortManager::signal_receive_raw_data()
+{
+        return m_signal_receive_raw_data;
+}
+
+
+sigc::signal<void, int> PortManager::signal_error()
+{
+        return m_signal_error;
+}
+
+
+sigc::signal<void, int> PortManager::signal_port_opened()
+{
+        return m_signal_port_opened;
+}
+
+
+sigc::signal<void, int> PortManager::signal_port_closed()
+{
+        return m_signal_port_closed;
+}
+
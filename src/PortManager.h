@@ -0,0 +1,312 @@
+/************************************************************************/
+/* PortManager                                                          */
+/*                                                                      */
+/* ZigBee Terminal - Port Manager                                       */
+/*                                                                      */
+/* PortManager.h                                                        */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __PORT_MANAGER_H
+#define __PORT_MANAGER_H
+
+#include <tr1/memory>
+#include <string>
+#include <vector>
+#include <sigc++/sigc++.h>
+
+#include "Transport.h"
+#include "SerialInterface.h"
+#include "SocketTransport.h"
+#include "SerialIoLoop.h"
+#include "PortRegistry.h"
+#include "ZigBeeInterface.h"
+#include "ZigBeePacketView.h"
+#include "Notifier.h"
+
+/** Port Manager
+ * 
+ * Gateway for several radios.  Owns one transport and ZigBeeInterface pair
+ * per port, each with its own parser and request state, all served by a
+ * single SerialIoLoop thread and woken through one notifier.  Ports are
+ * serial ports, or radios behind a network bridge given as tcp:// or
+ * udp:// addresses.  Frames and
+ * events from every port are re-emitted tagged with the port ID, so
+ * handlers can merge ports or pick one.  Port IDs are assigned in the order
+ * ports are added, starting at 0.  Only the CLI uses it so far; the GTK
+ * terminal still owns a single SerialInterface and ZigBeeInterface.  
+ */
+class PortManager
+{
+public:
+        /**
+         * Create a Port Manager.
+         * @param n notifier shared by all ports
+         */
+        PortManager(std::tr1::shared_ptr<Notifier> n);
+        virtual ~PortManager();
+        
+        /**
+         * Add a port.  The port is configured but not opened.
+         * @param port port name, or a tcp:// or udp:// address
+         * @param baud baud rate, ignored for sockets
+         * @param escaped API mode 2 (escaped)
+         * @return port ID
+         */
+        int add_port(std::string port, unsigned long baud, bool escaped);
+        
+        /**
+         * Get number of ports.
+         * @return ports
+         */
+        size_t get_port_count();
+        
+        /**
+         * Get transport of a port.
+         * @param id port ID
+         * @return transport, empty if no such port
+         */
+        std::tr1::shared_ptr<Transport> get_transport(int id);
+        
+        /**
+         * Get serial interface of a port.
+         * @param id port ID
+         * @return serial interface, empty if the port is a socket
+         */
+        std::tr1::shared_ptr<SerialInterface> get_serial_interface(int id);
+        
+        /**
+         * Get ZigBee interface of a port.
+         * @param id port ID
+         * @return ZigBee interface, or 0 if no such port
+         */
+        ZigBeeInterface *get_zigbee_interface(int id);
+        
+        /**
+         * Get the I/O loop shared by all ports.
+         * @return I/O loop
+         */
+        std::tr1::shared_ptr<SerialIoLoop> get_io_loop();
+        
+        /**
+         * Set port registry.  With reconnect on, a closed port is opened
+         * again as soon as the registry sees it come back, by device node
+         * or by-id link.
+         * @param reg port registry, may be shared
+         */
+        void set_port_registry(std::tr1::shared_ptr<PortRegistry> reg);
+        
+        /**
+         * Get port registry.
+         * @return port registry, empty if none
+         */
+        std::tr1::shared_ptr<PortRegistry> get_port_registry();
+        
+        /**
+         * Set reconnect.
+         * @param r true to reopen ports when they are plugged back in
+         * @see set_port_registry()
+         */
+        void set_reconnect(bool r);
+        
+        /**
+         * Get reconnect.
+         * @return true if ports are reopened when plugged back in
+         */
+        bool get_reconnect();
+        
+        /**
+         * Open all ports not already open.
+         * @return number of ports that failed to open
+         */
+        int open_ports();
+        
+        /**
+         * Close all ports.
+         */
+        void close_ports();
+        
+        /**
+         * Get number of open ports.
+         * @return ports
+         */
+        size_t get_open_count();
+        
+        /**
+         * Expire timed out requests on all ports.
+         * @return ms until the next request deadline, or -1 if none
+         * @see ZigBeeInterface::check_timeouts()
+         */
+        int check_timeouts();
+        
+        /**
+         * Receive frames signal.  Emitted once per port per batch.
+         * @par Prototype:
+         * <tt>void on_my_%receive_frames(int port, const std::vector<ZigBeePacketView> &frames)</tt>
+         * @see ZigBeeInterface::signal_receive_frames()
+         */
+        sigc::signal<void, int, const std::vector<ZigBeePacketView>&> signal_receive_frames();
+        
+        /**
+         * Receive raw data signal.
+         * @par Prototype:
+         * <tt>void on_my_%receive_raw_data(int port, const char *data, size_t len)</tt>
+         * @see ZigBeeInterface::signal_receive_raw_data()
+         */
+        sigc::signal<void, int, const char*, size_t> signal_receive_raw_data();
+        
+        /**
+         * Error signal.
+         * @par Prototype:
+         * <tt>void on_my_%error(int port)</tt>
+         * @see ZigBeeInterface::signal_error()
+         */
+        sigc::signal<void, int> signal_error();
+        
+        /**
+         * Port opened signal.
+         * @par Prototype:
+         * <tt>void on_my_%port_opened(int port)</tt>
+         * @see Transport::port_opened()
+         */
+        sigc::signal<void, int> signal_port_opened();
+        
+        /**
+         * Port closed signal.
+         * @par Prototype:
+         * <tt>void on_my_%port_closed(int port)</tt>
+         * @see Transport::port_closed()
+         */
+        sigc::signal<void, int> signal_port_closed();
+        
+protected:
+        /**
+         * Managed port.
+         */
+        struct Port
+        {
+                std::tr1::shared_ptr<Transport> transport;      ///< Transport
+                std::tr1::shared_ptr<SerialInterface> ser_int;  ///< Serial interface, empty for sockets
+                ZigBeeInterface *zb_int;                        ///< ZigBee interface, owned
+        };
+        
+        /**
+         * Receive frames event handler.
+         * @param frames frames
+         * @param id port ID
+         */
+        void on_receive_frames(const std::vector<ZigBeePacketView> &frames, int id);
+        
+        /**
+         * Receive raw data event handler.
+         * @param data data
+         * @param len length
+         * @param id port ID
+         */
+        void on_receive_raw_data(const char *data, size_t len, int id);
+        
+        /**
+         * Error event handler.
+         * @param id port ID
+         */
+        void on_error(int id);
+        
+        /**
+         * Port opened event handler.
+         * @param id port ID
+         */
+        void on_port_opened(int id);
+        
+        /**
+         * Port closed event handler.
+         * @param id port ID
+         */
+        void on_port_closed(int id);
+        
+        /**
+         * Registry port added event handler.
+         * @param port device node
+         */
+        void on_registry_port_added(std::string port);
+        
+        /**
+         * Notifier shared by all ports.
+         */
+        std::tr1::shared_ptr<Notifier> notifier;
+        
+        /**
+         * I/O loop shared by all ports.
+         */
+        std::tr1::shared_ptr<SerialIoLoop> io_loop;
+        
+        /**
+         * Ports, indexed by port ID.
+         */
+        std::vector<Port> ports;
+        
+        /**
+         * Port registry.
+         */
+        std::tr1::shared_ptr<PortRegistry> registry;
+        
+        /**
+         * Registry port added connection.
+         */
+        sigc::connection c_registry_port_added;
+        
+        /**
+         * Reopen ports when they are plugged back in.
+         */
+        bool reconnect;
+        
+        /**
+         * Receive frames signal.
+         */
+        sigc::signal<void, int, const std::vector<ZigBeePacketView>&> m_signal_receive_frames;
+        
+        /**
+         * Receive raw data signal.
+         */
+        sigc::signal<void, int, const char*, size_t> m_signal_receive_raw_data;
+        
+        /**
+         * Error signal.
+         */
+        sigc::signal<void, int> m_signal_error;
+        
+        /**
+         * Port opened signal.
+         */
+        sigc::signal<void, int> m_signal_port_opened;
+        
+        /**
+         * Port closed signal.
+         */
+        sigc::signal<void, int> m_signal_port_closed;
+};
+
+#endif //__PORT_MANAGER_H
@@ -0,0 +1,610 @@
+/************************************************************************/
+/* PortRegistry                                                         */
+/*                                                                      */
+/* ZigBee Terminal - Port Registry                                      */
+/*                                                                      */
+/* PortRegistry.cpp                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "PortRegistry.h"
+
+#include <iostream>
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef __unix__
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+
+// uevent multicast groups: raw kernel events, and events re-sent by udev
+// once its rules have run and the device node is ready to open
+#define UEVENT_GROUP_KERNEL 1
+#define UEVENT_GROUP_UDEV 2
+
+// header of the events udev sends, from libudev
+#define UDEV_MONITOR_MAGIC 0xfeedcafe
+
+struct udev_monitor_header
+{
+        char prefix[8];
+        unsigned int magic;
+        unsigned int header_size;
+        unsigned int properties_off;
+        unsigned int properties_len;
+        unsigned int filter_subsystem_hash;
+        unsigned int filter_devtype_hash;
+        unsigned int filter_tag_bloom_hi;
+        unsigned int filter_tag_bloom_lo;
+};
+
+#elif defined _WIN32
+
+#include <windows.h>
+#include <stdio.h>
+
+#endif
+
+#include "alphanum.h"
+
+// sort ports by device node, numbers in order
+static bool port_info_less(const PortRegistry::PortInfo &a, const PortRegistry::PortInfo &b)
+{
+        return doj::alphanum_less<std::string>()(a.port, b.port);
+}
+
+#ifdef __unix__
+
+// read the first line of a sysfs attribute
+static bool read_attr(const std::string &path, std::string &value)
+{
+        char buf[64];
+        int fd = ::open(path.c_str(), O_RDONLY);
+        ssize_t n;
+        
+        if (fd < 0)
+                return false;
+        
+        n = ::read(fd, buf, sizeof(buf) - 1);
+        ::close(fd);
+        
+        if (n < 0)
+                return false;
+        
+        buf[n] = 0;
+        value = buf;
+        value.erase(std::min(value.find('\n'), value.size()));
+        return true;
+}
+
+// last component of a symlink target
+static bool read_link_name(const std::string &path, std::string &value)
+{
+        char buf[PATH_MAX];
+        ssize_t n = readlink(path.c_str(), buf, sizeof(buf) - 1);
+        
+        if (n < 0)
+                return false;
+        
+        buf[n] = 0;
+        value = buf;
+        value.erase(0, value.rfind('/') + 1);
+        return true;
+}
+
+#endif
+
+PortRegistry::PortRegistry() :
+        scanned(false),
+        monitor_fd(-1)
+{
+        // nothing
+}
+
+
+PortRegistry::~PortRegistry()
+{
+        stop_monitor();
+}
+
+
+std::vector<std::string> PortRegistry::get_ports()
+{
+        std::vector<std::string> names;
+        const std::vector<PortInfo> &info = get_port_info();
+        
+        for (size_t i = 0; i < info.size(); i++)
+                names.push_back(info[i].port);
+        
+        return names;
+}
+
+
+const std::vector<PortRegistry::PortInfo> &PortRegistry::get_port_info()
+{
+        if (!scanned)
+        {
+                enumerate(ports);
+                scanned = true;
+        }
+        
+        return ports;
+}
+
+
+bool PortRegistry::find_port(const std::string &name, PortInfo &info)
+{
+        const std::vector<PortInfo> &p = get_port_info();
+        
+        for (size_t i = 0; i < p.size(); i++)
+        {
+                if (p[i].port == name || (!p[i].by_id.empty() && p[i].by_id == name))
+                {
+                        info = p[i];
+                        return true;
+                }
+        }
+        
+        return false;
+}
+
+
+void PortRegistry::refresh()
+{
+        std::vector<PortInfo> found;
+        std::vector<PortInfo> old;
+        
+        enumerate(found);
+        
+        if (!scanned)
+        {
+                ports = found;
+                scanned = true;
+                return;
+        }
+        
+        old.swap(ports);
+        
+        for (size_t i = 0; i < old.size(); i++)
+        {
+                if (!std::binary_search(found.begin(), found.end(), old[i], port_info_less))
+                        m_signal_port_removed.emit(old[i].port);
+        }
+        
+        // keep the cache whole while handlers look at it
+        ports = found;
+        
+        for (size_t i = 0; i < found.size(); i++)
+        {
+                if (!std::binary_search(old.begin(), old.end(), found[i], port_info_less))
+                        m_signal_port_added.emit(found[i].port);
+        }
+}
+
+
+bool PortRegistry::start_monitor()
+{
+        #ifdef __unix__
+        
+        struct sockaddr_nl addr;
+        int on = 1;
+        
+        if (monitor_fd >= 0)
+                return true;
+        
+        monitor_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+        
+        if (monitor_fd < 0)
+        {
+                std::cerr << "[PortRegistry] Unable to open uevent socket (errno " << errno << ")" << std::endl;
+                return false;
+        }
+        
+        // events from udev itself are checked against the sender
+        setsockopt(monitor_fd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on));
+        
+        // listen for udev when it is running, so ports are only reported
+        // once their permissions and by-id links are in place
+        memset(&addr, 0, sizeof(addr));
+        addr.nl_family = AF_NETLINK;
+        addr.nl_groups = access("/run/udev/control", F_OK) == 0 ? UEVENT_GROUP_UDEV : UEVENT_GROUP_KERNEL;
+        
+        if (bind(monitor_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+                std::cerr << "[PortRegistry] Unable to bind uevent socket (errno " << errno << ")" << std::endl;
+                ::close(monitor_fd);
+                monitor_fd = -1;
+                return false;
+        }
+        
+        // anything plugged in before the socket was up
+        refresh();
+        
+        return true;
+        
+        #else
+        
+        return false;
+        
+        #endif
+}
+
+
+void PortRegistry::stop_monitor()
+{
+        #ifdef __unix__
+        
+        if (monitor_fd >= 0)
+        {
+                ::close(monitor_fd);
+                monitor_fd = -1;
+        }
+        
+        #endif
+}
+
+
+int PortRegistry::get_fd()
+{
+        return monitor_fd;
+}
+
+
+void PortRegistry::dispatch()
+{
+        #ifdef __unix__
+        
+        char buf[8192];
+        char control[CMSG_SPACE(sizeof(struct ucred))];
+        struct sockaddr_nl addr;
+        struct iovec iov;
+        struct msghdr msg;
+        struct cmsghdr *cmsg;
+        struct ucred *cred;
+        ssize_t n;
+        
+        if (monitor_fd < 0)
+                return;
+        
+        for (;;)
+        {
+                iov.iov_base = buf;
+                iov.iov_len = sizeof(buf) - 1;
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_name = &addr;
+                msg.msg_namelen = sizeof(addr);
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+                msg.msg_control = control;
+                msg.msg_controllen = sizeof(control);
+                
+                n = recvmsg(monitor_fd, &msg, 0);
+                
+                if (n < 0)
+                {
+                        if (errno == EINTR)
+                                continue;
+                        
+                        // events were lost, scan for what changed
+                        if (errno == ENOBUFS)
+                        {
+                                refresh();
+                                continue;
+                        }
+                        
+                        if (errno != EAGAIN)
+                                std::cerr << "[PortRegistry] Error reading uevent socket (errno " << errno << ")" << std::endl;
+                        
+                        return;
+                }
+                
+                // only trust the kernel and root
+                cmsg = CMSG_FIRSTHDR(&msg);
+                if (cmsg == 0 || cmsg->cmsg_type != SCM_CREDENTIALS)
+                        continue;
+                
+                cred = (struct ucred *)CMSG_DATA(cmsg);
+                if (cred->uid != 0)
+                        continue;
+                
+                if (addr.nl_groups == UEVENT_GROUP_KERNEL && addr.nl_pid != 0)
+                        continue;
+                
+                buf[n] = 0;
+                handle_event(buf, n);
+        }
+        
+        #endif
+}
+
+
+void PortRegistry::enumerate(std::vector<PortInfo> &ports)
+{
+        ports.clear();
+        
+        #ifdef __unix__
+        
+        DIR *dp;
+        struct dirent *dirp;
+        PortInfo info;
+        
+        if ((dp = opendir("/sys/class/tty/")) == NULL)
+        {
+                std::cerr << "[PortRegistry] Error (" << errno << ") opening /sys/class/tty/" << std::endl;
+                return;
+        }
+        
+        while ((dirp = readdir(dp)) != NULL)
+        {
+                if (dirp->d_name[0] == '.')
+                        continue;
+                
+                if (read_port_info(dirp->d_name, info))
+                        ports.push_back(info);
+        }
+        
+        closedir(dp);
+        
+        read_by_id(ports);
+        
+        #elif defined _WIN32
+        
+        TCHAR szDevices[65535];
+        unsigned long dwChars = QueryDosDevice(NULL, szDevices, 65535);
+        TCHAR *ptr = szDevices;
+        TCHAR *temp_ptr;
+        PortInfo info;
+        
+        while (dwChars)
+        {
+                int port;
+                
+                if (sscanf(ptr, "COM%d", &port) == 1)
+                {
+                        info.port = ptr;
+                        ports.push_back(info);
+                }
+                
+                temp_ptr = strchr(ptr, 0);
+                dwChars -= (DWORD)((temp_ptr - ptr) / sizeof(TCHAR) + 1);
+                ptr = temp_ptr + 1;
+        }
+        
+        #endif
+        
+        std::sort(ports.begin(), ports.end(), port_info_less);
+}
+
+
+bool PortRegistry::read_port_info(const std::string &name, PortInfo &info)
+{
+        #ifdef __unix__
+        
+        std::string sys = "/sys/class/tty/" + name;
+        std::string type;
+        struct stat st;
+        
+        // virtual terminals, ptys and the like have no device behind them
+        if (lstat((sys + "/device").c_str(), &st) < 0)
+                return false;
+        
+        // serial core lists every UART it has a slot for; type 0 is
+        // PORT_UNKNOWN, nothing was found there
+        if (read_attr(sys + "/type", type) && atoi(type.c_str()) == 0)
+                return false;
+        
+        info.port = "/dev/" + name;
+        info.by_id.clear();
+        info.driver.clear();
+        
+        if (stat(info.port.c_str(), &st) < 0 || !S_ISCHR(st.st_mode))
+                return false;
+        
+        read_link_name(sys + "/device/driver", info.driver);
+        
+        return true;
+        
+        #else
+        
+        return false;
+        
+        #endif
+}
+
+
+void PortRegistry::read_by_id(std::vector<PortInfo> &ports)
+{
+        #ifdef __unix__
+        
+        DIR *dp;
+        struct dirent *dirp;
+        std::string f;
+        char buf[PATH_MAX];
+        
+        if ((dp = opendir("/dev/serial/by-id/")) == NULL)
+                return;
+        
+        while ((dirp = readdir(dp)) != NULL)
+        {
+                if (dirp->d_name[0] == '.')
+                        continue;
+                
+                f = std::string("/dev/serial/by-id/") + dirp->d_name;
+                
+                if (realpath(f.c_str(), buf) == NULL)
+                        continue;
+                
+                for (size_t i = 0; i < ports.size(); i++)
+                {
+                        if (ports[i].port == buf)
+                        {
+                                ports[i].by_id = f;
+                                break;
+                        }
+                }
+        }
+        
+        closedir(dp);
+        
+        #endif
+}
+
+
+void PortRegistry::handle_event(const char *buf, size_t len)
+{
+        const char *p = buf;
+        const char *end = buf + len;
+        std::string action, subsystem, devname, devlinks;
+        
+        #ifdef __unix__
+        
+        // udev events carry a binary header, kernel events start with
+        // "action@devpath"; both then have NUL separated KEY=value pairs
+        if (len >= sizeof(udev_monitor_header) && memcmp(buf, "libudev", 8) == 0)
+        {
+                const udev_monitor_header *hdr = (const udev_monitor_header *)buf;
+                
+                if (ntohl(hdr->magic) != UDEV_MONITOR_MAGIC ||
+                        hdr->properties_off > len || hdr->properties_len > len - hdr->properties_off)
+                        return;
+                
+                p = buf + hdr->properties_off;
+                end = p + hdr->properties_len;
+        }
+        else
+        {
+                p += strnlen(p, len) + 1;
+        }
+        
+        #endif
+        
+        while (p < end)
+        {
+                size_t n = strnlen(p, end - p);
+                std::string kv(p, n);
+                size_t eq = kv.find('=');
+                
+                p += n + 1;
+                
+                if (eq == std::string::npos)
+                        continue;
+                
+                if (kv.compare(0, eq, "ACTION") == 0)
+                        action = kv.substr(eq + 1);
+                else if (kv.compare(0, eq, "SUBSYSTEM") == 0)
+                        subsystem = kv.substr(eq + 1);
+                else if (kv.compare(0, eq, "DEVNAME") == 0)
+                        devname = kv.substr(eq + 1);
+                else if (kv.compare(0, eq, "DEVLINKS") == 0)
+                        devlinks = kv.substr(eq + 1);
+        }
+        
+        if (subsystem != "tty" || devname.empty())
+                return;
+        
+        // kernel events name the node relative to /dev
+        if (devname[0] == '/')
+                devname.erase(0, devname.rfind('/') + 1);
+        
+        if (action == "add")
+        {
+                PortInfo info;
+                
+                if (!read_port_info(devname, info))
+                        return;
+                
+                // udev lists the links it made
+                size_t pos = devlinks.find("/dev/serial/by-id/");
+                if (pos != std::string::npos)
+                        info.by_id = devlinks.substr(pos, devlinks.find(' ', pos) - pos);
+                
+                add_port(info);
+        }
+        else if (action == "remove")
+        {
+                remove_port("/dev/" + devname);
+        }
+}
+
+
+void PortRegistry::add_port(const PortInfo &info)
+{
+        std::vector<PortInfo>::iterator it;
+        
+        get_port_info();
+        
+        it = std::lower_bound(ports.begin(), ports.end(), info, port_info_less);
+        
+        if (it != ports.end() && it->port == info.port)
+        {
+                *it = info;
+                return;
+        }
+        
+        ports.insert(it, info);
+        m_signal_port_added.emit(info.port);
+}
+
+
+void PortRegistry::remove_port(const std::string &port)
+{
+        std::vector<PortInfo>::iterator it;
+        PortInfo info;
+        
+        get_port_info();
+        
+        info.port = port;
+        it = std::lower_bound(ports.begin(), ports.end(), info, port_info_less);
+        
+        if (it == ports.end() || it->port != port)
+                return;
+        
+        ports.erase(it);
+        m_signal_port_removed.emit(port);
+}
+
+
+sigc::signal<void, std::string> PortRegistry::signal_port_added()
+{
+        return m_signal_port_added;
+}
+
+
+sigc::signal<void, std::string> PortRegistry::signal_port_removed()
+{
+        return m_signal_port_removed;
+}
+
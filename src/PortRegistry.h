@@ -0,0 +1,195 @@
+/************************************************************************/
+/* PortRegistry                                                         */
+/*                                                                      */
+/* ZigBee Terminal - Port Registry                                      */
+/*                                                                      */
+/* PortRegistry.h                                                       */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __PORT_REGISTRY_H
+#define __PORT_REGISTRY_H
+
+#include <string>
+#include <vector>
+#include <sigc++/sigc++.h>
+
+/** Port Registry
+ * 
+ * Cached list of serial ports.  On Linux the list is read from sysfs,
+ * which says which ttys are backed by hardware and which UARTs are
+ * really there without opening any device, and is then kept up to date
+ * from udev (or kernel) hotplug events on a netlink socket, so it only
+ * needs to be scanned once.  The registry is driven from one thread: call
+ * dispatch() when the descriptor from get_fd() is readable, and the port
+ * added and removed signals are emitted from there.  
+ */
+class PortRegistry
+{
+public:
+        /**
+         * Port information.
+         */
+        struct PortInfo
+        {
+                std::string port;       ///< Device node, such as /dev/ttyUSB0
+                std::string by_id;      ///< Persistent /dev/serial/by-id/ link, empty if none
+                std::string driver;     ///< Kernel driver, empty if not known
+        };
+        
+        /**
+         * Create a Port Registry.  Nothing is scanned until the list is
+         * first asked for.
+         */
+        PortRegistry();
+        virtual ~PortRegistry();
+        
+        /**
+         * Get port names.  Scans on first call.
+         * @return device nodes, sorted
+         */
+        std::vector<std::string> get_ports();
+        
+        /**
+         * Get port information.  Scans on first call.
+         * @return ports, sorted by device node
+         */
+        const std::vector<PortInfo> &get_port_info();
+        
+        /**
+         * Find a port by device node or by-id link.
+         * @param name port name
+         * @param info return port information
+         * @return true if present
+         */
+        bool find_port(const std::string &name, PortInfo &info);
+        
+        /**
+         * Scan all ports again.  Emits the added and removed signals for
+         * any differences from the cached list.
+         */
+        void refresh();
+        
+        /**
+         * Start listening for hotplug events.
+         * @return false if not supported
+         */
+        bool start_monitor();
+        
+        /**
+         * Stop listening for hotplug events.
+         */
+        void stop_monitor();
+        
+        /**
+         * Get hotplug event descriptor.
+         * @return descriptor to poll for reading, -1 if not monitoring
+         */
+        int get_fd();
+        
+        /**
+         * Handle pending hotplug events.
+         */
+        void dispatch();
+        
+        /**
+         * Enumerate serial ports.  Does not open any device.
+         * @param ports return ports, sorted by device node
+         */
+        static void enumerate(std::vector<PortInfo> &ports);
+        
+        /**
+         * Port added signal.  
+         * @par Prototype:
+         * <tt>void on_my_%port_added(std::string port)</tt>
+         */
+        sigc::signal<void, std::string> signal_port_added();
+        
+        /**
+         * Port removed signal.  
+         * @par Prototype:
+         * <tt>void on_my_%port_removed(std::string port)</tt>
+         */
+        sigc::signal<void, std::string> signal_port_removed();
+        
+protected:
+        /**
+         * Check if a tty is a usable serial port.
+         * @param name tty name, such as ttyUSB0
+         * @param info return port information
+         * @return true if usable
+         */
+        static bool read_port_info(const std::string &name, PortInfo &info);
+        
+        /**
+         * Fill in by-id links.
+         * @param ports ports
+         */
+        static void read_by_id(std::vector<PortInfo> &ports);
+        
+        /**
+         * Handle one hotplug event.
+         * @param buf message
+         * @param len message length
+         */
+        void handle_event(const char *buf, size_t len);
+        
+        /**
+         * Add or update a port in the cached list.
+         * @param info port information
+         */
+        void add_port(const PortInfo &info);
+        
+        /**
+         * Remove a port from the cached list.
+         * @param port device node
+         */
+        void remove_port(const std::string &port);
+        
+        /**
+         * Cached ports, sorted by device node.
+         */
+        std::vector<PortInfo> ports;
+        
+        /**
+         * Set once the ports have been scanned.
+         */
+        bool scanned;
+        
+        /**
+         * Hotplug event socket, -1 if not monitoring.
+         */
+        int monitor_fd;
+        
+        /** Port added signal. */
+        sigc::signal<void, std::string> m_signal_port_added;
+        
+        /** Port removed signal. */
+        sigc::signal<void, std::string> m_signal_port_removed;
+};
+
+#endif //__PORT_REGISTRY_H
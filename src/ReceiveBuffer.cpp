@@ -0,0 +1,141 @@
+/************************************************************************/
+/* ReceiveBuffer                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Receive Buffer                                     */
+/*                                                                      */
+/* ReceiveBuffer.cpp                                                    */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ReceiveBuffer.h"
+
+#include <string.h>
+
+ReceiveBuffer::ReceiveBuffer(size_t capacity) :
+        storage(capacity),
+        head(0),
+        tail(0)
+{
+        // nothing
+}
+
+
+ReceiveBuffer::~ReceiveBuffer()
+{
+        // nothing
+}
+
+
+uint8_t *ReceiveBuffer::get_write_ptr()
+{
+        // compact once less than a quarter of the storage is left at the end
+        if (head > 0 && storage.size() - tail < storage.size() / 4)
+                compact();
+                
+        return &storage[0] + tail;
+}
+
+
+size_t ReceiveBuffer::get_write_space()
+{
+        return storage.size() - tail;
+}
+
+
+void ReceiveBuffer::commit(size_t count)
+{
+        if (count > storage.size() - tail)
+                count = storage.size() - tail;
+                
+        tail += count;
+}
+
+
+size_t ReceiveBuffer::write(const uint8_t *bytes, size_t count)
+{
+        uint8_t *ptr = get_write_ptr();
+        
+        if (count > get_write_space())
+                count = get_write_space();
+                
+        memcpy(ptr, bytes, count);
+        commit(count);
+        
+        return count;
+}
+
+
+uint8_t *ReceiveBuffer::get_data()
+{
+        return &storage[0] + head;
+}
+
+
+size_t ReceiveBuffer::get_size()
+{
+        return tail - head;
+}
+
+
+size_t ReceiveBuffer::get_capacity()
+{
+        return storage.size();
+}
+
+
+void ReceiveBuffer::consume(size_t count)
+{
+        if (count >= tail - head)
+        {
+                // empty, so rewind for free
+                head = 0;
+                tail = 0;
+                return;
+        }
+        
+        head += count;
+}
+
+
+void ReceiveBuffer::clear()
+{
+        head = 0;
+        tail = 0;
+}
+
+
+void ReceiveBuffer::compact()
+{
+        if (head == 0)
+                return;
+                
+        memmove(&storage[0], &storage[0] + head, tail - head);
+        tail -= head;
+        head = 0;
+}
+
+
@@ -0,0 +1,141 @@
+/************************************************************************/
+/* ReceiveBuffer                                                        */
+/*                                                                      */
+/* ZigBee Terminal - Receive Buffer                                     */
+/*                                                                      */
+/* ReceiveBuffer.h                                                      */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __RECEIVE_BUFFER_H
+#define __RECEIVE_BUFFER_H
+
+#include <vector>
+#include <stddef.h>
+#include <inttypes.h>
+
+/** Receive Buffer
+ * 
+ * Fixed capacity, contiguous receive buffer.  Data is written at the tail
+ * and consumed from the head.  Consuming data only advances the head, so it
+ * is O(1); the unread bytes are moved back to the start of the storage only
+ * when the free space at the end runs out.  Unread data is always
+ * contiguous, so parsers can hand out pointers into the buffer instead of
+ * copying.
+ */
+class ReceiveBuffer
+{
+public:
+        /**
+         * Create a Receive Buffer.
+         * @param capacity buffer size in bytes
+         */
+        ReceiveBuffer(size_t capacity = 65536);
+        virtual ~ReceiveBuffer();
+        
+        /**
+         * Get pointer to free space at the tail of the buffer.  Compacts
+         * the buffer first if the free space at the end is running low.
+         * Invalidates pointers returned by get_data().
+         * @return pointer to free space
+         * @see get_write_space()
+         * @see commit()
+         */
+        uint8_t *get_write_ptr();
+        
+        /**
+         * Get number of bytes that may be written at get_write_ptr().
+         * @return free space in bytes
+         */
+        size_t get_write_space();
+        
+        /**
+         * Mark bytes written at get_write_ptr() as valid.
+         * @param count number of bytes written
+         */
+        void commit(size_t count);
+        
+        /**
+         * Append bytes to the buffer.
+         * @param bytes pointer to data
+         * @param count number of bytes
+         * @return number of bytes actually stored
+         */
+        size_t write(const uint8_t *bytes, size_t count);
+        
+        /**
+         * Get pointer to unread data.
+         * @return pointer to first unread byte
+         */
+        uint8_t *get_data();
+        
+        /**
+         * Get number of unread bytes.
+         * @return unread byte count
+         */
+        size_t get_size();
+        
+        /**
+         * Get total capacity.
+         * @return capacity in bytes
+         */
+        size_t get_capacity();
+        
+        /**
+         * Drop bytes from the head of the buffer.
+         * @param count number of bytes to drop
+         */
+        void consume(size_t count);
+        
+        /**
+         * Drop all data.
+         */
+        void clear();
+        
+protected:
+        /**
+         * Move unread data to the start of the storage.
+         */
+        void compact();
+        
+        /**
+         * Buffer storage.
+         */
+        std::vector<uint8_t> storage;
+        
+        /**
+         * Offset of first unread byte.
+         */
+        size_t head;
+        
+        /**
+         * Offset of first free byte.
+         */
+        size_t tail;
+};
+
+#endif //__RECEIVE_BUFFER_H
@@ -0,0 +1,90 @@
+/************************************************************************/
+/* SerialBaud                                                           */
+/*                                                                      */
+/* ZigBee Terminal - Serial Custom Baud Rate                            */
+/*                                                                      */
+/* SerialBaud.cpp                                                       */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+
+#include "SerialBaud.h"
+
+#include <errno.h>
+
+#ifdef __linux__
+
+// the kernel's termios2 for this architecture; never mix with termios.h
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+#if defined(TCGETS2) && defined(BOTHER)
+#define SERIAL_BAUD_TERMIOS2
+#endif
+
+#endif
+
+
+bool SerialBaud::is_supported()
+{
+        #ifdef SERIAL_BAUD_TERMIOS2
+        return true;
+        #else
+        return false;
+        #endif
+}
+
+
+int SerialBaud::set_custom(int fd, unsigned long baud)
+{
+        #ifdef SERIAL_BAUD_TERMIOS2
+        
+        struct termios2 tio;
+        
+        if (::ioctl(fd, TCGETS2, &tio) < 0)
+                return errno;
+        
+        tio.c_cflag &= ~CBAUD;
+        tio.c_cflag |= BOTHER;
+        tio.c_ispeed = baud;
+        tio.c_ospeed = baud;
+        
+        if (::ioctl(fd, TCSETS2, &tio) < 0)
+                return errno;
+        
+        return 0;
+        
+        #else
+        
+        (void)fd;
+        (void)baud;
+        
+        return EINVAL;
+        
+        #endif
+}
+
@@ -0,0 +1,64 @@
+/************************************************************************/
+/* SerialBaud                                                           */
+/*                                                                      */
+/* ZigBee Terminal - Serial Custom Baud Rate                            */
+/*                                                                      */
+/* SerialBaud.h                                                         */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __SERIAL_BAUD_H
+#define __SERIAL_BAUD_H
+
+/** Serial Baud
+ * 
+ * Sets baud rates outside the Bxxx constants through the kernel's own
+ * struct termios2 (TCGETS2/TCSETS2 with BOTHER).  Kept in a translation
+ * unit of its own since asm/termbits.h, which defines the struct for the
+ * architecture being built, clashes with termios.h.  
+ */
+class SerialBaud
+{
+public:
+        /**
+         * Check for custom baud rate support.
+         * @return true if set_custom() can work on this platform
+         */
+        static bool is_supported();
+        
+        /**
+         * Set a custom baud rate on an open, configured port.  Leaves
+         * the rest of the port settings alone.
+         * @param fd port file descriptor
+         * @param baud baud rate
+         * @return 0 on success, otherwise errno of the failed call, EINVAL
+         * if not supported
+         */
+        static int set_custom(int fd, unsigned long baud);
+};
+
+#endif //__SERIAL_BAUD_H
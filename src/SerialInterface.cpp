@@ -32,130 +32,37 @@
 /************************************************************************/
 
 #include "SerialInterface.h"
+#include "SerialBaud.h"
+#include "PortRegistry.h"
+#include "HexCodec.h"
 
 #ifdef __unix__
 
-#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
 #include <linux/serial.h>
 
+// queued frames gathered into one writev()
+#define SERIAL_TX_IOV_MAX 64
+
 #endif
 
 #include <iostream>
 #include <iomanip>
-
-#include "alphanum.h"
+#include <sstream>
+#include <algorithm>
+#include <string.h>
 
 std::vector<std::string> SerialInterface::enumerate_ports()
 {
-        std::vector<std::string> SerialDeviceList = std::vector<std::string>();
-        
-        #ifdef __unix__
-        
-        DIR *dp;
-        struct dirent *dirp;
-        std::string f, d;
-        std::vector<std::string>::iterator it;
-        char buf[PATH_MAX];
-        
-        struct serial_struct serinfo;
-        int fd;
-        
-        if ((dp = opendir("/dev/")) == NULL)
-        {
-                std::cerr << "Error (" << errno << ") opening /dev/" << std::endl;
-        }
-        else
-        {
-                while ((dirp = readdir(dp)) != NULL)
-                {
-                        f = dirp->d_name;
-                        d = "/dev/" + f;
-                        if (f.find("ttyS") == 0)
-                        {
-                                if ((fd = ::open(d.c_str(), O_RDWR|O_NONBLOCK)) < 0)
-                                {
-                                        std::cerr << "Cannot open port " << d << std::endl;
-                                        continue;
-                                }
-                                
-                                serinfo.reserved_char[0] = 0;
-                                
-                                if (::ioctl(fd, TIOCGSERIAL, &serinfo) < 0)
-                                {
-                                        std::cerr << "Cannot get serial info for " << d << std::endl;
-                                        ::close(fd);
-                                        continue;
-                                }
-                                
-                                if (serinfo.port != 0)
-                                        SerialDeviceList.push_back(d);
-                                
-                                ::close(fd);
-                                
-                                continue;
-                        }
-                        if (f.find("ttyUSB") == 0)
-                        {
-                                SerialDeviceList.push_back(d);
-                        }
-                }
-                
-                closedir(dp);
-        }
-        
-        if ((dp = opendir("/dev/serial/by-id/")) != NULL)
-        {
-                while ((dirp = readdir(dp)) != NULL)
-                {
-                        f = dirp->d_name;
-                        if (f == "." || f == "..")
-                                continue;
-                        f = "/dev/serial/by-id/" + f;
-                        if (realpath(f.c_str(), buf));
-                        {
-                                f = buf;
-                                SerialDeviceList.push_back(f);
-                        }
-                }
-                
-                closedir(dp);
-        }
-        
-        #elif defined _WIN32
-        
-        TCHAR szDevices[65535];
-        unsigned long dwChars = QueryDosDevice(NULL, szDevices, 65535);
-        TCHAR *ptr = szDevices;
-        TCHAR *temp_ptr;
-        std::string c;
-        
-        while (dwChars)
-        {
-                int port;
-                
-                if (sscanf(ptr, "COM%d", &port) == 1)
-                {
-                        c = ptr;
-                        SerialDeviceList.push_back(c);
-                }
-                
-                temp_ptr = strchr(ptr, 0);
-                dwChars -= (DWORD)((temp_ptr - ptr) / sizeof(TCHAR) + 1);
-                ptr = temp_ptr + 1;
-        }
-        
-        #endif
-        
-        // sort it
-        sort(SerialDeviceList.begin(), SerialDeviceList.end(), doj::alphanum_less<std::string>());
+        PortRegistry reg;
         
-        // remove duplicates
-        SerialDeviceList.erase(std::unique(SerialDeviceList.begin(), SerialDeviceList.end()), SerialDeviceList.end());
-        
-        return SerialDeviceList;
+        return reg.get_ports();
 }
 
 SerialInterface::SerialInterface()
@@ -163,6 +70,9 @@ SerialInterface::SerialInterface()
         #ifdef __unix__
         
         port_fd = -1;
+        port_serial_flags_saved = -1;
+        event_fd = -1;
+        io_deferred = false;
         
         #elif defined _WIN32
         
@@ -181,46 +91,100 @@ SerialInterface::SerialInterface()
         
         debug = false;
         
+        low_latency = false;
+        read_min = 1;
+        read_timeout = 20;
+        
         running = false;
+        thread = 0;
+        
+        receiver = 0;
+        pending_events = 0;
+        
+        tx_index = 0;
+        tx_offset = 0;
+        tx_count = 0;
+        tx_max = 0;
+        tx_limit = 2048;
+        tx_full = false;
+        tx_wait_out = 0;
         
         in_on_receive_data = false;
         called_close_port = false;
-        
-        signal_receive_data.connect( sigc::mem_fun(*this, &SerialInterface::on_receive_data) );
-        signal_error.connect( sigc::mem_fun(*this, &SerialInterface::on_error) );
 }
 
 SerialInterface::~SerialInterface()
 {
         close_port();
+        c_notify.disconnect();
 }
 
-void SerialInterface::on_receive_data()
+void SerialInterface::on_notify()
 {
-        in_on_receive_data = true;
+        // clear before handling so events posted from here on wake us again
+        int events = Thread::atomic_exchange(&pending_events, 0);
         
+        if (events & SE_ReceiveData)
+                on_receive_data();
+                
+        if (events & SE_WriteSpace)
+                on_write_space();
+                
+        if (events & SE_Error)
+                on_error();
+}
+
+void SerialInterface::on_receive_data()
+{
         {
-                Glib::Mutex::Lock lock(running_mutex);
+                Mutex::Lock lock(running_mutex);
                 if (!running)
                         return;
         }
         
+        in_on_receive_data = true;
+        
+        #ifdef __unix__
+        
+        m_port_receive_data.emit();
+        
+        if (!receiver && !called_close_port && is_open())
+        {
+                // re-arm port, handlers have read what was available
+                arm_port();
+        }
+        
+        #elif defined _WIN32
+        
         {
-                Glib::Mutex::Lock read_lock(read_mutex);
+                Mutex::Lock read_lock(read_mutex);
                 m_port_receive_data.emit();
                 read_cond.signal();
         }
-                
+        
+        #endif
+        
         in_on_receive_data = false;
         
         if (called_close_port)
                 close_port();
 }
 
+void SerialInterface::on_write_space()
+{
+        {
+                Mutex::Lock lock(running_mutex);
+                if (!running)
+                        return;
+        }
+        
+        m_port_write_space.emit();
+}
+
 void SerialInterface::on_error()
 {
         {
-                Glib::Mutex::Lock lock(running_mutex);
+                Mutex::Lock lock(running_mutex);
                 if (!running)
                         return;
         }
@@ -230,97 +194,283 @@ void SerialInterface::on_error()
         close_port();
 }
 
-void SerialInterface::launch_select_thread()
+void SerialInterface::post_event(int event)
+{
+        // only the first event posted since on_notify() needs a wake up
+        if (Thread::atomic_or(&pending_events, event) == 0)
+                notifier->notify();
+}
+
+void SerialInterface::notify_receive_data()
+{
+        post_event(SE_ReceiveData);
+}
+
+void SerialInterface::arm_port()
+{
+        #ifdef __unix__
+        
+        // without a receiver the main loop reads, so wait for it to re-arm
+        uint32_t events = get_io_events();
+        
+        if (Thread::atomic_get(&tx_wait_out))
+                events |= EPOLLOUT;
+                
+        io_loop->set_port_events(this, events);
+        
+        #endif
+}
+
+SerialInterface::SerialStatus SerialInterface::launch_io_thread()
 {
+        if (!notifier)
+        {
+                std::cerr << "Error: no notifier set!" << std::endl;
+                return SS_Error;
+        }
+        
+        Thread::atomic_set(&pending_events, 0);
+        Thread::atomic_set(&tx_wait_out, 0);
+        
         running = true;
-        thread = Glib::Thread::create( sigc::mem_fun(*this, &SerialInterface::select_thread), true );
+        
+        #ifdef __unix__
+        
+        event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        
+        if (event_fd < 0)
+        {
+                std::cerr << "Error creating eventfd (errno " << errno << ")" << std::endl;
+                running = false;
+                return SS_Error;
+        }
+        
+        if (!io_loop)
+                io_loop.reset(new SerialIoLoop());
+                
+        if (!io_loop->add_port(this))
+        {
+                running = false;
+                return SS_Error;
+        }
+        
+        // pick up anything queued by port opened handlers
+        uint64_t v = 1;
+        if (::write(event_fd, &v, sizeof(v)) < 0)
+                std::cerr << "Error signaling eventfd (errno " << errno << ")" << std::endl;
+                
+        #elif defined _WIN32
+        
+        thread = Thread::create( sigc::mem_fun(*this, &SerialInterface::io_thread) );
+        
+        if (!thread)
+        {
+                running = false;
+                return SS_Error;
+        }
+        
+        #endif
+        
+        return SS_Success;
 }
 
-void SerialInterface::stop_select_thread()
+void SerialInterface::stop_io_thread()
 {
         
         {
-                Glib::Mutex::Lock lock(running_mutex);
+                Mutex::Lock lock(running_mutex);
                 running = false;
         }
         
-        read_cond.signal();
+        #ifdef __unix__
         
-        #ifdef _WIN32
+        // returns once the loop is done with the port
+        if (io_loop)
+                io_loop->remove_port(this);
+                
+        if (event_fd >= 0)
+                ::close(event_fd);
+        event_fd = -1;
+        
+        // drop anything not written
+        for (size_t i = tx_index; i < tx_write.size(); i++)
+                tx_pool.release(tx_write[i]);
+        tx_write.clear();
+        tx_index = 0;
+        tx_offset = 0;
+        
+        {
+                Mutex::Lock lock(tx_mutex);
                 
+                for (size_t i = 0; i < tx_queue.size(); i++)
+                        tx_pool.release(tx_queue[i]);
+                tx_queue.clear();
+                tx_count = 0;
+                tx_full = false;
+        }
+        
+        #elif defined _WIN32
+        
+        read_cond.signal();
+        
         // set event mask to cause thread to exit
         if (!SetCommMask(h_port, EV_RXCHAR))
         {
                 std::cerr << "Error setting mask!" << std::endl;
         }
         
-        #endif
-        
         if (thread)
         {
                 thread->join();
         }
         thread = 0;
+        
+        #endif
 }
 
-void SerialInterface::select_thread()
+#ifdef __unix__
+
+int SerialInterface::get_io_fd()
 {
-        #ifdef __unix__
+        return port_fd;
+}
+
+int SerialInterface::get_wake_fd()
+{
+        return event_fd;
+}
+
+uint32_t SerialInterface::get_io_events()
+{
+        return receiver ? EPOLLIN : EPOLLIN | EPOLLONESHOT;
+}
+
+void SerialInterface::io_start()
+{
+        io_deferred = false;
+        io_deadline = 0;
+        update_io_deadline();
+}
+
+bool SerialInterface::io_event(int source, uint32_t events)
+{
+        bool notify;
         
-        int n, max_fd;
-        fd_set input;
-        struct timeval timeout;
+        if (source == SerialIoLoop::SIO_Wake)
+        {
+                // data was queued
+                uint64_t v;
+                if (::read(event_fd, &v, sizeof(v)) < 0 && errno != EAGAIN)
+                        std::cerr << "Error reading eventfd (errno " << errno << ")" << std::endl;
+                        
+                if (!flush_tx())
+                        return false;
+                        
+                update_io_deadline();
+                return true;
+        }
         
-        #endif
+        if (!(events & (EPOLLIN | EPOLLOUT)))
+        {
+                std::cerr << "Error: serial port hung up!" << std::endl;
+                post_event(SE_Error);
+                return false;
+        }
         
-        while (is_open())
+        if (events & EPOLLOUT)
         {
-                {
-                        Glib::Mutex::Lock lock(running_mutex);
-                        if (!running)
-                                break;
-                }
-                
-                #ifdef __unix__
-                
-                FD_ZERO(&input);
-                FD_SET(port_fd, &input);
-                max_fd = port_fd + 1;
+                // port has room again
+                if (!flush_tx())
+                        return false;
+        }
+        
+        if (!(events & EPOLLIN))
+        {
+                // a one shot wake up for writing disarms reading too
+                if (!receiver)
+                        arm_port();
+                update_io_deadline();
+                return true;
+        }
+        
+        if (!receiver)
+        {
+                // main loop reads, on_receive_data() re-arms port
+                notify_receive_data();
+                return true;
+        }
+        
+        notify = false;
+        
+        if (read_receiver(notify) < 0)
+                return false;
                 
-                timeout.tv_sec = 0;
-                timeout.tv_usec = 100000;
+        if (notify)
+                notify_receive_data();
                 
-                n = select(max_fd, &input, NULL, NULL, &timeout);
+        io_deferred = !notify;
+        update_io_deadline();
+        
+        return true;
+}
+
+bool SerialInterface::io_timer()
+{
+        int num;
+        bool notify = io_deferred;
+        
+        io_deferred = false;
+        
+        // a tail shorter than the read minimum never wakes epoll, go and
+        // get it
+        if (receiver && read_min > 1)
+        {
+                if ((num = read_receiver(notify)) < 0)
+                        return false;
+                        
+                io_deferred = num > 0 && !notify;
+        }
+        
+        if (notify)
+                notify_receive_data();
                 
-                if (n < 0)
-                {
-                        std::cerr << "Error: select failed!" << std::endl;
-                        signal_error.emit();
-                        return;
-                }
-                else if (n == 0)
-                {
-                        // timeout...
-                }
-                else
+        update_io_deadline();
+        
+        return true;
+}
+
+void SerialInterface::io_fail()
+{
+        post_event(SE_Error);
+}
+
+void SerialInterface::update_io_deadline()
+{
+        // data held back by the receiver is delivered after a short idle
+        // period; with a read minimum, also wake up for tails that never
+        // reach it
+        if (io_deferred || (receiver && read_min > 1))
+                io_deadline = SerialIoLoop::get_time() + read_timeout;
+        else
+                io_deadline = 0;
+}
+
+#elif defined _WIN32
+
+void SerialInterface::io_thread()
+{
+        size_t count;
+        size_t num;
+        char *ptr;
+        
+        while (is_open())
+        {
                 {
-                        if (FD_ISSET(port_fd, &input))
-                        {
-                                Glib::Mutex::Lock read_lock(read_mutex);
-                                
-                                {
-                                        Glib::Mutex::Lock lock(running_mutex);
-                                        if (!running)
-                                                break;
-                                }
-                                
-                                signal_receive_data.emit();
-                                read_cond.wait(read_mutex);
-                        }
+                        Mutex::Lock lock(running_mutex);
+                        if (!running)
+                                break;
                 }
                 
-                #elif defined _WIN32
-                
                 ResetEvent(h_overlapped_thread);
                 
                 DWORD e_event = 0;
@@ -334,7 +484,7 @@ void SerialInterface::select_thread()
                         if (GetLastError() != ERROR_IO_PENDING)
                         {
                                 std::cerr << "Unable to wait for COM event (" << GetLastError() << ")" << std::endl;
-                                signal_error.emit();
+                                post_event(SE_Error);
                                 return;
                         }
                 }
@@ -342,32 +492,58 @@ void SerialInterface::select_thread()
                 if (WaitForSingleObject(h_overlapped_thread,INFINITE) != WAIT_OBJECT_0)
                 {
                         std::cerr << "Unable to wait until COM event has arrived" << std::endl;
-                        signal_error.emit();
+                        post_event(SE_Error);
                         return;
                 }
                 
                 if (e_event == EV_RXCHAR)
                 {
-                        Glib::Mutex::Lock read_lock(read_mutex);
-                        
                         {
-                                Glib::Mutex::Lock lock(running_mutex);
+                                Mutex::Lock lock(running_mutex);
                                 if (!running)
                                         break;
                         }
                         
-                        signal_receive_data.emit();
-                        read_cond.wait(read_mutex);
+                        if (receiver)
+                        {
+                                bool notify = false;
+                                
+                                do
+                                {
+                                        ptr = receiver->get_receive_space(count);
+                                        
+                                        if (read(ptr, count, num) != SS_Success)
+                                        {
+                                                post_event(SE_Error);
+                                                return;
+                                        }
+                                        
+                                        if (num > 0 && receiver->receive(num))
+                                                notify = true;
+                                }
+                                while (num == count);
+                                
+                                if (notify)
+                                        notify_receive_data();
+                        }
+                        else
+                        {
+                                Mutex::Lock read_lock(read_mutex);
+                                
+                                notify_receive_data();
+                                read_cond.wait(read_mutex);
+                        }
                 }
-        
-                #endif
-                
         }
 }
 
-SerialInterface::SerialStatus SerialInterface::write(const char *buf, gsize count, gsize& bytes_written)
+#endif
+
+SerialInterface::SerialStatus SerialInterface::write(const char *buf, size_t count, size_t& bytes_written)
 {
-        #ifdef __WIN32
+        #ifdef __unix__
+        ssize_t num;
+        #elif defined __WIN32
         DWORD d;
         #endif
         
@@ -376,9 +552,17 @@ SerialInterface::SerialStatus SerialInterface::write(const char *buf, gsize coun
         
         #ifdef __unix__
         
-        bytes_written = ::write(port_fd, buf, count);
+        num = ::write(port_fd, buf, count);
         
-        if (bytes_written == -1)
+        if (num < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+                // port is full, not an error
+                num = 0;
+        }
+        
+        bytes_written = num < 0 ? 0 : num;
+        
+        if (num < 0)
         {
                 std::cerr << "Error writing serial port (errno " << errno << ")" << std::endl;
                 m_port_error.emit();
@@ -428,16 +612,306 @@ SerialInterface::SerialStatus SerialInterface::write(const char *buf, gsize coun
         
         if (debug && bytes_written > 0)
         {
-                std::cout << "Write: ";
-                for (gsize i = 0; i < bytes_written; i++)
-                        std::cout << std::setfill('0') << std::setw(2) << std::hex << ((unsigned int)buf[i] & 0xff) << ' ';
-                std::cout << std::endl;
+                std::cout << "Write: " << HexCodec::encode((const uint8_t *)buf, bytes_written) << ' ' << std::endl;
+        }
+        
+        return SS_Success;
+}
+
+int SerialInterface::read_receiver(bool &notify)
+{
+        int total = 0;
+        
+        #ifdef __unix__
+        
+        ssize_t num;
+        size_t count;
+        char *ptr;
+        
+        // read until the port is drained
+        do
+        {
+                ptr = receiver->get_receive_space(count);
+                
+                num = ::read(port_fd, ptr, count);
+                
+                if (num < 0)
+                {
+                        if (errno == EAGAIN || errno == EINTR)
+                                break;
+                        
+                        std::cerr << "Error reading serial port (errno " << errno << ")" << std::endl;
+                        post_event(SE_Error);
+                        return -1;
+                }
+                
+                if (num == 0)
+                {
+                        if (debug)
+                                std::cout << "Read: End of File" << std::endl;
+                        
+                        post_event(SE_Error);
+                        return -1;
+                }
+                
+                if (debug)
+                {
+                        std::cout << "Read: " << HexCodec::encode((const uint8_t *)ptr, num) << ' ' << std::endl;
+                }
+                
+                if (receiver->receive(num))
+                        notify = true;
+                        
+                total += num;
+        }
+        while ((size_t)num == count);
+        
+        #endif
+        
+        return total;
+}
+
+FrameBufferPool::Buffer *SerialInterface::get_write_buffer(size_t size)
+{
+        return tx_pool.acquire(size);
+}
+
+SerialInterface::SerialStatus SerialInterface::queue_write(FrameBufferPool::Buffer *buf)
+{
+        if (!buf)
+                return SS_Error;
+                
+        if (!is_open() || buf->length == 0)
+        {
+                tx_pool.release(buf);
+                return is_open() ? SS_Success : SS_PortNotOpen;
+        }
+        
+        #ifdef __unix__
+        
+        bool wake;
+        
+        {
+                Mutex::Lock lock(tx_mutex);
+                
+                // only the first write since the I/O thread took the queue
+                // needs a wake up
+                wake = tx_queue.empty();
+                tx_queue.push_back(buf);
+                tx_count += buf->length;
+                
+                if (tx_count > tx_max)
+                        tx_max = tx_count;
+                
+                if (tx_count >= tx_limit)
+                        tx_full = true;
+        }
+        
+        if (wake && event_fd >= 0)
+        {
+                uint64_t v = 1;
+                if (::write(event_fd, &v, sizeof(v)) < 0)
+                        std::cerr << "Error signaling eventfd (errno " << errno << ")" << std::endl;
         }
         
         return SS_Success;
+        
+        #elif defined _WIN32
+        
+        const char *ptr = (const char *)&buf->data[0];
+        size_t count = buf->length;
+        size_t num;
+        SerialStatus ret = SS_Success;
+        
+        // no I/O thread writer here, overlapped writes wait for completion
+        while (count > 0)
+        {
+                ret = write(ptr, count, num);
+                
+                if (ret != SS_Success)
+                        break;
+                        
+                ptr += num;
+                count -= num;
+        }
+        
+        tx_pool.release(buf);
+        
+        return ret;
+        
+        #endif
+}
+
+SerialInterface::SerialStatus SerialInterface::queue_write(const char *buf, size_t count)
+{
+        FrameBufferPool::Buffer *b = get_write_buffer(count);
+        
+        if (count > 0)
+                memcpy(&b->data[0], buf, count);
+        b->length = count;
+        
+        return queue_write(b);
+}
+
+size_t SerialInterface::get_queued_write_count()
+{
+        Mutex::Lock lock(tx_mutex);
+        return tx_count;
+}
+
+size_t SerialInterface::get_queued_write_max()
+{
+        Mutex::Lock lock(tx_mutex);
+        return tx_max;
+}
+
+size_t SerialInterface::set_write_limit(size_t l)
+{
+        Mutex::Lock lock(tx_mutex);
+        tx_limit = l > 0 ? l : 1;
+        return tx_limit;
+}
+
+size_t SerialInterface::get_write_limit()
+{
+        Mutex::Lock lock(tx_mutex);
+        return tx_limit;
+}
+
+bool SerialInterface::is_write_blocked()
+{
+        Mutex::Lock lock(tx_mutex);
+        return tx_full;
 }
 
-SerialInterface::SerialStatus SerialInterface::read(char *buf, gsize count, gsize& bytes_read)
+bool SerialInterface::flush_tx()
+{
+        #ifdef __unix__
+        
+        struct iovec iov[SERIAL_TX_IOV_MAX];
+        FrameBufferPool::Buffer *b;
+        size_t n;
+        size_t len;
+        size_t rem;
+        ssize_t num;
+        bool blocked = false;
+        bool space = false;
+        
+        while (true)
+        {
+                if (tx_index >= tx_write.size())
+                {
+                        tx_write.clear();
+                        tx_index = 0;
+                        tx_offset = 0;
+                        
+                        Mutex::Lock lock(tx_mutex);
+                        
+                        if (tx_queue.empty())
+                                break;
+                                
+                        // both vectors keep their storage across swaps
+                        tx_write.swap(tx_queue);
+                }
+                
+                // gather as many queued frames as possible into one write
+                len = 0;
+                for (n = 0; n < SERIAL_TX_IOV_MAX && tx_index + n < tx_write.size(); n++)
+                {
+                        b = tx_write[tx_index + n];
+                        rem = n == 0 ? tx_offset : 0;
+                        iov[n].iov_base = &b->data[rem];
+                        iov[n].iov_len = b->length - rem;
+                        len += iov[n].iov_len;
+                }
+                
+                num = ::writev(port_fd, iov, n);
+                
+                if (num < 0)
+                {
+                        if (errno == EINTR)
+                                continue;
+                                
+                        if (errno == EAGAIN)
+                        {
+                                blocked = true;
+                                break;
+                        }
+                        
+                        std::cerr << "Error writing serial port (errno " << errno << ")" << std::endl;
+                        post_event(SE_Error);
+                        return false;
+                }
+                
+                if (debug && num > 0)
+                {
+                        std::cout << "Write: ";
+                        rem = num;
+                        for (size_t i = 0; i < n && rem > 0; i++)
+                        {
+                                size_t chunk = std::min<size_t>(iov[i].iov_len, rem);
+                                
+                                std::cout << HexCodec::encode((const uint8_t *)iov[i].iov_base, chunk) << ' ';
+                                rem -= chunk;
+                        }
+                        std::cout << std::endl;
+                }
+                
+                // retire what was written
+                rem = num;
+                while (rem > 0)
+                {
+                        b = tx_write[tx_index];
+                        
+                        if (rem < b->length - tx_offset)
+                        {
+                                tx_offset += rem;
+                                break;
+                        }
+                        
+                        rem -= b->length - tx_offset;
+                        tx_pool.release(b);
+                        tx_index++;
+                        tx_offset = 0;
+                }
+                
+                {
+                        Mutex::Lock lock(tx_mutex);
+                        
+                        tx_count -= num;
+                        
+                        // let producers back in once half the limit drained
+                        if (tx_full && tx_count <= tx_limit / 2)
+                        {
+                                tx_full = false;
+                                space = true;
+                        }
+                }
+                
+                // short write, port is full (or flow controlled)
+                if ((size_t)num < len)
+                {
+                        blocked = true;
+                        break;
+                }
+        }
+        
+        if (space)
+                post_event(SE_WriteSpace);
+                
+        // wait for the port to take more instead of retrying
+        if (blocked != (Thread::atomic_get(&tx_wait_out) != 0))
+        {
+                Thread::atomic_set(&tx_wait_out, blocked);
+                arm_port();
+        }
+        
+        #endif
+        
+        return true;
+}
+
+SerialInterface::SerialStatus SerialInterface::read(char *buf, size_t count, size_t& bytes_read)
 {
         #ifdef __WIN32
         DWORD d;
@@ -509,10 +983,7 @@ SerialInterface::SerialStatus SerialInterface::read(char *buf, gsize count, gsiz
         
         if (debug && bytes_read > 0)
         {
-                std::cout << "Read: ";
-                for (gsize i = 0; i < bytes_read; i++)
-                        std::cout << std::setfill('0') << std::setw(2) << std::hex << ((unsigned int)buf[i] & 0xff) << ' ';
-                std::cout << std::endl;
+                std::cout << "Read: " << HexCodec::encode((const uint8_t *)buf, bytes_read) << ' ' << std::endl;
         }
         
         #ifdef __unix__
@@ -568,6 +1039,12 @@ SerialInterface::SerialStatus SerialInterface::open_port()
         tcgetattr(port_fd, &port_termios);
         memcpy(&port_termios_saved, &port_termios, sizeof(struct termios));
         
+        {
+                // not every driver has serial info, e.g. pseudo terminals
+                struct serial_struct serinfo;
+                port_serial_flags_saved = ::ioctl(port_fd, TIOCGSERIAL, &serinfo) == 0 ? serinfo.flags : -1;
+        }
+        
         configure_port();
         
         tcflush(port_fd, TCOFLUSH);  
@@ -633,13 +1110,18 @@ SerialInterface::SerialStatus SerialInterface::open_port()
         
         #endif
         
-        launch_select_thread();
-        
         if (debug)
                 std::cout << "Port opened." << std::endl;
         
+        // handlers run before the I/O thread starts delivering data
         m_port_opened.emit();
         
+        if (launch_io_thread() != SS_Success)
+        {
+                close_port();
+                return SS_Error;
+        }
+        
         return SS_Success;
 }
 
@@ -655,11 +1137,22 @@ SerialInterface::SerialStatus SerialInterface::close_port()
         
         if (is_open())
         {
-                stop_select_thread();
+                stop_io_thread();
                 
                 #ifdef __unix__
                 
                 tcsetattr(port_fd, TCSANOW, &port_termios_saved);
+                
+                if (low_latency && port_serial_flags_saved >= 0)
+                {
+                        struct serial_struct serinfo;
+                        if (::ioctl(port_fd, TIOCGSERIAL, &serinfo) == 0)
+                        {
+                                serinfo.flags = port_serial_flags_saved;
+                                ::ioctl(port_fd, TIOCSSERIAL, &serinfo);
+                        }
+                }
+                
                 tcflush(port_fd, TCOFLUSH);
                 tcflush(port_fd, TCIFLUSH);
                 close(port_fd);
@@ -693,6 +1186,9 @@ SerialInterface::SerialStatus SerialInterface::configure_port()
         
         #ifdef __unix__
         
+        bool custom_baud = false;
+        struct serial_struct serinfo;
+        
         port_termios.c_cflag = B19200;
         switch (baud)
         {
@@ -726,6 +1222,25 @@ SerialInterface::SerialStatus SerialInterface::configure_port()
                 case 115200:
                         port_termios.c_cflag = B115200;
                         break;
+                #ifdef B230400
+                case 230400:
+                        port_termios.c_cflag = B230400;
+                        break;
+                #endif
+                #ifdef B460800
+                case 460800:
+                        port_termios.c_cflag = B460800;
+                        break;
+                #endif
+                #ifdef B921600
+                case 921600:
+                        port_termios.c_cflag = B921600;
+                        break;
+                #endif
+                default:
+                        // set through termios2 below
+                        custom_baud = true;
+                        break;
         }
         
         switch (bits)
@@ -785,10 +1300,41 @@ SerialInterface::SerialStatus SerialInterface::configure_port()
         
         port_termios.c_oflag = 0;
         port_termios.c_lflag = 0;
+        // VMIN sets how many bytes it takes to wake the I/O thread; VTIME
+        // would make the port readable after one byte, so the I/O thread
+        // times out short reads itself
         port_termios.c_cc[VTIME] = 0;
-        port_termios.c_cc[VMIN] = 1;
+        port_termios.c_cc[VMIN] = read_min;
         tcsetattr(port_fd, TCSANOW, &port_termios);
         
+        if (custom_baud)
+        {
+                int err;
+                
+                if (!SerialBaud::is_supported())
+                        std::cerr << "Baud rate " << baud << " not supported, using 19200" << std::endl;
+                else if ((err = SerialBaud::set_custom(port_fd, baud)) != 0)
+                        std::cerr << "Error setting baud rate " << baud << " (errno " << err << ")" << std::endl;
+        }
+        
+        // low latency only ever adds to the driver's own setting
+        if (port_serial_flags_saved >= 0 && ::ioctl(port_fd, TIOCGSERIAL, &serinfo) == 0)
+        {
+                int flags = low_latency ? port_serial_flags_saved | ASYNC_LOW_LATENCY : port_serial_flags_saved;
+                
+                if (serinfo.flags != flags)
+                {
+                        serinfo.flags = flags;
+                        
+                        if (::ioctl(port_fd, TIOCSSERIAL, &serinfo) < 0)
+                                std::cerr << "Error setting low latency mode (errno " << errno << ")" << std::endl;
+                }
+        }
+        else if (low_latency && debug)
+        {
+                std::cout << "Low latency mode not supported by " << port << std::endl;
+        }
+        
         #elif defined _WIN32
         
         dcb_serial_params.BaudRate = CBR_19200;
@@ -824,6 +1370,10 @@ SerialInterface::SerialStatus SerialInterface::configure_port()
                 case 115200:
                         dcb_serial_params.BaudRate = CBR_115200;
                         break;
+                default:
+                        // the driver takes any rate it supports
+                        dcb_serial_params.BaudRate = baud;
+                        break;
         }
         
         dcb_serial_params.ByteSize = bits;
@@ -889,7 +1439,7 @@ SerialInterface::SerialStatus SerialInterface::configure_port()
         return SS_Success;
 }
 
-Glib::ustring SerialInterface::set_port(Glib::ustring p)
+std::string SerialInterface::set_port(std::string p)
 {
         if (!is_open())
                 port = p;
@@ -897,7 +1447,7 @@ Glib::ustring SerialInterface::set_port(Glib::ustring p)
         return port;
 }
 
-Glib::ustring SerialInterface::get_port()
+std::string SerialInterface::get_port()
 {
         return port;
 }
@@ -946,6 +1496,11 @@ SerialInterface::SerialFlow SerialInterface::get_flow()
         return flow;
 }
 
+bool SerialInterface::has_software_flow()
+{
+        return flow == SF_XonXoff;
+}
+
 SerialInterface::SerialParity SerialInterface::set_parity(SerialParity p)
 {
         if (p >= 0 && p <= 2)
@@ -976,6 +1531,48 @@ int SerialInterface::get_stop()
         return stop;
 }
 
+bool SerialInterface::set_low_latency(bool l)
+{
+        low_latency = l;
+        
+        configure_port();
+        
+        return low_latency;
+}
+
+bool SerialInterface::get_low_latency()
+{
+        return low_latency;
+}
+
+int SerialInterface::set_read_min(int m)
+{
+        if (m >= 1 && m <= 255)
+                read_min = m;
+        
+        configure_port();
+        
+        return read_min;
+}
+
+int SerialInterface::get_read_min()
+{
+        return read_min;
+}
+
+int SerialInterface::set_read_timeout(int t)
+{
+        if (t >= 1)
+                read_timeout = t;
+        
+        return read_timeout;
+}
+
+int SerialInterface::get_read_timeout()
+{
+        return read_timeout;
+}
+
 bool SerialInterface::set_debug(bool d)
 {
         debug = d;
@@ -987,47 +1584,94 @@ bool SerialInterface::get_debug()
         return debug;
 }
 
-Glib::ustring SerialInterface::get_status_string()
+TransportReceiver *SerialInterface::set_receiver(TransportReceiver *r)
+{
+        if (!is_open())
+                receiver = r;
+                
+        return receiver;
+}
+
+TransportReceiver *SerialInterface::get_receiver()
+{
+        return receiver;
+}
+
+std::tr1::shared_ptr<Notifier> SerialInterface::set_notifier(std::tr1::shared_ptr<Notifier> n)
 {
-        Glib::ustring str;
+        if (is_open())
+                return notifier;
+                
+        c_notify.disconnect();
+        notifier = n;
+        
+        if (notifier)
+                c_notify = notifier->signal_notify().connect( sigc::mem_fun(*this, &SerialInterface::on_notify) );
+                
+        return notifier;
+}
+
+std::tr1::shared_ptr<Notifier> SerialInterface::get_notifier()
+{
+        return notifier;
+}
+
+std::tr1::shared_ptr<SerialIoLoop> SerialInterface::set_io_loop(std::tr1::shared_ptr<SerialIoLoop> l)
+{
+        if (!is_open())
+                io_loop = l;
+                
+        return io_loop;
+}
+
+std::tr1::shared_ptr<SerialIoLoop> SerialInterface::get_io_loop()
+{
+        return io_loop;
+}
+
+std::string SerialInterface::get_status_string()
+{
+        std::stringstream str;
         
         if (is_open())
         {
-                str = port + ": ";
-                str += Glib::ustring::format(baud) + " ";
-                str += Glib::ustring::format(bits) + "-";
+                str << port << ": ";
+                str << baud << " ";
+                str << bits << "-";
                 switch (parity)
                 {
                         case SP_None:
-                                str += "N-";
+                                str << "N-";
                                 break;
                         case SP_Even:
-                                str += "E-";
+                                str << "E-";
                                 break;
                         case SP_Odd:
-                                str += "O-";
+                                str << "O-";
                                 break;
                 }
-                str += Glib::ustring::format(stop) + " FLOW:";
+                str << stop << " FLOW:";
                 switch (flow)
                 {
                         case SF_None:
-                                str += "NONE";
+                                str << "NONE";
                                 break;
                         case SF_Hardware:
-                                str += "HW";
+                                str << "HW";
                                 break;
                         case SF_XonXoff:
-                                str += "SW";
+                                str << "SW";
                                 break;
                 }
+                if (low_latency)
+                        str << " LOWLAT";
         }
         else
         {
-                str = "Not connected";
+                str << "Not connected";
         }
         
-        return str;
+        return str.str();
 }
 
 bool SerialInterface::is_open()
@@ -1042,28 +1686,3 @@ bool SerialInterface::is_open()
         
         #endif
 }
-
-sigc::signal<void> SerialInterface::port_opened()
-{
-        return m_port_opened;
-}
-
-sigc::signal<void> SerialInterface::port_closed()
-{
-        return m_port_closed;
-}
-
-sigc::signal<void> SerialInterface::port_error()
-{
-        return m_port_error;
-}
-
-sigc::signal<void> SerialInterface::port_receive_data()
-{
-        return m_port_receive_data;
-}
-
-
-
-
-
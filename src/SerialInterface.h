@@ -36,7 +36,16 @@
 
 #include <string>
 #include <vector>
-#include <gtkmm.h>
+#include <tr1/memory>
+#include <stddef.h>
+#include <sigc++/sigc++.h>
+
+#include "Mutex.h"
+#include "Thread.h"
+#include "Notifier.h"
+#include "FrameBufferPool.h"
+#include "SerialIoLoop.h"
+#include "Transport.h"
 
 #ifdef __unix__
 #include <termios.h>
@@ -47,22 +56,19 @@
 /** Serial Interface
  * 
  * Cross-platform serial interface module.  Tested on windows and linux.  
+ * Signals are emitted on the main loop woken by the notifier, which must be
+ * set before the port is opened.  Without a receiver, data is read on the
+ * main loop with read().  
+ * @see set_notifier()
+ * @see set_io_loop()
  */
-class SerialInterface
+class SerialInterface : public Transport
 {
 public:
         /**
          * Port status.
          */
-        typedef enum
-        {
-                SS_Success = 0,
-                SS_Error = 1,
-                SS_Timeout = 2,
-                SS_EOF = 3,
-                SS_PortNotOpen = 4,
-        }
-        SerialStatus;
+        typedef TransportStatus SerialStatus;
         
         /**
          * Flow control.
@@ -93,13 +99,85 @@ public:
         virtual ~SerialInterface();
         
         /**
-         * Write data.
+         * Write data.  Does not wait; if the port cannot take any more,
+         * bytes_written is 0 and the status is still SS_Success.
          * @param buf pointer to data
          * @param count number of bytes to send
          * @param bytes_written return number of bytes written
          * @return status
          */
-        SerialStatus write(const char *buf, gsize count, gsize& bytes_written);
+        SerialStatus write(const char *buf, size_t count, size_t& bytes_written);
+        
+        /**
+         * Get a buffer to queue.  Fill in data and length, then pass it to
+         * queue_write().
+         * @param size minimum size
+         * @return buffer
+         * @see queue_write()
+         */
+        virtual FrameBufferPool::Buffer *get_write_buffer(size_t size);
+        
+        /**
+         * Queue a buffer for transmission.  Returns without waiting for
+         * the port; the I/O thread gathers queued buffers into as few
+         * writes as it can and waits for the port to drain, so hardware or
+         * software flow control only holds data back.  Data still queued
+         * when the port closes is discarded.  Data is always accepted, even
+         * past the write limit.
+         * @param buf buffer from get_write_buffer(), owned by the serial
+         * interface from here on
+         * @return status
+         * @see tx_queue
+         * @see is_write_blocked()
+         */
+        virtual SerialStatus queue_write(FrameBufferPool::Buffer *buf);
+        
+        /**
+         * Queue data for transmission.  Copies the data into a buffer.
+         * @param buf pointer to data
+         * @param count number of bytes to send
+         * @return status
+         * @see queue_write(FrameBufferPool::Buffer*)
+         */
+        virtual SerialStatus queue_write(const char *buf, size_t count);
+        
+        /**
+         * Get number of bytes queued and not yet written.
+         * @return bytes
+         * @see queue_write()
+         */
+        virtual size_t get_queued_write_count();
+        
+        /**
+         * Get the most bytes that have been queued at once.
+         * @return bytes
+         * @see get_queued_write_count()
+         */
+        virtual size_t get_queued_write_max();
+        
+        /**
+         * Set write limit.  Once this many bytes are queued the port is
+         * write blocked until half of them have been written.
+         * @param l limit in bytes
+         * @return limit
+         * @see is_write_blocked()
+         */
+        virtual size_t set_write_limit(size_t l);
+        
+        /**
+         * Get write limit.
+         * @return limit in bytes
+         * @see set_write_limit()
+         */
+        virtual size_t get_write_limit();
+        
+        /**
+         * Check write blocked.  Producers that can wait should hold data
+         * back while this is true and resume on port_write_space.
+         * @return true if the write limit was reached
+         * @see port_write_space()
+         */
+        virtual bool is_write_blocked();
         
         /**
          * Read data.
@@ -108,41 +186,42 @@ public:
          * @param bytes_read return number of bytes read
          * @return status
          */
-        SerialStatus read(char *buf, gsize count, gsize& bytes_read);
+        SerialStatus read(char *buf, size_t count, size_t& bytes_read);
         
         /**
          * Open port.
          * @return status
          */
-        SerialStatus open_port();
+        virtual SerialStatus open_port();
         
         /**
          * Close port.
          * @return status
          */
-        SerialStatus close_port();
+        virtual SerialStatus close_port();
         
         /**
          * Check port open.
          * @return true if open
          */
-        bool is_open();
+        virtual bool is_open();
         
         /**
          * Set serial port.
          * @param p port
          * @return port
          */
-        Glib::ustring set_port(Glib::ustring p);
+        virtual std::string set_port(std::string p);
         
         /**
          * Get serial port.
          * @return port
          */
-        Glib::ustring get_port();
+        virtual std::string get_port();
         
         /**
-         * Set baud rate.
+         * Set baud rate.  Rates without a standard constant are set
+         * through termios2 (BOTHER) on Linux.
          * @param b baud rate
          * @return baud rate
          */
@@ -180,6 +259,12 @@ public:
          */
         SerialFlow get_flow();
         
+        /**
+         * Check software flow control.
+         * @return true if flow control is XON/XOFF
+         */
+        virtual bool has_software_flow();
+        
         /**
          * Set parity.
          * @param p parity
@@ -206,100 +291,306 @@ public:
          */
         int get_stop();
         
+        /**
+         * Set low latency mode.  Sets ASYNC_LOW_LATENCY on the port, which
+         * for FTDI adapters drops the latency timer from 16 ms to 1 ms at
+         * the cost of more interrupts.  The driver setting is restored when
+         * the port closes.  Ignored by drivers without serial info.
+         * @param l low latency mode
+         * @return low latency mode
+         */
+        bool set_low_latency(bool l);
+        
+        /**
+         * Get low latency mode.
+         * @return low latency mode
+         * @see set_low_latency()
+         */
+        bool get_low_latency();
+        
+        /**
+         * Set read minimum (VMIN).  The I/O thread is woken once this many
+         * bytes have arrived, or after the read timeout for anything less.
+         * Larger values mean fewer wake ups and more latency.
+         * @param m bytes, 1 to 255
+         * @return read minimum
+         * @see set_read_timeout()
+         */
+        int set_read_min(int m);
+        
+        /**
+         * Get read minimum.
+         * @return read minimum
+         * @see set_read_min()
+         */
+        int get_read_min();
+        
+        /**
+         * Set read timeout.  Time the I/O thread waits for the rest of a
+         * frame, or for the read minimum, before passing on what it has.
+         * @param t timeout in ms
+         * @return read timeout
+         * @see set_read_min()
+         */
+        int set_read_timeout(int t);
+        
+        /**
+         * Get read timeout.
+         * @return read timeout in ms
+         * @see set_read_timeout()
+         */
+        int get_read_timeout();
+        
         /**
          * Set debug mode.  If debug mode is enabled, all bytes read and
          * written are printed in hex to stdout.
          * @param d debug mode
          * @return debug mode
          */
-        bool set_debug(bool d);
+        virtual bool set_debug(bool d);
         
         /**
          * Get debug mode.  If debug mode is enabled, all bytes read and
          * written are printed in hex to stdout.
          * @return debug mode
          */
-        bool get_debug();
+        virtual bool get_debug();
+        
+        /**
+         * Set receiver.  If a receiver is set, the I/O thread reads data
+         * directly into it and port_receive_data is only emitted when the
+         * receiver asks for it.  If no receiver is set, port_receive_data is
+         * emitted whenever data is available and data must be read with
+         * read().  Must not be changed while the port is open.
+         * @param r receiver, or 0 for none
+         * @return receiver
+         */
+        virtual TransportReceiver *set_receiver(TransportReceiver *r);
+        
+        /**
+         * Get receiver.
+         * @return receiver
+         * @see set_receiver()
+         */
+        virtual TransportReceiver *get_receiver();
+        
+        /**
+         * Set notifier.  The I/O thread wakes the main loop through the
+         * notifier, and all signals are emitted from its notify signal.
+         * Must not be changed while the port is open.
+         * @param n notifier
+         * @return notifier
+         */
+        virtual std::tr1::shared_ptr<Notifier> set_notifier(std::tr1::shared_ptr<Notifier> n);
+        
+        /**
+         * Get notifier.
+         * @return notifier
+         * @see set_notifier()
+         */
+        virtual std::tr1::shared_ptr<Notifier> get_notifier();
+        
+        /**
+         * Set I/O loop.  Ports sharing a loop are all served by its single
+         * thread.  If no loop is set when the port is opened, the port gets
+         * a loop of its own.  Must not be changed while the port is open.
+         * Ignored on Windows, where every port runs its own thread.  
+         * @param l I/O loop
+         * @return I/O loop
+         */
+        virtual std::tr1::shared_ptr<SerialIoLoop> set_io_loop(std::tr1::shared_ptr<SerialIoLoop> l);
+        
+        /**
+         * Get I/O loop.
+         * @return I/O loop
+         * @see set_io_loop()
+         */
+        virtual std::tr1::shared_ptr<SerialIoLoop> get_io_loop();
         
         /**
          * Get status string.  Returns a short representation of the
          * connection configuration.  
          * @return status string
          */
-        Glib::ustring get_status_string();
+        virtual std::string get_status_string();
         
         /**
          * Enumerate serial ports.  Returns a vector of strings with the
-         * names of likely usable ports.
+         * names of likely usable ports.  Scans every time; keep a
+         * PortRegistry to scan once and follow hotplug events.
          * @return list of ports
+         * @see PortRegistry
          */
         static std::vector<std::string> enumerate_ports();
         
+protected:
         /**
-         * Port opened signal.  
-         * @par Prototype:
-         * <tt>void on_my_%port_opened()</tt>
+         * I/O thread events.
+         * @see pending_events
          */
-        sigc::signal<void> port_opened();
+        typedef enum
+        {
+                SE_ReceiveData = 1,
+                SE_Error = 2,
+                SE_WriteSpace = 4,
+        }
+        SerialEvent;
         
         /**
-         * Port closed signal.  
-         * @par Prototype:
-         * <tt>void on_my_%port_closed()</tt>
+         * Notifier event handler.  Dispatches pending events on the main
+         * loop.
+         * @see post_event()
          */
-        sigc::signal<void> port_closed();
+        void on_notify();
         
         /**
-         * Port error signal.  
-         * @par Prototype:
-         * <tt>void on_my_%port_error()</tt>
+         * I/O thread receive data event.  
+         * @see io_thread()
          */
-        sigc::signal<void> port_error();
+        void on_receive_data();
         
         /**
-         * Port receive_data signal.  
-         * @par Prototype:
-         * <tt>void on_my_%port_receive_data()</tt>
+         * I/O thread write space event.  
+         * @see flush_tx()
          */
-        sigc::signal<void> port_receive_data();
+        void on_write_space();
         
-protected:
         /**
-         * Select thread receive data event.  
-         * @see select_thread()
+         * I/O thread error event.  
+         * @see io_thread()
          */
-        void on_receive_data();
+        void on_error();
+        
+        #ifdef __unix__
         
         /**
-         * Select thread error event.  
-         * @see select_thread()
+         * Get the port descriptor.
+         * @return port_fd
          */
-        void on_error();
+        virtual int get_io_fd();
+        
+        /**
+         * Get the eventfd that wakes the I/O loop.
+         * @return event_fd
+         */
+        virtual int get_wake_fd();
+        
+        /**
+         * Get the port events to poll for when the port is added.  Without
+         * a receiver the main loop reads, so the port is polled once and
+         * re-armed by on_receive_data().
+         * @return epoll event bits
+         */
+        virtual uint32_t get_io_events();
+        
+        /**
+         * Reset I/O state when the I/O loop starts polling the port.  Called
+         * by the I/O loop.
+         * @see SerialIoLoop::add_port()
+         */
+        virtual void io_start();
+        
+        /**
+         * Handle an event for the port.  Called by the I/O loop.  Reads the
+         * port into the receiver, if one is set, and writes queued data.  
+         * @param source SerialIoLoop::SerialIoSource
+         * @param events epoll event bits
+         * @return false on error, the loop stops polling the port
+         * @see post_event()
+         * @see on_receive_data()
+         * @see on_error()
+         */
+        virtual bool io_event(int source, uint32_t events);
+        
+        /**
+         * Handle the I/O timer.  Called by the I/O loop once io_deadline
+         * has passed.  Delivers data held back by the receiver and reads
+         * tails shorter than the read minimum.
+         * @return false on error, the loop stops polling the port
+         * @see io_deadline
+         */
+        virtual bool io_timer();
+        
+        /**
+         * Post an error event after an I/O loop failure.
+         */
+        virtual void io_fail();
+        
+        /**
+         * Set io_deadline after handling an event or timer.
+         */
+        void update_io_deadline();
+        
+        #elif defined _WIN32
         
         /**
-         * Select thread for monitoring serial port.
-         * @see launch_select_thread()
-         * @see stop_select_thread()
-         * @see signal_receive_data
-         * @see signal_error
+         * I/O thread for monitoring serial port.  Waits for data with no
+         * timeout and reads it into the receiver, if one is set.
+         * @see launch_io_thread()
+         * @see stop_io_thread()
+         * @see post_event()
          * @see on_receive_data()
          * @see on_error()
          */
-        void select_thread();
+        void io_thread();
+        
+        #endif
+        
+        /**
+         * Start I/O thread.  On unix, adds the port to the I/O loop.
+         * @return status
+         * @see set_io_loop()
+         * @see stop_io_thread()
+         */
+        SerialStatus launch_io_thread();
+        
+        /**
+         * Stop I/O thread.  On unix, removes the port from the I/O loop.
+         * @see set_io_loop()
+         * @see launch_io_thread()
+         */
+        void stop_io_thread();
         
         /**
-         * Start select thread.  
-         * @see select_thread()
-         * @see stop_select_thread()
+         * Post an event to the main loop.  Wakes the main loop through the
+         * notifier, unless a wake up is already pending.  Called from the
+         * I/O thread.
+         * @param event SerialEvent bits
+         * @see pending_events
          */
-        void launch_select_thread();
+        void post_event(int event);
         
         /**
-         * Stop select thread.
-         * @see select_thread()
-         * @see launch_select_thread()
+         * Post a receive data event.  Called from the I/O thread.
+         * @see post_event()
          */
-        void stop_select_thread();
+        void notify_receive_data();
+        
+        /**
+         * Read from the port into the receiver until the port is drained.
+         * Called from the I/O thread.
+         * @param notify set if the receiver asks for the main loop to be
+         * notified
+         * @return bytes read, or -1 on error
+         * @see io_event()
+         */
+        int read_receiver(bool &notify);
+        
+        /**
+         * Write queued data.  Called from the I/O thread.  Writes until the
+         * queue is empty or the port stops accepting data, in which case
+         * the port is armed for writing.
+         * @return false on a write error
+         * @see queue_write()
+         */
+        bool flush_tx();
+        
+        /**
+         * Set the port events the I/O loop waits for.  Waits for writing
+         * too while tx_wait_out is set.
+         * @see SerialIoLoop::set_port_events()
+         */
+        void arm_port();
         
         /**
          * Configure serial port.
@@ -307,18 +598,15 @@ protected:
         SerialStatus configure_port();
         
         /**
-         * Receive data signal dispatcher
-         * @see select_thread()
-         * @see on_receive_data()
+         * Notifier used to wake the main loop.
+         * @see set_notifier()
          */
-        Glib::Dispatcher signal_receive_data;
+        std::tr1::shared_ptr<Notifier> notifier;
         
         /**
-         * Error signal dispatcher
-         * @see select_thread()
-         * @see on_error()
+         * Notifier signal connection.
          */
-        Glib::Dispatcher signal_error;
+        sigc::connection c_notify;
         
         #ifdef __unix__
         
@@ -326,6 +614,24 @@ protected:
         struct termios port_termios;
         struct termios port_termios_saved;
         
+        /**
+         * Serial info flags when the port was opened, -1 if not supported
+         * @see set_low_latency()
+         */
+        int port_serial_flags_saved;
+        
+        /**
+         * eventfd used to wake the I/O loop for queued data
+         * @see queue_write()
+         */
+        int event_fd;
+        
+        /**
+         * Data read into the receiver is waiting to be delivered
+         * @see io_timer()
+         */
+        bool io_deferred;
+        
         #elif defined _WIN32
         
         HANDLE h_port;
@@ -338,40 +644,131 @@ protected:
         
         /**
          * Running mutex
-         * @see select_thread()
+         * @see io_thread()
          */
-        Glib::Mutex running_mutex;
+        Mutex running_mutex;
+        
+        #ifdef _WIN32
         
         /**
-         * Read mutex
+         * Read mutex, used when no receiver is set
          * @see read_cond
-         * @see select_thread()
+         * @see io_thread()
          */
-        Glib::Mutex read_mutex;
+        Mutex read_mutex;
         
         /**
-         * Read condition
+         * Read condition, used when no receiver is set
          * @see read_mutex
-         * @see select_thread()
+         * @see io_thread()
+         */
+        Cond read_cond;
+        
+        #endif
+        
+        /**
+         * Transmit buffer pool.
+         * @see get_write_buffer()
+         */
+        FrameBufferPool tx_pool;
+        
+        /**
+         * Transmit mutex.  Protects tx_queue, tx_count, tx_limit and
+         * tx_full.
+         */
+        Mutex tx_mutex;
+        
+        /**
+         * Buffers queued for transmission.
+         * @see tx_mutex
+         * @see queue_write()
+         */
+        std::vector<FrameBufferPool::Buffer *> tx_queue;
+        
+        /**
+         * Buffers being written by the I/O thread.  Swapped with tx_queue
+         * so that writers are not held up by a slow port.
+         * @see tx_index
+         */
+        std::vector<FrameBufferPool::Buffer *> tx_write;
+        
+        /**
+         * Index of the first buffer in tx_write not completely written.
+         * @see tx_offset
+         */
+        size_t tx_index;
+        
+        /**
+         * Bytes of tx_write[tx_index] already written.
+         */
+        size_t tx_offset;
+        
+        /**
+         * Bytes queued and not yet written.
+         * @see tx_mutex
+         */
+        size_t tx_count;
+        
+        /**
+         * Most bytes queued at once.
+         * @see tx_mutex
          */
-        Glib::Cond read_cond;
+        size_t tx_max;
         
         /**
-         * Pointer for select thread
-         * @see select_thread()
+         * Write limit.
+         * @see set_write_limit()
          */
-        Glib::Thread *thread;
+        size_t tx_limit;
+        
+        /**
+         * Write limit reached.
+         * @see is_write_blocked()
+         */
+        bool tx_full;
+        
+        /**
+         * Port is full and the I/O thread waits for it to take more data,
+         * accessed atomically.
+         * @see arm_port()
+         */
+        volatile int tx_wait_out;
+        
+        /**
+         * I/O loop
+         * @see set_io_loop()
+         */
+        std::tr1::shared_ptr<SerialIoLoop> io_loop;
+        
+        /**
+         * Pointer for I/O thread, Windows only
+         * @see io_thread()
+         */
+        Thread *thread;
         
         /**
          * Thread running indicator
-         * @see select_thread()
+         * @see io_thread()
          */
         bool running;
         
+        /**
+         * Receiver
+         * @see set_receiver()
+         */
+        TransportReceiver *receiver;
+        
+        /**
+         * Pending SerialEvent bits, accessed atomically.  Set by the I/O
+         * thread and cleared by on_notify(), so bursts of reads cost a
+         * single wake up.
+         */
+        volatile int pending_events;
+        
         /**
          * Port.
          */
-        Glib::ustring port;
+        std::string port;
         
         /**
          * Baud rate.
@@ -411,29 +808,24 @@ protected:
         bool called_close_port;
         
         /**
-         * Debug status.
+         * Low latency mode.
          */
-        bool debug;
+        bool low_latency;
         
         /**
-         * Port opened signal.
+         * Read minimum in bytes.
          */
-        sigc::signal<void> m_port_opened;
+        int read_min;
         
         /**
-         * Port closed signal.
+         * Read timeout in ms.
          */
-        sigc::signal<void> m_port_closed;
+        int read_timeout;
         
         /**
-         * Port error signal.
-         */
-        sigc::signal<void> m_port_error;
-        
-        /**
-         * Port receive data signal.
+         * Debug status.
          */
-        sigc::signal<void> m_port_receive_data;
+        bool debug;
 };
 
 #endif //__SERIALINTERFACE_H
@@ -0,0 +1,384 @@
+/************************************************************************/
+/* SerialIoLoop                                                         */
+/*                                                                      */
+/* ZigBee Terminal - Serial I/O Loop                                    */
+/*                                                                      */
+/* SerialIoLoop.cpp                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "SerialIoLoop.h"
+#include "Transport.h"
+
+#ifdef __unix__
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#elif defined _WIN32
+
+#include <windows.h>
+
+#endif
+
+#include <iostream>
+#include <string.h>
+#include <time.h>
+
+// epoll events handled per wake up
+#define SERIAL_IO_MAX_EVENTS 32
+
+// key of the stop eventfd, registration IDs start at 1
+#define SERIAL_IO_STOP_KEY 0
+
+SerialIoLoop::SerialIoLoop() :
+        next_id(1),
+        epoll_fd(-1),
+        stop_fd(-1),
+        thread(0),
+        running(false)
+{
+        #ifdef __unix__
+        
+        struct epoll_event ev;
+        
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        
+        if (epoll_fd < 0 || stop_fd < 0)
+        {
+                std::cerr << "[SerialIoLoop] Error creating epoll instance (errno " << errno << ")" << std::endl;
+                return;
+        }
+        
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u64 = SERIAL_IO_STOP_KEY;
+        
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &ev) < 0)
+                std::cerr << "[SerialIoLoop] Error adding eventfd to epoll (errno " << errno << ")" << std::endl;
+        
+        #endif
+}
+
+
+SerialIoLoop::~SerialIoLoop()
+{
+        // ports keep a reference, so none can be left here
+        #ifdef __unix__
+        
+        if (epoll_fd >= 0)
+                ::close(epoll_fd);
+        if (stop_fd >= 0)
+                ::close(stop_fd);
+        
+        #endif
+}
+
+
+bool SerialIoLoop::add_port(Transport *transport)
+{
+        #ifdef __unix__
+        
+        struct epoll_event ev;
+        Port p;
+        
+        if (epoll_fd < 0)
+                return false;
+                
+        Mutex::Lock lock(mutex);
+        
+        p.id = next_id++;
+        p.transport = transport;
+        transport->io_id = p.id;
+        transport->io_start();
+        
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u64 = make_key(p.id, SIO_Wake);
+        
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, transport->get_wake_fd(), &ev) < 0)
+        {
+                std::cerr << "[SerialIoLoop] Error adding eventfd to epoll (errno " << errno << ")" << std::endl;
+                return false;
+        }
+        
+        ev.events = transport->get_io_events();
+        ev.data.u64 = make_key(p.id, SIO_Port);
+        
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, transport->get_io_fd(), &ev) < 0)
+        {
+                std::cerr << "[SerialIoLoop] Error adding port to epoll (errno " << errno << ")" << std::endl;
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, transport->get_wake_fd(), &ev);
+                return false;
+        }
+        
+        ports.push_back(p);
+        
+        if (!thread)
+        {
+                running = true;
+                thread = Thread::create( sigc::mem_fun(*this, &SerialIoLoop::run) );
+                
+                if (!thread)
+                {
+                        running = false;
+                        ports.pop_back();
+                        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, transport->get_io_fd(), &ev);
+                        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, transport->get_wake_fd(), &ev);
+                        return false;
+                }
+        }
+        
+        return true;
+        
+        #else
+        
+        return false;
+        
+        #endif
+}
+
+
+void SerialIoLoop::remove_port(Transport *transport)
+{
+        #ifdef __unix__
+        
+        Thread *t = 0;
+        
+        {
+                // waits for the thread to finish handling events
+                Mutex::Lock lock(mutex);
+                
+                for (size_t i = 0; i < ports.size(); i++)
+                {
+                        if (ports[i].id != transport->io_id)
+                                continue;
+                                
+                        if (ports[i].transport)
+                                fail_port(ports[i]);
+                                
+                        ports.erase(ports.begin() + i);
+                        break;
+                }
+                
+                transport->io_id = 0;
+                
+                if (ports.empty() && thread)
+                {
+                        running = false;
+                        t = thread;
+                        thread = 0;
+                }
+        }
+        
+        if (t)
+        {
+                // wake thread up
+                uint64_t v = 1;
+                if (::write(stop_fd, &v, sizeof(v)) < 0)
+                        std::cerr << "[SerialIoLoop] Error signaling eventfd (errno " << errno << ")" << std::endl;
+                        
+                t->join();
+                
+                // clear the stop signal for the next start
+                if (::read(stop_fd, &v, sizeof(v)) < 0 && errno != EAGAIN)
+                        std::cerr << "[SerialIoLoop] Error reading eventfd (errno " << errno << ")" << std::endl;
+        }
+        
+        #endif
+}
+
+
+void SerialIoLoop::set_port_events(Transport *transport, uint32_t events)
+{
+        #ifdef __unix__
+        
+        struct epoll_event ev;
+        
+        memset(&ev, 0, sizeof(ev));
+        ev.events = events;
+        ev.data.u64 = make_key(transport->io_id, SIO_Port);
+        
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, transport->get_io_fd(), &ev);
+        
+        #endif
+}
+
+
+size_t SerialIoLoop::get_port_count()
+{
+        Mutex::Lock lock(mutex);
+        return ports.size();
+}
+
+
+// Static
+uint64_t SerialIoLoop::get_time()
+{
+        #ifdef __unix__
+        
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+        
+        #elif defined _WIN32
+        
+        return GetTickCount();
+        
+        #endif
+}
+
+
+void SerialIoLoop::run()
+{
+        #ifdef __unix__
+        
+        struct epoll_event evs[SERIAL_IO_MAX_EVENTS];
+        uint64_t now;
+        uint64_t deadline;
+        uint64_t next;
+        int timeout;
+        int n;
+        Port *p;
+        
+        while (true)
+        {
+                // sleep until the earliest port timer, if any
+                {
+                        Mutex::Lock lock(mutex);
+                        
+                        next = 0;
+                        for (size_t i = 0; i < ports.size(); i++)
+                        {
+                                if (!ports[i].transport)
+                                        continue;
+                                        
+                                deadline = ports[i].transport->io_deadline;
+                                if (deadline && (next == 0 || deadline < next))
+                                        next = deadline;
+                        }
+                }
+                
+                now = get_time();
+                timeout = next == 0 ? -1 : next > now ? (int)(next - now) : 0;
+                
+                n = epoll_wait(epoll_fd, evs, SERIAL_IO_MAX_EVENTS, timeout);
+                
+                Mutex::Lock lock(mutex);
+                
+                if (!running)
+                        break;
+                        
+                if (n < 0)
+                {
+                        if (errno == EINTR)
+                                continue;
+                                
+                        std::cerr << "[SerialIoLoop] Error: epoll_wait failed!" << std::endl;
+                        
+                        for (size_t i = 0; i < ports.size(); i++)
+                        {
+                                if (ports[i].transport)
+                                {
+                                        ports[i].transport->io_fail();
+                                        fail_port(ports[i]);
+                                }
+                        }
+                        continue;
+                }
+                
+                for (int i = 0; i < n; i++)
+                {
+                        if (evs[i].data.u64 == SERIAL_IO_STOP_KEY)
+                                continue;
+                                
+                        // events for removed ports may still be in the batch
+                        p = find_port(evs[i].data.u64 >> 1);
+                        
+                        if (!p || !p->transport)
+                                continue;
+                                
+                        if (!p->transport->io_event(evs[i].data.u64 & 1, evs[i].events))
+                                fail_port(*p);
+                }
+                
+                now = get_time();
+                
+                for (size_t i = 0; i < ports.size(); i++)
+                {
+                        if (!ports[i].transport)
+                                continue;
+                                
+                        deadline = ports[i].transport->io_deadline;
+                        
+                        if (deadline && deadline <= now && !ports[i].transport->io_timer())
+                                fail_port(ports[i]);
+                }
+        }
+        
+        #endif
+}
+
+
+void SerialIoLoop::fail_port(Port &p)
+{
+        #ifdef __unix__
+        
+        struct epoll_event ev;
+        
+        // the port stays listed until it is closed, it is just not polled
+        memset(&ev, 0, sizeof(ev));
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, p.transport->get_io_fd(), &ev);
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, p.transport->get_wake_fd(), &ev);
+        
+        p.transport = 0;
+        
+        #endif
+}
+
+
+SerialIoLoop::Port *SerialIoLoop::find_port(int id)
+{
+        for (size_t i = 0; i < ports.size(); i++)
+        {
+                if (ports[i].id == id)
+                        return &ports[i];
+        }
+        
+        return 0;
+}
+
+
+// Static
+uint64_t SerialIoLoop::make_key(int id, int source)
+{
+        return ((uint64_t)id << 1) | source;
+}
+
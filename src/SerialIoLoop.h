@@ -0,0 +1,184 @@
+/************************************************************************/
+/* SerialIoLoop                                                         */
+/*                                                                      */
+/* ZigBee Terminal - Serial I/O Loop                                    */
+/*                                                                      */
+/* SerialIoLoop.h                                                       */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __SERIAL_IO_LOOP_H
+#define __SERIAL_IO_LOOP_H
+
+#include "Mutex.h"
+#include "Thread.h"
+
+#include <vector>
+#include <stddef.h>
+#include <inttypes.h>
+
+class Transport;
+
+/** Serial I/O Loop
+ * 
+ * I/O thread shared by any number of transports.  One epoll instance waits
+ * on every open port, so a gateway with many radios needs one thread rather
+ * than one per port.  Serial ports and sockets may share a loop.  Each port
+ * keeps its own receiver and transmit queue; the loop only dispatches
+ * readiness and timers to them.  The thread runs while at least one port
+ * is open.  Ports are added and removed by the transports on the main
+ * loop.  Only implemented on unix; on Windows every serial port still runs
+ * its own thread.  
+ * @see Transport::set_io_loop()
+ */
+class SerialIoLoop
+{
+public:
+        /**
+         * Event sources registered for each port.
+         */
+        typedef enum
+        {
+                SIO_Port = 0,
+                SIO_Wake = 1,
+        }
+        SerialIoSource;
+        
+        /**
+         * Create a Serial I/O Loop.
+         */
+        SerialIoLoop();
+        virtual ~SerialIoLoop();
+        
+        /**
+         * Start polling an open port.  Starts the thread if needed.
+         * @param transport transport
+         * @return true if added
+         */
+        bool add_port(Transport *transport);
+        
+        /**
+         * Stop polling a port.  Returns once the loop is no longer using
+         * the port, stopping the thread if this was the last one.
+         * @param transport transport
+         */
+        void remove_port(Transport *transport);
+        
+        /**
+         * Set the epoll events for a port's file descriptor.
+         * @param transport transport
+         * @param events epoll event bits
+         */
+        void set_port_events(Transport *transport, uint32_t events);
+        
+        /**
+         * Get number of ports being polled.
+         * @return ports
+         */
+        size_t get_port_count();
+        
+        /**
+         * Get monotonic time.
+         * @return time in ms
+         */
+        static uint64_t get_time();
+        
+protected:
+        /**
+         * Port being polled.
+         */
+        struct Port
+        {
+                int id;                         ///< Registration ID, part of the epoll key
+                Transport *transport;           ///< Transport, 0 once it failed
+        };
+        
+        /**
+         * Thread function.
+         */
+        void run();
+        
+        /**
+         * Stop polling a port after an error.  Called with mutex held.
+         * @param p port
+         */
+        void fail_port(Port &p);
+        
+        /**
+         * Find a port.  Called with mutex held.
+         * @param id registration ID
+         * @return port, or 0 if not found
+         */
+        Port *find_port(int id);
+        
+        /**
+         * Make an epoll key.
+         * @param id registration ID
+         * @param source SerialIoSource
+         * @return key
+         */
+        static uint64_t make_key(int id, int source);
+        
+        /**
+         * Protects ports and running.  Held by the thread while it handles
+         * events, so remove_port() waits for handlers to finish.
+         */
+        Mutex mutex;
+        
+        /**
+         * Ports being polled.
+         */
+        std::vector<Port> ports;
+        
+        /**
+         * Next registration ID.  IDs are not reused, so stale events for a
+         * removed port are ignored.
+         */
+        int next_id;
+        
+        /**
+         * epoll instance.
+         */
+        int epoll_fd;
+        
+        /**
+         * eventfd used to stop the thread.
+         */
+        int stop_fd;
+        
+        /**
+         * Thread, or 0 when stopped.
+         */
+        Thread *thread;
+        
+        /**
+         * Thread running indicator.
+         */
+        bool running;
+};
+
+#endif //__SERIAL_IO_LOOP_H
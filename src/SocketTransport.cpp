@@ -0,0 +1,903 @@
+/************************************************************************/
+/* SocketTransport                                                      */
+/*                                                                      */
+/* ZigBee Terminal - TCP and UDP Transport                              */
+/*                                                                      */
+/* SocketTransport.cpp                                                  */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "SocketTransport.h"
+#include "Thread.h"
+#include "HexCodec.h"
+
+#ifdef __unix__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#endif
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <string.h>
+
+// queued buffers gathered into one sendmsg() or sendmmsg()
+#define SOCKET_TX_IOV_MAX 64
+
+const int SocketTransport::deliver_delay;
+
+SocketTransport::SocketTransport()
+{
+        type = ST_Tcp;
+        connect_timeout = 3000;
+        sock_fd = -1;
+        event_fd = -1;
+        io_deferred = false;
+        pending_events = 0;
+        receiver = 0;
+        
+        tx_index = 0;
+        tx_offset = 0;
+        tx_count = 0;
+        tx_max = 0;
+        tx_limit = 2048;
+        tx_full = false;
+        tx_wait_out = 0;
+        
+        debug = false;
+}
+
+SocketTransport::~SocketTransport()
+{
+        close_port();
+        c_notify.disconnect();
+}
+
+// Static
+bool SocketTransport::is_address(const std::string &name)
+{
+        return name.compare(0, 6, "tcp://") == 0 || name.compare(0, 6, "udp://") == 0;
+}
+
+// Static
+bool SocketTransport::parse_address(const std::string &addr, SocketType &type, std::string &host, std::string &service)
+{
+        std::string::size_type start = 0;
+        std::string::size_type colon;
+        
+        type = ST_Tcp;
+        
+        if (is_address(addr))
+        {
+                type = addr[0] == 'u' ? ST_Udp : ST_Tcp;
+                start = 6;
+        }
+        
+        if (start < addr.size() && addr[start] == '[')
+        {
+                // IPv6 literal, the port follows the closing bracket
+                std::string::size_type end = addr.find(']', start);
+                
+                if (end == std::string::npos || end + 1 >= addr.size() || addr[end + 1] != ':')
+                        return false;
+                        
+                host = addr.substr(start + 1, end - start - 1);
+                colon = end + 1;
+        }
+        else
+        {
+                colon = addr.rfind(':');
+                
+                if (colon == std::string::npos || colon < start)
+                        return false;
+                        
+                host = addr.substr(start, colon - start);
+        }
+        
+        service = addr.substr(colon + 1);
+        
+        return !host.empty() && !service.empty();
+}
+
+void SocketTransport::on_notify()
+{
+        // clear before handling so events posted from here on wake us again
+        int events = Thread::atomic_exchange(&pending_events, 0);
+        
+        // events from a closed socket are stale
+        if (!is_open())
+                return;
+                
+        if (events & SE_ReceiveData)
+                m_port_receive_data.emit();
+                
+        if ((events & SE_WriteSpace) && is_open())
+                m_port_write_space.emit();
+                
+        if ((events & SE_Error) && is_open())
+        {
+                m_port_error.emit();
+                close_port();
+        }
+}
+
+void SocketTransport::post_event(int event)
+{
+        // only the first event posted since on_notify() needs a wake up
+        if (Thread::atomic_or(&pending_events, event) == 0)
+                notifier->notify();
+}
+
+SocketTransport::TransportStatus SocketTransport::open_port()
+{
+        close_port();
+        
+        if (!notifier || !receiver)
+        {
+                std::cerr << "[SocketTransport] Error: no notifier or receiver set!" << std::endl;
+                return SS_Error;
+        }
+        
+        if (connect_socket() != SS_Success)
+                return SS_Error;
+                
+        if (debug)
+                std::cout << "Port opened." << std::endl;
+                
+        // handlers run before the I/O thread starts delivering data
+        m_port_opened.emit();
+        
+        if (launch_io_thread() != SS_Success)
+        {
+                close_port();
+                return SS_Error;
+        }
+        
+        return SS_Success;
+}
+
+SocketTransport::TransportStatus SocketTransport::connect_socket()
+{
+        #ifdef __unix__
+        
+        struct addrinfo hints;
+        struct addrinfo *res;
+        struct addrinfo *ai;
+        std::string host;
+        std::string service;
+        char name[NI_MAXHOST];
+        char serv[NI_MAXSERV];
+        int err;
+        
+        if (!parse_address(port, type, host, service))
+        {
+                std::cerr << "[SocketTransport] Invalid address " << port << std::endl;
+                return SS_Error;
+        }
+        
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = type == ST_Udp ? SOCK_DGRAM : SOCK_STREAM;
+        
+        err = getaddrinfo(host.c_str(), service.c_str(), &hints, &res);
+        
+        if (err != 0)
+        {
+                std::cerr << "[SocketTransport] Unable to resolve " << port << ": " << gai_strerror(err) << std::endl;
+                return SS_Error;
+        }
+        
+        for (ai = res; ai; ai = ai->ai_next)
+        {
+                sock_fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+                
+                if (sock_fd < 0)
+                        continue;
+                        
+                if (::connect(sock_fd, ai->ai_addr, ai->ai_addrlen) == 0)
+                        break;
+                        
+                if (errno == EINPROGRESS)
+                {
+                        // TCP handshake, wait for it here rather than
+                        // reporting the port open before it is
+                        struct pollfd pfd;
+                        socklen_t len = sizeof(err);
+                        
+                        pfd.fd = sock_fd;
+                        pfd.events = POLLOUT;
+                        pfd.revents = 0;
+                        
+                        if (poll(&pfd, 1, connect_timeout) == 1 &&
+                                getsockopt(sock_fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0)
+                                break;
+                }
+                
+                ::close(sock_fd);
+                sock_fd = -1;
+        }
+        
+        if (ai && getnameinfo(ai->ai_addr, ai->ai_addrlen, name, sizeof(name), serv, sizeof(serv), NI_NUMERICHOST | NI_NUMERICSERV) == 0)
+                peer = ai->ai_family == AF_INET6 ? std::string("[") + name + "]:" + serv : std::string(name) + ":" + serv;
+        else
+                peer = host + ":" + service;
+        
+        freeaddrinfo(res);
+        
+        if (sock_fd < 0)
+        {
+                std::cerr << "[SocketTransport] Unable to connect to " << port << std::endl;
+                return SS_Error;
+        }
+        
+        if (type == ST_Tcp)
+        {
+                // frames are small and latency matters more than packing
+                int one = 1;
+                setsockopt(sock_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        
+        return SS_Success;
+        
+        #else
+        
+        std::cerr << "[SocketTransport] Sockets are only supported on unix" << std::endl;
+        return SS_Error;
+        
+        #endif
+}
+
+SocketTransport::TransportStatus SocketTransport::launch_io_thread()
+{
+        #ifdef __unix__
+        
+        Thread::atomic_set(&pending_events, 0);
+        Thread::atomic_set(&tx_wait_out, 0);
+        
+        event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        
+        if (event_fd < 0)
+        {
+                std::cerr << "[SocketTransport] Error creating eventfd (errno " << errno << ")" << std::endl;
+                return SS_Error;
+        }
+        
+        if (!io_loop)
+                io_loop.reset(new SerialIoLoop());
+                
+        if (!io_loop->add_port(this))
+                return SS_Error;
+                
+        // pick up anything queued by port opened handlers
+        uint64_t v = 1;
+        if (::write(event_fd, &v, sizeof(v)) < 0)
+                std::cerr << "[SocketTransport] Error signaling eventfd (errno " << errno << ")" << std::endl;
+                
+        return SS_Success;
+        
+        #else
+        
+        return SS_Error;
+        
+        #endif
+}
+
+void SocketTransport::stop_io_thread()
+{
+        #ifdef __unix__
+        
+        // returns once the loop is done with the socket
+        if (io_loop && io_id)
+                io_loop->remove_port(this);
+                
+        if (event_fd >= 0)
+                ::close(event_fd);
+        event_fd = -1;
+        
+        #endif
+        
+        // drop anything not written
+        for (size_t i = tx_index; i < tx_write.size(); i++)
+                tx_pool.release(tx_write[i]);
+        tx_write.clear();
+        tx_index = 0;
+        tx_offset = 0;
+        
+        Mutex::Lock lock(tx_mutex);
+        
+        for (size_t i = 0; i < tx_queue.size(); i++)
+                tx_pool.release(tx_queue[i]);
+        tx_queue.clear();
+        tx_count = 0;
+        tx_full = false;
+}
+
+SocketTransport::TransportStatus SocketTransport::close_port()
+{
+        if (!is_open())
+                return SS_Success;
+                
+        stop_io_thread();
+        
+        #ifdef __unix__
+        
+        ::close(sock_fd);
+        
+        #endif
+        
+        sock_fd = -1;
+        
+        if (debug)
+                std::cout << "Port closed." << std::endl;
+                
+        m_port_closed.emit();
+        
+        return SS_Success;
+}
+
+bool SocketTransport::is_open()
+{
+        return sock_fd >= 0;
+}
+
+#ifdef __unix__
+
+int SocketTransport::get_io_fd()
+{
+        return sock_fd;
+}
+
+int SocketTransport::get_wake_fd()
+{
+        return event_fd;
+}
+
+uint32_t SocketTransport::get_io_events()
+{
+        return EPOLLIN;
+}
+
+void SocketTransport::io_start()
+{
+        io_deferred = false;
+        io_deadline = 0;
+}
+
+bool SocketTransport::io_event(int source, uint32_t events)
+{
+        bool notify = false;
+        
+        if (source == SerialIoLoop::SIO_Wake)
+        {
+                // data was queued
+                uint64_t v;
+                if (::read(event_fd, &v, sizeof(v)) < 0 && errno != EAGAIN)
+                        std::cerr << "[SocketTransport] Error reading eventfd (errno " << errno << ")" << std::endl;
+                        
+                return flush_tx();
+        }
+        
+        if (events & EPOLLOUT)
+        {
+                // socket has room again
+                if (!flush_tx())
+                        return false;
+        }
+        
+        // errors and hang ups turn up as EOF or an error when reading
+        if (!(events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+                return true;
+                
+        if (!read_receiver(notify))
+                return false;
+                
+        if (notify)
+                post_event(SE_ReceiveData);
+                
+        io_deferred = !notify && io_deferred;
+        io_deadline = io_deferred ? SerialIoLoop::get_time() + deliver_delay : 0;
+        
+        return true;
+}
+
+bool SocketTransport::io_timer()
+{
+        if (io_deferred)
+                post_event(SE_ReceiveData);
+                
+        io_deferred = false;
+        io_deadline = 0;
+        
+        return true;
+}
+
+void SocketTransport::io_fail()
+{
+        post_event(SE_Error);
+}
+
+#endif
+
+bool SocketTransport::read_receiver(bool &notify)
+{
+        #ifdef __unix__
+        
+        ssize_t num;
+        size_t count;
+        char *ptr;
+        
+        while (true)
+        {
+                ptr = receiver->get_receive_space(count);
+                
+                if (count == 0)
+                {
+                        // receiver is full, it drops data on the next read
+                        notify = true;
+                        break;
+                }
+                
+                // MSG_TRUNC reports the real size of a datagram that did
+                // not fit
+                num = recv(sock_fd, ptr, count, type == ST_Udp ? MSG_TRUNC : 0);
+                
+                if (num < 0)
+                {
+                        if (errno == EINTR)
+                                continue;
+                                
+                        if (errno == EAGAIN)
+                                break;
+                                
+                        // nobody is listening at the bridge yet
+                        if (type == ST_Udp && errno == ECONNREFUSED)
+                                continue;
+                                
+                        std::cerr << "[SocketTransport] Error reading " << port << " (errno " << errno << ")" << std::endl;
+                        post_event(SE_Error);
+                        return false;
+                }
+                
+                if (num == 0 && type == ST_Tcp)
+                {
+                        if (debug)
+                                std::cout << "Read: End of File" << std::endl;
+                                
+                        post_event(SE_Error);
+                        return false;
+                }
+                
+                if ((size_t)num > count)
+                {
+                        std::cerr << "[SocketTransport] Datagram of " << num << " bytes truncated to " << count << std::endl;
+                        num = count;
+                }
+                
+                if (debug && num > 0)
+                        std::cout << "Read: " << HexCodec::encode((const uint8_t *)ptr, num) << ' ' << std::endl;
+                        
+                if (receiver->receive(num))
+                        notify = true;
+                else if (num > 0)
+                        io_deferred = true;
+                        
+                // a short stream read drained the socket
+                if (type == ST_Tcp && (size_t)num < count)
+                        break;
+        }
+        
+        #endif
+        
+        return true;
+}
+
+FrameBufferPool::Buffer *SocketTransport::get_write_buffer(size_t size)
+{
+        return tx_pool.acquire(size);
+}
+
+SocketTransport::TransportStatus SocketTransport::queue_write(FrameBufferPool::Buffer *buf)
+{
+        bool wake;
+        
+        if (!buf)
+                return SS_Error;
+                
+        if (!is_open() || buf->length == 0)
+        {
+                tx_pool.release(buf);
+                return is_open() ? SS_Success : SS_PortNotOpen;
+        }
+        
+        {
+                Mutex::Lock lock(tx_mutex);
+                
+                // only the first write since the I/O thread took the queue
+                // needs a wake up
+                wake = tx_queue.empty();
+                tx_queue.push_back(buf);
+                tx_count += buf->length;
+                
+                if (tx_count > tx_max)
+                        tx_max = tx_count;
+                        
+                if (tx_count >= tx_limit)
+                        tx_full = true;
+        }
+        
+        #ifdef __unix__
+        
+        if (wake && event_fd >= 0)
+        {
+                uint64_t v = 1;
+                if (::write(event_fd, &v, sizeof(v)) < 0)
+                        std::cerr << "[SocketTransport] Error signaling eventfd (errno " << errno << ")" << std::endl;
+        }
+        
+        #endif
+        
+        return SS_Success;
+}
+
+SocketTransport::TransportStatus SocketTransport::queue_write(const char *buf, size_t count)
+{
+        FrameBufferPool::Buffer *b = get_write_buffer(count);
+        
+        if (count > 0)
+                memcpy(&b->data[0], buf, count);
+        b->length = count;
+        
+        return queue_write(b);
+}
+
+size_t SocketTransport::get_queued_write_count()
+{
+        Mutex::Lock lock(tx_mutex);
+        return tx_count;
+}
+
+size_t SocketTransport::get_queued_write_max()
+{
+        Mutex::Lock lock(tx_mutex);
+        return tx_max;
+}
+
+size_t SocketTransport::set_write_limit(size_t l)
+{
+        Mutex::Lock lock(tx_mutex);
+        tx_limit = l > 0 ? l : 1;
+        return tx_limit;
+}
+
+size_t SocketTransport::get_write_limit()
+{
+        Mutex::Lock lock(tx_mutex);
+        return tx_limit;
+}
+
+bool SocketTransport::is_write_blocked()
+{
+        Mutex::Lock lock(tx_mutex);
+        return tx_full;
+}
+
+bool SocketTransport::flush_tx()
+{
+        #ifdef __unix__
+        
+        struct iovec iov[SOCKET_TX_IOV_MAX];
+        struct mmsghdr msgs[SOCKET_TX_IOV_MAX];
+        struct msghdr msg;
+        FrameBufferPool::Buffer *b;
+        size_t n;
+        size_t len;
+        size_t rem;
+        ssize_t num;
+        int sent;
+        bool blocked = false;
+        bool space = false;
+        
+        while (true)
+        {
+                if (tx_index >= tx_write.size())
+                {
+                        tx_write.clear();
+                        tx_index = 0;
+                        tx_offset = 0;
+                        
+                        Mutex::Lock lock(tx_mutex);
+                        
+                        if (tx_queue.empty())
+                                break;
+                                
+                        // both vectors keep their storage across swaps
+                        tx_write.swap(tx_queue);
+                }
+                
+                len = 0;
+                for (n = 0; n < SOCKET_TX_IOV_MAX && tx_index + n < tx_write.size(); n++)
+                {
+                        b = tx_write[tx_index + n];
+                        rem = n == 0 ? tx_offset : 0;
+                        iov[n].iov_base = &b->data[rem];
+                        iov[n].iov_len = b->length - rem;
+                        len += iov[n].iov_len;
+                }
+                
+                if (type == ST_Udp)
+                {
+                        // one datagram per buffer, never split
+                        memset(msgs, 0, n * sizeof(struct mmsghdr));
+                        for (size_t i = 0; i < n; i++)
+                        {
+                                msgs[i].msg_hdr.msg_iov = &iov[i];
+                                msgs[i].msg_hdr.msg_iovlen = 1;
+                        }
+                        
+                        sent = sendmmsg(sock_fd, msgs, n, MSG_NOSIGNAL);
+                        
+                        num = 0;
+                        for (int i = 0; i < sent; i++)
+                                num += iov[i].iov_len;
+                                
+                        if (sent < 0)
+                                num = -1;
+                }
+                else
+                {
+                        memset(&msg, 0, sizeof(msg));
+                        msg.msg_iov = iov;
+                        msg.msg_iovlen = n;
+                        
+                        // a closed peer is an error here, not SIGPIPE
+                        num = sendmsg(sock_fd, &msg, MSG_NOSIGNAL);
+                }
+                
+                if (num < 0)
+                {
+                        if (errno == EINTR)
+                                continue;
+                                
+                        if (errno == EAGAIN)
+                        {
+                                blocked = true;
+                                break;
+                        }
+                        
+                        if (type == ST_Udp && errno == ECONNREFUSED)
+                        {
+                                // the bridge is not up, drop the data like
+                                // a radio out of range
+                                num = len;
+                        }
+                        else
+                        {
+                                std::cerr << "[SocketTransport] Error writing " << port << " (errno " << errno << ")" << std::endl;
+                                post_event(SE_Error);
+                                return false;
+                        }
+                }
+                
+                if (debug && num > 0)
+                {
+                        std::cout << "Write: ";
+                        rem = num;
+                        for (size_t i = 0; i < n && rem > 0; i++)
+                        {
+                                size_t len = std::min<size_t>(iov[i].iov_len, rem);
+                                
+                                std::cout << HexCodec::encode((const uint8_t *)iov[i].iov_base, len) << ' ';
+                                rem -= len;
+                        }
+                        std::cout << std::endl;
+                }
+                
+                if (retire_tx(num))
+                        space = true;
+                        
+                // short write, socket is full
+                if ((size_t)num < len)
+                {
+                        blocked = true;
+                        break;
+                }
+        }
+        
+        if (space)
+                post_event(SE_WriteSpace);
+                
+        // wait for the socket to take more instead of retrying
+        if (blocked != (Thread::atomic_get(&tx_wait_out) != 0))
+        {
+                Thread::atomic_set(&tx_wait_out, blocked);
+                arm_port();
+        }
+        
+        #endif
+        
+        return true;
+}
+
+bool SocketTransport::retire_tx(size_t count)
+{
+        FrameBufferPool::Buffer *b;
+        size_t rem = count;
+        
+        while (rem > 0)
+        {
+                b = tx_write[tx_index];
+                
+                if (rem < b->length - tx_offset)
+                {
+                        tx_offset += rem;
+                        break;
+                }
+                
+                rem -= b->length - tx_offset;
+                tx_pool.release(b);
+                tx_index++;
+                tx_offset = 0;
+        }
+        
+        Mutex::Lock lock(tx_mutex);
+        
+        tx_count -= count;
+        
+        // let producers back in once half the limit drained
+        if (tx_full && tx_count <= tx_limit / 2)
+        {
+                tx_full = false;
+                return true;
+        }
+        
+        return false;
+}
+
+void SocketTransport::arm_port()
+{
+        #ifdef __unix__
+        
+        uint32_t events = get_io_events();
+        
+        if (Thread::atomic_get(&tx_wait_out))
+                events |= EPOLLOUT;
+                
+        io_loop->set_port_events(this, events);
+        
+        #endif
+}
+
+std::string SocketTransport::set_port(std::string p)
+{
+        port = p;
+        return port;
+}
+
+std::string SocketTransport::get_port()
+{
+        return port;
+}
+
+std::string SocketTransport::get_status_string()
+{
+        std::stringstream str;
+        
+        if (is_open())
+                str << port << ": " << (type == ST_Udp ? "UDP " : "TCP ") << peer;
+        else
+                str << "Not connected";
+                
+        return str.str();
+}
+
+SocketTransport::SocketType SocketTransport::get_type()
+{
+        std::string host;
+        std::string service;
+        SocketType t;
+        
+        if (is_open())
+                return type;
+                
+        return parse_address(port, t, host, service) ? t : ST_Tcp;
+}
+
+int SocketTransport::set_connect_timeout(int t)
+{
+        connect_timeout = t > 0 ? t : 1;
+        return connect_timeout;
+}
+
+int SocketTransport::get_connect_timeout()
+{
+        return connect_timeout;
+}
+
+bool SocketTransport::set_debug(bool d)
+{
+        debug = d;
+        return debug;
+}
+
+bool SocketTransport::get_debug()
+{
+        return debug;
+}
+
+TransportReceiver *SocketTransport::set_receiver(TransportReceiver *r)
+{
+        if (!is_open())
+                receiver = r;
+        return receiver;
+}
+
+TransportReceiver *SocketTransport::get_receiver()
+{
+        return receiver;
+}
+
+std::tr1::shared_ptr<Notifier> SocketTransport::set_notifier(std::tr1::shared_ptr<Notifier> n)
+{
+        if (is_open())
+                return notifier;
+                
+        c_notify.disconnect();
+        notifier = n;
+        
+        if (notifier)
+                c_notify = notifier->signal_notify().connect( sigc::mem_fun(*this, &SocketTransport::on_notify) );
+                
+        return notifier;
+}
+
+std::tr1::shared_ptr<Notifier> SocketTransport::get_notifier()
+{
+        return notifier;
+}
+
+std::tr1::shared_ptr<SerialIoLoop> SocketTransport::set_io_loop(std::tr1::shared_ptr<SerialIoLoop> l)
+{
+        if (!is_open())
+                io_loop = l;
+        return io_loop;
+}
+
+std::tr1::shared_ptr<SerialIoLoop> SocketTransport::get_io_loop()
+{
+        return io_loop;
+}
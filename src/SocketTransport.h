@@ -0,0 +1,408 @@
+/************************************************************************/
+/* SocketTransport                                                      */
+/*                                                                      */
+/* ZigBee Terminal - TCP and UDP Transport                              */
+/*                                                                      */
+/* SocketTransport.h                                                    */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __SOCKET_TRANSPORT_H
+#define __SOCKET_TRANSPORT_H
+
+#include <string>
+#include <vector>
+#include <tr1/memory>
+#include <stddef.h>
+#include <inttypes.h>
+#include <sigc++/sigc++.h>
+
+#include "Mutex.h"
+#include "Notifier.h"
+#include "FrameBufferPool.h"
+#include "SerialIoLoop.h"
+#include "Transport.h"
+
+/** Socket Transport
+ * 
+ * Transport to a radio behind a network bridge, such as ser2net or another
+ * zigbee terminal in bridge mode.  Addresses are written
+ * tcp://host:port or udp://host:port.  TCP carries the API byte stream as
+ * is; over UDP every datagram holds whole frames and every queued buffer
+ * goes out as one datagram.  The socket is non-blocking and polled by a
+ * SerialIoLoop thread, which may be shared with serial ports; received data
+ * goes straight into the receiver, so a receiver must be set before the
+ * port is opened.  Only implemented on unix.  
+ * @see NetworkBridge
+ */
+class SocketTransport : public Transport
+{
+public:
+        /**
+         * Socket type.
+         */
+        typedef enum
+        {
+                ST_Tcp = 0,
+                ST_Udp = 1,
+        }
+        SocketType;
+        
+        /**
+         * Create a Socket Transport.
+         */
+        SocketTransport();
+        virtual ~SocketTransport();
+        
+        /**
+         * Check for a socket address.
+         * @param name port name
+         * @return true if name starts with tcp:// or udp://
+         */
+        static bool is_address(const std::string &name);
+        
+        /**
+         * Split a socket address.  The host may be a name, an IPv4
+         * address or an IPv6 address in brackets; tcp:// is assumed when
+         * there is no scheme.
+         * @param addr address, [tcp://|udp://]host:port
+         * @param type return socket type
+         * @param host return host
+         * @param service return port
+         * @return true if valid
+         */
+        static bool parse_address(const std::string &addr, SocketType &type, std::string &host, std::string &service);
+        
+        /**
+         * Open port.  Resolves the address and connects, waiting at most
+         * the connect timeout.  UDP sockets are connected too, so only
+         * datagrams from the bridge are received.
+         * @return status
+         * @see set_connect_timeout()
+         */
+        virtual TransportStatus open_port();
+        
+        virtual TransportStatus close_port();
+        
+        virtual bool is_open();
+        
+        /**
+         * Set address.
+         * @param p address, [tcp://|udp://]host:port
+         * @return address
+         */
+        virtual std::string set_port(std::string p);
+        
+        virtual std::string get_port();
+        
+        virtual std::string get_status_string();
+        
+        /**
+         * Get socket type of the address.
+         * @return socket type
+         */
+        SocketType get_type();
+        
+        /**
+         * Set connect timeout.
+         * @param t timeout in ms
+         * @return connect timeout
+         */
+        int set_connect_timeout(int t);
+        
+        /**
+         * Get connect timeout.
+         * @return connect timeout in ms
+         */
+        int get_connect_timeout();
+        
+        virtual FrameBufferPool::Buffer *get_write_buffer(size_t size);
+        
+        virtual TransportStatus queue_write(FrameBufferPool::Buffer *buf);
+        
+        virtual TransportStatus queue_write(const char *buf, size_t count);
+        
+        virtual size_t get_queued_write_count();
+        
+        virtual size_t get_queued_write_max();
+        
+        virtual size_t set_write_limit(size_t l);
+        
+        virtual size_t get_write_limit();
+        
+        virtual bool is_write_blocked();
+        
+        virtual bool set_debug(bool d);
+        
+        virtual bool get_debug();
+        
+        virtual TransportReceiver *set_receiver(TransportReceiver *r);
+        
+        virtual TransportReceiver *get_receiver();
+        
+        virtual std::tr1::shared_ptr<Notifier> set_notifier(std::tr1::shared_ptr<Notifier> n);
+        
+        virtual std::tr1::shared_ptr<Notifier> get_notifier();
+        
+        virtual std::tr1::shared_ptr<SerialIoLoop> set_io_loop(std::tr1::shared_ptr<SerialIoLoop> l);
+        
+        virtual std::tr1::shared_ptr<SerialIoLoop> get_io_loop();
+        
+protected:
+        /**
+         * I/O thread events.
+         * @see pending_events
+         */
+        typedef enum
+        {
+                SE_ReceiveData = 1,
+                SE_Error = 2,
+                SE_WriteSpace = 4,
+        }
+        SocketEvent;
+        
+        /**
+         * Notifier event handler.  Dispatches pending events on the main
+         * loop.
+         * @see post_event()
+         */
+        void on_notify();
+        
+        /**
+         * Post an event to the main loop.  Called from the I/O thread.
+         * @param event SocketEvent bits
+         */
+        void post_event(int event);
+        
+        /**
+         * Connect the socket.
+         * @return status
+         */
+        TransportStatus connect_socket();
+        
+        /**
+         * Start polling the socket.
+         * @return status
+         */
+        TransportStatus launch_io_thread();
+        
+        /**
+         * Stop polling the socket and drop queued data.
+         */
+        void stop_io_thread();
+        
+        #ifdef __unix__
+        
+        virtual int get_io_fd();
+        
+        virtual int get_wake_fd();
+        
+        virtual uint32_t get_io_events();
+        
+        virtual void io_start();
+        
+        /**
+         * Handle an event for the socket.  Called by the I/O loop.  Reads
+         * the socket into the receiver and writes queued data.
+         * @param source SerialIoLoop::SerialIoSource
+         * @param events epoll event bits
+         * @return false on error, the loop stops polling the socket
+         */
+        virtual bool io_event(int source, uint32_t events);
+        
+        /**
+         * Handle the I/O timer.  Delivers data held back by the receiver.
+         * @return true
+         */
+        virtual bool io_timer();
+        
+        virtual void io_fail();
+        
+        #endif
+        
+        /**
+         * Read from the socket into the receiver until it is drained.
+         * Called from the I/O thread.
+         * @param notify set if the receiver asks for the main loop to be
+         * notified
+         * @return false on error
+         */
+        bool read_receiver(bool &notify);
+        
+        /**
+         * Write queued data.  Called from the I/O thread.  TCP gathers
+         * buffers into one sendmsg(); UDP sends each buffer as a datagram,
+         * several per sendmmsg().  Arms the socket for writing when it is
+         * full.
+         * @return false on a write error
+         */
+        bool flush_tx();
+        
+        /**
+         * Retire written data from tx_write.  Called from the I/O thread.
+         * @param count bytes written
+         * @return true if the port is no longer write blocked
+         */
+        bool retire_tx(size_t count);
+        
+        /**
+         * Set the socket events the I/O loop waits for.
+         */
+        void arm_port();
+        
+        /**
+         * Address.
+         * @see set_port()
+         */
+        std::string port;
+        
+        /**
+         * Peer address of the connected socket, numeric.
+         */
+        std::string peer;
+        
+        /**
+         * Socket type of the connected socket.
+         */
+        SocketType type;
+        
+        /**
+         * Connect timeout in ms.
+         */
+        int connect_timeout;
+        
+        /**
+         * Socket, -1 if closed.
+         */
+        int sock_fd;
+        
+        /**
+         * eventfd used to wake the I/O loop for queued data
+         * @see queue_write()
+         */
+        int event_fd;
+        
+        /**
+         * Data read into the receiver is waiting to be delivered
+         * @see io_timer()
+         */
+        bool io_deferred;
+        
+        /**
+         * Pending SocketEvent bits, accessed atomically.
+         */
+        volatile int pending_events;
+        
+        /**
+         * Receiver
+         */
+        TransportReceiver *receiver;
+        
+        /**
+         * Notifier used to wake the main loop.
+         */
+        std::tr1::shared_ptr<Notifier> notifier;
+        
+        /**
+         * Notifier signal connection.
+         */
+        sigc::connection c_notify;
+        
+        /**
+         * I/O loop
+         */
+        std::tr1::shared_ptr<SerialIoLoop> io_loop;
+        
+        /**
+         * Transmit buffer pool.
+         */
+        FrameBufferPool tx_pool;
+        
+        /**
+         * Transmit mutex.  Protects tx_queue, tx_count, tx_max, tx_limit
+         * and tx_full.
+         */
+        Mutex tx_mutex;
+        
+        /**
+         * Buffers queued for transmission.
+         */
+        std::vector<FrameBufferPool::Buffer *> tx_queue;
+        
+        /**
+         * Buffers being written by the I/O thread, swapped with tx_queue.
+         */
+        std::vector<FrameBufferPool::Buffer *> tx_write;
+        
+        /**
+         * Index of the first buffer in tx_write not completely written.
+         */
+        size_t tx_index;
+        
+        /**
+         * Bytes of tx_write[tx_index] already written, TCP only.
+         */
+        size_t tx_offset;
+        
+        /**
+         * Bytes queued and not yet written.
+         */
+        size_t tx_count;
+        
+        /**
+         * Most bytes queued at once.
+         */
+        size_t tx_max;
+        
+        /**
+         * Write limit.
+         */
+        size_t tx_limit;
+        
+        /**
+         * Write limit reached.
+         */
+        bool tx_full;
+        
+        /**
+         * Socket is full and the I/O thread waits for it to take more
+         * data, accessed atomically.
+         */
+        volatile int tx_wait_out;
+        
+        /**
+         * Debug status.
+         */
+        bool debug;
+        
+        /**
+         * Time the receiver may hold data back before it is delivered.
+         */
+        static const int deliver_delay = 20;
+};
+
+#endif //__SOCKET_TRANSPORT_H
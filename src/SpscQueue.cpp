@@ -0,0 +1,172 @@
+/************************************************************************/
+/* SpscQueue                                                            */
+/*                                                                      */
+/* ZigBee Terminal - Single Producer Single Consumer Queue              */
+/*                                                                      */
+/* SpscQueue.cpp                                                        */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "SpscQueue.h"
+#include "Thread.h"
+
+#include <string.h>
+
+// record header: type in the top byte, length below
+#define SPSC_HEADER_SIZE 4
+#define SPSC_MAX_LENGTH 0x00ffffff
+
+// header type marking unused space at the end of the ring
+#define SPSC_TYPE_WRAP 0xff
+
+SpscQueue::SpscQueue(size_t capacity) :
+        head(0),
+        tail(0),
+        read_pos(0),
+        dropped_count(0),
+        dropped_bytes(0)
+{
+        size_t size = 64;
+        
+        // records are 4 byte aligned, so a power of two keeps the space at
+        // the end of the ring a whole number of headers
+        while (size < capacity && size < 0x40000000)
+                size <<= 1;
+                
+        ring.resize(size);
+        mask = size - 1;
+}
+
+
+SpscQueue::~SpscQueue()
+{
+        // nothing
+}
+
+
+bool SpscQueue::push(int type, const void *data, size_t count)
+{
+        unsigned int h = head;
+        unsigned int t = Thread::atomic_get(&tail);
+        unsigned int space = mask + 1 - (h - t);
+        unsigned int pos = h & mask;
+        unsigned int end = mask + 1 - pos;
+        size_t need = SPSC_HEADER_SIZE + ((count + 3) & ~(size_t)3);
+        uint32_t header;
+        
+        if (need > end && need <= mask + 1 && end <= space)
+        {
+                // record does not fit before the end, skip to the start;
+                // published on its own so the record fits once the
+                // consumer catches up, even if it has to be dropped now
+                header = (uint32_t)SPSC_TYPE_WRAP << 24;
+                memcpy(&ring[pos], &header, SPSC_HEADER_SIZE);
+                h += end;
+                space -= end;
+                pos = 0;
+                Thread::atomic_set(&head, h);
+        }
+        
+        if (count > SPSC_MAX_LENGTH || need > space || need > mask + 1 - pos)
+        {
+                // only the producer writes these
+                Thread::atomic_set(&dropped_count, dropped_count + 1);
+                Thread::atomic_set(&dropped_bytes, dropped_bytes + count);
+                return false;
+        }
+        
+        header = ((uint32_t)type << 24) | count;
+        memcpy(&ring[pos], &header, SPSC_HEADER_SIZE);
+        memcpy(&ring[pos + SPSC_HEADER_SIZE], data, count);
+        
+        // full barrier, the record is complete before it is published
+        Thread::atomic_set(&head, h + need);
+        
+        return true;
+}
+
+
+bool SpscQueue::read(Record &r)
+{
+        unsigned int h = Thread::atomic_get(&head);
+        unsigned int pos;
+        uint32_t header;
+        
+        while (read_pos != h)
+        {
+                pos = read_pos & mask;
+                memcpy(&header, &ring[pos], SPSC_HEADER_SIZE);
+                
+                if ((header >> 24) == SPSC_TYPE_WRAP)
+                {
+                        read_pos += mask + 1 - pos;
+                        continue;
+                }
+                
+                r.type = header >> 24;
+                r.length = header & SPSC_MAX_LENGTH;
+                r.data = &ring[pos + SPSC_HEADER_SIZE];
+                
+                read_pos += SPSC_HEADER_SIZE + ((r.length + 3) & ~(size_t)3);
+                
+                return true;
+        }
+        
+        return false;
+}
+
+
+void SpscQueue::release()
+{
+        Thread::atomic_set(&tail, read_pos);
+}
+
+
+void SpscQueue::discard()
+{
+        read_pos = Thread::atomic_get(&head);
+        release();
+}
+
+
+size_t SpscQueue::get_dropped_count()
+{
+        return (unsigned int)Thread::atomic_get(&dropped_count);
+}
+
+
+size_t SpscQueue::get_dropped_bytes()
+{
+        return (unsigned int)Thread::atomic_get(&dropped_bytes);
+}
+
+
+size_t SpscQueue::get_capacity()
+{
+        return mask + 1;
+}
+
@@ -0,0 +1,160 @@
+/************************************************************************/
+/* SpscQueue                                                            */
+/*                                                                      */
+/* ZigBee Terminal - Single Producer Single Consumer Queue              */
+/*                                                                      */
+/* SpscQueue.h                                                          */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __SPSC_QUEUE_H
+#define __SPSC_QUEUE_H
+
+#include <vector>
+#include <stddef.h>
+#include <inttypes.h>
+
+/** Single Producer Single Consumer Queue
+ * 
+ * Lock-free queue of variable length records, used to hand received data
+ * from the I/O thread to the main loop.  One thread pushes and one thread
+ * reads; neither ever waits for the other.  Records are stored back to
+ * back in a fixed ring and read in place, so the consumer can hand out
+ * pointers into the ring until it releases them.  When the ring is full,
+ * push() drops the record and counts it instead of blocking.  
+ */
+class SpscQueue
+{
+public:
+        /**
+         * Record read from the queue.
+         */
+        struct Record
+        {
+                int type;               ///< Record type passed to push()
+                const uint8_t *data;    ///< Record data, valid until release()
+                size_t length;          ///< Record length
+        };
+        
+        /**
+         * Create a Single Producer Single Consumer Queue.
+         * @param capacity ring size in bytes, rounded up to a power of two
+         */
+        SpscQueue(size_t capacity = 1048576);
+        virtual ~SpscQueue();
+        
+        /**
+         * Push a record.  Producer only.
+         * @param type record type, 0 to 254
+         * @param data record data
+         * @param count record length, at most 16 MiB - 1
+         * @return false if the ring is full and the record was dropped
+         */
+        bool push(int type, const void *data, size_t count);
+        
+        /**
+         * Read the next record.  Consumer only.  Records read stay in the
+         * ring until release() is called.
+         * @param r return record
+         * @return false if there are no more records
+         */
+        bool read(Record &r);
+        
+        /**
+         * Release all records read so far, making their space available to
+         * the producer.  Consumer only.
+         */
+        void release();
+        
+        /**
+         * Drop all records pushed so far, read or not.  Consumer only.
+         */
+        void discard();
+        
+        /**
+         * Get number of records dropped because the ring was full.
+         * @return records dropped
+         */
+        size_t get_dropped_count();
+        
+        /**
+         * Get number of bytes in records dropped because the ring was full.
+         * @return bytes dropped
+         */
+        size_t get_dropped_bytes();
+        
+        /**
+         * Get ring size.
+         * @return size in bytes
+         */
+        size_t get_capacity();
+        
+protected:
+        /**
+         * Ring storage.
+         */
+        std::vector<uint8_t> ring;
+        
+        /**
+         * Ring size minus one.
+         */
+        unsigned int mask;
+        
+        /**
+         * Write position, counted from the start and wrapping at 2^32.
+         * Written by the producer only, accessed atomically.
+         */
+        volatile int head;
+        
+        // keep the positions on separate cache lines
+        char pad_head[64];
+        
+        /**
+         * Release position.  Written by the consumer only, accessed
+         * atomically.
+         */
+        volatile int tail;
+        
+        char pad_tail[64];
+        
+        /**
+         * Read position.  Consumer only.
+         */
+        unsigned int read_pos;
+        
+        /**
+         * Records dropped.  Written by the producer only.
+         */
+        volatile int dropped_count;
+        
+        /**
+         * Bytes dropped.  Written by the producer only.
+         */
+        volatile int dropped_bytes;
+};
+
+#endif //__SPSC_QUEUE_H
@@ -0,0 +1,244 @@
+/************************************************************************/
+/* Thread                                                               */
+/*                                                                      */
+/* ZigBee Terminal - Thread                                             */
+/*                                                                      */
+/* Thread.cpp                                                           */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "Thread.h"
+
+#include <iostream>
+
+#ifdef __unix__
+#include <unistd.h>
+#endif
+
+Thread::Thread(const sigc::slot<void> &slot) :
+        slot(slot)
+{
+        #ifdef _WIN32
+        
+        h_thread = NULL;
+        
+        #endif
+}
+
+
+Thread::~Thread()
+{
+        // nothing
+}
+
+
+Thread *Thread::create(const sigc::slot<void> &slot)
+{
+        Thread *t = new Thread(slot);
+        
+        #ifdef __unix__
+        
+        if (pthread_create(&t->thread, 0, &Thread::thread_main, t) != 0)
+        {
+                std::cerr << "[Thread] Unable to create thread" << std::endl;
+                delete t;
+                return 0;
+        }
+        
+        #elif defined _WIN32
+        
+        t->h_thread = CreateThread(0, 0, &Thread::thread_main, t, 0, 0);
+        
+        if (t->h_thread == NULL)
+        {
+                std::cerr << "[Thread] Unable to create thread" << std::endl;
+                delete t;
+                return 0;
+        }
+        
+        #endif
+        
+        return t;
+}
+
+
+void Thread::join()
+{
+        #ifdef __unix__
+        
+        pthread_join(thread, 0);
+        
+        #elif defined _WIN32
+        
+        WaitForSingleObject(h_thread, INFINITE);
+        CloseHandle(h_thread);
+        
+        #endif
+        
+        delete this;
+}
+
+
+#ifdef __unix__
+void *Thread::thread_main(void *arg)
+#elif defined _WIN32
+DWORD WINAPI Thread::thread_main(LPVOID arg)
+#endif
+{
+        Thread *t = (Thread *)arg;
+        
+        t->slot();
+        
+        return 0;
+}
+
+
+int Thread::atomic_get(volatile int *atomic)
+{
+        #ifdef _WIN32
+        
+        return InterlockedCompareExchange((volatile LONG *)atomic, 0, 0);
+        
+        #else
+        
+        return __sync_fetch_and_add(atomic, 0);
+        
+        #endif
+}
+
+
+void Thread::atomic_set(volatile int *atomic, int v)
+{
+        atomic_exchange(atomic, v);
+}
+
+
+bool Thread::atomic_compare_and_exchange(volatile int *atomic, int oldval, int newval)
+{
+        #ifdef _WIN32
+        
+        return InterlockedCompareExchange((volatile LONG *)atomic, newval, oldval) == oldval;
+        
+        #else
+        
+        return __sync_bool_compare_and_swap(atomic, oldval, newval);
+        
+        #endif
+}
+
+
+int Thread::atomic_or(volatile int *atomic, int v)
+{
+        #ifdef _WIN32
+        
+        return InterlockedOr((volatile LONG *)atomic, v);
+        
+        #else
+        
+        return __sync_fetch_and_or(atomic, v);
+        
+        #endif
+}
+
+
+int Thread::atomic_exchange(volatile int *atomic, int v)
+{
+        #ifdef _WIN32
+        
+        return InterlockedExchange((volatile LONG *)atomic, v);
+        
+        #else
+        
+        // full barrier, __sync_lock_test_and_set is only an acquire barrier
+        __sync_synchronize();
+        return __sync_lock_test_and_set(atomic, v);
+        
+        #endif
+}
+
+
+int Thread::atomic_add(volatile int *atomic, int v)
+{
+        #ifdef _WIN32
+        
+        return InterlockedExchangeAdd((volatile LONG *)atomic, v);
+        
+        #else
+        
+        return __sync_fetch_and_add(atomic, v);
+        
+        #endif
+}
+
+
+int64_t Thread::atomic_get(volatile int64_t *atomic)
+{
+        #ifdef _WIN32
+        
+        return InterlockedCompareExchange64((volatile LONGLONG *)atomic, 0, 0);
+        
+        #else
+        
+        return __sync_fetch_and_add(atomic, 0);
+        
+        #endif
+}
+
+
+int64_t Thread::atomic_add(volatile int64_t *atomic, int64_t v)
+{
+        #ifdef _WIN32
+        
+        return InterlockedExchangeAdd64((volatile LONGLONG *)atomic, v);
+        
+        #else
+        
+        return __sync_fetch_and_add(atomic, v);
+        
+        #endif
+}
+
+
+// Static
+int Thread::get_cpu_count()
+{
+        #ifdef __unix__
+        
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        
+        return n > 0 ? (int)n : 1;
+        
+        #elif defined _WIN32
+        
+        SYSTEM_INFO info;
+        
+        GetSystemInfo(&info);
+        
+        return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+        
+        #endif
+}
@@ -0,0 +1,169 @@
+/************************************************************************/
+/* Thread                                                               */
+/*                                                                      */
+/* ZigBee Terminal - Thread                                             */
+/*                                                                      */
+/* Thread.h                                                             */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __THREAD_H
+#define __THREAD_H
+
+#include <sigc++/sigc++.h>
+#include <inttypes.h>
+
+#ifdef __unix__
+#include <pthread.h>
+#elif defined _WIN32
+#include <windows.h>
+#endif
+
+/** Thread
+ * 
+ * Cross-platform joinable thread, with the same interface as Glib::Thread
+ * so that the core classes do not need glib.  Also provides the few
+ * atomic integer operations the core classes use.  
+ */
+class Thread
+{
+public:
+        /**
+         * Start a thread.
+         * @param slot function to run
+         * @return thread, or 0 on failure
+         */
+        static Thread *create(const sigc::slot<void> &slot);
+        
+        /**
+         * Wait for the thread to finish.  Frees the thread object.
+         */
+        void join();
+        
+        /**
+         * Get number of processors available to run threads.
+         * @return processor count, at least 1
+         */
+        static int get_cpu_count();
+        
+        /**
+         * Atomically read an integer.
+         * @param atomic pointer to integer
+         * @return value
+         */
+        static int atomic_get(volatile int *atomic);
+        
+        /**
+         * Atomically set an integer.
+         * @param atomic pointer to integer
+         * @param v value
+         */
+        static void atomic_set(volatile int *atomic, int v);
+        
+        /**
+         * Atomically replace an integer if it has the expected value.
+         * @param atomic pointer to integer
+         * @param oldval expected value
+         * @param newval new value
+         * @return true if replaced
+         */
+        static bool atomic_compare_and_exchange(volatile int *atomic, int oldval, int newval);
+        
+        /**
+         * Atomically OR bits into an integer.
+         * @param atomic pointer to integer
+         * @param v bits to set
+         * @return previous value
+         */
+        static int atomic_or(volatile int *atomic, int v);
+        
+        /**
+         * Atomically replace an integer.
+         * @param atomic pointer to integer
+         * @param v new value
+         * @return previous value
+         */
+        static int atomic_exchange(volatile int *atomic, int v);
+        
+        /**
+         * Atomically add to an integer.
+         * @param atomic pointer to integer
+         * @param v value to add
+         * @return previous value
+         */
+        static int atomic_add(volatile int *atomic, int v);
+        
+        /**
+         * Atomically read a 64-bit integer.
+         * @param atomic pointer to integer
+         * @return value
+         */
+        static int64_t atomic_get(volatile int64_t *atomic);
+        
+        /**
+         * Atomically add to a 64-bit integer.
+         * @param atomic pointer to integer
+         * @param v value to add
+         * @return previous value
+         */
+        static int64_t atomic_add(volatile int64_t *atomic, int64_t v);
+        
+protected:
+        Thread(const sigc::slot<void> &slot);
+        virtual ~Thread();
+        
+        /**
+         * Thread entry point.
+         * @param arg pointer to Thread object
+         */
+        #ifdef __unix__
+        static void *thread_main(void *arg);
+        #elif defined _WIN32
+        static DWORD WINAPI thread_main(LPVOID arg);
+        #endif
+        
+        /**
+         * Function run by the thread.
+         */
+        sigc::slot<void> slot;
+        
+        #ifdef __unix__
+        
+        pthread_t thread;
+        
+        #elif defined _WIN32
+        
+        HANDLE h_thread;
+        
+        #endif
+        
+private:
+        Thread(const Thread &);
+        Thread &operator=(const Thread &);
+};
+
+#endif //__THREAD_H
@@ -0,0 +1,79 @@
+/************************************************************************/
+/* Transport                                                            */
+/*                                                                      */
+/* ZigBee Terminal - Transport Interface                                */
+/*                                                                      */
+/* Transport.cpp                                                        */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "Transport.h"
+
+Transport::Transport()
+{
+        #ifdef __unix__
+        
+        io_id = 0;
+        io_deadline = 0;
+        
+        #endif
+}
+
+Transport::~Transport()
+{
+        // nothing
+}
+
+bool Transport::has_software_flow()
+{
+        return false;
+}
+
+sigc::signal<void> Transport::port_opened()
+{
+        return m_port_opened;
+}
+
+sigc::signal<void> Transport::port_closed()
+{
+        return m_port_closed;
+}
+
+sigc::signal<void> Transport::port_error()
+{
+        return m_port_error;
+}
+
+sigc::signal<void> Transport::port_write_space()
+{
+        return m_port_write_space;
+}
+
+sigc::signal<void> Transport::port_receive_data()
+{
+        return m_port_receive_data;
+}
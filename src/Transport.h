@@ -0,0 +1,407 @@
+/************************************************************************/
+/* Transport                                                            */
+/*                                                                      */
+/* ZigBee Terminal - Transport Interface                                */
+/*                                                                      */
+/* Transport.h                                                          */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __TRANSPORT_H
+#define __TRANSPORT_H
+
+#include <string>
+#include <tr1/memory>
+#include <stddef.h>
+#include <inttypes.h>
+#include <sigc++/sigc++.h>
+
+#include "Notifier.h"
+#include "FrameBufferPool.h"
+
+class SerialIoLoop;
+
+/** Transport Receiver
+ * 
+ * Interface for objects that take data straight from a transport's I/O
+ * thread.  Both methods are called on the I/O thread, not on the main
+ * loop.  
+ * @see Transport::set_receiver()
+ */
+class TransportReceiver
+{
+public:
+        virtual ~TransportReceiver() {}
+        
+        /**
+         * Get space for the next read.
+         * @param count return number of bytes available
+         * @return pointer to buffer space
+         */
+        virtual char *get_receive_space(size_t &count) = 0;
+        
+        /**
+         * Process data read into the space returned by get_receive_space().
+         * @param count number of bytes read
+         * @return true if the main loop should be notified now, false if
+         * notification can wait for more data
+         */
+        virtual bool receive(size_t count) = 0;
+};
+
+/** Transport
+ * 
+ * Byte stream to a radio.  Implemented by SerialInterface for local ports
+ * and by SocketTransport for radios behind a TCP or UDP bridge, so
+ * ZigBeeInterface does not care how the radio is attached.  Received data
+ * goes straight into the receiver on an I/O thread and queued buffers are
+ * written from it; signals are emitted on the main loop woken by the
+ * notifier.  On unix, transports are polled by a SerialIoLoop, which may be
+ * shared by transports of any kind.  
+ * @see SerialInterface
+ * @see SocketTransport
+ */
+class Transport
+{
+public:
+        /**
+         * Port status.
+         */
+        typedef enum
+        {
+                SS_Success = 0,
+                SS_Error = 1,
+                SS_Timeout = 2,
+                SS_EOF = 3,
+                SS_PortNotOpen = 4,
+        }
+        TransportStatus;
+        
+        /**
+         * Create a Transport.
+         */
+        Transport();
+        virtual ~Transport();
+        
+        /**
+         * Open port.
+         * @return status
+         */
+        virtual TransportStatus open_port() = 0;
+        
+        /**
+         * Close port.  Data still queued is discarded.
+         * @return status
+         */
+        virtual TransportStatus close_port() = 0;
+        
+        /**
+         * Check port open.
+         * @return true if open
+         */
+        virtual bool is_open() = 0;
+        
+        /**
+         * Set port.  A device name for serial ports, an address for
+         * sockets.
+         * @param p port
+         * @return port
+         */
+        virtual std::string set_port(std::string p) = 0;
+        
+        /**
+         * Get port.
+         * @return port
+         */
+        virtual std::string get_port() = 0;
+        
+        /**
+         * Get status string.  Returns a short representation of the
+         * connection configuration.  
+         * @return status string
+         */
+        virtual std::string get_status_string() = 0;
+        
+        /**
+         * Check software flow control.
+         * @return true if XON and XOFF bytes are taken out of the stream,
+         * so frames must be escaped
+         */
+        virtual bool has_software_flow();
+        
+        /**
+         * Get a buffer to queue.  Fill in data and length, then pass it to
+         * queue_write().
+         * @param size minimum size
+         * @return buffer
+         * @see queue_write()
+         */
+        virtual FrameBufferPool::Buffer *get_write_buffer(size_t size) = 0;
+        
+        /**
+         * Queue a buffer for transmission.  Returns without waiting; the
+         * I/O thread writes queued buffers in order.  Data is always
+         * accepted, even past the write limit.
+         * @param buf buffer from get_write_buffer(), owned by the transport
+         * from here on
+         * @return status
+         * @see is_write_blocked()
+         */
+        virtual TransportStatus queue_write(FrameBufferPool::Buffer *buf) = 0;
+        
+        /**
+         * Queue data for transmission.  Copies the data into a buffer.
+         * @param buf pointer to data
+         * @param count number of bytes to send
+         * @return status
+         * @see queue_write(FrameBufferPool::Buffer*)
+         */
+        virtual TransportStatus queue_write(const char *buf, size_t count) = 0;
+        
+        /**
+         * Get number of bytes queued and not yet written.
+         * @return bytes
+         */
+        virtual size_t get_queued_write_count() = 0;
+        
+        /**
+         * Get the most bytes that have been queued at once.
+         * @return bytes
+         */
+        virtual size_t get_queued_write_max() = 0;
+        
+        /**
+         * Set write limit.  Once this many bytes are queued the port is
+         * write blocked until half of them have been written.
+         * @param l limit in bytes
+         * @return limit
+         * @see is_write_blocked()
+         */
+        virtual size_t set_write_limit(size_t l) = 0;
+        
+        /**
+         * Get write limit.
+         * @return limit in bytes
+         */
+        virtual size_t get_write_limit() = 0;
+        
+        /**
+         * Check write blocked.  Producers that can wait should hold data
+         * back while this is true and resume on port_write_space.
+         * @return true if the write limit was reached
+         * @see port_write_space()
+         */
+        virtual bool is_write_blocked() = 0;
+        
+        /**
+         * Set debug mode.  If debug mode is enabled, all bytes read and
+         * written are printed in hex to stdout.
+         * @param d debug mode
+         * @return debug mode
+         */
+        virtual bool set_debug(bool d) = 0;
+        
+        /**
+         * Get debug mode.
+         * @return debug mode
+         */
+        virtual bool get_debug() = 0;
+        
+        /**
+         * Set receiver.  The I/O thread reads data directly into the
+         * receiver.  Must not be changed while the port is open.
+         * @param r receiver, or 0 for none
+         * @return receiver
+         */
+        virtual TransportReceiver *set_receiver(TransportReceiver *r) = 0;
+        
+        /**
+         * Get receiver.
+         * @return receiver
+         */
+        virtual TransportReceiver *get_receiver() = 0;
+        
+        /**
+         * Set notifier.  The I/O thread wakes the main loop through the
+         * notifier.  Must be set before the port is opened.
+         * @param n notifier
+         * @return notifier
+         */
+        virtual std::tr1::shared_ptr<Notifier> set_notifier(std::tr1::shared_ptr<Notifier> n) = 0;
+        
+        /**
+         * Get notifier.
+         * @return notifier
+         */
+        virtual std::tr1::shared_ptr<Notifier> get_notifier() = 0;
+        
+        /**
+         * Set I/O loop.  If no loop is set when the port is opened, the
+         * port gets a loop of its own.  Must not be changed while the port
+         * is open.
+         * @param l I/O loop
+         * @return I/O loop
+         */
+        virtual std::tr1::shared_ptr<SerialIoLoop> set_io_loop(std::tr1::shared_ptr<SerialIoLoop> l) = 0;
+        
+        /**
+         * Get I/O loop.
+         * @return I/O loop
+         */
+        virtual std::tr1::shared_ptr<SerialIoLoop> get_io_loop() = 0;
+        
+        /**
+         * Port opened signal.  
+         * @par Prototype:
+         * <tt>void on_my_%port_opened()</tt>
+         */
+        sigc::signal<void> port_opened();
+        
+        /**
+         * Port closed signal.  
+         * @par Prototype:
+         * <tt>void on_my_%port_closed()</tt>
+         */
+        sigc::signal<void> port_closed();
+        
+        /**
+         * Port error signal.  
+         * @par Prototype:
+         * <tt>void on_my_%port_error()</tt>
+         */
+        sigc::signal<void> port_error();
+        
+        /**
+         * Port write space signal.  Emitted when a write blocked port has
+         * drained to half the write limit.  
+         * @par Prototype:
+         * <tt>void on_my_%port_write_space()</tt>
+         * @see is_write_blocked()
+         */
+        sigc::signal<void> port_write_space();
+        
+        /**
+         * Port receive_data signal.  
+         * @par Prototype:
+         * <tt>void on_my_%port_receive_data()</tt>
+         */
+        sigc::signal<void> port_receive_data();
+        
+protected:
+        friend class SerialIoLoop;
+        
+        #ifdef __unix__
+        
+        /**
+         * Get the descriptor the I/O loop polls for port events.
+         * @return file descriptor
+         */
+        virtual int get_io_fd() = 0;
+        
+        /**
+         * Get the descriptor that wakes the I/O loop for queued data.
+         * @return file descriptor
+         */
+        virtual int get_wake_fd() = 0;
+        
+        /**
+         * Get the port events to poll for when the port is added.
+         * @return epoll event bits
+         */
+        virtual uint32_t get_io_events() = 0;
+        
+        /**
+         * Reset I/O state when the I/O loop starts polling the port.  Called
+         * by the I/O loop.
+         * @see SerialIoLoop::add_port()
+         */
+        virtual void io_start() = 0;
+        
+        /**
+         * Handle an event for the port.  Called by the I/O loop.
+         * @param source SerialIoLoop::SerialIoSource
+         * @param events epoll event bits
+         * @return false on error, the loop stops polling the port
+         */
+        virtual bool io_event(int source, uint32_t events) = 0;
+        
+        /**
+         * Handle the I/O timer.  Called by the I/O loop once io_deadline
+         * has passed.
+         * @return false on error, the loop stops polling the port
+         * @see io_deadline
+         */
+        virtual bool io_timer() = 0;
+        
+        /**
+         * Report an I/O loop failure to the main loop.  Called by the I/O
+         * loop before it stops polling the port.
+         */
+        virtual void io_fail() = 0;
+        
+        /**
+         * I/O loop registration ID, 0 if not polled
+         * @see SerialIoLoop::add_port()
+         */
+        int io_id;
+        
+        /**
+         * Time io_timer() is due, or 0 if not needed.  Written by the I/O
+         * loop only.
+         * @see SerialIoLoop::get_time()
+         */
+        uint64_t io_deadline;
+        
+        #endif
+        
+        /**
+         * Port opened signal.
+         */
+        sigc::signal<void> m_port_opened;
+        
+        /**
+         * Port closed signal.
+         */
+        sigc::signal<void> m_port_closed;
+        
+        /**
+         * Port error signal.
+         */
+        sigc::signal<void> m_port_error;
+        
+        /**
+         * Port write space signal.
+         */
+        sigc::signal<void> m_port_write_space;
+        
+        /**
+         * Port receive data signal.
+         */
+        sigc::signal<void> m_port_receive_data;
+};
+
+#endif //__TRANSPORT_H
@@ -0,0 +1,334 @@
+/************************************************************************/
+/* ZigBeeFrameParser                                                    */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee Frame Parser                                */
+/*                                                                      */
+/* ZigBeeFrameParser.cpp                                                */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeeFrameParser.h"
+#include "ZigBeePacket.h"
+
+#include <string.h>
+
+ZigBeeFrameParser::ZigBeeFrameParser(size_t capacity) :
+        buffer(capacity),
+        state(FPS_Delimiter),
+        frame_length(0),
+        pending_consume(0),
+        escaped(false),
+        escape_next(false),
+        scan(0),
+        out(0),
+        sum(0xff),
+        junk_bytes(0),
+        checksum_errors(0)
+{
+        // nothing
+}
+
+
+ZigBeeFrameParser::~ZigBeeFrameParser()
+{
+        // nothing
+}
+
+
+ReceiveBuffer& ZigBeeFrameParser::get_buffer()
+{
+        return buffer;
+}
+
+
+bool ZigBeeFrameParser::read_frame(const uint8_t *&payload, size_t &length)
+{
+        uint8_t *ptr;
+        uint8_t *start;
+        size_t count;
+        
+        // release previously returned frame
+        if (pending_consume > 0)
+        {
+                buffer.consume(pending_consume);
+                pending_consume = 0;
+        }
+        
+        if (escaped)
+                return read_escaped_frame(payload, length);
+                
+        while (true)
+        {
+                ptr = buffer.get_data();
+                count = buffer.get_size();
+                
+                switch (state)
+                {
+                        case FPS_Delimiter:
+                                // find packet start byte, discard junk ahead of it
+                                start = (uint8_t *)memchr(ptr, ZIGBEE_IDENTIFIER, count);
+                                
+                                if (start == 0)
+                                {
+                                        junk_bytes += count;
+                                        buffer.consume(count);
+                                        return false;
+                                }
+                                
+                                junk_bytes += start - ptr;
+                                buffer.consume(start - ptr);
+                                state = FPS_Length;
+                                break;
+                                
+                        case FPS_Length:
+                                // delimiter and two length bytes
+                                if (count < 3)
+                                        return false;
+                                        
+                                frame_length = (size_t)ptr[1] << 8;
+                                frame_length |= (size_t)ptr[2];
+                                
+                                if (frame_length + 4 > buffer.get_capacity())
+                                {
+                                        // can never fit, must be a stray delimiter
+                                        junk_bytes++;
+                                        buffer.consume(1);
+                                        state = FPS_Delimiter;
+                                        break;
+                                }
+                                
+                                state = FPS_Payload;
+                                break;
+                                
+                        case FPS_Payload:
+                                // return if we don't have the whole packet
+                                if (count < frame_length + 4)
+                                        return false;
+                                        
+                                sum = 0xff;
+                                for (size_t i = 0; i < frame_length; i++)
+                                        sum -= ptr[3+i];
+                                        
+                                state = FPS_Delimiter;
+                                
+                                if (sum != ptr[3+frame_length])
+                                {
+                                        // bad checksum, resync after the delimiter
+                                        checksum_errors++;
+                                        buffer.consume(1);
+                                        break;
+                                }
+                                
+                                payload = ptr + 3;
+                                length = frame_length;
+                                pending_consume = frame_length + 4;
+                                return true;
+                                
+                        default:
+                                state = FPS_Delimiter;
+                                break;
+                }
+        }
+}
+
+
+bool ZigBeeFrameParser::read_escaped_frame(const uint8_t *&payload, size_t &length)
+{
+        uint8_t *ptr = buffer.get_data();
+        uint8_t *start;
+        size_t count = buffer.get_size();
+        uint8_t b;
+        
+        while (true)
+        {
+                if (state == FPS_Delimiter)
+                {
+                        // find packet start byte, discard junk ahead of it
+                        start = (uint8_t *)memchr(ptr, ZIGBEE_IDENTIFIER, count);
+                        
+                        if (start == 0)
+                        {
+                                junk_bytes += count;
+                                buffer.consume(count);
+                                return false;
+                        }
+                        
+                        junk_bytes += start - ptr;
+                        buffer.consume(start - ptr);
+                        ptr = buffer.get_data();
+                        count = buffer.get_size();
+                        
+                        state = FPS_Length;
+                        escape_next = false;
+                        scan = 1;
+                        out = 1;
+                        sum = 0xff;
+                }
+                
+                if (scan >= count)
+                        return false;
+                        
+                b = ptr[scan++];
+                
+                if (b == ZIGBEE_IDENTIFIER)
+                {
+                        // unescaped start byte always begins a new frame
+                        junk_bytes += scan - 1;
+                        buffer.consume(scan - 1);
+                        ptr = buffer.get_data();
+                        count = buffer.get_size();
+                        state = FPS_Delimiter;
+                        continue;
+                }
+                
+                if (escape_next)
+                {
+                        b ^= 0x20;
+                        escape_next = false;
+                }
+                else if (b == ZIGBEE_ESCAPE)
+                {
+                        escape_next = true;
+                        continue;
+                }
+                
+                ptr[out++] = b;
+                
+                switch (state)
+                {
+                        case FPS_Length:
+                                if (out < 3)
+                                        break;
+                                        
+                                frame_length = (size_t)ptr[1] << 8;
+                                frame_length |= (size_t)ptr[2];
+                                
+                                if ((frame_length + 4) * 2 > buffer.get_capacity())
+                                {
+                                        // can never fit, must be a stray delimiter
+                                        junk_bytes += scan;
+                                        buffer.consume(scan);
+                                        ptr = buffer.get_data();
+                                        count = buffer.get_size();
+                                        state = FPS_Delimiter;
+                                        break;
+                                }
+                                
+                                state = frame_length > 0 ? FPS_Payload : FPS_Checksum;
+                                break;
+                                
+                        case FPS_Payload:
+                                sum -= b;
+                                
+                                if (out == frame_length + 3)
+                                        state = FPS_Checksum;
+                                break;
+                                
+                        case FPS_Checksum:
+                                state = FPS_Delimiter;
+                                
+                                if (sum != b)
+                                {
+                                        // bad checksum, no frame can start inside
+                                        // this one so drop all of it
+                                        checksum_errors++;
+                                        buffer.consume(scan);
+                                        ptr = buffer.get_data();
+                                        count = buffer.get_size();
+                                        break;
+                                }
+                                
+                                payload = ptr + 3;
+                                length = frame_length;
+                                pending_consume = scan;
+                                return true;
+                                
+                        default:
+                                state = FPS_Delimiter;
+                                break;
+                }
+        }
+}
+
+
+void ZigBeeFrameParser::reset()
+{
+        buffer.clear();
+        state = FPS_Delimiter;
+        frame_length = 0;
+        pending_consume = 0;
+        escape_next = false;
+        scan = 0;
+        out = 0;
+        sum = 0xff;
+}
+
+
+bool ZigBeeFrameParser::is_idle()
+{
+        return state == FPS_Delimiter && buffer.get_size() == pending_consume;
+}
+
+
+size_t ZigBeeFrameParser::get_junk_bytes()
+{
+        return junk_bytes;
+}
+
+
+size_t ZigBeeFrameParser::get_checksum_errors()
+{
+        return checksum_errors;
+}
+
+
+bool ZigBeeFrameParser::set_escaped(bool e)
+{
+        if (escaped != e)
+        {
+                // restart detection, any partial frame still begins with a
+                // start byte and will be picked up again
+                if (pending_consume > 0)
+                {
+                        buffer.consume(pending_consume);
+                        pending_consume = 0;
+                }
+                
+                state = FPS_Delimiter;
+                escaped = e;
+        }
+        
+        return escaped;
+}
+
+
+bool ZigBeeFrameParser::get_escaped()
+{
+        return escaped;
+}
+
+
@@ -0,0 +1,202 @@
+/************************************************************************/
+/* ZigBeeFrameParser                                                    */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee Frame Parser                                */
+/*                                                                      */
+/* ZigBeeFrameParser.h                                                  */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_FRAME_PARSER_H
+#define __ZIGBEE_FRAME_PARSER_H
+
+#include "ReceiveBuffer.h"
+
+#include <stddef.h>
+#include <inttypes.h>
+
+/** ZigBee Frame Parser
+ * 
+ * Streaming API frame parser.  Raw data is written straight into the
+ * parser's receive buffer and complete frames are returned as pointers into
+ * that buffer, so no bytes are copied between the serial port and
+ * ZigBeePacket::set_payload().  Parser state is kept between calls, so
+ * bytes that have already been examined are never scanned again.  
+ * 
+ * Both API mode 1 (AP=1, unescaped) and API mode 2 (AP=2, escaped) frames
+ * are supported.  Escaped frames are decoded one byte at a time and
+ * unescaped in place, with length and checksum worked out as the bytes
+ * arrive.  
+ */
+class ZigBeeFrameParser
+{
+public:
+        /**
+         * Create a ZigBee Frame Parser.
+         * @param capacity receive buffer size in bytes.  Frames that do not
+         * fit are discarded.
+         */
+        ZigBeeFrameParser(size_t capacity = 65536);
+        virtual ~ZigBeeFrameParser();
+        
+        /**
+         * Get receive buffer.  Raw data should be written to the buffer with
+         * ReceiveBuffer::get_write_ptr() and ReceiveBuffer::commit().
+         * @return receive buffer
+         */
+        ReceiveBuffer& get_buffer();
+        
+        /**
+         * Try to read the next complete frame from the buffer.  Junk ahead of
+         * a frame and frames with bad checksums are discarded.  The returned
+         * pointer refers to the frame payload (identifier through data,
+         * without start delimiter, length and checksum) and stays valid until
+         * the next call to read_frame(), reset() or
+         * ReceiveBuffer::get_write_ptr().
+         * @param payload return pointer to frame payload
+         * @param length return frame payload length
+         * @return true if frame read, false if more data is needed
+         */
+        bool read_frame(const uint8_t *&payload, size_t &length);
+        
+        /**
+         * Drop all buffered data and restart frame detection.
+         */
+        void reset();
+        
+        /**
+         * Check parser state.
+         * @return true if no partial frame is buffered
+         */
+        bool is_idle();
+        
+        /**
+         * Get number of bytes skipped while looking for a start delimiter,
+         * including cut off frames and stray delimiters.
+         * @return bytes skipped since the parser was created
+         */
+        size_t get_junk_bytes();
+        
+        /**
+         * Get number of frames dropped for a bad checksum.
+         * @return frames dropped since the parser was created
+         */
+        size_t get_checksum_errors();
+        
+        /**
+         * Set escaped mode.  If escaped mode is enabled, frames are expected
+         * in API mode 2 (AP=2) format with 0x7E, 0x7D, 0x11 and 0x13 escaped.
+         * @param e escaped mode
+         * @return escaped mode
+         */
+        bool set_escaped(bool e);
+        
+        /**
+         * Get escaped mode.
+         * @return escaped mode
+         * @see set_escaped()
+         */
+        bool get_escaped();
+        
+protected:
+        /**
+         * Parser states.
+         */
+        typedef enum
+        {
+                FPS_Delimiter = 0,
+                FPS_Length = 1,
+                FPS_Payload = 2,
+                FPS_Checksum = 3,
+        }
+        FrameParserState;
+        
+        /**
+         * Read API mode 2 frame.
+         * @see read_frame()
+         */
+        bool read_escaped_frame(const uint8_t *&payload, size_t &length);
+        
+        /**
+         * Receive buffer.
+         */
+        ReceiveBuffer buffer;
+        
+        /**
+         * Current state.
+         */
+        FrameParserState state;
+        
+        /**
+         * Payload length of current frame.
+         */
+        size_t frame_length;
+        
+        /**
+         * Bytes of the last returned frame, consumed on the next read.
+         */
+        size_t pending_consume;
+        
+        /**
+         * Escaped mode.
+         * @see set_escaped()
+         */
+        bool escaped;
+        
+        /**
+         * Escape byte seen, next byte must be XORed with 0x20.
+         */
+        bool escape_next;
+        
+        /**
+         * Offset of next raw byte to decode, relative to buffer head.
+         */
+        size_t scan;
+        
+        /**
+         * Offset of next unescaped byte, relative to buffer head.  Frames are
+         * unescaped in place, so out never passes scan.
+         */
+        size_t out;
+        
+        /**
+         * Running checksum of current frame.
+         */
+        uint8_t sum;
+        
+        /**
+         * Bytes skipped looking for a start delimiter.
+         */
+        size_t junk_bytes;
+        
+        /**
+         * Frames dropped for a bad checksum.
+         */
+        size_t checksum_errors;
+};
+
+#endif //__ZIGBEE_FRAME_PARSER_H
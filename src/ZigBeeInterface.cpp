@@ -32,103 +32,402 @@
 /************************************************************************/
 
 #include "ZigBeeInterface.h"
+#include "Thread.h"
 
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
 
 ZigBeeInterface::ZigBeeInterface() :
+        receive_ptr(0),
+        topology(0),
+        junk_seen(0),
+        checksum_seen(0),
+        in_flight_count(0),
+        window(1),
+        request_timeout(5000),
+        next_frame_id(1),
+        reset_requested(0),
+        escaped(0),
         debug(false)
 {
-        // nothing
+        for (int i = 0; i < 256; i++)
+                in_flight[i].active = false;
 }
 
 
 ZigBeeInterface::~ZigBeeInterface()
 {
-        // nothing
+        clear_transport();
 }
 
 
-void ZigBeeInterface::set_serial_interface(std::tr1::shared_ptr<SerialInterface> si)
+void ZigBeeInterface::set_transport(std::tr1::shared_ptr<Transport> t)
 {
-        clear_serial_interface();
-        if (!si)
+        clear_transport();
+        if (!t)
                 return;
-        ser_int = si;
-        c_port_opened = ser_int->port_opened().connect( sigc::mem_fun(*this, &ZigBeeInterface::reset_buffer) );
-        c_port_closed = ser_int->port_closed().connect( sigc::mem_fun(*this, &ZigBeeInterface::reset_buffer) );
-        c_port_receive_data = ser_int->port_receive_data().connect( sigc::mem_fun(*this, &ZigBeeInterface::on_receive_data) );
+        transport = t;
+        transport->set_receiver(this);
+        c_port_opened = transport->port_opened().connect( sigc::mem_fun(*this, &ZigBeeInterface::on_port_opened) );
+        c_port_closed = transport->port_closed().connect( sigc::mem_fun(*this, &ZigBeeInterface::on_port_closed) );
+        c_port_write_space = transport->port_write_space().connect( sigc::mem_fun(*this, &ZigBeeInterface::on_port_write_space) );
+        c_port_receive_data = transport->port_receive_data().connect( sigc::mem_fun(*this, &ZigBeeInterface::on_receive_data) );
+        c_port_error = transport->port_error().connect( sigc::mem_fun(*this, &ZigBeeInterface::on_port_error) );
 }
 
 
-void ZigBeeInterface::clear_serial_interface()
+void ZigBeeInterface::clear_transport()
 {
-        if (!ser_int)
+        if (!transport)
                 return;
         c_port_opened.disconnect();
         c_port_closed.disconnect();
+        c_port_write_space.disconnect();
         c_port_receive_data.disconnect();
-        ser_int = std::tr1::shared_ptr<SerialInterface>();
+        c_port_error.disconnect();
+        if (transport->get_receiver() == this)
+                transport->set_receiver(0);
+        transport = std::tr1::shared_ptr<Transport>();
 }
 
 
-bool ZigBeeInterface::has_serial_interface()
+bool ZigBeeInterface::has_transport()
 {
-        return ser_int;
+        return transport;
 }
 
 
 bool ZigBeeInterface::is_connected()
 {
-        return ser_int && ser_int->is_open();
+        return transport && transport->is_open();
 }
 
 
 void ZigBeeInterface::reset_buffer()
 {
-        read_data_queue.clear();
+        // the I/O thread owns the parser, let it reset on the next read
+        Thread::atomic_set(&reset_requested, 1);
+        rx_queue.discard();
 }
 
 
-void ZigBeeInterface::send_packet(ZigBeePacket pkt)
+void ZigBeeInterface::inject_receive_data(const char *data, size_t count)
 {
-        gsize num;
-        int ret;
-        int len;
+        size_t space;
         char *ptr;
         
-        if (!ser_int)
+        while (count > 0)
+        {
+                ptr = get_receive_space(space);
+                
+                if (space == 0)
+                        break;
+                        
+                if (space > count)
+                        space = count;
+                        
+                memcpy(ptr, data, space);
+                receive(space);
+                
+                data += space;
+                count -= space;
+        }
+        
+        on_receive_data();
+}
+
+
+void ZigBeeInterface::send_packet(const ZigBeePacket &pkt)
+{
+        FrameBufferPool::Buffer *buf;
+        bool esc;
+        
+        if (!transport)
+        {
+                std::cerr << "[ZigBeeInterface] No transport associated!" << std::endl;
+                m_signal_error.emit();
+                return;
+        }
+        
+        if (!transport->is_open())
         {
-                std::cerr << "[ZigBeeInterface] No SerialInterface associated!" << std::endl;
+                std::cerr << "[ZigBeeInterface] Error: unable to write packet, port not open!" << std::endl;
                 m_signal_error.emit();
                 return;
         }
         
-        std::vector<uint8_t> data = pkt.get_raw_packet();
+        // hand the radio the route first so it need not discover one
+        if (topology && topology->get_source_route(pkt.identifier, pkt.dest64, route_pkt))
+                send_packet(route_pkt);
+        
+        esc = get_escaped();
+        
+        // encode straight into a buffer the I/O thread writes from
+        buf = transport->get_write_buffer(pkt.get_max_encoded_length(esc));
+        buf->length = pkt.encode(&buf->data[0], buf->data.size(), esc);
+        
+        // the buffer belongs to the transport once queued
+        m_signal_send_raw_data.emit((const char *)&buf->data[0], buf->length);
+        
+        if (transport->queue_write(buf) != Transport::SS_Success)
+        {
+                std::cerr << "[ZigBeeInterface] Error: unable to write packet!" << std::endl;
+                m_signal_error.emit();
+        }
+}
+
+
+bool ZigBeeInterface::send_encoded(const uint8_t *data, size_t count)
+{
+        FrameBufferPool::Buffer *buf;
+        
+        if (!is_connected())
+        {
+                std::cerr << "[ZigBeeInterface] Error: unable to write frames, port not open!" << std::endl;
+                m_signal_error.emit();
+                return false;
+        }
+        
+        buf = transport->get_write_buffer(count);
+        memcpy(&buf->data[0], data, count);
+        buf->length = count;
+        
+        m_signal_send_raw_data.emit((const char *)&buf->data[0], buf->length);
+        
+        if (transport->queue_write(buf) != Transport::SS_Success)
+        {
+                std::cerr << "[ZigBeeInterface] Error: unable to write frames!" << std::endl;
+                m_signal_error.emit();
+                return false;
+        }
+        
+        return true;
+}
+
+
+bool ZigBeeInterface::send_frame(const ZigBeePacketView &frame)
+{
+        FrameBufferPool::Buffer *buf;
+        bool esc;
+        
+        if (!is_connected())
+        {
+                std::cerr << "[ZigBeeInterface] Error: unable to write frame, port not open!" << std::endl;
+                m_signal_error.emit();
+                return false;
+        }
+        
+        if (topology && frame.has_field(ZigBeePacket::ZBPF_Dest64) &&
+                topology->get_source_route(frame.get_identifier(), frame.get_dest64(), route_pkt))
+                send_packet(route_pkt);
+        
+        esc = get_escaped();
+        
+        buf = transport->get_write_buffer(frame.get_max_encoded_length(esc));
+        buf->length = frame.encode(&buf->data[0], buf->data.size(), esc);
+        
+        m_signal_send_raw_data.emit((const char *)&buf->data[0], buf->length);
+        
+        if (transport->queue_write(buf) != Transport::SS_Success)
+        {
+                std::cerr << "[ZigBeeInterface] Error: unable to write frame!" << std::endl;
+                m_signal_error.emit();
+                return false;
+        }
+        
+        return true;
+}
+
+
+bool ZigBeeInterface::is_write_blocked()
+{
+        return !transport || transport->is_write_blocked();
+}
+
+
+size_t ZigBeeInterface::get_queued_write_count()
+{
+        return transport ? transport->get_queued_write_count() : 0;
+}
+
+
+bool ZigBeeInterface::send_request(const ZigBeePacket &pkt, const RequestSlot &slot, unsigned int timeout)
+{
+        if (!ZigBeePacket::get_response_identifier(pkt.identifier))
+                return false;
+                
+        if (!is_connected())
+                return false;
+                
+        requests.push_back(Request());
+        requests.back().pkt = pkt;
+        requests.back().slot = slot;
+        requests.back().timeout = timeout ? timeout : request_timeout;
+        
+        send_requests();
+        
+        return true;
+}
+
+
+void ZigBeeInterface::cancel_requests()
+{
+        std::deque<Request> queued;
+        ZigBeePacket pkt;
         
-        len = data.size();
-        ptr = (char *)&data[0];
+        // callbacks may queue new requests, finish with the current set
+        queued.swap(requests);
         
-        // write packet
-        while (len > 0)
+        for (int i = 1; i < 256; i++)
         {
-                ret = ser_int->write(ptr, len, num);
+                if (in_flight[i].active)
+                {
+                        pkt = in_flight[i].pkt;
+                        complete_request(i, RS_Cancelled, pkt);
+                }
+        }
+        
+        for (size_t i = 0; i < queued.size(); i++)
+                queued[i].slot(RS_Cancelled, queued[i].pkt);
+}
+
+
+int ZigBeeInterface::check_timeouts()
+{
+        uint64_t now = get_time();
+        uint64_t next = 0;
+        ZigBeePacket pkt;
+        
+        if (in_flight_count == 0)
+                return -1;
                 
-                if (ret != SerialInterface::SS_Success)
+        for (int i = 1; i < 256; i++)
+        {
+                if (in_flight[i].active && in_flight[i].deadline <= now)
                 {
-                        std::cerr << "[ZigBeeInterface] Error: unable to write packet!" << std::endl;
-                        m_signal_error.emit();
-                        return;
+                        pkt = in_flight[i].pkt;
+                        complete_request(i, RS_Timeout, pkt);
                 }
+        }
+        
+        send_requests();
+        
+        for (int i = 1; i < 256; i++)
+        {
+                if (in_flight[i].active && (next == 0 || in_flight[i].deadline < next))
+                        next = in_flight[i].deadline;
+        }
+        
+        if (next == 0)
+                return -1;
                 
-                if (num > 0)
-                        m_signal_send_raw_data.emit(ptr, num);
+        return next > now ? next - now : 0;
+}
+
+
+size_t ZigBeeInterface::set_window(size_t w)
+{
+        // frame IDs 1 to 255 are available
+        if (w < 1)
+                w = 1;
+        if (w > 255)
+                w = 255;
                 
-                len -= num;
-                ptr += num;
+        window = w;
+        
+        send_requests();
+        
+        return window;
+}
+
+
+size_t ZigBeeInterface::get_window()
+{
+        return window;
+}
+
+
+unsigned int ZigBeeInterface::set_request_timeout(unsigned int t)
+{
+        request_timeout = t;
+        return request_timeout;
+}
+
+
+unsigned int ZigBeeInterface::get_request_timeout()
+{
+        return request_timeout;
+}
+
+
+size_t ZigBeeInterface::get_in_flight_count()
+{
+        return in_flight_count;
+}
+
+
+size_t ZigBeeInterface::get_queued_request_count()
+{
+        return requests.size();
+}
+
+
+bool ZigBeeInterface::set_escaped(bool e)
+{
+        if ((Thread::atomic_get(&escaped) != 0) != e)
+        {
+                // partial frames in the old format are useless
+                Thread::atomic_set(&escaped, e);
+                Thread::atomic_set(&reset_requested, 1);
+        }
+        
+        return e;
+}
+
+
+bool ZigBeeInterface::get_escaped()
+{
+        return Thread::atomic_get(&escaped) != 0;
+}
+
+
+size_t ZigBeeInterface::get_receive_overflows()
+{
+        return rx_queue.get_dropped_count();
+}
+
+
+Metrics &ZigBeeInterface::get_metrics()
+{
+        metrics.set(Metrics::MC_ReceiveOverflows, rx_queue.get_dropped_count());
+        
+        if (transport)
+        {
+                metrics.set(Metrics::MC_TxQueueBytes, transport->get_queued_write_count());
+                metrics.set(Metrics::MC_TxQueueMax, transport->get_queued_write_max());
         }
+        
+        return metrics;
+}
+
+
+void ZigBeeInterface::set_topology(NetworkTopology *t)
+{
+        topology = t;
+}
+
+
+NetworkTopology *ZigBeeInterface::get_topology()
+{
+        return topology;
 }
 
 
@@ -151,6 +450,18 @@ sigc::signal<void, ZigBeePacket> ZigBeeInterface::signal_receive_packet()
 }
 
 
+sigc::signal<void, const std::vector<ZigBeePacketView>&> ZigBeeInterface::signal_receive_frames()
+{
+        return m_signal_receive_frames;
+}
+
+
+sigc::signal<void, std::vector<ZigBeePacket>&> ZigBeeInterface::signal_receive_packets()
+{
+        return m_signal_receive_packets;
+}
+
+
 sigc::signal<void, const char*, size_t> ZigBeeInterface::signal_send_raw_data()
 {
         return m_signal_send_raw_data;
@@ -169,70 +480,291 @@ sigc::signal<void> ZigBeeInterface::signal_error()
 }
 
 
-void ZigBeeInterface::on_receive_data()
+sigc::signal<void> ZigBeeInterface::signal_write_space()
 {
-        gsize num;
-        int status;
-        static char buf[1024];
-        ZigBeePacket pkt;
+        return m_signal_write_space;
+}
+
+
+char *ZigBeeInterface::get_receive_space(size_t &count)
+{
+        if (Thread::atomic_exchange(&reset_requested, 0))
+        {
+                parser.reset();
+                parser.set_escaped(Thread::atomic_get(&escaped) != 0);
+        }
+        
+        receive_ptr = (char *)parser.get_buffer().get_write_ptr();
+        count = parser.get_buffer().get_write_space();
+        
+        return receive_ptr;
+}
+
+
+bool ZigBeeInterface::receive(size_t count)
+{
+        const uint8_t *frame;
         size_t len;
+        size_t frames = 0;
+        uint64_t start = Metrics::now();
+        uint64_t parsed;
         
-        if (!ser_int)
+        if (Thread::atomic_get(&reset_requested))
         {
-                std::cerr << "[ZigBeeInterface] No SerialInterface associated!" << std::endl;
-                m_signal_error.emit();
-                return;
+                // buffer was reset after the read was started, drop the data
+                return false;
         }
         
-        // read raw data from serial port
-        do
+        // keep a copy of the raw data, the parser unescapes in place
+        rx_queue.push(RQ_Raw, receive_ptr, count);
+        
+        parser.get_buffer().commit(count);
+        
+        // read packets, parser resumes where it left off; a full queue
+        // drops frames rather than waiting for the main loop
+        while (parser.read_frame(frame, len))
         {
-                status = ser_int->read(buf, 1024, num);
-                
-                if (status == SerialInterface::SS_Error)
+                rx_queue.push(RQ_Frame, frame, len);
+                frames++;
+        }
+        
+        metrics.add(Metrics::MC_Reads);
+        metrics.add(Metrics::MC_BytesRead, count);
+        
+        // parser counts are only touched from this thread
+        if (parser.get_junk_bytes() != junk_seen || parser.get_checksum_errors() != checksum_seen)
+        {
+                metrics.add(Metrics::MC_JunkBytes, parser.get_junk_bytes() - junk_seen);
+                metrics.add(Metrics::MC_ChecksumErrors, parser.get_checksum_errors() - checksum_seen);
+                junk_seen = parser.get_junk_bytes();
+                checksum_seen = parser.get_checksum_errors();
+        }
+        
+        if (frames > 0)
+        {
+                // stamp the batch so the main loop can time its delivery
+                parsed = Metrics::now();
+                metrics.add(Metrics::MC_FramesParsed, frames);
+                metrics.record(Metrics::MS_ReadToParsed, parsed - start);
+                rx_queue.push(RQ_Stamp, &parsed, sizeof(parsed));
+        }
+        
+        // wake the main loop for complete frames, or when nothing is left
+        // half-parsed so that stray bytes still show up promptly
+        return frames > 0 || parser.is_idle();
+}
+
+
+void ZigBeeInterface::on_receive_data()
+{
+        SpscQueue::Record r;
+        size_t raw = 0;
+        size_t count = 0;
+        
+        // take everything queued so far; frames are delivered in place and
+        // their space is released once all handlers have run
+        while (rx_queue.read(r))
+        {
+                if (r.type == RQ_Raw)
                 {
-                        std::cerr << "[ZigBeeInterface] Read error!" << std::endl;
-                        m_signal_error.emit();
-                        ser_int->close_port();
-                        return;
+                        raw += r.length;
+                        m_signal_receive_raw_data.emit((const char *)r.data, r.length);
+                        continue;
                 }
                 
-                if (status == SerialInterface::SS_EOF)
+                if (r.type == RQ_Stamp)
                 {
-                        std::cerr << "[ZigBeeInterface] End of file!" << std::endl;
-                        m_signal_error.emit();
-                        ser_int->close_port();
-                        return;
+                        uint64_t stamp;
+                        memcpy(&stamp, r.data, sizeof(stamp));
+                        deliver_stamps.push_back(stamp);
+                        continue;
                 }
                 
-                if (debug)
+                if (count == deliver_views.size())
+                        deliver_views.push_back(ZigBeePacketView());
+                deliver_views[count++].set(r.data, r.length);
+        }
+        
+        deliver_views.resize(count);
+        
+        if (debug)
+        {
+                std::cout << "[ZigBeeInterface] Read " << std::dec << raw << " bytes" << std::endl;
+        }
+        
+        if (count > 0)
+        {
+                uint64_t now = Metrics::now();
+                
+                for (size_t i = 0; i < deliver_stamps.size(); i++)
+                        metrics.record(Metrics::MS_ParsedToDelivered, now - deliver_stamps[i]);
+                metrics.add(Metrics::MC_FramesDelivered, count);
+                
+                // handlers see the routes these frames report
+                if (topology)
                 {
-                        std::cout << "[ZigBeeInterface] Read " << std::dec << num << " bytes" << std::endl;
+                        for (size_t i = 0; i < count; i++)
+                                topology->add(deliver_views[i]);
                 }
                 
-                for (int i = 0; i < num; i++)
+                m_signal_receive_frames.emit(deliver_views);
+        }
+        
+        deliver_stamps.clear();
+        
+        // only pay for decoding if someone wants whole packets
+        if (count > 0 && (!m_signal_receive_packets.empty() || !m_signal_receive_packet.empty()))
+        {
+                if (deliver_packets.size() < count)
+                        deliver_packets.resize(count);
+                        
+                for (size_t i = 0; i < count; i++)
+                        deliver_views[i].decode(deliver_packets[i]);
+                        
+                // shrink without releasing storage held by the remaining packets
+                while (deliver_packets.size() > count)
+                        deliver_packets.pop_back();
+                        
+                m_signal_receive_packets.emit(deliver_packets);
+                
+                if (!m_signal_receive_packet.empty())
+                {
+                        for (size_t i = 0; i < deliver_packets.size(); i++)
+                                m_signal_receive_packet.emit(deliver_packets[i]);
+                }
+        }
+        
+        // match responses with requests in flight
+        if (in_flight_count > 0)
+        {
+                for (size_t i = 0; i < count; i++)
                 {
-                        read_data_queue.push_back(buf[i]);
+                        const ZigBeePacketView &v = deliver_views[i];
+                        
+                        if (!v.has_field(ZigBeePacket::ZBPF_FrameID))
+                                continue;
+                                
+                        int id = v.get_frame_id();
+                        
+                        if (!in_flight[id].active || in_flight[id].response != v.get_identifier())
+                                continue;
+                                
+                        v.decode(response_pkt);
+                        complete_request(id, RS_Success, response_pkt);
                 }
                 
-                if (num > 0)
-                        m_signal_receive_raw_data.emit(buf, num);
+                send_requests();
         }
-        while (num == 1024);
         
-        // try to read packets
-        do
+        rx_queue.release();
+}
+
+
+void ZigBeeInterface::on_port_error()
+{
+        std::cerr << "[ZigBeeInterface] Read error!" << std::endl;
+        m_signal_error.emit();
+}
+
+
+void ZigBeeInterface::on_port_write_space()
+{
+        send_requests();
+        
+        m_signal_write_space.emit();
+}
+
+
+void ZigBeeInterface::on_port_opened()
+{
+        reset_buffer();
+        
+        // the radio may have been reset and lost the routes it was sent
+        if (topology)
+                topology->reset_sent_routes();
+        
+        // XON and XOFF bytes in frames would be eaten by the port
+        if (transport->has_software_flow() && !get_escaped())
+                std::cerr << "[ZigBeeInterface] Warning: XON/XOFF flow control needs escaped (AP=2) mode" << std::endl;
+}
+
+
+void ZigBeeInterface::on_port_closed()
+{
+        reset_buffer();
+        cancel_requests();
+}
+
+
+void ZigBeeInterface::send_requests()
+{
+        int id;
+        
+        // hold requests back while the port is behind, port_write_space
+        // brings us back here
+        while (!requests.empty() && in_flight_count < window && is_connected() &&
+                !transport->is_write_blocked())
         {
-                len = 0;
-                if (pkt.read_packet(read_data_queue, len))
+                // next frame ID not in flight, the window keeps one free
+                do
                 {
-                        pkt.decode_packet();
-                        m_signal_receive_packet.emit(pkt);
+                        id = next_frame_id;
+                        next_frame_id = next_frame_id < 255 ? next_frame_id + 1 : 1;
                 }
-                for (int i = 0; i < len; i++)
-                        read_data_queue.pop_front();
+                while (in_flight[id].active);
+                
+                InFlight &f = in_flight[id];
+                Request &r = requests.front();
+                
+                r.pkt.set_field_value(ZigBeePacket::ZBPF_FrameID, id);
+                r.pkt.build_packet();
+                
+                f.active = true;
+                f.response = ZigBeePacket::get_response_identifier(r.pkt.identifier);
+                f.deadline = get_time() + r.timeout;
+                f.pkt = r.pkt;
+                f.slot = r.slot;
+                in_flight_count++;
+                
+                requests.pop_front();
+                
+                send_packet(f.pkt);
         }
-        while (read_data_queue.size() > 0 && len > 0);
+}
+
+
+void ZigBeeInterface::complete_request(int frame_id, RequestStatus status, const ZigBeePacket &pkt)
+{
+        InFlight &f = in_flight[frame_id];
+        RequestSlot slot;
+        
+        if (!f.active)
+                return;
+                
+        // free the entry first, the callback may send another request
+        slot = f.slot;
+        f.slot = RequestSlot();
+        f.active = false;
+        in_flight_count--;
+        
+        slot(status, pkt);
+}
+
+
+// Static
+uint64_t ZigBeeInterface::get_time()
+{
+        #ifdef __unix__
+        
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+        
+        #elif defined _WIN32
+        
+        return GetTickCount();
+        
+        #endif
 }
 
 
@@ -34,10 +34,15 @@
 #ifndef __ZIGBEE_INTERFACE_H
 #define __ZIGBEE_INTERFACE_H
 
-#include <gtkmm.h>
+#include <sigc++/sigc++.h>
 
 #include "ZigBeePacket.h"
-#include "SerialInterface.h"
+#include "ZigBeePacketView.h"
+#include "ZigBeeFrameParser.h"
+#include "Transport.h"
+#include "SpscQueue.h"
+#include "Metrics.h"
+#include "NetworkTopology.h"
 
 #include <string>
 #include <tr1/memory>
@@ -48,11 +53,35 @@
 /** ZigBee Interface
  * 
  * The ZigBee interface class is used to manage transmission and reception
- * of ZigBee packets through a serial interface to a ZigBee module.
+ * of ZigBee packets through a transport, a serial port or a socket, to a
+ * ZigBee module.  Frames are parsed on the transport I/O thread and handed
+ * to the main loop in batches.  Requests sent with send_request() are given frame IDs and
+ * matched with their responses, with a configurable number in flight.  
  */
-class ZigBeeInterface
+class ZigBeeInterface : public TransportReceiver
 {
 public:
+        /**
+         * Request completion status.
+         * @see send_request()
+         */
+        typedef enum
+        {
+                RS_Success = 0,
+                RS_Timeout = 1,
+                RS_Cancelled = 2,
+        }
+        RequestStatus;
+        
+        /**
+         * Request completion callback.
+         * @par Prototype:
+         * <tt>void on_my_%request_done(ZigBeeInterface::RequestStatus status, const ZigBeePacket &pkt)</tt>
+         * @par
+         * pkt is the response for RS_Success, the request otherwise.
+         */
+        typedef sigc::slot<void, RequestStatus, const ZigBeePacket&> RequestSlot;
+        
         /**
          * Create a ZigBee Interface.
          */
@@ -60,48 +89,224 @@ public:
         virtual ~ZigBeeInterface();
         
         /**
-         * Connect a serial interface
-         * @param si shared_ptr to the serial interface object to associate.
-         * with
-         * @see clear_serial_interface()
-         * @see has_serial_interface()
+         * Connect a transport, a serial interface or a socket.
+         * @param t shared_ptr to the transport object to associate with
+         * @see clear_transport()
+         * @see has_transport()
          */
-        void set_serial_interface(std::tr1::shared_ptr<SerialInterface> si);
+        void set_transport(std::tr1::shared_ptr<Transport> t);
         
         /**
-         * Disconnect from currently connected serial interface.
-         * @see set_serial_interface()
-         * @see has_serial_interface()
+         * Disconnect from currently connected transport.
+         * @see set_transport()
+         * @see has_transport()
          */
-        void clear_serial_interface();
+        void clear_transport();
         
         /**
-         * Check if serial interface is associated.
+         * Check if transport is associated.
          * @return true if associated to an interface, false if not
-         * @see set_serial_interface()
-         * @see clear_serial_interface()
+         * @see set_transport()
+         * @see clear_transport()
          */
-        bool has_serial_interface();
+        bool has_transport();
         
         /**
          * Check if connected.
          * @return true if associated to an interface and the interface is
          * connected
-         * @see has_serial_interface()
+         * @see has_transport()
          */
         bool is_connected();
         
         /**
          * Clear receive buffer.
-         * @see read_data_queue
+         * @see parser
          */
         void reset_buffer();
         
         /**
-         * Transmit a packet.
+         * Inject received data.  Data is parsed and delivered exactly as if
+         * it had been read from the transport, including the receive
+         * raw data signal.  Used to replay captures; must not be called
+         * while the port is open.
+         * @param data pointer to data
+         * @param count number of bytes
+         */
+        void inject_receive_data(const char *data, size_t count);
+        
+        /**
+         * Transmit a packet.  The frame is encoded straight into a
+         * transport write buffer and queued, so sending neither waits for
+         * the port nor allocates once the buffer pool is warm.
          * @param pkt packet to transmit
+         * @see Transport::queue_write()
+         */
+        void send_packet(const ZigBeePacket &pkt);
+        
+        /**
+         * Transmit frames that are already encoded, in the escaped mode of
+         * the interface, as one write buffer.  The frames are not looked
+         * at, so the sender must send any source routes itself.
+         * @param data encoded frames
+         * @param count number of bytes
+         * @return true if queued
+         * @see send_packet()
+         * @see NetworkTopology::get_source_route()
+         */
+        bool send_encoded(const uint8_t *data, size_t count);
+        
+        /**
+         * Transmit a received frame as is, such as one taken from a bridge
+         * client.  Encoded straight into a write buffer like send_packet().
+         * @param frame frame to transmit
+         * @return true if queued
+         * @see send_packet()
+         */
+        bool send_frame(const ZigBeePacketView &frame);
+        
+        /**
+         * Check write blocked.  Bulk senders should hold frames back while
+         * this is true and resume on signal_write_space().
+         * @return true if the transport write limit was reached, or
+         * there is no transport
+         * @see Transport::is_write_blocked()
+         */
+        bool is_write_blocked();
+        
+        /**
+         * Get number of bytes queued for transmission and not yet written.
+         * @return bytes, 0 if there is no transport
+         * @see Transport::get_queued_write_count()
+         */
+        size_t get_queued_write_count();
+        
+        /**
+         * Transmit a request and wait for its response.  The request is
+         * given the next free frame ID and sent as soon as fewer than
+         * get_window() requests are in flight.  The callback is called on
+         * the main loop when the matching response arrives, when the
+         * request times out or when it is cancelled.  Timeouts are only
+         * noticed when check_timeouts() is called.
+         * @param pkt request, any frame ID set is replaced
+         * @param slot completion callback
+         * @param timeout timeout in ms, 0 for get_request_timeout()
+         * @return true if queued, false if the frame type gets no response
+         * or the port is not open
+         * @see ZigBeePacket::get_response_identifier()
+         * @see check_timeouts()
+         */
+        bool send_request(const ZigBeePacket &pkt, const RequestSlot &slot, unsigned int timeout = 0);
+        
+        /**
+         * Cancel all queued and in flight requests.  Callbacks are called
+         * with RS_Cancelled.  Done automatically when the port closes.
+         */
+        void cancel_requests();
+        
+        /**
+         * Time out expired requests.  Must be called from the main loop
+         * while requests are in flight.
+         * @return ms until the next request expires, or -1 if none are in
+         * flight
+         */
+        int check_timeouts();
+        
+        /**
+         * Set request window.
+         * @param w maximum number of requests in flight, 1 to 255
+         * @return request window
+         * @see send_request()
+         */
+        size_t set_window(size_t w);
+        
+        /**
+         * Get request window.
+         * @return request window
+         * @see set_window()
+         */
+        size_t get_window();
+        
+        /**
+         * Set default request timeout.
+         * @param t timeout in ms
+         * @return timeout
+         * @see send_request()
+         */
+        unsigned int set_request_timeout(unsigned int t);
+        
+        /**
+         * Get default request timeout.
+         * @return timeout in ms
+         * @see set_request_timeout()
+         */
+        unsigned int get_request_timeout();
+        
+        /**
+         * Get number of requests sent and waiting for a response.
+         * @return requests in flight
          */
-        void send_packet(ZigBeePacket pkt);
+        size_t get_in_flight_count();
+        
+        /**
+         * Get number of requests waiting for room in the window.
+         * @return queued requests
+         */
+        size_t get_queued_request_count();
+        
+        /**
+         * Set escaped mode.  If escaped mode is enabled, packets are sent and
+         * received in API mode 2 (AP=2) format, with control bytes escaped so
+         * that software flow control can be used.
+         * @param e escaped mode
+         * @return escaped mode
+         * @see get_escaped()
+         */
+        bool set_escaped(bool e);
+        
+        /**
+         * Get escaped mode.
+         * @return escaped mode
+         * @see set_escaped()
+         */
+        bool get_escaped();
+        
+        /**
+         * Get number of receive overflows.  Counts raw data chunks and
+         * frames dropped because the main loop fell behind the I/O thread
+         * by more than the receive queue holds.
+         * @return records dropped
+         * @see SpscQueue
+         */
+        size_t get_receive_overflows();
+        
+        /**
+         * Get receive path metrics.  Counters are kept as data is read and
+         * delivered; the receive overflow and transmit queue gauges are
+         * brought up to date by this call.  The delivered to rendered
+         * stage is left to the application to record.
+         * @return metrics
+         */
+        Metrics &get_metrics();
+        
+        /**
+         * Set network topology.  Frames received are added to it before
+         * they are delivered, and ZigBee transmit requests sent with
+         * send_packet() or send_frame() to a node it knows a route to are
+         * preceded by a Create Source Route frame when the route has
+         * changed, so the radio does not have to discover it.  The
+         * topology is not owned and must outlive the interface.
+         * @param t topology, 0 for none
+         * @see get_topology()
+         */
+        void set_topology(NetworkTopology *t);
+        
+        /**
+         * Get network topology.
+         * @return topology, 0 for none
+         * @see set_topology()
+         */
+        NetworkTopology *get_topology();
         
         /**
          * Set debug status.  If debug mode is enabled, received byte counts
@@ -127,6 +332,27 @@ public:
          */
         sigc::signal<void, ZigBeePacket> signal_receive_packet();
         
+        /**
+         * Receive frames signal.  Emitted once per wake up with a view of
+         * every frame received, before any packets are decoded.  The views
+         * point into the receive buffers and are only valid during the
+         * signal; handlers that need to keep a frame must copy or decode it.
+         * @par Prototype:
+         * <tt>void on_my_%receive_frames(const std::vector<ZigBeePacketView> &frames)</tt>
+         */
+        sigc::signal<void, const std::vector<ZigBeePacketView>&> signal_receive_frames();
+        
+        /**
+         * Receive packets signal.  Emitted once per wake up with every
+         * packet decoded from the data received, before signal_receive_packet
+         * is emitted for each one.  Handlers may swap the contents out of the
+         * vector to keep them.  Packets are only decoded if this signal or
+         * signal_receive_packet has handlers.
+         * @par Prototype:
+         * <tt>void on_my_%receive_packets(std::vector<ZigBeePacket> &pkts)</tt>
+         */
+        sigc::signal<void, std::vector<ZigBeePacket>&> signal_receive_packets();
+        
         /**
          * Send raw data signal. 
          * @par Prototype:
@@ -148,24 +374,234 @@ public:
          */
         sigc::signal<void> signal_error();
         
+        /**
+         * Write space signal, emitted when the transport is no
+         * longer write blocked, after queued requests have been sent.
+         * @par Prototype:
+         * <tt>void on_my_%write_space()</tt>
+         */
+        sigc::signal<void> signal_write_space();
+        
+        /**
+         * Get receive space.  Called on the transport I/O thread.
+         * @param count return number of bytes available
+         * @return pointer to parser buffer space
+         * @see TransportReceiver
+         */
+        virtual char *get_receive_space(size_t &count);
+        
+        /**
+         * Parse received data.  Called on the transport I/O thread.
+         * @param count number of bytes read
+         * @return true if the main loop should be notified
+         * @see TransportReceiver
+         */
+        virtual bool receive(size_t count);
+        
 protected:
         /**
-         * Serial interface receive data event handler.
+         * Transport receive data event handler.  Delivers data
+         * parsed by the I/O thread.
          */
         void on_receive_data();
         
         /**
-         * Shared pointer to serial interface instance.
-         * @see set_serial_interface()
-         * @see clear_serial_interface()
-         * @see has_serial_interface()
+         * Transport port error event handler.
+         */
+        void on_port_error();
+        
+        /**
+         * Transport write space event handler.
+         */
+        void on_port_write_space();
+        
+        /**
+         * Transport port opened event handler.
+         */
+        void on_port_opened();
+        
+        /**
+         * Transport port closed event handler.
+         */
+        void on_port_closed();
+        
+        /**
+         * Send queued requests while there is room in the window and the
+         * port is not write blocked.
+         * @see send_request()
+         * @see Transport::is_write_blocked()
+         */
+        void send_requests();
+        
+        /**
+         * Complete an in flight request and call its callback.
+         * @param frame_id frame ID of request
+         * @param status completion status
+         * @param pkt packet passed to the callback
+         */
+        void complete_request(int frame_id, RequestStatus status, const ZigBeePacket &pkt);
+        
+        /**
+         * Get monotonic time.
+         * @return time in ms
+         */
+        static uint64_t get_time();
+        
+        /**
+         * Request waiting for room in the window.
+         */
+        struct Request
+        {
+                ZigBeePacket pkt;               ///< Request packet
+                RequestSlot slot;               ///< Completion callback
+                unsigned int timeout;           ///< Timeout in ms
+        };
+        
+        /**
+         * Request in flight.
+         */
+        struct InFlight
+        {
+                bool active;                    ///< Entry in use
+                int response;                   ///< Expected response identifier
+                uint64_t deadline;              ///< Expiry time in ms
+                ZigBeePacket pkt;               ///< Request packet
+                RequestSlot slot;               ///< Completion callback
+        };
+        
+        /**
+         * Shared pointer to transport instance.
+         * @see set_transport()
+         * @see clear_transport()
+         * @see has_transport()
+         */
+        std::tr1::shared_ptr<Transport> transport;
+        
+        /**
+         * Receive queue record types.
+         * @see rx_queue
+         */
+        typedef enum
+        {
+                RQ_Raw = 0,
+                RQ_Frame = 1,
+                RQ_Stamp = 2,
+        }
+        ReceiveRecord;
+        
+        /**
+         * Frame parser.  Owns the receive buffer that serial data is read
+         * into.  Only used by the I/O thread while the port is open.
+         */
+        ZigBeeFrameParser parser;
+        
+        /**
+         * Pointer to the space returned by get_receive_space().
+         */
+        char *receive_ptr;
+        
+        /**
+         * Raw data and frame payloads handed from the I/O thread to the
+         * main loop.  The I/O thread never waits on the main loop; if the
+         * queue fills up, records are dropped and counted.
+         * @see get_receive_overflows()
+         */
+        SpscQueue rx_queue;
+        
+        /**
+         * Views of the frames being delivered, pointing into rx_queue.
+         * @see signal_receive_frames()
+         */
+        std::vector<ZigBeePacketView> deliver_views;
+        
+        /**
+         * Parse times of the frames being delivered, one per read that
+         * completed any frames.
+         */
+        std::vector<uint64_t> deliver_stamps;
+        
+        /**
+         * Receive path metrics.
+         * @see get_metrics()
+         */
+        Metrics metrics;
+        
+        /**
+         * Network topology, 0 for none.
+         * @see set_topology()
+         */
+        NetworkTopology *topology;
+        
+        /**
+         * Create Source Route frame sent ahead of a transmit request.
+         */
+        ZigBeePacket route_pkt;
+        
+        /**
+         * Parser junk and checksum counts already added to metrics.  Only
+         * used by the I/O thread.
+         */
+        size_t junk_seen;
+        size_t checksum_seen;
+        
+        /**
+         * Decoded packets being delivered.  Packets are decoded in place so
+         * their storage is reused from one batch to the next.
+         * @see signal_receive_packets()
+         */
+        std::vector<ZigBeePacket> deliver_packets;
+        
+        /**
+         * Requests waiting for room in the window.
+         * @see send_requests()
+         */
+        std::deque<Request> requests;
+        
+        /**
+         * Requests in flight, indexed by frame ID.  Frame ID 0 asks for no
+         * response, so entry 0 is never used.
+         */
+        InFlight in_flight[256];
+        
+        /**
+         * Number of active entries in in_flight.
+         */
+        size_t in_flight_count;
+        
+        /**
+         * Maximum number of requests in flight.
+         * @see set_window()
+         */
+        size_t window;
+        
+        /**
+         * Default request timeout in ms.
+         * @see set_request_timeout()
+         */
+        unsigned int request_timeout;
+        
+        /**
+         * Next frame ID to try.
+         */
+        int next_frame_id;
+        
+        /**
+         * Response being delivered to a request callback.
+         */
+        ZigBeePacket response_pkt;
+        
+        /**
+         * Parser reset requested.  Applied by the I/O thread on the next
+         * read.  Accessed atomically.
          */
-        std::tr1::shared_ptr<SerialInterface> ser_int;
+        volatile int reset_requested;
         
         /**
-         * Double ended read data queue.
+         * Escaped mode.  Applied to the parser by the I/O thread.  Accessed
+         * atomically.
+         * @see set_escaped()
          */
-        std::deque<char> read_data_queue;
+        volatile int escaped;
         
         /**
          * Debug mode.
@@ -179,6 +615,16 @@ protected:
          */
         sigc::signal<void, ZigBeePacket> m_signal_receive_packet;
         
+        /**
+         * Receive frames signal.
+         */
+        sigc::signal<void, const std::vector<ZigBeePacketView>&> m_signal_receive_frames;
+        
+        /**
+         * Receive packets signal.
+         */
+        sigc::signal<void, std::vector<ZigBeePacket>&> m_signal_receive_packets;
+        
         /**
          * Send raw data signal.
          */
@@ -195,19 +641,34 @@ protected:
         sigc::signal<void> m_signal_error;
         
         /**
-         * Serial interface port opened signal connection.
+         * Write space signal.
+         */
+        sigc::signal<void> m_signal_write_space;
+        
+        /**
+         * Transport port opened signal connection.
          */
         sigc::connection c_port_opened;
         
         /**
-         * Serial interface port closed signal connection.
+         * Transport port closed signal connection.
          */
         sigc::connection c_port_closed;
         
         /**
-         * Serial interface port receive data signal connection.
+         * Transport port write space signal connection.
+         */
+        sigc::connection c_port_write_space;
+        
+        /**
+         * Transport port receive data signal connection.
          */
         sigc::connection c_port_receive_data;
+        
+        /**
+         * Transport port error signal connection.
+         */
+        sigc::connection c_port_error;
 };
 
 #endif //__ZIGBEE_INTERFACE_H
@@ -32,78 +32,197 @@
 /************************************************************************/
 
 #include "ZigBeePacket.h"
+#include "HexCodec.h"
 
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
+#include <string.h>
+
+// Frame types.  Fields are listed in payload order; offsets follow from
+// the field sizes.
+const ZigBeePacket::ZBP_FrameDef ZigBeePacket::frame_defs[] = {
+        {ZBPID_TxRequest64, "Transmit Request (64-bit address)",
+                {ZBPF_FrameID, ZBPF_Dest64, ZBPF_Options, ZBPF_Data}},
+        {ZBPID_TxRequest16, "Transmit Request (16-bit address)",
+                {ZBPF_FrameID, ZBPF_Dest16, ZBPF_Options, ZBPF_Data}},
+        {ZBPID_ATCommand, "AT Command",
+                {ZBPF_FrameID, ZBPF_ATCommand, ZBPF_Data}},
+        {ZBPID_ATCommandQueueRegisterValue, "AT Command Queue Register Value",
+                {ZBPF_FrameID, ZBPF_ATCommand, ZBPF_Data}},
+        {ZBPID_TxRequest, "Transmit Request",
+                {ZBPF_FrameID, ZBPF_Dest64, ZBPF_Dest16, ZBPF_Radius, ZBPF_Options, ZBPF_Data}},
+        {ZBPID_EATxRequest, "Explicit Addressing Transmit Request",
+                {ZBPF_FrameID, ZBPF_Dest64, ZBPF_Dest16, ZBPF_SrcEndpoint, ZBPF_DestEndpoint,
+                ZBPF_ClusterID, ZBPF_ProfileID, ZBPF_Radius, ZBPF_Options, ZBPF_Data}},
+        {ZBPID_RemoteATCommand, "Remote AT Command",
+                {ZBPF_FrameID, ZBPF_Dest64, ZBPF_Dest16, ZBPF_Options, ZBPF_ATCommand, ZBPF_Data}},
+        {ZBPID_CreateSourceRoute, "Create Source Route",
+                {ZBPF_FrameID, ZBPF_Dest64, ZBPF_Dest16, ZBPF_Options, ZBPF_RouteRecords}},
+        {ZBPID_RegisterJoiningDevice, "Register Joining Device",
+                {ZBPF_FrameID, ZBPF_Dest64, ZBPF_Dest16, ZBPF_Options, ZBPF_Data}},
+        {ZBPID_RxPacket64, "Receive Packet (64-bit address)",
+                {ZBPF_Src64, ZBPF_RSSI, ZBPF_Options, ZBPF_Data}},
+        {ZBPID_RxPacket16, "Receive Packet (16-bit address)",
+                {ZBPF_Src16, ZBPF_RSSI, ZBPF_Options, ZBPF_Data}},
+        {ZBPID_RxPacketIO64, "Receive Packet (64-bit address IO)",
+                {ZBPF_Src64, ZBPF_RSSI, ZBPF_Options, ZBPF_Data}},
+        {ZBPID_RxPacketIO16, "Receive Packet (16-bit address IO)",
+                {ZBPF_Src16, ZBPF_RSSI, ZBPF_Options, ZBPF_Data}},
+        {ZBPID_ATCommandResponse, "AT Command Response",
+                {ZBPF_FrameID, ZBPF_ATCommand, ZBPF_Status, ZBPF_Data}},
+        {ZBPID_TxStatusS1, "Transmit Status (S1)",
+                {ZBPF_FrameID, ZBPF_Status}},
+        {ZBPID_ModemStatus, "Modem Status",
+                {ZBPF_Status}},
+        {ZBPID_TxStatusS2, "Transmit Status (S2)",
+                {ZBPF_FrameID, ZBPF_Dest16, ZBPF_TransmitRetries, ZBPF_DeliveryStatus, ZBPF_DiscoveryStatus}},
+        {ZBPID_RxPacket, "Receive Packet",
+                {ZBPF_Src64, ZBPF_Src16, ZBPF_Options, ZBPF_Data}},
+        {ZBPID_EARxPacket, "Explicit Addressing Receive Packet",
+                {ZBPF_Src64, ZBPF_Src16, ZBPF_SrcEndpoint, ZBPF_DestEndpoint, ZBPF_ClusterID,
+                ZBPF_ProfileID, ZBPF_Options, ZBPF_Data}},
+        // TODO decode samples
+        {ZBPID_IODataSampleRx, "IO Data Sample RX",
+                {ZBPF_Src64, ZBPF_Src16, ZBPF_Options, ZBPF_NumSamples, ZBPF_DigitalMask,
+                ZBPF_AnalogMask, ZBPF_Data}},
+        // TODO decode readings
+        {ZBPID_SensorRead, "Sensor Read",
+                {ZBPF_Src64, ZBPF_Src16, ZBPF_Options, ZBPF_Data}},
+        {ZBPID_NodeIdentification, "Node Identification",
+                {ZBPF_Sender64, ZBPF_Sender16, ZBPF_Options, ZBPF_Src16, ZBPF_Src64, ZBPF_Data}},
+        {ZBPID_RemoteCommandResponse, "Remote AT Command Response",
+                {ZBPF_FrameID, ZBPF_Src64, ZBPF_Src16, ZBPF_ATCommand, ZBPF_Status, ZBPF_Data}},
+        // TODO decode status
+        {ZBPID_OTAFirmwareUpdateStatus, "Over-the-Air Firmware Update Status",
+                {ZBPF_Src64, ZBPF_Dest16, ZBPF_Options, ZBPF_Data}},
+        {ZBPID_RouteRecord, "Route Record",
+                {ZBPF_Src64, ZBPF_Src16, ZBPF_Options, ZBPF_RouteRecords}},
+        {ZBPID_DeviceAuthenticated, "Device Authenticated",
+                {ZBPF_Src64, ZBPF_Src16, ZBPF_Status}},
+        {ZBPID_ManyToOneRouteRequest, "Many To One Route Request",
+                {ZBPF_FrameID, ZBPF_Src64, ZBPF_Src16, ZBPF_Reserved}},
+        {ZBPID_RegisterJoiningDeviceStatus, "Register Joining Device Status",
+                {ZBPF_FrameID, ZBPF_Status}},
+        {ZBPID_JoinNotificationStatus, "Join Notification Status",
+                {ZBPF_Parent16, ZBPF_New16, ZBPF_New64, ZBPF_Status}},
+};
+
+// Fields, in ZBP_Field order
+const ZigBeePacket::ZBP_FieldInfo ZigBeePacket::field_info[ZBPF_Count] = {
+        {0, 0, ZBPT_Reserved, ZBPD_Hex, 0, 0, 0},
+        {"Frame ID", "Frame ID:", ZBPT_Uint8, ZBPD_Hex, &ZigBeePacket::frame_id, 0, 0},
+        {"AT Command", "AT Command:", ZBPT_Chars, ZBPD_Hex, 0, 0, 0},
+        {"Status", "Status:", ZBPT_Uint8, ZBPD_Hex, &ZigBeePacket::status, 0, 0},
+        {"Options", "Options:", ZBPT_Uint8, ZBPD_Hex, &ZigBeePacket::options, 0, 0},
+        {0, 0, ZBPT_Reserved, ZBPD_Hex, 0, 0, 0},
+        {"Dest64", "Dest 64:", ZBPT_Uint64, ZBPD_Hex, 0, 0, &ZigBeePacket::dest64},
+        {"Dest16", "Dest 16:", ZBPT_Uint16, ZBPD_Hex, 0, &ZigBeePacket::dest16, 0},
+        {"Src64", "Source 64:", ZBPT_Uint64, ZBPD_Hex, 0, 0, &ZigBeePacket::src64},
+        {"Src16", "Source 16:", ZBPT_Uint16, ZBPD_Hex, 0, &ZigBeePacket::src16, 0},
+        {"Sender64", "Sender 64:", ZBPT_Uint64, ZBPD_Hex, 0, 0, &ZigBeePacket::sender64},
+        {"Sender16", "Sender 16:", ZBPT_Uint16, ZBPD_Hex, 0, &ZigBeePacket::sender16, 0},
+        {"Parent16", "Parent 16:", ZBPT_Uint16, ZBPD_Hex, 0, &ZigBeePacket::parent16, 0},
+        {"New64", "New 64:", ZBPT_Uint64, ZBPD_Hex, 0, 0, &ZigBeePacket::new64},
+        {"New16", "New 16:", ZBPT_Uint16, ZBPD_Hex, 0, &ZigBeePacket::new16, 0},
+        {"Source Endpoint", "Source EP:", ZBPT_Uint8, ZBPD_Hex, &ZigBeePacket::src_ep, 0, 0},
+        {"Destination Endpoint", "Dest EP:", ZBPT_Uint8, ZBPD_Hex, &ZigBeePacket::dest_ep, 0, 0},
+        {"Cluster ID", "Cluster ID:", ZBPT_Uint16, ZBPD_Hex, 0, &ZigBeePacket::cluster_id, 0},
+        {"Profile ID", "Profile ID:", ZBPT_Uint16, ZBPD_Hex, 0, &ZigBeePacket::profile_id, 0},
+        {"Radius", "Radius:", ZBPT_Uint8, ZBPD_Dec, &ZigBeePacket::radius, 0, 0},
+        {"Transmit Retries", "Transmit Retries:", ZBPT_Uint8, ZBPD_Dec, &ZigBeePacket::transmit_retries, 0, 0},
+        {"Delivery Status", "Delivery Status:", ZBPT_Uint8, ZBPD_Hex, &ZigBeePacket::delivery_status, 0, 0},
+        {"Discovery Status", "Discovery Status:", ZBPT_Uint8, ZBPD_Hex, &ZigBeePacket::discovery_status, 0, 0},
+        {"RSSI", "RSSI:", ZBPT_Uint8, ZBPD_RSSI, &ZigBeePacket::rssi, 0, 0},
+        {"Digital Mask", "Digital Mask:", ZBPT_Uint16, ZBPD_Hex, 0, &ZigBeePacket::digital_mask, 0},
+        {"Analog Mask", "Analog Mask:", ZBPT_Uint8, ZBPD_Hex, &ZigBeePacket::analog_mask, 0, 0},
+        {"Samples", "Samples:", ZBPT_Uint8, ZBPD_Dec, &ZigBeePacket::num_samples, 0, 0},
+        {"Data (hex)", "Data:", ZBPT_Bytes, ZBPD_Hex, 0, 0, 0},
+        {"Route records (hex)", "Route Records:", ZBPT_Words, ZBPD_Hex, 0, 0, 0},
+};
+
+struct ZigBeePacket::ZBP_LayoutTable
+{
+        ZBP_Layout layouts[256];
+        
+        ZBP_LayoutTable()
+        {
+                memset(layouts, 0, sizeof(layouts));
+                
+                for (size_t i = 0; i < sizeof(frame_defs) / sizeof(frame_defs[0]); i++)
+                {
+                        const ZBP_FrameDef &def = frame_defs[i];
+                        ZBP_Layout &l = layouts[def.identifier];
+                        int offset = 1;
+                        int n;
+                        
+                        l.desc = def.desc;
+                        
+                        for (n = 0; n < ZBP_MAX_FIELDS && def.fields[n] != ZBPF_None; n++)
+                        {
+                                l.fields[n].field = def.fields[n];
+                                l.fields[n].offset = offset;
+                                offset += get_field_size(def.fields[n]);
+                        }
+                        
+                        l.min_length = offset;
+                        l.num_fields = n;
+                }
+        }
+        
+        static int get_field_size(ZBP_Field f)
+        {
+                switch (field_info[f].type)
+                {
+                        case ZBPT_Uint16:
+                        case ZBPT_Chars:
+                                return 2;
+                        case ZBPT_Uint64:
+                                return 8;
+                        case ZBPT_Bytes:
+                                return 0;
+                        default:
+                                // including the count byte of ZBPT_Words
+                                return 1;
+                }
+        }
+};
 
-// Static
-bool ZigBeePacket::is_valid_identifier(int identifier)
+// big endian helpers
+static inline uint16_t get_uint16(const uint8_t *ptr)
 {
-        switch (identifier)
+        return ((uint16_t)ptr[0] << 8) | ptr[1];
+}
+
+static inline uint64_t get_uint64(const uint8_t *ptr)
+{
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++)
+                value = (value << 8) | ptr[i];
+        return value;
+}
+
+static inline void put_uint16(uint8_t *ptr, uint16_t value)
+{
+        ptr[0] = value >> 8;
+        ptr[1] = value;
+}
+
+static inline void put_uint64(uint8_t *ptr, uint64_t value)
+{
+        for (int i = 7; i >= 0; i--)
         {
-                case ZBPID_TxRequest64:
-                        return true;
-                case ZBPID_TxRequest16:
-                        return true;
-                case ZBPID_ATCommand:
-                        return true;
-                case ZBPID_ATCommandQueueRegisterValue:
-                        return true;
-                case ZBPID_TxRequest:
-                        return true;
-                case ZBPID_EATxRequest:
-                        return true;
-                case ZBPID_RemoteATCommand:
-                        return true;
-                case ZBPID_CreateSourceRoute:
-                        return true;
-                case ZBPID_RegisterJoiningDevice:
-                        return true;
-                case ZBPID_RxPacket64:
-                        return true;
-                case ZBPID_RxPacket16:
-                        return true;
-                case ZBPID_RxPacketIO64:
-                        return true;
-                case ZBPID_RxPacketIO16:
-                        return true;
-                case ZBPID_ATCommandResponse:
-                        return true;
-                case ZBPID_TxStatusS1:
-                        return true;
-                case ZBPID_ModemStatus:
-                        return true;
-                case ZBPID_TxStatusS2:
-                        return true;
-                case ZBPID_RxPacket:
-                        return true;
-                case ZBPID_EARxPacket:
-                        return true;
-                case ZBPID_IODataSampleRx:
-                        return true;
-                case ZBPID_SensorRead:
-                        return true;
-                case ZBPID_NodeIdentification:
-                        return true;
-                case ZBPID_RemoteCommandResponse:
-                        return true;
-                case ZBPID_OTAFirmwareUpdateStatus:
-                        return true;
-                case ZBPID_RouteRecord:
-                        return true;
-                case ZBPID_DeviceAuthenticated:
-                        return true;
-                case ZBPID_ManyToOneRouteRequest:
-                        return true;
-                case ZBPID_RegisterJoiningDeviceStatus:
-                        return true;
-                case ZBPID_JoinNotificationStatus:
-                        return true;
-                default:
-                        return false;
+                ptr[i] = value;
+                value >>= 8;
         }
 }
 
+// Static
+bool ZigBeePacket::is_valid_identifier(int identifier)
+{
+        return get_layout(identifier) != 0;
+}
+
 // Static
 std::vector<int> ZigBeePacket::get_valid_identifiers()
 {
@@ -120,72 +239,60 @@ std::vector<int> ZigBeePacket::get_valid_identifiers()
 
 // Static
 std::string ZigBeePacket::get_type_desc(int identifier)
+{
+        const ZBP_Layout *l = get_layout(identifier);
+        
+        if (!l)
+                return "Unknown";
+                
+        return l->desc;
+}
+
+// Static
+const ZigBeePacket::ZBP_Layout *ZigBeePacket::get_layout(int identifier)
+{
+        // built on first use; function statics are only initialized once,
+        // even when several threads decode at the same time
+        static const ZBP_LayoutTable table;
+        
+        if (identifier < 0 || identifier > 0xff || !table.layouts[identifier].desc)
+                return 0;
+                
+        return &table.layouts[identifier];
+}
+
+// Static
+int ZigBeePacket::get_response_identifier(int identifier)
 {
         switch (identifier)
         {
-                case ZBPID_TxRequest64:
-                        return "Transmit Request (64-bit address)";
-                case ZBPID_TxRequest16:
-                        return "Transmit Request (16-bit address)";
-                case ZBPID_ATCommand:
-                        return "AT Command";
-                case ZBPID_ATCommandQueueRegisterValue:
-                        return "AT Command Queue Register Value";
-                case ZBPID_TxRequest:
-                        return "Transmit Request";
-                case ZBPID_EATxRequest:
-                        return "Explicit Addressing Transmit Request";
-                case ZBPID_RemoteATCommand:
-                        return "Remote AT Command";
-                case ZBPID_CreateSourceRoute:
-                        return "Create Source Route";
-                case ZBPID_RegisterJoiningDevice:
-                        return "Register Joining Device";
-                case ZBPID_RxPacket64:
-                        return "Receive Packet (64-bit address)";
-                case ZBPID_RxPacket16:
-                        return "Receive Packet (16-bit address)";
-                case ZBPID_RxPacketIO64:
-                        return "Receive Packet (64-bit address IO)";
-                case ZBPID_RxPacketIO16:
-                        return "Receive Packet (16-bit address IO)";
-                case ZBPID_ATCommandResponse:
-                        return "AT Command Response";
-                case ZBPID_TxStatusS1:
-                        return "Transmit Status (S1)";
-                case ZBPID_ModemStatus:
-                        return "Modem Status";
-                case ZBPID_TxStatusS2:
-                        return "Transmit Status (S2)";
-                case ZBPID_RxPacket:
-                        return "Receive Packet";
-                case ZBPID_EARxPacket:
-                        return "Explicit Addressing Receive Packet";
-                case ZBPID_IODataSampleRx:
-                        return "IO Data Sample RX";
-                case ZBPID_SensorRead:
-                        return "Sensor Read";
-                case ZBPID_NodeIdentification:
-                        return "Node Identification";
-                case ZBPID_RemoteCommandResponse:
-                        return "Remote AT Command Response";
-                case ZBPID_OTAFirmwareUpdateStatus:
-                        return "Over-the-Air Firmware Update Status";
-                case ZBPID_RouteRecord:
-                        return "Route Record";
-                case ZBPID_DeviceAuthenticated:
-                        return "Device Authenticated";
-                case ZBPID_ManyToOneRouteRequest:
-                        return "Many To One Route Request";
-                case ZBPID_RegisterJoiningDeviceStatus:
-                        return "Register Joining Device Status";
-                case ZBPID_JoinNotificationStatus:
-                        return "Join Notification Status";
-                default:
-                        return "Unknown";
+        case ZBPID_TxRequest64:
+        case ZBPID_TxRequest16:
+                return ZBPID_TxStatusS1;
+        case ZBPID_ATCommand:
+        case ZBPID_ATCommandQueueRegisterValue:
+                return ZBPID_ATCommandResponse;
+        case ZBPID_TxRequest:
+        case ZBPID_EATxRequest:
+                return ZBPID_TxStatusS2;
+        case ZBPID_RemoteATCommand:
+                return ZBPID_RemoteCommandResponse;
+        case ZBPID_RegisterJoiningDevice:
+                return ZBPID_RegisterJoiningDeviceStatus;
+        default:
+                return 0;
         }
 }
 
+// Static
+const ZigBeePacket::ZBP_FieldInfo &ZigBeePacket::get_field_info(ZBP_Field f)
+{
+        if (f < 0 || f >= ZBPF_Count)
+                return field_info[ZBPF_None];
+                
+        return field_info[f];
+}
+
 ZigBeePacket::ZigBeePacket()
 {
         zero();
@@ -199,76 +306,47 @@ ZigBeePacket::~ZigBeePacket()
 void ZigBeePacket::zero()
 {
         identifier = ZBPID_ATCommand;
+        layout = 0;
         frame_id = 0;
-        frame_id_offset = 0;
         at_cmd[0] = ' ';
         at_cmd[1] = ' ';
-        at_cmd_offset = 0;
         status = 0;
-        status_offset = 0;
         options = 0;
-        options_offset = 0;
-        reserved_offset = 0;
-        min_length = 0;
-        field_count = 0;
         dest64 = 0;
-        dest64_offset = 0;
         dest16 = 0;
-        dest16_offset = 0;
         src64 = 0;
-        src64_offset = 0;
         src16 = 0;
-        src16_offset = 0;
         sender64 = 0;
-        sender64_offset = 0;
         sender16 = 0;
-        sender16_offset = 0;
         parent16 = 0;
-        parent16_offset = 0;
         new64 = 0;
-        new64_offset = 0;
         new16 = 0;
-        new16_offset = 0;
         src_ep = 0;
-        src_ep_offset = 0;
         dest_ep = 0;
-        dest_ep_offset = 0;
         cluster_id = 0;
-        cluster_id_offset = 0;
         profile_id = 0;
-        profile_id_offset = 0;
         radius = 0;
-        radius_offset = 0;
         transmit_retries = 0;
-        transmit_retries_offset = 0;
         delivery_status = 0;
-        delivery_status_offset = 0;
         discovery_status = 0;
-        discovery_status_offset = 0;
         rssi = 0;
-        rssi_offset = 0;
         digital_mask = 0;
-        digital_mask_offset = 0;
         analog_mask = 0;
-        analog_mask_offset = 0;
         num_samples = 0;
-        num_samples_offset = 0;
         data.clear();
-        data_offset = 0;
         route_records.clear();
-        route_records_offset = 0;
 }
 
-uint16_t ZigBeePacket::get_length()
+uint16_t ZigBeePacket::get_length() const
 {
         return payload.size()+4;
 }
 
-uint8_t ZigBeePacket::get_checksum()
+uint8_t ZigBeePacket::get_checksum() const
 {
         uint8_t sum = 0xFF;
         
-        for (int i = 0; i < payload.size(); i++)
+        for (size_t i = 0; i < payload.size(); i++)
         {
                 sum -= payload[i];
         }
@@ -276,73 +354,134 @@ uint8_t ZigBeePacket::get_checksum()
         return sum;
 }
 
-std::vector<uint8_t> ZigBeePacket::get_raw_packet()
+size_t ZigBeePacket::get_max_encoded_length(bool escaped) const
+{
+        return get_max_frame_length(payload.size(), escaped);
+}
+
+size_t ZigBeePacket::encode(uint8_t *buf, size_t size, bool escaped) const
 {
-        std::vector<uint8_t> dataout;
+        return encode_frame(payload.empty() ? 0 : &payload[0], payload.size(), buf, size, escaped);
+}
+
+// Static
+size_t ZigBeePacket::get_max_frame_length(size_t length, bool escaped)
+{
+        // everything but the start byte may be escaped
+        if (escaped)
+                return 1 + 2*(length+3);
+        return length+4;
+}
+
+static inline uint8_t *encode_byte(uint8_t *ptr, uint8_t b)
+{
+        if (b == ZIGBEE_IDENTIFIER || b == ZIGBEE_ESCAPE || b == 0x11 || b == 0x13)
+        {
+                *(ptr++) = ZIGBEE_ESCAPE;
+                *(ptr++) = b^0x20;
+        }
+        else
+        {
+                *(ptr++) = b;
+        }
+        
+        return ptr;
+}
+
+// Static
+size_t ZigBeePacket::encode_frame(const uint8_t *payload, size_t length, uint8_t *buf, size_t size, bool escaped)
+{
+        uint8_t *ptr = buf;
+        size_t len = length;
+        uint8_t sum = 0xFF;
+        uint8_t b;
+        
+        if (!buf || size < get_max_frame_length(length, escaped))
+                return 0;
+        
+        *(ptr++) = ZIGBEE_IDENTIFIER;
+        
+        if (!escaped)
+        {
+                *(ptr++) = len >> 8;
+                *(ptr++) = len;
+                
+                if (len > 0)
+                        memcpy(ptr, payload, len);
+                
+                for (size_t i = 0; i < len; i++)
+                        sum -= ptr[i];
+                
+                ptr += len;
+                *(ptr++) = sum;
+                
+                return ptr - buf;
+        }
+        
+        ptr = encode_byte(ptr, len >> 8);
+        ptr = encode_byte(ptr, len);
+        
+        for (size_t i = 0; i < len; i++)
+        {
+                b = payload[i];
+                sum -= b;
+                ptr = encode_byte(ptr, b);
+        }
         
-        dataout.push_back(ZIGBEE_IDENTIFIER);
-        dataout.push_back(payload.size() >> 8);
-        dataout.push_back(payload.size());
+        ptr = encode_byte(ptr, sum);
         
-        dataout.insert(dataout.end(), payload.begin(), payload.end());
+        return ptr - buf;
+}
+
+std::vector<uint8_t> ZigBeePacket::get_raw_packet()
+{
+        std::vector<uint8_t> dataout(get_max_encoded_length(false));
         
-        dataout.push_back(get_checksum());
+        dataout.resize(encode(&dataout[0], dataout.size(), false));
         
         return dataout;
 }
 
 std::vector<uint8_t> ZigBeePacket::get_escaped_raw_packet()
 {
-        std::vector<uint8_t> datain = get_raw_packet();
-        std::vector<uint8_t> dataout;
+        std::vector<uint8_t> dataout(get_max_encoded_length(true));
         
-        dataout.push_back(ZIGBEE_IDENTIFIER);
-        
-        for (int i = 1; i < datain.size(); i++)
-        {
-                if (datain[i] == ZIGBEE_IDENTIFIER || datain[i] == ZIGBEE_ESCAPE ||
-                        datain[i] == 0x11 || datain[i] == 0x13)
-                {
-                        dataout.push_back(ZIGBEE_ESCAPE);
-                        dataout.push_back(datain[i]^0x20);
-                }
-                else
-                {
-                        dataout.push_back(datain[i]);
-                }
-        }
+        dataout.resize(encode(&dataout[0], dataout.size(), true));
         
         return dataout;
 }
 
-bool ZigBeePacket::read_packet(std::vector<char> bytes, size_t &bytes_read)
+bool ZigBeePacket::read_packet(const std::vector<char> &bytes, size_t &bytes_read)
 {
-        return read_packet((uint8_t *)&bytes[0], bytes.size(), bytes_read);
+        if (bytes.empty())
+                return false;
+        return read_packet((const uint8_t *)&bytes[0], bytes.size(), bytes_read);
 }
 
-bool ZigBeePacket::read_packet(std::vector<uint8_t> bytes, size_t &bytes_read)
+bool ZigBeePacket::read_packet(const std::vector<uint8_t> &bytes, size_t &bytes_read)
 {
+        if (bytes.empty())
+                return false;
         return read_packet(&bytes[0], bytes.size(), bytes_read);
 }
 
-bool ZigBeePacket::read_packet(std::deque<char> bytes, size_t &bytes_read)
+bool ZigBeePacket::read_packet(const std::deque<char> &bytes, size_t &bytes_read)
 {
-        std::vector<char> v(bytes.begin(), bytes.end());
+        std::vector<uint8_t> v(bytes.begin(), bytes.end());
         return read_packet(v, bytes_read);
 }
 
-bool ZigBeePacket::read_packet(std::deque<uint8_t> bytes, size_t &bytes_read)
+bool ZigBeePacket::read_packet(const std::deque<uint8_t> &bytes, size_t &bytes_read)
 {
         std::vector<uint8_t> v(bytes.begin(), bytes.end());
         return read_packet(v, bytes_read);
 }
 
-bool ZigBeePacket::read_packet(uint8_t *bytes, size_t count, size_t &bytes_read)
+bool ZigBeePacket::read_packet(const uint8_t *bytes, size_t count, size_t &bytes_read)
 {
         size_t n = 0;
-        uint8_t *ptr = bytes;
+        const uint8_t *ptr = bytes;
         uint16_t size;
-        uint8_t b;
         uint8_t sum = 0xff;
         
         if (count == 0)
@@ -373,17 +512,16 @@ bool ZigBeePacket::read_packet(uint8_t *bytes, size_t count, size_t &bytes_read)
         if (count - n < size + 1)
                 return false;
         
-        payload.clear();
+        // read payload, assign reuses the existing storage
+        payload.assign(ptr, ptr + size);
         
-        // read payload
         for (int i = 0; i < size; i++)
         {
-                b = *(ptr++);
-                payload.push_back(b);
-                sum -= b;
-                n++;
+                sum -= *(ptr++);
         }
         
+        n += size;
+        
         // add one for checksum and set bytes read
         n++;
         bytes_read = n;
@@ -395,521 +533,247 @@ bool ZigBeePacket::read_packet(uint8_t *bytes, size_t count, size_t &bytes_read)
         return true;
 }
 
-bool ZigBeePacket::set_offsets()
+void ZigBeePacket::set_payload(const uint8_t *bytes, size_t count)
+{
+        payload.assign(bytes, bytes + count);
+}
+
+bool ZigBeePacket::set_layout()
 {
-        // clear offsets
-        frame_id_offset = 0;
-        at_cmd_offset = 0;
-        status_offset = 0;
-        options_offset = 0;
-        reserved_offset = 0;
-        dest64_offset = 0;
-        dest16_offset = 0;
-        src64_offset = 0;
-        src16_offset = 0;
-        sender64_offset = 0;
-        sender16_offset = 0;
-        parent16_offset = 0;
-        new64_offset = 0;
-        new16_offset = 0;
-        src_ep_offset = 0;
-        dest_ep_offset = 0;
-        cluster_id_offset = 0;
-        profile_id_offset = 0;
-        radius_offset = 0;
-        transmit_retries_offset = 0;
-        delivery_status_offset = 0;
-        discovery_status_offset = 0;
-        rssi_offset = 0;
-        digital_mask_offset = 0;
-        analog_mask_offset = 0;
-        data_offset = 0;
-        num_samples_offset = 0;
-        route_records_offset = 0;
-        min_length = 0;
-        field_count = 0;
+        layout = get_layout(identifier);
         
-        switch (identifier)
+        return layout != 0;
+}
+
+int ZigBeePacket::get_field_offset(ZBP_Field f)
+{
+        if (!layout)
+                return 0;
+        
+        for (int i = 0; i < layout->num_fields; i++)
         {
-                case ZBPID_TxRequest64:
-                        frame_id_offset = 1;
-                        dest64_offset = 2;
-                        options_offset = 10;
-                        data_offset = 11;
-                        min_length = 11;
-                        field_count = 5;
-                        return true;
-                case ZBPID_TxRequest16:
-                        frame_id_offset = 1;
-                        dest16_offset = 2;
-                        options_offset = 4;
-                        data_offset = 5;
-                        min_length = 5;
-                        field_count = 5;
-                        return true;
-                case ZBPID_ATCommand:
-                        frame_id_offset = 1;
-                        at_cmd_offset = 2;
-                        data_offset = 4;
-                        min_length = 4;
-                        field_count = 4;
-                        return true;
-                case ZBPID_ATCommandQueueRegisterValue:
-                        frame_id_offset = 1;
-                        at_cmd_offset = 2;
-                        data_offset = 4;
-                        min_length = 4;
-                        field_count = 4;
-                        return true;
-                case ZBPID_TxRequest:
-                        frame_id_offset = 1;
-                        dest64_offset = 2;
-                        dest16_offset = 10;
-                        radius_offset = 12;
-                        options_offset = 13;
-                        data_offset = 14;
-                        min_length = 14;
-                        field_count = 7;
-                        return true;
-                case ZBPID_EATxRequest:
-                        frame_id_offset = 1;
-                        dest64_offset = 2;
-                        dest16_offset = 10;
-                        src_ep_offset = 12;
-                        dest_ep_offset = 13;
-                        cluster_id_offset = 14;
-                        profile_id_offset = 16;
-                        radius_offset = 18;
-                        options_offset = 19;
-                        data_offset = 20;
-                        min_length = 20;
-                        field_count = 11;
-                        return true;
-                case ZBPID_RemoteATCommand:
-                        frame_id_offset = 1;
-                        dest64_offset = 2;
-                        dest16_offset = 10;
-                        options_offset = 12;
-                        at_cmd_offset = 13;
-                        data_offset = 15;
-                        min_length = 15;
-                        field_count = 7;
-                        return true;
-                case ZBPID_CreateSourceRoute:
-                        frame_id_offset = 1;
-                        dest64_offset = 2;
-                        dest16_offset = 10;
-                        options_offset = 12;
-                        route_records_offset = 13;
-                        min_length = 14;
-                        field_count = 6;
-                        return true;
-                case ZBPID_RegisterJoiningDevice:
-                        frame_id_offset = 1;
-                        dest64_offset = 2;
-                        dest16_offset = 10;
-                        options_offset = 12;
-                        data_offset = 13;
-                        min_length = 13;
-                        field_count = 6;
-                        return true;
-                case ZBPID_RxPacket64:
-                        src64_offset = 1;
-                        rssi_offset = 9;
-                        options_offset = 10;
-                        data_offset = 11;
-                        min_length = 11;
-                        field_count = 5;
-                        return true;
-                case ZBPID_RxPacket16:
-                        src16_offset = 1;
-                        rssi_offset = 3;
-                        options_offset = 4;
-                        data_offset = 5;
-                        min_length = 5;
-                        field_count = 5;
-                        return true;
-                case ZBPID_RxPacketIO64:
-                        src64_offset = 1;
-                        rssi_offset = 9;
-                        options_offset = 10;
-                        data_offset = 11;
-                        min_length = 11;
-                        field_count = 5;
-                        return true;
-                case ZBPID_RxPacketIO16:
-                        src16_offset = 1;
-                        rssi_offset = 3;
-                        options_offset = 4;
-                        data_offset = 5;
-                        min_length = 5;
-                        field_count = 5;
-                        return true;
-                case ZBPID_ATCommandResponse:
-                        frame_id_offset = 1;
-                        at_cmd_offset = 2;
-                        status_offset = 4;
-                        data_offset = 5;
-                        min_length = 5;
-                        field_count = 5;
-                        return true;
-                case ZBPID_TxStatusS1:
-                        frame_id_offset = 1;
-                        status_offset = 2;
-                        min_length = 3;
-                        field_count = 3;
-                        return true;
-                case ZBPID_ModemStatus:
-                        status_offset = 1;
-                        min_length = 2;
-                        field_count = 2;
-                        return true;
-                case ZBPID_TxStatusS2:
-                        frame_id_offset = 1;
-                        dest16_offset = 2;
-                        transmit_retries_offset = 4;
-                        delivery_status_offset = 5;
-                        discovery_status_offset = 6;
-                        min_length = 7;
-                        field_count = 6;
-                        return true;
-                case ZBPID_RxPacket:
-                        src64_offset = 1;
-                        src16_offset = 9;
-                        options_offset = 11;
-                        data_offset = 12;
-                        min_length = 12;
-                        field_count = 5;
-                        return true;
-                case ZBPID_EARxPacket:
-                        src64_offset = 1;
-                        src16_offset = 9;
-                        src_ep_offset = 11;
-                        dest_ep_offset = 12;
-                        cluster_id_offset = 13;
-                        profile_id_offset = 15;
-                        options_offset = 17;
-                        data_offset = 18;
-                        min_length = 18;
-                        field_count = 9;
-                        return true;
-                case ZBPID_IODataSampleRx:
-                        src64_offset = 1;
-                        src16_offset = 9;
-                        options_offset = 11;
-                        num_samples_offset = 12;
-                        digital_mask_offset = 13;
-                        analog_mask_offset = 15;
-                        // TODO
-                        data_offset = 16;
-                        min_length = 16;
-                        field_count = 8;
-                        return true;
-                case ZBPID_SensorRead:
-                        src64_offset = 1;
-                        src16_offset = 9;
-                        options_offset = 11;
-                        // TODO
-                        data_offset = 12;
-                        min_length = 12;
-                        field_count = 5;
-                        return true;
-                case ZBPID_NodeIdentification:
-                        sender64_offset = 1;
-                        sender16_offset = 9;
-                        options_offset = 11;
-                        src64_offset = 12;
-                        src16_offset = 20;
-                        data_offset = 21;
-                        min_length = 21;
-                        field_count = 7;
-                        return true;
-                case ZBPID_RemoteCommandResponse:
-                        frame_id_offset = 1;
-                        src64_offset = 2;
-                        src16_offset = 10;
-                        at_cmd_offset = 12;
-                        status_offset = 14;
-                        data_offset = 15;
-                        min_length = 15;
-                        field_count = 7;
-                        return true;
-                case ZBPID_OTAFirmwareUpdateStatus:
-                        src64_offset = 1;
-                        dest16_offset = 9;
-                        options_offset = 11;
-                        // TODO
-                        data_offset = 12;
-                        min_length = 12;
-                        field_count = 5;
-                        return true;
-                case ZBPID_RouteRecord:
-                        src64_offset = 1;
-                        src16_offset = 9;
-                        options_offset = 11;
-                        route_records_offset = 12;
-                        min_length = 13;
-                        field_count = 5;
-                        return true;
-                case ZBPID_DeviceAuthenticated:
-                        src64_offset = 1;
-                        src16_offset = 9;
-                        status_offset = 11;
-                        min_length = 12;
-                        field_count = 4;
-                        return true;
-                case ZBPID_ManyToOneRouteRequest:
-                        frame_id_offset = 1;
-                        src64_offset = 2;
-                        src16_offset = 10;
-                        reserved_offset = 12;
-                        min_length = 13;
-                        field_count = 5;
-                        return true;
-                case ZBPID_RegisterJoiningDeviceStatus:
-                        frame_id_offset = 1;
-                        status_offset = 2;
-                        min_length = 3;
-                        field_count = 3;
-                        return true;
-                case ZBPID_JoinNotificationStatus:
-                        parent16_offset = 1;
-                        new16_offset = 3;
-                        new64_offset = 5;
-                        status_offset = 13;
-                        min_length = 14;
-                        field_count = 5;
-                        return true;
+                if (layout->fields[i].field == f)
+                        return layout->fields[i].offset;
+        }
+        
+        return 0;
+}
+
+uint64_t ZigBeePacket::get_field_value(ZBP_Field f)
+{
+        const ZBP_FieldInfo &info = get_field_info(f);
+        
+        switch (info.type)
+        {
+                case ZBPT_Uint8:
+                        return this->*info.u8;
+                case ZBPT_Uint16:
+                        return this->*info.u16;
+                case ZBPT_Uint64:
+                        return this->*info.u64;
                 default:
-                        return false;
+                        return 0;
         }
 }
 
-bool ZigBeePacket::build_packet()
+void ZigBeePacket::set_field_value(ZBP_Field f, uint64_t value)
 {
-        // get offsets
-        if (!set_offsets())
-                return false;
+        const ZBP_FieldInfo &info = get_field_info(f);
+        
+        switch (info.type)
+        {
+                case ZBPT_Uint8:
+                        this->*info.u8 = value;
+                        break;
+                case ZBPT_Uint16:
+                        this->*info.u16 = value;
+                        break;
+                case ZBPT_Uint64:
+                        this->*info.u64 = value;
+                        break;
+                default:
+                        break;
+        }
+}
+
+std::string ZigBeePacket::get_field_string(ZBP_Field f)
+{
+        std::stringstream ss;
         
-        // init payload
-        payload.clear();
-        payload.push_back(identifier);
-        payload.resize(min_length);
+        write_field(ss, f);
         
-        // fill in fields
-        write_payload_uint8(frame_id_offset, frame_id);
+        return ss.str();
+}
+
+void ZigBeePacket::write_field(std::ostream &ss, ZBP_Field f)
+{
+        const ZBP_FieldInfo &info = get_field_info(f);
         
-        if (at_cmd_offset)
+        switch (info.type)
         {
-                write_payload_uint8(at_cmd_offset,   at_cmd[0]);
-                write_payload_uint8(at_cmd_offset+1, at_cmd[1]);
+                case ZBPT_Uint8:
+                case ZBPT_Uint16:
+                case ZBPT_Uint64:
+                        if (info.display == ZBPD_Hex)
+                        {
+                                int width = info.type == ZBPT_Uint8 ? 2 : info.type == ZBPT_Uint16 ? 4 : 16;
+                                ss << "0x" << std::setfill('0') << std::setw(width) << std::hex << get_field_value(f);
+                        }
+                        else
+                        {
+                                ss << std::dec << get_field_value(f);
+                        }
+                        break;
+                case ZBPT_Chars:
+                        ss << at_cmd[0] << at_cmd[1];
+                        break;
+                case ZBPT_Bytes:
+                        if (!data.empty())
+                                ss << HexCodec::encode(&data[0], data.size());
+                        break;
+                case ZBPT_Words:
+                        for (size_t i = 0; i < route_records.size(); i++)
+                        {
+                                if (i > 0)
+                                        ss << " ";
+                                ss << "0x" << std::setfill('0') << std::setw(4) << std::hex << (int)route_records[i];
+                        }
+                        break;
+                default:
+                        break;
         }
+}
+
+bool ZigBeePacket::build_packet()
+{
+        const ZBP_FieldLayout *f;
+        size_t size;
+        size_t words;
+        uint8_t *ptr;
+        
+        // get layout
+        if (!set_layout())
+                return false;
         
-        write_payload_uint8(status_offset, status);
-        write_payload_uint8(options_offset, options);
-        write_payload_uint64(dest64_offset, dest64);
-        write_payload_uint16(dest16_offset, dest16);
-        write_payload_uint64(src64_offset, src64);
-        write_payload_uint16(src16_offset, src16);
-        write_payload_uint64(sender64_offset, sender64);
-        write_payload_uint16(sender16_offset, sender16);
-        write_payload_uint16(parent16_offset, parent16);
-        write_payload_uint64(new64_offset, new64);
-        write_payload_uint16(new16_offset, new16);
-        write_payload_uint8(src_ep_offset, src_ep);
-        write_payload_uint8(dest_ep_offset, dest_ep);
-        write_payload_uint16(cluster_id_offset, cluster_id);
-        write_payload_uint16(profile_id_offset, profile_id);
-        write_payload_uint8(radius_offset, radius);
-        write_payload_uint8(transmit_retries_offset, transmit_retries);
-        write_payload_uint8(delivery_status_offset, delivery_status);
-        write_payload_uint8(discovery_status_offset, discovery_status);
-        write_payload_uint8(rssi_offset, rssi);
-        write_payload_uint16(digital_mask_offset, digital_mask);
-        write_payload_uint8(analog_mask_offset, analog_mask);
-        write_payload_uint8(num_samples_offset, num_samples);
+        // the count byte limits the number of route records
+        words = std::min(route_records.size(), (size_t)255);
         
-        if (data_offset)
+        // size payload once, only the last field can be variable length
+        size = layout->min_length;
+        if (layout->num_fields > 0)
         {
-                payload.insert(payload.begin()+data_offset, data.begin(), data.end());
+                switch (field_info[layout->fields[layout->num_fields-1].field].type)
+                {
+                        case ZBPT_Bytes:
+                                size += data.size();
+                                break;
+                        case ZBPT_Words:
+                                size += words * 2;
+                                break;
+                        default:
+                                break;
+                }
         }
         
-        if (route_records_offset)
+        payload.assign(size, 0);
+        payload[0] = identifier;
+        
+        // fill in fields
+        for (f = layout->fields; f->field != ZBPF_None; f++)
         {
-                payload.insert(payload.begin()+route_records_offset, route_records.size()*2, 0);
-                
-                write_payload_uint8(route_records_offset, route_records.size());
+                const ZBP_FieldInfo &info = field_info[f->field];
+                ptr = &payload[f->offset];
                 
-                for (int i = 0; i < route_records.size(); i++)
+                switch (info.type)
                 {
-                        payload[route_records_offset+1+i*2]   = route_records[i] >> 8;
-                        payload[route_records_offset+1+i*2+1] = route_records[i];
+                        case ZBPT_Uint8:
+                                *ptr = this->*info.u8;
+                                break;
+                        case ZBPT_Uint16:
+                                put_uint16(ptr, this->*info.u16);
+                                break;
+                        case ZBPT_Uint64:
+                                put_uint64(ptr, this->*info.u64);
+                                break;
+                        case ZBPT_Chars:
+                                ptr[0] = at_cmd[0];
+                                ptr[1] = at_cmd[1];
+                                break;
+                        case ZBPT_Bytes:
+                                if (!data.empty())
+                                        memcpy(ptr, &data[0], data.size());
+                                break;
+                        case ZBPT_Words:
+                                *ptr++ = words;
+                                for (size_t i = 0; i < words; i++, ptr += 2)
+                                        put_uint16(ptr, route_records[i]);
+                                break;
+                        default:
+                                break;
                 }
         }
+        
+        return true;
 }
 
 bool ZigBeePacket::decode_packet()
 {
-        std::vector<uint8_t>::iterator it = payload.begin();
+        const ZBP_FieldLayout *f;
+        const uint8_t *ptr;
+        size_t size = payload.size();
+        size_t words;
         
-        if (payload.size() < 1)
+        if (size < 1)
                 return false;
         
         // get identifier
         identifier = ZBP_Identifier(payload[0]);
         
-        // get offsets
-        if (!set_offsets())
+        // get layout
+        if (!set_layout())
                 return false;
         
-        // check length
-        if (payload.size() < min_length)
+        // check length, every fixed field is in range after this
+        if (size < layout->min_length)
                 return false;
         
         // read fields
-        if (frame_id_offset)
+        for (f = layout->fields; f->field != ZBPF_None; f++)
         {
-                frame_id = read_payload_uint8(frame_id_offset);
-        }
-        
-        if (at_cmd_offset)
-        {
-                at_cmd[0] = read_payload_uint8(at_cmd_offset);
-                at_cmd[1] = read_payload_uint8(at_cmd_offset+1);
-        }
-        
-        if (status_offset)
-        {
-                status = read_payload_uint8(status_offset);
-        }
-        
-        if (options_offset)
-        {
-                options = read_payload_uint8(options_offset);
-        }
-        
-        if (dest64_offset)
-        {
-                dest64 = read_payload_uint64(dest64_offset);
-        }
-        
-        if (dest16_offset)
-        {
-                dest16 = read_payload_uint16(dest16_offset);
-        }
-        
-        if (src64_offset)
-        {
-                src64 = read_payload_uint64(src64_offset);
-        }
-        
-        if (src16_offset)
-        {
-                src16 = read_payload_uint16(src16_offset);
-        }
-        
-        if (sender64_offset)
-        {
-                sender64 = read_payload_uint64(sender64_offset);
-        }
-        
-        if (sender16_offset)
-        {
-                sender16 = read_payload_uint16(sender16_offset);
-        }
-        
-        if (parent16_offset)
-        {
-                parent16 = read_payload_uint16(parent16_offset);
-        }
-        
-        if (new64_offset)
-        {
-                new64 = read_payload_uint64(new64_offset);
-        }
-        
-        if (new16_offset)
-        {
-                new16 = read_payload_uint16(new16_offset);
-        }
-        
-        if (src_ep_offset)
-        {
-                src_ep = read_payload_uint8(src_ep_offset);
-        }
-        
-        if (dest_ep_offset)
-        {
-                dest_ep = read_payload_uint8(dest_ep_offset);
-        }
-        
-        if (cluster_id_offset)
-        {
-                cluster_id = read_payload_uint16(cluster_id_offset);
-        }
-        
-        if (profile_id_offset)
-        {
-                profile_id = read_payload_uint16(profile_id_offset);
-        }
-        
-        if (radius_offset)
-        {
-                radius = read_payload_uint8(radius_offset);
-        }
-        
-        if (transmit_retries_offset)
-        {
-                transmit_retries = read_payload_uint8(transmit_retries_offset);
-        }
-        
-        if (delivery_status_offset)
-        {
-                delivery_status = read_payload_uint8(delivery_status_offset);
-        }
-        
-        if (discovery_status_offset)
-        {
-                discovery_status = read_payload_uint8(discovery_status_offset);
-        }
-        
-        if (rssi_offset)
-        {
-                rssi = read_payload_uint8(rssi_offset);
-        }
-        
-        if (digital_mask_offset)
-        {
-                digital_mask = read_payload_uint16(digital_mask_offset);
-        }
-        
-        if (analog_mask_offset)
-        {
-                analog_mask = read_payload_uint8(analog_mask_offset);
-        }
-        
-        if (num_samples_offset)
-        {
-                num_samples = read_payload_uint8(num_samples_offset);
-        }
-        
-        if (data_offset)
-        {
-                data.clear();
-                data.insert(data.begin(), payload.begin()+data_offset, payload.end());
-        }
-        
-        if (route_records_offset)
-        {
-                route_records.clear();
+                const ZBP_FieldInfo &info = field_info[f->field];
+                ptr = &payload[f->offset];
                 
-                for (int i = read_payload_uint8(route_records_offset); i > 0; i--)
+                switch (info.type)
                 {
-                        uint16_t n = (uint16_t)payload[route_records_offset+1+n*2] << 8;
-                        n |= (uint16_t)payload[route_records_offset+1+n*2+1];
-                        route_records.push_back(n);
+                        case ZBPT_Uint8:
+                                this->*info.u8 = *ptr;
+                                break;
+                        case ZBPT_Uint16:
+                                this->*info.u16 = get_uint16(ptr);
+                                break;
+                        case ZBPT_Uint64:
+                                this->*info.u64 = get_uint64(ptr);
+                                break;
+                        case ZBPT_Chars:
+                                at_cmd[0] = ptr[0];
+                                at_cmd[1] = ptr[1];
+                                break;
+                        case ZBPT_Bytes:
+                                data.assign(ptr, ptr + (size - f->offset));
+                                break;
+                        case ZBPT_Words:
+                                // don't trust the count past the end of the frame
+                                words = std::min((size_t)*ptr++, (size - f->offset - 1) / 2);
+                                route_records.resize(words);
+                                for (size_t i = 0; i < words; i++, ptr += 2)
+                                        route_records[i] = get_uint16(ptr);
+                                break;
+                        default:
+                                break;
                 }
         }
+        
+        return true;
 }
 
 std::string ZigBeePacket::get_type_desc()
@@ -925,157 +789,43 @@ std::string ZigBeePacket::get_desc()
         desc << "  Length: " << std::dec << get_length() << std::endl;
         desc << "  Identifier: 0x" << std::setw(2) << std::hex << identifier << std::endl;
         
-        
-        for (int i = 1; i <= min_length; i++)
+        for (int n = 0; layout && n < layout->num_fields; n++)
         {
-                if (frame_id_offset == i)
-                {
-                        desc << "  Frame ID: 0x" << std::setfill('0') << std::setw(2) << std::hex << (int)frame_id << std::endl;
-                }
+                ZBP_Field f = layout->fields[n].field;
+                const ZBP_FieldInfo &info = field_info[f];
                 
-                if (at_cmd_offset == i)
-                {
-                        desc << "  AT Command: " << at_cmd[0] << at_cmd[1] << std::endl;
-                }
-                
-                if (status_offset == i)
-                {
-                        desc << "  Status: 0x" << std::setfill('0') << std::setw(2) << std::hex << (int)status << std::endl;
-                }
-                
-                if (options_offset == i)
-                {
-                        desc << "  Options: 0x" << std::setfill('0') << std::setw(2) << std::hex << (int)options << std::endl;
-                }
-                
-                if (dest64_offset == i)
-                {
-                        desc << "  Dest64: 0x" << std::setfill('0') << std::setw(16) << std::hex << dest64 << std::endl;
-                }
-                
-                if (dest16_offset == i)
-                {
-                        desc << "  Dest16: 0x" << std::setfill('0') << std::setw(4) << std::hex << dest16 << std::endl;
-                }
-                
-                if (src64_offset == i)
-                {
-                        desc << "  Src64: 0x" << std::setfill('0') << std::setw(16) << std::hex << src64 << std::endl;
-                }
-                
-                if (src16_offset == i)
-                {
-                        desc << "  Src16: 0x" << std::setfill('0') << std::setw(4) << std::hex << src16 << std::endl;
-                }
-                
-                if (sender64_offset == i)
-                {
-                        desc << "  Sender64: 0x" << std::setfill('0') << std::setw(16) << std::hex << sender64 << std::endl;
-                }
-                
-                if (sender16_offset == i)
-                {
-                        desc << "  Sender16: 0x" << std::setfill('0') << std::setw(4) << std::hex << sender16 << std::endl;
-                }
-                
-                if (parent16_offset == i)
-                {
-                        desc << "  Parent16: 0x" << std::setfill('0') << std::setw(4) << std::hex << parent16 << std::endl;
-                }
-                
-                if (new64_offset == i)
-                {
-                        desc << "  New64: 0x" << std::setfill('0') << std::setw(16) << std::hex << new64 << std::endl;
-                }
-                
-                if (new16_offset == i)
-                {
-                        desc << "  New16: 0x" << std::setfill('0') << std::setw(4) << std::hex << new16 << std::endl;
-                }
-                
-                if (src_ep_offset == i)
-                {
-                        desc << "  Source Endpoint: 0x" << std::setfill('0') << std::setw(2) << std::hex << (int)src_ep << std::endl;
-                }
-                
-                if (dest_ep_offset == i)
-                {
-                        desc << "  Destination Endpoint: 0x" << std::setfill('0') << std::setw(2) << std::hex << (int)dest_ep << std::endl;
-                }
-                
-                if (cluster_id_offset == i)
-                {
-                        desc << "  Cluster ID: 0x" << std::setfill('0') << std::setw(4) << std::hex << cluster_id << std::endl;
-                }
-                
-                if (profile_id_offset == i)
-                {
-                        desc << "  Profile ID: 0x" << std::setfill('0') << std::setw(4) << std::hex << profile_id << std::endl;
-                }
-                
-                if (radius_offset == i)
-                {
-                        desc << "  Radius: " << std::dec << (int)radius << std::endl;
-                }
-                
-                if (transmit_retries_offset == i)
-                {
-                        desc << "  Transmit Retries: " << std::dec << (int)transmit_retries << std::endl;
-                }
-                
-                if (delivery_status_offset == i)
-                {
-                        desc << "  Delivery Status: 0x" << std::setfill('0') << std::setw(2) << std::hex << (int)delivery_status << std::endl;
-                }
+                if (!info.name)
+                        continue;
                 
-                if (discovery_status_offset == i)
-                {
-                        desc << "  Discovery Status: 0x" << std::setfill('0') << std::setw(2) << std::hex << (int)discovery_status << std::endl;
-                }
+                desc << "  " << info.name << ":";
                 
-                if (rssi_offset == i)
+                switch (info.type)
                 {
-                        desc << "  RSSI: -" << std::dec << (int)rssi << " dBm" << std::endl;
+                        case ZBPT_Bytes:
+                                for (size_t i = 0; i < data.size(); i += 16)
+                                {
+                                        if (i > 0)
+                                                desc << std::endl << "             ";
+                                        desc << " " << HexCodec::encode(&data[i], std::min<size_t>(16, data.size() - i));
+                                }
+                                break;
+                        case ZBPT_Words:
+                                for (int i = 0; i < route_records.size(); i++)
+                                {
+                                        if (i > 0 && i % 16 == 0)
+                                                desc << std::endl << "                      ";
+                                        desc << " " << std::setfill('0') << std::setw(4) << std::hex << route_records[i];
+                                }
+                                break;
+                        default:
+                                desc << (info.display == ZBPD_RSSI ? " -" : " ");
+                                write_field(desc, f);
+                                if (info.display == ZBPD_RSSI)
+                                        desc << " dBm";
+                                break;
                 }
                 
-                if (digital_mask_offset == i)
-                {
-                        desc << "  Digital Mask: 0x" << std::setfill('0') << std::setw(4) << std::hex << digital_mask << std::endl;
-                }
-                
-                if (analog_mask_offset == i)
-                {
-                        desc << "  Analog Mask: 0x" << std::setfill('0') << std::setw(2) << std::hex << (int)analog_mask << std::endl;
-                }
-                
-                if (num_samples_offset == i)
-                {
-                        desc << "  Samples: " << std::dec << (int)num_samples << std::endl;
-                }
-                
-                if (data_offset == i)
-                {
-                        desc << "  Data (hex):";
-                        for (int i = 0; i < data.size(); i++)
-                        {
-                                if (i > 0 && i % 16 == 0)
-                                        desc << std::endl << "             ";
-                                desc << " " << std::setfill('0') << std::setw(2) << std::hex << (int)data[i];
-                        }
-                        desc << std::endl;
-                }
-                
-                if (route_records_offset == i)
-                {
-                        desc << "  Route records (hex):";
-                        for (int i = 0; i < route_records.size(); i++)
-                        {
-                                if (i > 0 && i % 16 == 0)
-                                        desc << std::endl << "                      ";
-                                desc << " " << std::setfill('0') << std::setw(4) << std::hex << route_records[i];
-                        }
-                        desc << std::endl;
-                }
+                desc << std::endl;
         }
         
         desc << "  Checksum: 0x" << std::setfill('0') << std::setw(2) << std::hex << (int)get_checksum();
@@ -1086,30 +836,25 @@ std::string ZigBeePacket::get_desc()
 std::string ZigBeePacket::get_hex_packet()
 {
         std::vector<uint8_t> pkt = get_raw_packet();
-        std::stringstream out;
         
-        for (int i = 0; i < pkt.size(); i++)
-        {
-                if (i > 0)
-                        out << " ";
-                out << std::setfill('0') << std::setw(2) << std::hex << (int)pkt[i];
-        }
+        if (pkt.empty())
+                return std::string();
         
-        return out.str();
+        return HexCodec::encode(&pkt[0], pkt.size());
 }
 
 
 // read and write payload data
 uint8_t ZigBeePacket::read_payload_uint8(int offset)
 {
-        if (offset <= 0)
+        if (offset <= 0 || offset + 1 > payload.size())
                 return 0;
         return payload[offset];
 }
 
 uint16_t ZigBeePacket::read_payload_uint16(int offset)
 {
-        if (offset <= 0)
+        if (offset <= 0 || offset + 2 > payload.size())
                 return 0;
         uint16_t value;
         value  = (uint16_t)payload[offset]   << 8;
@@ -1119,7 +864,7 @@ uint16_t ZigBeePacket::read_payload_uint16(int offset)
 
 uint32_t ZigBeePacket::read_payload_uint32(int offset)
 {
-        if (offset <= 0)
+        if (offset <= 0 || offset + 4 > payload.size())
                 return 0;
         uint32_t value;
         value  = (uint32_t)payload[offset]   << 24;
@@ -1131,7 +876,7 @@ uint32_t ZigBeePacket::read_payload_uint32(int offset)
 
 uint64_t ZigBeePacket::read_payload_uint64(int offset)
 {
-        if (offset <= 0)
+        if (offset <= 0 || offset + 8 > payload.size())
                 return 0;
         uint64_t value;
         value  = (uint64_t)payload[offset]   << 56;
@@ -1147,14 +892,14 @@ uint64_t ZigBeePacket::read_payload_uint64(int offset)
 
 void ZigBeePacket::write_payload_uint8(int offset, uint8_t value)
 {
-        if (offset <= 0)
+        if (offset <= 0 || offset + 1 > payload.size())
                 return;
         payload[offset] = value;
 }
 
 void ZigBeePacket::write_payload_uint16(int offset, uint16_t value)
 {
-        if (offset <= 0)
+        if (offset <= 0 || offset + 2 > payload.size())
                 return;
         payload[offset]   = value >> 8;
         payload[offset+1] = value;
@@ -1162,7 +907,7 @@ void ZigBeePacket::write_payload_uint16(int offset, uint16_t value)
 
 void ZigBeePacket::write_payload_uint32(int offset, uint32_t value)
 {
-        if (offset <= 0)
+        if (offset <= 0 || offset + 4 > payload.size())
                 return;
         payload[offset]   = value >> 24;
         payload[offset+1] = value >> 16;
@@ -1172,7 +917,7 @@ void ZigBeePacket::write_payload_uint32(int offset, uint32_t value)
 
 void ZigBeePacket::write_payload_uint64(int offset, uint64_t value)
 {
-        if (offset <= 0)
+        if (offset <= 0 || offset + 8 > payload.size())
                 return;
         payload[offset]   = value >> 56;
         payload[offset+1] = value >> 48;
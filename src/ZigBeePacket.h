@@ -37,11 +37,15 @@
 #include <string>
 #include <vector>
 #include <deque>
+#include <ostream>
 #include <inttypes.h>
 
 #define ZIGBEE_IDENTIFIER 0x7E
 #define ZIGBEE_ESCAPE 0x7D
 
+// most fields in any frame type, plus terminator
+#define ZBP_MAX_FIELDS 12
+
 /** ZigBee packet
  * 
  * The ZigBee packet class is used to create and parse ZigBee packets for Digi
@@ -88,6 +92,112 @@ public:
         }
         ZBP_Identifier;
         
+        /**
+         * ZigBee Packet Fields.
+         * Every field that appears in any frame type.  Frame layouts are
+         * sequences of these.
+         * @see ZBP_Layout
+         */
+        typedef enum
+        {
+                ZBPF_None = 0,                  ///< End of layout
+                ZBPF_FrameID,                   ///< Frame ID
+                ZBPF_ATCommand,                 ///< AT command
+                ZBPF_Status,                    ///< Status
+                ZBPF_Options,                   ///< Options
+                ZBPF_Reserved,                  ///< Reserved byte
+                ZBPF_Dest64,                    ///< Destination 64-bit address
+                ZBPF_Dest16,                    ///< Destination 16-bit address
+                ZBPF_Src64,                     ///< Source 64-bit address
+                ZBPF_Src16,                     ///< Source 16-bit address
+                ZBPF_Sender64,                  ///< Sender 64-bit address
+                ZBPF_Sender16,                  ///< Sender 16-bit address
+                ZBPF_Parent16,                  ///< Parent 16-bit address
+                ZBPF_New64,                     ///< New 64-bit address
+                ZBPF_New16,                     ///< New 16-bit address
+                ZBPF_SrcEndpoint,               ///< Source endpoint
+                ZBPF_DestEndpoint,              ///< Destination endpoint
+                ZBPF_ClusterID,                 ///< Cluster ID
+                ZBPF_ProfileID,                 ///< Profile ID
+                ZBPF_Radius,                    ///< Radius
+                ZBPF_TransmitRetries,           ///< Transmit retries
+                ZBPF_DeliveryStatus,            ///< Delivery status
+                ZBPF_DiscoveryStatus,           ///< Discovery status
+                ZBPF_RSSI,                      ///< Receive signal strength indication
+                ZBPF_DigitalMask,               ///< Digital mask
+                ZBPF_AnalogMask,                ///< Analog mask
+                ZBPF_NumSamples,                ///< Num samples
+                ZBPF_Data,                      ///< Packet data, rest of payload
+                ZBPF_RouteRecords,              ///< Route records, count and addresses
+                ZBPF_Count                      ///< Number of fields
+        }
+        ZBP_Field;
+        
+        /**
+         * ZigBee Packet Field Types.
+         * How a field is stored in the payload.
+         */
+        typedef enum
+        {
+                ZBPT_Uint8 = 0,                 ///< 8 bit integer
+                ZBPT_Uint16 = 1,                ///< 16 bit big endian integer
+                ZBPT_Uint64 = 2,                ///< 64 bit big endian integer
+                ZBPT_Chars = 3,                 ///< Two characters
+                ZBPT_Bytes = 4,                 ///< Bytes to end of payload
+                ZBPT_Words = 5,                 ///< Count byte, then 16 bit big endian integers
+                ZBPT_Reserved = 6,              ///< Reserved byte, written as zero
+        }
+        ZBP_FieldType;
+        
+        /**
+         * ZigBee Packet Field Display Formats.
+         */
+        typedef enum
+        {
+                ZBPD_Hex = 0,                   ///< 0x prefixed, zero padded hex
+                ZBPD_Dec = 1,                   ///< Decimal
+                ZBPD_RSSI = 2,                  ///< Decimal, -dBm
+        }
+        ZBP_FieldDisplay;
+        
+        /**
+         * Field description.  One per ZBP_Field, the member pointer
+         * matching the type is set for integer fields.
+         * @see get_field_info()
+         */
+        struct ZBP_FieldInfo
+        {
+                const char *name;               ///< Name used in descriptions
+                const char *label;              ///< Label used in the packet builder
+                ZBP_FieldType type;             ///< Storage type
+                ZBP_FieldDisplay display;       ///< Display format
+                uint8_t ZigBeePacket::*u8;      ///< 8 bit member
+                uint16_t ZigBeePacket::*u16;    ///< 16 bit member
+                uint64_t ZigBeePacket::*u64;    ///< 64 bit member
+        };
+        
+        /**
+         * Field position within a frame layout.
+         */
+        struct ZBP_FieldLayout
+        {
+                ZBP_Field field;                ///< Field
+                int offset;                     ///< Payload offset
+        };
+        
+        /**
+         * Frame layout.  Fields in payload order, terminated by ZBPF_None.
+         * Only the last field may be variable length.
+         * @see get_layout()
+         */
+        struct ZBP_Layout
+        {
+                const char *desc;               ///< Type description
+                int min_length;                 ///< Length of fixed fields, including identifier
+                int num_fields;                 ///< Number of fields, excluding identifier
+                ZBP_FieldLayout fields[ZBP_MAX_FIELDS]; ///< Fields
+        };
+        
         // Data must be written in big endian
         struct sZBP_TxRequest64
         {
@@ -387,81 +497,52 @@ public:
         // packet fields
         
         ZBP_Identifier identifier;      ///< Packet type identifier
+        const ZBP_Layout *layout;       ///< Layout for identifier, 0 if unknown
         uint8_t frame_id;               ///< Frame ID field
-        int frame_id_offset;            ///< Frame ID field offset
         
         // AT commands
         uint8_t at_cmd[2];              ///< AT command field
-        int at_cmd_offset;              ///< AT command field offset
         
         // general fields
         uint8_t status;                 ///< Status field
-        int status_offset;              ///< Status field offset
         uint8_t options;                ///< Options field
-        int options_offset;             ///< Options field offset
-        int reserved_offset;            ///< Reserved offset
-        int min_length;                 ///< Min length
-        int field_count;                ///< Field count
         
         // addressing
         uint64_t dest64;                ///< Destination 64-bit address field
-        int dest64_offset;              ///< Destination 64-bit address field offset
         uint16_t dest16;                ///< Destination 16-bit address field
-        int dest16_offset;              ///< Destination 16-bit address field offset
         uint64_t src64;                 ///< Source 64-bit address field
-        int src64_offset;               ///< Source 64-bit address field offset
         uint16_t src16;                 ///< Source 16-bit address field
-        int src16_offset;               ///< Source 16-bit address field offset
         uint64_t sender64;              ///< Sender 64-bit address field
-        int sender64_offset;            ///< Sender 64-bit address field offset
         uint16_t sender16;              ///< Sender 16-bit address field
-        int sender16_offset;            ///< Sender 16-bit address field offset
         uint16_t parent16;              ///< Parent 16-bit address field
-        int parent16_offset;            ///< Parent 16-bit address field offset
         uint64_t new64;                 ///< New 64-bit address field
-        int new64_offset;               ///< New 64-bit address field offset
         uint16_t new16;                 ///< New 16-bit address field
-        int new16_offset;               ///< New 16-bit address field offset
         
         // explicit addressing
         uint8_t src_ep;                 ///< Source endpoint field
-        int src_ep_offset;              ///< Source endpoint field offset
         uint8_t dest_ep;                ///< Destination endpoint field
-        int dest_ep_offset;             ///< Destination endpoint field offset
         uint16_t cluster_id;            ///< Cluster ID field
-        int cluster_id_offset;          ///< Cluster ID field offset
         uint16_t profile_id;            ///< Profile ID field
-        int profile_id_offset;          ///< Profile ID field offset
         
         // transmit parameters
         uint8_t radius;                 ///< Radius field
-        int radius_offset;              ///< Radius field offset
         uint8_t transmit_retries;       ///< Transmit retries field
-        int transmit_retries_offset;    ///< Transmit retries field offset
         uint8_t delivery_status;        ///< Delivery status field
-        int delivery_status_offset;     ///< Delivery status field offset
         uint8_t discovery_status;       ///< Discovery status field
-        int discovery_status_offset;    ///< Discovery status field offset
         
         // RSSI
         uint8_t rssi;                   ///< Receive signal strength indication field
-        int rssi_offset;                ///< Receive signal strength indication field offset
         
         // sampling
         uint16_t digital_mask;          ///< Digital mask field
-        int digital_mask_offset;        ///< Digital mask field offset
         uint8_t analog_mask;            ///< Analog mask field
-        int analog_mask_offset;         ///< Analog mask field offset
         uint8_t num_samples;            ///< Num samples field
-        int num_samples_offset;         ///< Num samples field offset
         
         // packet data (rf, at, etc.)
         std::vector<uint8_t> data;      ///< Packet data field
-        int data_offset;                ///< Packet data field offset
         
         // routing
         std::vector<uint16_t> route_records;    ///< Route records field
-        int route_records_offset;               ///< Route records field offset
         
         /**
          * Zero out all packet fields.
@@ -472,13 +553,33 @@ public:
          * Get size of packet and header.
          * @return packet size in bytes
          */
-        uint16_t get_length();
+        uint16_t get_length() const;
         
         /**
          * Calculate checksum of payload.
          * @return checksum byte
          */
-        uint8_t get_checksum();
+        uint8_t get_checksum() const;
+        
+        /**
+         * Get worst case size of the encoded frame.
+         * @param escaped true for API mode 2 (AP=2) framing
+         * @return buffer size needed by encode()
+         * @see encode()
+         */
+        size_t get_max_encoded_length(bool escaped) const;
+        
+        /**
+         * Encode the frame into a caller supplied buffer.  Start byte,
+         * length, payload, escaping and checksum are written in a single
+         * pass, nothing is allocated.
+         * @param buf buffer to write to
+         * @param size size of buffer, at least get_max_encoded_length()
+         * @param escaped true for API mode 2 (AP=2) framing
+         * @return number of bytes written, 0 if the buffer is too small
+         * @see get_max_encoded_length()
+         */
+        size_t encode(uint8_t *buf, size_t size, bool escaped) const;
         
         /**
          * Get raw packet data, including identifier and size.
@@ -499,7 +600,7 @@ public:
          * @param bytes_read Return number bytes read
          * @return true if packet read, false if not
          */
-        bool read_packet(std::vector<char> bytes, size_t &bytes_read);
+        bool read_packet(const std::vector<char> &bytes, size_t &bytes_read);
         
         /**
          * Try to read packet from a vector of bytes. Looks for identifier
@@ -508,7 +609,7 @@ public:
          * @param bytes_read Return number bytes read
          * @return true if packet read, false if not
          */
-        bool read_packet(std::vector<uint8_t> bytes, size_t &bytes_read);
+        bool read_packet(const std::vector<uint8_t> &bytes, size_t &bytes_read);
         
         /**
          * Try to read packet from a deque of bytes. Looks for identifier
@@ -517,31 +618,74 @@ public:
          * @param bytes_read Return number bytes read
          * @return true if packet read, false if not
          */
-        bool read_packet(std::deque<char> bytes, size_t &bytes_read);
+        bool read_packet(const std::deque<char> &bytes, size_t &bytes_read);
         
         /**
          * Try to read packet from a deque of bytes. Looks for identifier
          * byte to indicate start of packet.
-         * @param bytes deque of type char to read from
+         * @param bytes deque of type uint8_t to read from
          * @param bytes_read Return number bytes read
          * @return true if packet read, false if not
          */
-        bool read_packet(std::deque<uint8_t> bytes, size_t &bytes_read);
+        bool read_packet(const std::deque<uint8_t> &bytes, size_t &bytes_read);
         
         /**
-         * Try to read packet from a deque of bytes. Looks for identifier
+         * Try to read packet from a buffer of bytes. Looks for identifier
          * byte to indicate start of packet.
-         * @param bytes deque of type uint8_t to read from
+         * @param bytes pointer to buffer of type uint8_t to read from
+         * @param count number of bytes in buffer
          * @param bytes_read Return number bytes read
          * @return true if packet read, false if not
          */
-        bool read_packet(uint8_t *bytes, size_t count, size_t &bytes_read);
+        bool read_packet(const uint8_t *bytes, size_t count, size_t &bytes_read);
         
         /**
-         * Configure field offsets based on identifier.
+         * Load payload from an unescaped frame payload, such as one returned
+         * by ZigBeeFrameParser::read_frame().
+         * @param bytes pointer to payload (identifier through data)
+         * @param count payload length
+         * @see payload
+         * @see decode_packet()
+         */
+        void set_payload(const uint8_t *bytes, size_t count);
+        
+        /**
+         * Look up field layout based on identifier.
          * @return true if success, false if bad identifier
+         * @see layout
+         */
+        bool set_layout();
+        
+        /**
+         * Get offset of a field in the current layout.
+         * @param f field
+         * @return payload offset, 0 if the frame type has no such field
+         * @see layout
+         */
+        int get_field_offset(ZBP_Field f);
+        
+        /**
+         * Get value of an integer field.
+         * @param f field
+         * @return value, 0 for fields that are not integers
+         */
+        uint64_t get_field_value(ZBP_Field f);
+        
+        /**
+         * Set value of an integer field.  Ignored for fields that are not
+         * integers.
+         * @param f field
+         * @param value value
+         */
+        void set_field_value(ZBP_Field f, uint64_t value);
+        
+        /**
+         * Get field value formatted for display or editing.
+         * @param f field
+         * @return formatted value
+         * @see ZBP_FieldDisplay
          */
-        bool set_offsets();
+        std::string get_field_string(ZBP_Field f);
         
         /**
          * Populate payload with header fields and data.
@@ -601,8 +745,87 @@ public:
          */
         static std::string get_type_desc(int identifier);
         
+        /**
+         * Get the frame layout for a given identifier.
+         * @return layout, or 0 if identifier is not valid
+         * @see ZBP_Layout
+         */
+        static const ZBP_Layout *get_layout(int identifier);
+        
+        /**
+         * Get worst case size of an encoded frame.
+         * @param length payload length
+         * @param escaped true for API mode 2 (AP=2) framing
+         * @return buffer size needed by encode_frame()
+         */
+        static size_t get_max_frame_length(size_t length, bool escaped);
+        
+        /**
+         * Encode a frame payload into a caller supplied buffer.
+         * @param payload frame payload, identifier through data
+         * @param length payload length
+         * @param buf buffer to write to
+         * @param size size of buffer, at least get_max_frame_length()
+         * @param escaped true for API mode 2 (AP=2) framing
+         * @return number of bytes written, 0 if the buffer is too small
+         * @see encode()
+         */
+        static size_t encode_frame(const uint8_t *payload, size_t length, uint8_t *buf, size_t size, bool escaped);
+        
+        /**
+         * Get the identifier of the response a request frame type produces.
+         * Responses carry the frame ID of the request.
+         * @param identifier request identifier
+         * @return response identifier, or 0 if the frame type gets no
+         * response
+         */
+        static int get_response_identifier(int identifier);
+        
+        /**
+         * Get description of a field.
+         * @param f field
+         * @return field description
+         * @see ZBP_FieldInfo
+         */
+        static const ZBP_FieldInfo &get_field_info(ZBP_Field f);
+        
 protected:
+        /**
+         * Write formatted field value to a stream.
+         * @param out output stream
+         * @param f field
+         * @see get_field_string()
+         */
+        void write_field(std::ostream &out, ZBP_Field f);
+        
+        /**
+         * Frame type definition, fields only.  Offsets are derived from the
+         * field sizes when the layout table is built.
+         */
+        struct ZBP_FrameDef
+        {
+                ZBP_Identifier identifier;      ///< Identifier
+                const char *desc;               ///< Type description
+                ZBP_Field fields[ZBP_MAX_FIELDS]; ///< Fields in payload order
+        };
+        
+        /**
+         * Layout table indexed by identifier.
+         */
+        struct ZBP_LayoutTable;
+        
+        /**
+         * Frame type definitions.
+         */
+        static const ZBP_FrameDef frame_defs[];
+        
+        /**
+         * Field descriptions, in ZBP_Field order.
+         */
+        static const ZBP_FieldInfo field_info[ZBPF_Count];
+        
         // read and write payload data
+        // out of range offsets read as 0 and are not written
         /**
          * Read an 8 bit integer from payload
          * @param offset offset to read from
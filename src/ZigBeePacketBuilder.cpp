@@ -32,6 +32,7 @@
 /************************************************************************/
 
 #include "ZigBeePacketBuilder.h"
+#include "HexCodec.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -48,8 +49,11 @@ ZigBeePacketBuilder::ZigBeePacketBuilder()
         identifier_list = ZigBeePacket::get_valid_identifiers();
         
         current_identifier = -1;
+        current_fields = 0;
         
         updating_fields = false;
+        update_pending = false;
+        data_pending = false;
         
         tbl.resize(2, 2);
         tbl.set_col_spacings(10);
@@ -96,958 +100,315 @@ ZigBeePacketBuilder::ZigBeePacketBuilder()
 
 ZigBeePacketBuilder::~ZigBeePacketBuilder()
 {
-        labels.clear();
-        fields.clear();
+        c_update_timeout.disconnect();
+        
+        current_fields = 0;
+        field_sets.clear();
 }
 
 
 void ZigBeePacketBuilder::on_type_change()
 {
+        // keep edits still waiting, the new type shares the data
+        flush_updates(false);
+        
         pkt.identifier = ZigBeePacket::ZBP_Identifier(identifier_list[cmbt_type.get_active_row_number()]);
         
         read_packet();
 }
 
-void ZigBeePacketBuilder::on_field_change(int offset, int index)
+void ZigBeePacketBuilder::on_field_change(int field, int index)
 {
+        ZigBeePacket::ZBP_Field f = ZigBeePacket::ZBP_Field(field);
+        
         if (updating_fields)
                 return;
         
-        if (pkt.frame_id_offset == offset)
-        {
-                pkt.frame_id = parse_number(fields[index]->get_text());
-        }
-        
-        if (pkt.at_cmd_offset == offset)
-        {
-                Glib::ustring str = fields[index]->get_text();
-                pkt.at_cmd[0] = ' ';
-                pkt.at_cmd[1] = ' ';
-                if (str.size() > 0)
-                        pkt.at_cmd[0] = str[0];
-                if (str.size() > 1)
-                        pkt.at_cmd[1] = str[1];
-        }
-        
-        if (pkt.status_offset == offset)
-        {
-                pkt.status = parse_number(fields[index]->get_text());
-        }
-        
-        if (pkt.options_offset == offset)
-        {
-                pkt.options = parse_number(fields[index]->get_text());
-        }
+        Glib::ustring str = current_fields->fields[index]->get_text();
         
-        if (pkt.dest64_offset == offset)
+        switch (ZigBeePacket::get_field_info(f).type)
         {
-                pkt.dest64 = parse_number(fields[index]->get_text());
+                case ZigBeePacket::ZBPT_Chars:
+                        pkt.at_cmd[0] = ' ';
+                        pkt.at_cmd[1] = ' ';
+                        if (str.size() > 0)
+                                pkt.at_cmd[0] = str[0];
+                        if (str.size() > 1)
+                                pkt.at_cmd[1] = str[1];
+                        break;
+                case ZigBeePacket::ZBPT_Words:
+                        {
+                                const char *p = str.data();
+                                const char *end = p + str.bytes();
+                                uint64_t k;
+                                
+                                pkt.route_records.clear();
+                                
+                                while (HexCodec::read_hex(p, end, 4, k))
+                                        pkt.route_records.push_back(k);
+                        }
+                        break;
+                default:
+                        pkt.set_field_value(f, parse_number(str));
+                        break;
         }
         
-        if (pkt.dest16_offset == offset)
-        {
-                pkt.dest16 = parse_number(fields[index]->get_text());
-        }
+        update_packet();
+}
+
+void ZigBeePacketBuilder::on_data_change()
+{
+        if (updating_fields)
+                return;
         
-        if (pkt.src64_offset == offset)
-        {
-                pkt.src64 = parse_number(fields[index]->get_text());
-        }
+        // parsed when the update delay runs out
+        data_pending = true;
         
-        if (pkt.src16_offset == offset)
-        {
-                pkt.src16 = parse_number(fields[index]->get_text());
-        }
+        update_packet();
+}
+
+void ZigBeePacketBuilder::read_data(bool hex)
+{
+        Glib::ustring str = tv_data.get_buffer()->get_text();
         
-        if (pkt.sender64_offset == offset)
-        {
-                pkt.sender64 = parse_number(fields[index]->get_text());
-        }
+        data_pending = false;
         
-        if (pkt.sender16_offset == offset)
-        {
-                pkt.sender16 = parse_number(fields[index]->get_text());
-        }
+        pkt.data.clear();
         
-        if (pkt.parent16_offset == offset)
+        if (hex)
         {
-                pkt.parent16 = parse_number(fields[index]->get_text());
+                HexCodec::decode(str.raw(), pkt.data);
         }
-        
-        if (pkt.new64_offset == offset)
+        else
         {
-                pkt.new64 = parse_number(fields[index]->get_text());
+                // walk by iterator, indexing a ustring is linear per character
+                pkt.data.reserve(str.bytes());
+                
+                for (Glib::ustring::const_iterator it = str.begin(); it != str.end(); ++it)
+                {
+                        pkt.data.push_back(*it);
+                }
         }
+}
+
+void ZigBeePacketBuilder::on_hex_data_toggle()
+{
+        // text still waiting was typed in the other mode
+        if (data_pending)
+                read_data(!hex_data.get_active());
         
-        if (pkt.new16_offset == offset)
-        {
-                pkt.new16 = parse_number(fields[index]->get_text());
-        }
+        update_data();
+}
+
+bool ZigBeePacketBuilder::on_update_timeout()
+{
+        flush_updates();
         
-        if (pkt.src_ep_offset == offset)
-        {
-                pkt.src_ep = parse_number(fields[index]->get_text());
-        }
+        return false;
+}
+
+void ZigBeePacketBuilder::update_packet()
+{
+        update_pending = true;
         
-        if (pkt.dest_ep_offset == offset)
-        {
-                pkt.dest_ep = parse_number(fields[index]->get_text());
-        }
+        c_update_timeout.disconnect();
+        c_update_timeout = Glib::signal_timeout().connect( sigc::mem_fun(*this, &ZigBeePacketBuilder::on_update_timeout), update_delay );
+}
+
+void ZigBeePacketBuilder::flush_updates(bool emit)
+{
+        c_update_timeout.disconnect();
         
-        if (pkt.cluster_id_offset == offset)
-        {
-                pkt.cluster_id = parse_number(fields[index]->get_text());
-        }
+        if (data_pending)
+                read_data(hex_data.get_active());
         
-        if (pkt.profile_id_offset == offset)
-        {
-                pkt.profile_id = parse_number(fields[index]->get_text());
-        }
+        if (!update_pending)
+                return;
         
-        if (pkt.radius_offset == offset)
-        {
-                pkt.radius = parse_number(fields[index]->get_text());
-        }
+        update_pending = false;
         
-        if (pkt.transmit_retries_offset == offset)
-        {
-                pkt.transmit_retries = parse_number(fields[index]->get_text());
-        }
+        pkt.build_packet();
         
-        if (pkt.delivery_status_offset == offset)
-        {
-                pkt.delivery_status = parse_number(fields[index]->get_text());
-        }
+        if (emit)
+                m_signal_changed.emit();
+}
+
+void ZigBeePacketBuilder::update_data()
+{
+        std::string str;
         
-        if (pkt.discovery_status_offset == offset)
-        {
-                pkt.discovery_status = parse_number(fields[index]->get_text());
-        }
+        updating_fields = true;
         
-        if (pkt.rssi_offset == offset)
+        if (hex_data.get_active())
         {
-                pkt.rssi = parse_number(fields[index]->get_text());
+                if (!pkt.data.empty())
+                        HexCodec::append(str, &pkt.data[0], pkt.data.size());
+                
+                tv_data.get_buffer()->set_text(str);
         }
-        
-        if (pkt.digital_mask_offset == offset)
+        else
         {
-                pkt.digital_mask = parse_number(fields[index]->get_text());
+                str.assign(pkt.data.begin(), pkt.data.end());
+                
+                tv_data.get_buffer()->set_text(Glib::convert(str, "utf-8", "iso-8859-1"));
         }
         
-        if (pkt.analog_mask_offset == offset)
-        {
-                pkt.analog_mask = parse_number(fields[index]->get_text());
-        }
+        updating_fields = false;
+}
+
+uint64_t ZigBeePacketBuilder::parse_number(const Glib::ustring &str)
+{
+        uint64_t l = 0;
+        size_t n = str.raw().find("0x");
         
-        if (pkt.num_samples_offset == offset)
+        if (n != std::string::npos)
         {
-                pkt.num_samples = parse_number(fields[index]->get_text());
+                const char *p = str.data() + n;
+                
+                HexCodec::read_hex(p, str.data() + str.bytes(), 16, l);
         }
-        
-        if (pkt.route_records_offset == offset)
+        else
         {
-                pkt.route_records.clear();
-                
-                Glib::ustring str = fields[index]->get_text();
-                
-                for (int i = 0; i < str.size(); i++)
-                {
-                        int k, num;
-                        
-                        if (sscanf(str.c_str()+i, "%4x%n", &k, &num) > 0)
-                        {
-                                i += num-1;
-                                pkt.route_records.push_back(k);
-                        }
-                }
+                l = strtoull(str.c_str(), 0, 10);
         }
         
-        update_packet();
+        return l;
 }
 
-void ZigBeePacketBuilder::on_data_change()
+void ZigBeePacketBuilder::create_fields(FieldSet &set)
 {
-        if (updating_fields)
-                return;
+        const ZigBeePacket::ZBP_FieldLayout *f;
+        int row = 2;
         
-        pkt.data.clear();
-        
-        Glib::ustring str = tv_data.get_buffer()->get_text();
+        set.data_row = -1;
         
-        if (hex_data.get_active())
+        // one label and entry per field, data gets the text view
+        for (f = pkt.layout->fields; f->field != ZigBeePacket::ZBPF_None; f++)
         {
-                for (int i = 0; i < str.size(); i++)
+                const ZigBeePacket::ZBP_FieldInfo &info = ZigBeePacket::get_field_info(f->field);
+                
+                if (!info.label)
+                        continue;
+                
+                set.labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
+                set.labels.back()->set_label(info.label);
+                set.labels.back()->set_visible(true);
+                
+                set.fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
+                set.rows.push_back(row);
+                
+                if (info.type == ZigBeePacket::ZBPT_Bytes)
                 {
-                        int k, num;
-                        uint8_t b;
+                        set.data_row = row;
                         
-                        if (sscanf(str.c_str()+i, "%2x%n", &k, &num) > 0)
-                        {
-                                i += num-1;
-                                b = k;
-                                pkt.data.push_back(b);
-                        }
-                }
-        }
-        else
-        {
-                for (int i = 0; i < str.size(); i++)
-                {
-                        pkt.data.push_back(str[i]);
+                        row += 2;
+                        continue;
                 }
+                
+                set.fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), f->field, set.fields.size()-1));
+                set.fields.back()->set_visible(true);
+                
+                row++;
         }
-        
-        update_packet();
-}
-
-void ZigBeePacketBuilder::on_hex_data_toggle()
-{
-        update_data();
-}
-
-void ZigBeePacketBuilder::update_packet()
-{
-        pkt.build_packet();
-        
-        m_signal_changed.emit();
 }
 
-void ZigBeePacketBuilder::update_data()
+void ZigBeePacketBuilder::attach_fields(FieldSet &set, bool attach)
 {
-        std::stringstream ss;
-        
-        for (int j = 0; j < pkt.data.size(); j++)
+        for (size_t i = 0; i < set.labels.size(); i++)
         {
-                if (hex_data.get_active())
+                int row = set.rows[i];
+                
+                if (attach)
                 {
-                        if (j > 0)
-                                ss << " ";
-                        ss << std::setfill('0') << std::setw(2) << std::hex << (int)pkt.data[j];
+                        tbl.attach(*set.labels[i], 0, 1, row, row+1);
+                        if (row != set.data_row)
+                                tbl.attach(*set.fields[i], 1, 2, row, row+1);
                 }
                 else
                 {
-                        ss << pkt.data[j];
+                        tbl.remove(*set.labels[i]);
+                        if (row != set.data_row)
+                                tbl.remove(*set.fields[i]);
                 }
         }
         
-        updating_fields = true;
-        
-        tv_data.get_buffer()->set_text(Glib::convert(ss.str(), "utf-8", "iso-8859-1"));
-        
-        updating_fields = false;
-}
-
-unsigned long ZigBeePacketBuilder::parse_number(Glib::ustring str)
-{
-        unsigned long l = 0;
-        size_t n = str.find("0x");
+        if (set.data_row < 0)
+                return;
         
-        if (n != std::string::npos)
+        if (attach)
         {
-                l = std::strtol(str.substr(n).c_str(), 0, 16);
+                tbl.attach(al_hex_data, 0, 1, set.data_row+1, set.data_row+2);
+                tbl.attach(sw_data, 1, 2, set.data_row, set.data_row+2);
         }
         else
         {
-                l = std::strtol(str.c_str(), 0, 10);
+                tbl.remove(sw_data);
+                tbl.remove(al_hex_data);
         }
-        
-        return l;
 }
 
 void ZigBeePacketBuilder::read_packet()
 {
+        const ZigBeePacket::ZBP_FieldLayout *f;
         int row;
         std::stringstream ss;
         
         if (pkt.identifier != current_identifier)
         {
-                row = 2;
+                std::map<int, FieldSet>::iterator it;
                 
                 current_identifier = pkt.identifier;
                 
                 ss << "0x" << std::setfill('0') << std::setw(2) << std::hex << pkt.identifier;
                 ent_identifier.set_text(ss.str());
                 
-                labels.clear();
-                fields.clear();
-                if (sw_data.get_parent())
-                {
-                        tbl.remove(sw_data);
-                        tbl.remove(al_hex_data);
-                }
+                if (current_fields)
+                        attach_fields(*current_fields, false);
+                current_fields = 0;
                 tbl.resize(3, 2);
                 
-                if (!pkt.set_offsets())
+                if (!pkt.set_layout())
                         return;
                 
                 pkt.build_packet();
                 
-                tbl.resize(pkt.field_count+1, 2);
-                
-                for (int i = 1; i <= pkt.min_length; i++)
+                it = field_sets.find(current_identifier);
+                if (it == field_sets.end())
                 {
-                        if (pkt.frame_id_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Frame ID:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.at_cmd_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("AT Command:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.status_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Status:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.options_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Options:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.dest64_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Dest 64:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.dest16_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Dest 16:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.src64_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Source 64:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.src16_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Source 16:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.sender64_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Sender 64:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.sender16_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Sender 16:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.parent16_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Parent 16:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.new64_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("New 64:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.new16_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("New 16:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.src_ep_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Source EP:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.dest_ep_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Dest EP:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.cluster_id_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Cluster ID:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.profile_id_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Profile ID:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.radius_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Radius:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.transmit_retries_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Transmit Retries:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.delivery_status_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Delivery Status:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.discovery_status_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Discovery Status:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.rssi_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("RSSI:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.digital_mask_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Digital Mask:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.analog_mask_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Analog Mask:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.num_samples_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Samples:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
-                        if (pkt.data_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Data:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                tbl.attach(al_hex_data, 0, 1, row+1, row+2);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                tbl.attach(sw_data, 1, 2, row, row+2);
-                                
-                                row += 2;
-                        }
-                        
-                        if (pkt.route_records_offset == i)
-                        {
-                                labels.push_back(shared_ptr<Gtk::Label>(new Gtk::Label()));
-                                labels.back()->set_label("Route Records:");
-                                labels.back()->set_visible(true);
-                                tbl.attach(*labels.back(), 0, 1, row, row+1);
-                                
-                                fields.push_back(shared_ptr<Gtk::Entry>(new Gtk::Entry()));
-                                fields.back()->signal_changed().connect(sigc::bind(sigc::mem_fun(*this, &ZigBeePacketBuilder::on_field_change), i, fields.size()-1));
-                                fields.back()->set_visible(true);
-                                tbl.attach(*fields.back(), 1, 2, row, row+1);
-                                
-                                row++;
-                        }
-                        
+                        it = field_sets.insert(std::make_pair(current_identifier, FieldSet())).first;
+                        create_fields(it->second);
                 }
+                current_fields = &it->second;
                 
+                tbl.resize(pkt.layout->num_fields+3, 2);
+                attach_fields(*current_fields, true);
         }
         
+        if (!pkt.set_layout())
+                return;
+                
         row = 0;
         
         updating_fields = true;
         
-        for (int i = 1; i <= pkt.min_length; i++)
+        for (f = pkt.layout->fields; f->field != ZigBeePacket::ZBPF_None; f++)
         {
-                if (pkt.frame_id_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(2) << std::hex << (int)pkt.frame_id;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
+                const ZigBeePacket::ZBP_FieldInfo &info = ZigBeePacket::get_field_info(f->field);
                 
-                if (pkt.at_cmd_offset == i)
-                {
-                        ss.str("");
-                        ss << pkt.at_cmd[0] << pkt.at_cmd[1];
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.status_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(2) << std::hex << (int)pkt.status;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.options_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(2) << std::hex << (int)pkt.options;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.dest64_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(16) << std::hex << pkt.dest64;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.dest16_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(4) << std::hex << (int)pkt.dest16;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.src64_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(16) << std::hex << pkt.src64;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.src16_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(4) << std::hex << (int)pkt.src16;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.sender64_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(16) << std::hex << pkt.sender64;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.sender16_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(4) << std::hex << (int)pkt.sender16;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.parent16_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(4) << std::hex << (int)pkt.parent16;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.new64_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(16) << std::hex << pkt.new64;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.new16_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(4) << std::hex << (int)pkt.new16;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.src_ep_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(2) << std::hex << (int)pkt.src_ep;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.dest_ep_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(2) << std::hex << (int)pkt.dest_ep;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.cluster_id_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(4) << std::hex << (int)pkt.cluster_id;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.profile_id_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(4) << std::hex << (int)pkt.profile_id;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.radius_offset == i)
-                {
-                        ss.str("");
-                        ss << std::dec << (int)pkt.radius;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.transmit_retries_offset == i)
-                {
-                        ss.str("");
-                        ss << std::dec << (int)pkt.transmit_retries;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.delivery_status_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(2) << std::hex << (int)pkt.delivery_status;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.discovery_status_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(2) << std::hex << (int)pkt.discovery_status;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
+                if (!info.label)
+                        continue;
                 
-                if (pkt.rssi_offset == i)
-                {
-                        ss.str("");
-                        ss << std::dec << (int)pkt.rssi;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.digital_mask_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(4) << std::hex << (int)pkt.digital_mask;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.analog_mask_offset == i)
-                {
-                        ss.str("");
-                        ss << "0x" << std::setfill('0') << std::setw(2) << std::hex << (int)pkt.analog_mask;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.num_samples_offset == i)
-                {
-                        ss.str("");
-                        ss << std::dec << (int)pkt.num_samples;
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
-                }
-                
-                if (pkt.data_offset == i)
+                if (info.type == ZigBeePacket::ZBPT_Bytes)
                 {
                         update_data();
                         updating_fields = true;
-                        
-                        row += 2;
                 }
-                
-                if (pkt.route_records_offset == i)
+                else
                 {
-                        ss.str("");
-                        for (int j = 0; j < pkt.route_records.size(); j++)
-                        {
-                                if (j > 0)
-                                        ss << " ";
-                                ss << "0x" << std::setfill('0') << std::setw(4) << std::hex << (int)pkt.route_records[j];
-                        }
-                        fields[row]->set_text(ss.str());
-                        
-                        row++;
+                        current_fields->fields[row]->set_text(pkt.get_field_string(f->field));
                 }
                 
+                row++;
         }
         
         updating_fields = false;
@@ -1057,6 +418,11 @@ void ZigBeePacketBuilder::read_packet()
 
 void ZigBeePacketBuilder::set_packet(ZigBeePacket p)
 {
+        // edits still waiting belong to the packet being replaced
+        c_update_timeout.disconnect();
+        update_pending = false;
+        data_pending = false;
+        
         pkt = p;
         
         for (int i = 0; i < identifier_list.size(); i++)
@@ -1072,6 +438,8 @@ void ZigBeePacketBuilder::set_packet(ZigBeePacket p)
 
 ZigBeePacket ZigBeePacketBuilder::get_packet()
 {
+        flush_updates();
+        
         return pkt;
 }
 
@@ -36,6 +36,7 @@
 
 #include <gtkmm.h>
 #include <tr1/memory>
+#include <map>
 
 #include "ZigBeePacket.h"
 
@@ -44,7 +45,10 @@
  * 
  * The ZigBee Packet Builder is a specialized widget for for creating ZigBee
  * packets for Digi XBee radios.  The packet builder will configure itself for
- * the selected packet type.  
+ * the selected packet type.  Edits are applied to the packet at once but the
+ * packet is only rebuilt, and the changed signal emitted, once typing pauses
+ * for update_delay ms; the field widgets of each packet type are kept and
+ * reattached when the type is selected again.  
  */
 class ZigBeePacketBuilder : public Gtk::VBox
 {
@@ -70,7 +74,8 @@ public:
         void set_packet(ZigBeePacket p);
         
         /**
-         * Get built packet
+         * Get built packet.  Applies any edits still waiting on the update
+         * delay first.
          * @return built ZigBee packet.
          * @see pkt
          */
@@ -84,6 +89,17 @@ public:
         sigc::signal<void> signal_changed();
         
 protected:
+        /**
+         * Field widgets of one packet type.
+         */
+        struct FieldSet
+        {
+                std::vector< std::tr1::shared_ptr< Gtk::Label > > labels;       ///< Field labels
+                std::vector< std::tr1::shared_ptr< Gtk::Entry > > fields;       ///< Field text boxes, unused for data
+                std::vector<int> rows;                                          ///< Table row of each field
+                int data_row;                                                   ///< Table row of data text view, -1 if none
+        };
+        
         //Signal handlers:
         /**
          * Type combo change event.
@@ -92,10 +108,10 @@ protected:
         
         /**
          * Field change signal.
-         * @param offset field offset in packet
+         * @param field ZigBeePacket::ZBP_Field of the changed field
          * @param index widget index in field list
          */
-        void on_field_change(int offset, int index);
+        void on_field_change(int field, int index);
         
         /**
          * Data change signal.
@@ -108,12 +124,46 @@ protected:
         void on_hex_data_toggle();
         
         /**
-         * Build packet and emit changed signal.
+         * Update delay timeout.
+         * @return false
+         * @see update_packet()
+         */
+        bool on_update_timeout();
+        
+        /**
+         * Build packet and emit changed signal once the update delay runs
+         * out, restarting the delay if already waiting.
          * @see pkt
          * @see signal_changed()
          */
         void update_packet();
         
+        /**
+         * Apply edits waiting on the update delay now.
+         * @param emit true to build the packet and emit the changed signal
+         * @see update_packet()
+         */
+        void flush_updates(bool emit = true);
+        
+        /**
+         * Parse data text box into packet data.
+         * @param hex true if the text is hex
+         */
+        void read_data(bool hex);
+        
+        /**
+         * Create field widgets for the packet layout.
+         * @param set return widgets
+         */
+        void create_fields(FieldSet &set);
+        
+        /**
+         * Attach or detach field widgets.
+         * @param set widgets
+         * @param attach true to attach, false to detach
+         */
+        void attach_fields(FieldSet &set, bool attach);
+        
         /**
          * Update data text box with data from packet.
          */
@@ -124,7 +174,7 @@ protected:
          * @param str string containing decimal or hexidecimal integer
          * @return value of integer
          */
-        unsigned long parse_number(Glib::ustring str);
+        uint64_t parse_number(const Glib::ustring &str);
         
         //Child widgets:
         /**
@@ -173,14 +223,14 @@ protected:
         Gtk::CheckButton hex_data;
         
         /**
-         * List of field label references.
+         * Field widgets by packet identifier, created on first use.
          */
-        std::vector< std::tr1::shared_ptr< Gtk::Label > > labels;
+        std::map<int, FieldSet> field_sets;
         
         /**
-         * List of field text boxes.
+         * Field widgets of the current identifier, 0 if none.
          */
-        std::vector< std::tr1::shared_ptr< Gtk::Entry > > fields;
+        FieldSet *current_fields;
         
         /**
          * List of packet identifier values in combo box.
@@ -197,6 +247,26 @@ protected:
          */
         bool updating_fields;
         
+        /**
+         * Packet waiting to be rebuilt.
+         */
+        bool update_pending;
+        
+        /**
+         * Data text box changed since last parsed.
+         */
+        bool data_pending;
+        
+        /**
+         * Update delay timeout connection.
+         */
+        sigc::connection c_update_timeout;
+        
+        /**
+         * Delay after the last edit before rebuilding, in ms.
+         */
+        static const unsigned int update_delay = 150;
+        
         /**
          * Local packet for field updates.
          * @see update_packet()
@@ -0,0 +1,283 @@
+/************************************************************************/
+/* ZigBeePacketView                                                     */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee Packet View                                 */
+/*                                                                      */
+/* ZigBeePacketView.cpp                                                 */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeePacketView.h"
+
+ZigBeePacketView::ZigBeePacketView() :
+        payload(0),
+        length(0),
+        layout(0)
+{
+        // nothing
+}
+
+
+ZigBeePacketView::ZigBeePacketView(const uint8_t *bytes, size_t count)
+{
+        set(bytes, count);
+}
+
+
+void ZigBeePacketView::set(const uint8_t *bytes, size_t count)
+{
+        payload = bytes;
+        length = count;
+        layout = 0;
+        
+        if (length > 0)
+        {
+                layout = ZigBeePacket::get_layout(payload[0]);
+                
+                // too short for the fixed fields, don't read any of them
+                if (layout && length < (size_t)layout->min_length)
+                        layout = 0;
+        }
+}
+
+
+bool ZigBeePacketView::is_valid() const
+{
+        return layout != 0;
+}
+
+
+const uint8_t *ZigBeePacketView::get_payload() const
+{
+        return payload;
+}
+
+
+size_t ZigBeePacketView::get_payload_length() const
+{
+        return length;
+}
+
+
+uint16_t ZigBeePacketView::get_length() const
+{
+        return length + 4;
+}
+
+
+uint8_t ZigBeePacketView::get_checksum() const
+{
+        uint8_t sum = 0xFF;
+        
+        for (size_t i = 0; i < length; i++)
+                sum -= payload[i];
+                
+        return sum;
+}
+
+
+size_t ZigBeePacketView::get_max_encoded_length(bool escaped) const
+{
+        return ZigBeePacket::get_max_frame_length(length, escaped);
+}
+
+
+size_t ZigBeePacketView::encode(uint8_t *buf, size_t size, bool escaped) const
+{
+        return ZigBeePacket::encode_frame(payload, length, buf, size, escaped);
+}
+
+
+int ZigBeePacketView::get_identifier() const
+{
+        return length > 0 ? payload[0] : -1;
+}
+
+
+const ZigBeePacket::ZBP_Layout *ZigBeePacketView::get_layout() const
+{
+        return layout;
+}
+
+
+std::string ZigBeePacketView::get_type_desc() const
+{
+        return ZigBeePacket::get_type_desc(get_identifier());
+}
+
+
+bool ZigBeePacketView::has_field(ZigBeePacket::ZBP_Field f) const
+{
+        return get_offset(f) != 0;
+}
+
+
+uint64_t ZigBeePacketView::get_field_value(ZigBeePacket::ZBP_Field f) const
+{
+        int offset = get_offset(f);
+        const uint8_t *ptr = payload + offset;
+        uint64_t value = 0;
+        int size;
+        
+        if (offset == 0)
+                return 0;
+                
+        switch (ZigBeePacket::get_field_info(f).type)
+        {
+                case ZigBeePacket::ZBPT_Uint8:
+                        size = 1;
+                        break;
+                case ZigBeePacket::ZBPT_Uint16:
+                        size = 2;
+                        break;
+                case ZigBeePacket::ZBPT_Uint64:
+                        size = 8;
+                        break;
+                default:
+                        return 0;
+        }
+        
+        // big endian
+        for (int i = 0; i < size; i++)
+                value = (value << 8) | ptr[i];
+                
+        return value;
+}
+
+
+uint8_t ZigBeePacketView::get_frame_id() const
+{
+        return get_field_value(ZigBeePacket::ZBPF_FrameID);
+}
+
+
+uint8_t ZigBeePacketView::get_status() const
+{
+        return get_field_value(ZigBeePacket::ZBPF_Status);
+}
+
+
+uint64_t ZigBeePacketView::get_src64() const
+{
+        return get_field_value(ZigBeePacket::ZBPF_Src64);
+}
+
+
+uint16_t ZigBeePacketView::get_src16() const
+{
+        return get_field_value(ZigBeePacket::ZBPF_Src16);
+}
+
+
+uint64_t ZigBeePacketView::get_dest64() const
+{
+        return get_field_value(ZigBeePacket::ZBPF_Dest64);
+}
+
+
+uint16_t ZigBeePacketView::get_dest16() const
+{
+        return get_field_value(ZigBeePacket::ZBPF_Dest16);
+}
+
+
+const uint8_t *ZigBeePacketView::get_data(size_t &count) const
+{
+        int offset = get_offset(ZigBeePacket::ZBPF_Data);
+        
+        count = 0;
+        
+        if (offset == 0)
+                return 0;
+                
+        count = length - offset;
+        return payload + offset;
+}
+
+
+size_t ZigBeePacketView::get_route_record_count() const
+{
+        int offset = get_offset(ZigBeePacket::ZBPF_RouteRecords);
+        size_t count;
+        
+        if (offset == 0)
+                return 0;
+                
+        // don't trust the count past the end of the frame
+        count = payload[offset];
+        if (count > (length - offset - 1) / 2)
+                count = (length - offset - 1) / 2;
+                
+        return count;
+}
+
+
+uint16_t ZigBeePacketView::get_route_record(size_t index) const
+{
+        const uint8_t *ptr;
+        
+        if (index >= get_route_record_count())
+                return 0;
+                
+        ptr = payload + get_offset(ZigBeePacket::ZBPF_RouteRecords) + 1 + index * 2;
+        
+        return ((uint16_t)ptr[0] << 8) | ptr[1];
+}
+
+
+bool ZigBeePacketView::decode(ZigBeePacket &pkt) const
+{
+        pkt.zero();
+        pkt.set_payload(payload, length);
+        return pkt.decode_packet();
+}
+
+
+ZigBeePacket ZigBeePacketView::get_packet() const
+{
+        ZigBeePacket pkt;
+        
+        decode(pkt);
+        
+        return pkt;
+}
+
+
+int ZigBeePacketView::get_offset(ZigBeePacket::ZBP_Field f) const
+{
+        if (!layout)
+                return 0;
+                
+        for (int i = 0; i < layout->num_fields; i++)
+        {
+                if (layout->fields[i].field == f)
+                        return layout->fields[i].offset;
+        }
+        
+        return 0;
+}
+
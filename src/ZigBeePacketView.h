@@ -0,0 +1,252 @@
+/************************************************************************/
+/* ZigBeePacketView                                                     */
+/*                                                                      */
+/* ZigBee Terminal - ZigBee Packet View                                 */
+/*                                                                      */
+/* ZigBeePacketView.h                                                   */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_PACKET_VIEW_H
+#define __ZIGBEE_PACKET_VIEW_H
+
+#include "ZigBeePacket.h"
+
+#include <string>
+#include <inttypes.h>
+
+/** ZigBee Packet View
+ * 
+ * Read only view of an unescaped frame payload.  Fields are read straight
+ * from the payload bytes when asked for, using the same layout tables as
+ * ZigBeePacket, so nothing is copied or allocated.  Views are the size of
+ * two pointers and a length and are meant to be passed by value.  The
+ * view does not own the payload; it is only valid as long as the bytes
+ * it points to.  
+ * @see ZigBeePacket
+ */
+class ZigBeePacketView
+{
+public:
+        /**
+         * Create an empty view.
+         */
+        ZigBeePacketView();
+        
+        /**
+         * Create a view of a frame payload.
+         * @param bytes pointer to payload (identifier through data)
+         * @param count payload length
+         */
+        ZigBeePacketView(const uint8_t *bytes, size_t count);
+        
+        /**
+         * Point view at a frame payload.
+         * @param bytes pointer to payload (identifier through data)
+         * @param count payload length
+         */
+        void set(const uint8_t *bytes, size_t count);
+        
+        /**
+         * Check that the payload is a known frame type and holds all of
+         * its fixed fields.  Field accessors return 0 otherwise.
+         * @return true if valid
+         */
+        bool is_valid() const;
+        
+        /**
+         * Get payload.
+         * @return pointer to payload
+         */
+        const uint8_t *get_payload() const;
+        
+        /**
+         * Get payload length.
+         * @return payload length
+         */
+        size_t get_payload_length() const;
+        
+        /**
+         * Get frame length, including start byte, length and checksum.
+         * @return frame length
+         * @see ZigBeePacket::get_length()
+         */
+        uint16_t get_length() const;
+        
+        /**
+         * Get frame checksum.
+         * @return checksum
+         */
+        uint8_t get_checksum() const;
+        
+        /**
+         * Get worst case size of the encoded frame.
+         * @param escaped true for API mode 2 (AP=2) framing
+         * @return buffer size needed by encode()
+         */
+        size_t get_max_encoded_length(bool escaped) const;
+        
+        /**
+         * Encode the frame into a caller supplied buffer.
+         * @param buf buffer to write to
+         * @param size size of buffer, at least get_max_encoded_length()
+         * @param escaped true for API mode 2 (AP=2) framing
+         * @return number of bytes written, 0 if the buffer is too small
+         * @see ZigBeePacket::encode_frame()
+         */
+        size_t encode(uint8_t *buf, size_t size, bool escaped) const;
+        
+        /**
+         * Get identifier.
+         * @return identifier byte, -1 if payload is empty
+         */
+        int get_identifier() const;
+        
+        /**
+         * Get frame layout.
+         * @return layout, 0 if not valid
+         * @see ZigBeePacket::get_layout()
+         */
+        const ZigBeePacket::ZBP_Layout *get_layout() const;
+        
+        /**
+         * Get a string description of the packet type.
+         * @return description string
+         */
+        std::string get_type_desc() const;
+        
+        /**
+         * Check if the frame type has a field.
+         * @param f field
+         * @return true if present
+         */
+        bool has_field(ZigBeePacket::ZBP_Field f) const;
+        
+        /**
+         * Read an integer field.
+         * @param f field
+         * @return value, 0 if not present or not an integer field
+         */
+        uint64_t get_field_value(ZigBeePacket::ZBP_Field f) const;
+        
+        /**
+         * Read frame ID field.
+         * @return frame ID, 0 if not present
+         */
+        uint8_t get_frame_id() const;
+        
+        /**
+         * Read status field.
+         * @return status, 0 if not present
+         */
+        uint8_t get_status() const;
+        
+        /**
+         * Read source 64-bit address field.
+         * @return address, 0 if not present
+         */
+        uint64_t get_src64() const;
+        
+        /**
+         * Read source 16-bit address field.
+         * @return address, 0 if not present
+         */
+        uint16_t get_src16() const;
+        
+        /**
+         * Read destination 64-bit address field.
+         * @return address, 0 if not present
+         */
+        uint64_t get_dest64() const;
+        
+        /**
+         * Read destination 16-bit address field.
+         * @return address, 0 if not present
+         */
+        uint16_t get_dest16() const;
+        
+        /**
+         * Get packet data field.
+         * @param count return data length
+         * @return pointer to data in payload, 0 if not present
+         */
+        const uint8_t *get_data(size_t &count) const;
+        
+        /**
+         * Get number of route records.  Limited to the records actually
+         * present in the payload.
+         * @return route record count
+         */
+        size_t get_route_record_count() const;
+        
+        /**
+         * Read a route record.
+         * @param index route record index
+         * @return route record, 0 if out of range
+         */
+        uint16_t get_route_record(size_t index) const;
+        
+        /**
+         * Decode into a full packet.
+         * @param pkt packet to fill in
+         * @return true if packet successfully parsed
+         * @see ZigBeePacket::decode_packet()
+         */
+        bool decode(ZigBeePacket &pkt) const;
+        
+        /**
+         * Decode into a full packet.
+         * @return decoded packet
+         * @see decode()
+         */
+        ZigBeePacket get_packet() const;
+        
+protected:
+        /**
+         * Get field offset.
+         * @param f field
+         * @return payload offset, 0 if not present
+         */
+        int get_offset(ZigBeePacket::ZBP_Field f) const;
+        
+        /**
+         * Payload, not owned.
+         */
+        const uint8_t *payload;
+        
+        /**
+         * Payload length.
+         */
+        size_t length;
+        
+        /**
+         * Layout, 0 if not valid.
+         */
+        const ZigBeePacket::ZBP_Layout *layout;
+};
+
+#endif //__ZIGBEE_PACKET_VIEW_H
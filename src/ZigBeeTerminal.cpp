@@ -32,17 +32,52 @@
 /************************************************************************/
 
 #include "ZigBeeTerminal.h"
+#include "HexCodec.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include <iostream>
 #include <iomanip>
 #include <string>
 #include <vector>
+#include <algorithm>
 
-ZigBeeTerminal::ZigBeeTerminal()
+ZigBeeTerminal::ZigBeeTerminal(const Glib::ustring &p, unsigned long b)
 {
+        baud = b;
+        port = p;
+        parity = SerialInterface::SP_None;
+        bits = 8;
+        stop_bits = 1;
+        flow_control = SerialInterface::SF_None;
+        low_latency = false;
+        read_min = 1;
+        read_timeout = 20;
+        
+        status.push("Not connected");
+        
+        ser_int = std::tr1::shared_ptr<SerialInterface>(new SerialInterface());
+        ser_int->set_notifier(std::tr1::shared_ptr<Notifier>(new GlibNotifier()));
+        
+        ser_int->port_opened().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_port_open) );
+        ser_int->port_closed().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_port_close) );
+        //ser_int->port_error().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_port_error) );
+        //ser_int->port_receive_data().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_port_receive_data) );
+        
+        zb_int.set_transport(ser_int);
+        zb_int.set_topology(&topology);
+        
+        zb_int.signal_receive_frames().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_receive_frames) );
+        zb_int.signal_receive_raw_data().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_receive_raw_data) );
+        zb_int.signal_send_raw_data().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_send_raw_data) );
+        
+        // start receiving before the window is built, frames are handled
+        // once the main loop runs
+        if (port != "")
+                open_port();
+        
         set_title("ZigBee Terminal");
         set_position(Gtk::WIN_POS_CENTER);
         
@@ -58,6 +93,35 @@ ZigBeeTerminal::ZigBeeTerminal()
         
         file_menu_item.set_submenu(file_menu);
         
+        file_capture_start_item.set_label("Start Capture...");
+        file_capture_start_item.signal_activate().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_file_capture_start_activate) );
+        file_menu.append(file_capture_start_item);
+        
+        file_capture_stop_item.set_label("Stop Capture");
+        file_capture_stop_item.signal_activate().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_file_capture_stop_activate) );
+        file_menu.append(file_capture_stop_item);
+        
+        file_menu.append(file_sep1);
+        
+        file_capture_open_item.set_label("Open Capture...");
+        file_capture_open_item.signal_activate().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_file_capture_open_activate) );
+        file_menu.append(file_capture_open_item);
+        
+        file_replay_start_item.set_label("Replay Capture...");
+        file_replay_start_item.signal_activate().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_file_replay_start_activate) );
+        file_menu.append(file_replay_start_item);
+        
+        file_replay_stop_item.set_label("Stop Replay");
+        file_replay_stop_item.signal_activate().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_file_replay_stop_activate) );
+        file_menu.append(file_replay_stop_item);
+        
+        file_replay_realtime.set_label("Replay at Original Speed");
+        file_replay_realtime.set_active(true);
+        file_replay_realtime.signal_toggled().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_file_replay_realtime_toggle) );
+        file_menu.append(file_replay_realtime);
+        
+        file_menu.append(file_sep2);
+        
         file_quit_item.set_label(Gtk::Stock::QUIT.id);
         file_quit_item.set_use_stock(true);
         file_quit_item.signal_activate().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_file_quit_item_activate) );
@@ -77,6 +141,31 @@ ZigBeeTerminal::ZigBeeTerminal()
         view_hex_log.signal_toggled().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_view_hex_log_toggle) );
         view_menu.append(view_hex_log);
         
+        view_scrollback_item.set_label("Scrollback");
+        view_scrollback_item.set_submenu(view_scrollback_menu);
+        view_menu.append(view_scrollback_item);
+        
+        {
+                Gtk::RadioMenuItem::Group group = view_scrollback_64k.get_group();
+                view_scrollback_1m.set_group(group);
+                view_scrollback_16m.set_group(group);
+                view_scrollback_unlimited.set_group(group);
+        }
+        
+        view_scrollback_64k.set_label("64 KB");
+        view_scrollback_1m.set_label("1 MB");
+        view_scrollback_16m.set_label("16 MB");
+        view_scrollback_unlimited.set_label("Unlimited");
+        view_scrollback_1m.set_active(true);
+        view_scrollback_64k.signal_toggled().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_view_scrollback_toggle) );
+        view_scrollback_1m.signal_toggled().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_view_scrollback_toggle) );
+        view_scrollback_16m.signal_toggled().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_view_scrollback_toggle) );
+        view_scrollback_unlimited.signal_toggled().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_view_scrollback_toggle) );
+        view_scrollback_menu.append(view_scrollback_64k);
+        view_scrollback_menu.append(view_scrollback_1m);
+        view_scrollback_menu.append(view_scrollback_16m);
+        view_scrollback_menu.append(view_scrollback_unlimited);
+        
         view_menu.append(view_sep1);
         
         view_clear_item.set_label("Clear");
@@ -105,8 +194,16 @@ ZigBeeTerminal::ZigBeeTerminal()
         config_api_mode.set_label("Use API Mode");
         config_menu.append(config_api_mode);
         
+        config_api_escaped.set_label("Escaped API Mode (AP=2)");
+        config_api_escaped.signal_toggled().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_config_api_escaped_toggle) );
+        config_menu.append(config_api_escaped);
+        
         // Tabs
         note.set_border_width(5);
+        pkt_builder_page = -1;
+        nodes_page = -1;
+        stats_page = -1;
+        note.signal_switch_page().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_note_switch_page) );
         vbox1.pack_start(note, true, true, 0);
         
         // Terminal tab
@@ -147,24 +244,48 @@ ZigBeeTerminal::ZigBeeTerminal()
         vbox_raw_log.pack_start(sw_raw_log, true, true, 0);
         
         // Packet Log Tab
-        note.append_page(vpane_pkt_log, "Packet Log");
-        //note.append_page(vbox_pkt_log, "Packet Log");
-        
-        tv_pkt_log_tm = Gtk::ListStore::create(cPacketLogModel);
+        note.append_page(vbox_pkt_log, "Packet Log");
+        
+        // filter bar, queries the log index on enter
+        lbl_pkt_log_filter.set_text("Filter:");
+        ent_pkt_log_filter.set_tooltip_text("key=value terms: type, src64, src16, dest64, dest16, cluster, profile (hex), last (seconds)");
+        ent_pkt_log_filter.signal_activate().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_pkt_log_filter_activate) );
+        hbox_pkt_log_filter.pack_start(lbl_pkt_log_filter, false, false, 4);
+        hbox_pkt_log_filter.pack_start(ent_pkt_log_filter, true, true, 0);
+        hbox_pkt_log_filter.pack_start(lbl_pkt_log_count, false, false, 4);
+        vbox_pkt_log.pack_start(hbox_pkt_log_filter, false, false, 2);
+        vbox_pkt_log.pack_start(vpane_pkt_log, true, true, 0);
+        
+        tv_pkt_log_tm = PacketLogModel::create();
         tv_pkt_log.set_model(tv_pkt_log_tm);
         tv_pkt_log.signal_cursor_changed().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_tv_pkt_log_cursor_changed) );
         
-        tv_pkt_log.append_column("Dir", cPacketLogModel.Direction);
-        tv_pkt_log.append_column("Type", cPacketLogModel.Type);
-        tv_pkt_log.append_column("Sz", cPacketLogModel.Size);
-        tv_pkt_log.append_column("Data", cPacketLogModel.Data);
+        tv_pkt_log.append_column("Dir", tv_pkt_log_tm->get_columns().Direction);
+        tv_pkt_log.append_column("Type", tv_pkt_log_tm->get_columns().Type);
+        tv_pkt_log.append_column("Sz", tv_pkt_log_tm->get_columns().Size);
+        tv_pkt_log.append_column("Data", tv_pkt_log_tm->get_columns().Data);
+        
+        // fixed height mode, so only visible rows are formatted
+        {
+                static const int widths[] = {40, 200, 40, 600};
+                
+                for (int i = 0; i < 4; i++)
+                {
+                        Gtk::TreeViewColumn *col = tv_pkt_log.get_column(i);
+                        col->set_sizing(Gtk::TREE_VIEW_COLUMN_FIXED);
+                        col->set_fixed_width(widths[i]);
+                        col->set_resizable(true);
+                }
+        }
+        tv_pkt_log.set_fixed_height_mode(true);
+        
+        pkt_log_scroll_pending = false;
         
         tv_pkt_log.modify_font(Pango::FontDescription("monospace"));
         
         sw_pkt_log.add(tv_pkt_log);
         sw_pkt_log.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
         vpane_pkt_log.pack1(sw_pkt_log, true, true);
-        //vbox_pkt_log.pack_start(sw_pkt_log, true, true, 0);
         
         tv2_pkt_log.set_size_request(400,100);
         tv2_pkt_log.modify_font(Pango::FontDescription("monospace"));
@@ -175,15 +296,75 @@ ZigBeeTerminal::ZigBeeTerminal()
         sw2_pkt_log.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
         vpane_pkt_log.pack2(sw2_pkt_log, false, false);
         
-        // Packet Builder Tab
-        note.append_page(vbox_pkt_builder, "Packet Builder");
+        // Packet Builder Tab, filled in when first shown
+        pkt_builder_page = note.append_page(vbox_pkt_builder, "Packet Builder");
+        
+        // Nodes Tab, filled in when first shown
+        nodes_page = note.append_page(sw_nodes, "Nodes");
+        nodes_built = false;
+        Glib::signal_timeout().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_nodes_timeout), nodes_refresh_interval );
+        
+        // Stats Tab, filled in when first shown
+        stats_page = note.append_page(sw_stats, "Stats");
+        stats_built = false;
+        
+        render_pending_since = 0;
+        Glib::signal_timeout().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_stats_timeout), stats_refresh_interval );
+        
+        // status bar
+        vbox1.pack_start(status, false, true, 0);
+        
+        data_log_ptr = 0;
+        raw_data_log_ptr = 0;
+        rx_overflows = 0;
+        data_log_text_begin = 0;
+        raw_data_log_text_begin = 0;
+        
+        // right gravity marks stay at the end as text is appended
+        term_end_mark = tv_term.get_buffer()->create_mark(tv_term.get_buffer()->end(), false);
+        raw_log_end_mark = tv_raw_log.get_buffer()->create_mark(tv_raw_log.get_buffer()->end(), false);
+        log_render_pending = false;
+        
+        set_scrollback(1048576);
+        
+        dlg_load_test.set_transient_for(*this);
+        dlg_load_test.set_zigbee_interface(&zb_int);
+        
+        replay.signal_replay_data().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_replay_data) );
+        
+        show_all_children();
+}
+
+
+ZigBeeTerminal::~ZigBeeTerminal()
+{
+        
+}
+
+
+void ZigBeeTerminal::on_note_switch_page(GtkNotebookPage *page, guint page_num)
+{
+        if ((int)page_num == pkt_builder_page)
+                build_pkt_builder_page();
+        else if ((int)page_num == nodes_page)
+                build_nodes_page();
+        else if ((int)page_num == stats_page)
+                build_stats_page();
+}
+
+
+void ZigBeeTerminal::build_pkt_builder_page()
+{
+        if (pkt_builder)
+                return;
         
         vbox_pkt_builder.pack_start(vpane_pkt_builder, true, true, 0);
         
-        pkt_builder.set_border_width(5);
-        pkt_builder.signal_changed().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_pkt_builder_change) );
-        //vbox_pkt_builder.pack_start(pkt_builder, true, true, 0);
-        sw_pkt_builder.add(pkt_builder);
+        // the builder fills its type list and field widgets when created
+        pkt_builder = std::tr1::shared_ptr<ZigBeePacketBuilder>(new ZigBeePacketBuilder());
+        pkt_builder->set_border_width(5);
+        pkt_builder->signal_changed().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_pkt_builder_change) );
+        sw_pkt_builder.add(*pkt_builder);
         sw_pkt_builder.set_policy(Gtk::POLICY_NEVER, Gtk::POLICY_AUTOMATIC);
         vpane_pkt_builder.pack1(sw_pkt_builder, true, true);
         
@@ -203,50 +384,107 @@ ZigBeeTerminal::ZigBeeTerminal()
         btn_pkt_builder_send.signal_clicked().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_btn_pkt_builder_send_click) );
         bbox_pkt_builder.add(btn_pkt_builder_send);
         
-        // status bar
+        btn_pkt_builder_load.set_label("Load Test...");
+        btn_pkt_builder_load.signal_clicked().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_btn_pkt_builder_load_click) );
+        bbox_pkt_builder.add(btn_pkt_builder_load);
         
-        status.push("Not connected");
-        vbox1.pack_start(status, false, true, 0);
-        
-        baud = 115200;
-        port = "";
-        parity = SerialInterface::SP_None;
-        bits = 8;
-        stop_bits = 1;
-        flow_control = SerialInterface::SF_None;
+        vbox_pkt_builder.show_all();
+}
+
+
+void ZigBeeTerminal::build_nodes_page()
+{
+        if (nodes_built)
+                return;
+        
+        tv_nodes_tm = Gtk::ListStore::create(nodes_columns);
+        tv_nodes.set_model(tv_nodes_tm);
+        
+        tv_nodes.append_column("Address", nodes_columns.Address64);
+        tv_nodes.append_column("Addr16", nodes_columns.Address16);
+        tv_nodes.append_column("RX", nodes_columns.RxFrames);
+        tv_nodes.append_column("TX", nodes_columns.TxFrames);
+        tv_nodes.append_column("RX Bytes", nodes_columns.RxBytes);
+        tv_nodes.append_column("TX Bytes", nodes_columns.TxBytes);
+        tv_nodes.append_column("RSSI", nodes_columns.Rssi);
+        tv_nodes.append_column("RSSI -40..-100", nodes_columns.RssiHist);
+        tv_nodes.append_column("Status", nodes_columns.TxStatus);
+        tv_nodes.append_column("Retries", nodes_columns.Retries);
+        tv_nodes.append_column("Failed", nodes_columns.Failures);
+        tv_nodes.append_column("Last Seen", nodes_columns.LastSeen);
+        tv_nodes.append_column("Route", nodes_columns.Route);
+        
+        // sort formatted columns on their raw values
+        {
+                const Gtk::TreeModelColumnBase *sort[] = {
+                        &nodes_columns.Address64, &nodes_columns.Address16,
+                        &nodes_columns.RxFrames, &nodes_columns.TxFrames,
+                        &nodes_columns.RxBytes, &nodes_columns.TxBytes,
+                        &nodes_columns.RssiSort, &nodes_columns.RssiSort,
+                        &nodes_columns.TxStatus, &nodes_columns.Retries,
+                        &nodes_columns.Failures, &nodes_columns.LastSeenSort,
+                        &nodes_columns.Route
+                };
+                
+                for (int i = 0; i < 13; i++)
+                {
+                        Gtk::TreeViewColumn *col = tv_nodes.get_column(i);
+                        col->set_sort_column(*sort[i]);
+                        col->set_resizable(true);
+                }
+        }
         
-        data_log_ptr = 0;
-        raw_data_log_ptr = 0;
+        tv_nodes.modify_font(Pango::FontDescription("monospace"));
         
-        dlgPort.set_port(port);
-        dlgPort.set_baud(baud);
-        dlgPort.set_parity(parity);
-        dlgPort.set_bits(bits);
-        dlgPort.set_stop_bits(stop_bits);
-        dlgPort.set_flow_control(flow_control);
+        sw_nodes.add(tv_nodes);
+        sw_nodes.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
         
-        ser_int = std::tr1::shared_ptr<SerialInterface>(new SerialInterface());
+        nodes_stamp = nodes.get_stamp();
+        topology_stamp = topology.get_stamp();
         
-        ser_int->port_opened().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_port_open) );
-        ser_int->port_closed().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_port_close) );
-        //ser_int->port_error().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_port_error) );
-        //ser_int->port_receive_data().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_port_receive_data) );
+        sw_nodes.show_all();
+        nodes_built = true;
+}
+
+
+void ZigBeeTerminal::build_stats_page()
+{
+        if (stats_built)
+                return;
         
-        ser_int->set_debug(true);
+        tv_stats.modify_font(Pango::FontDescription("monospace"));
+        tv_stats.set_editable(false);
         
-        zb_int.set_serial_interface(ser_int);
+        sw_stats.add(tv_stats);
+        sw_stats.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
         
-        zb_int.signal_receive_packet().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_receive_packet) );
-        zb_int.signal_receive_raw_data().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_receive_raw_data) );
-        zb_int.signal_send_raw_data().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_send_raw_data) );
+        sw_stats.show_all();
+        stats_built = true;
+}
+
+
+ZigBeePacketBuilder &ZigBeeTerminal::get_pkt_builder()
+{
+        build_pkt_builder_page();
         
-        show_all_children();
+        return *pkt_builder;
 }
 
 
-ZigBeeTerminal::~ZigBeeTerminal()
+PortConfig &ZigBeeTerminal::get_port_dialog()
 {
+        if (dlgPort)
+                return *dlgPort;
+        
+        // ports are only scanned once somebody wants to pick one
+        port_registry = std::tr1::shared_ptr<PortRegistry>(new PortRegistry());
+        if (port_registry->start_monitor())
+                Glib::signal_io().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_port_registry_io), port_registry->get_fd(), Glib::IO_IN );
+        
+        dlgPort = std::tr1::shared_ptr<PortConfig>(new PortConfig());
+        dlgPort->set_port_registry(port_registry);
         
+        return *dlgPort;
 }
 
 
@@ -256,28 +494,274 @@ void ZigBeeTerminal::on_file_quit_item_activate()
 }
 
 
+bool ZigBeeTerminal::choose_capture_file(const Glib::ustring &title, bool save, std::string &filename)
+{
+        Gtk::FileChooserDialog dlg(*this, title, save ? Gtk::FILE_CHOOSER_ACTION_SAVE : Gtk::FILE_CHOOSER_ACTION_OPEN);
+        
+        dlg.add_button(Gtk::Stock::CANCEL, Gtk::RESPONSE_CANCEL);
+        dlg.add_button(save ? Gtk::Stock::SAVE : Gtk::Stock::OPEN, Gtk::RESPONSE_OK);
+        
+        if (dlg.run() != Gtk::RESPONSE_OK)
+                return false;
+                
+        filename = dlg.get_filename();
+        return true;
+}
+
+
+void ZigBeeTerminal::update_overflow_status()
+{
+        size_t n = zb_int.get_receive_overflows();
+        
+        // the I/O thread dropped data while we were busy
+        if (n != rx_overflows)
+        {
+                guint id = status.get_context_id("overflow");
+                
+                rx_overflows = n;
+                status.pop(id);
+                status.push("Receive overflow: " + Glib::ustring::format(n) + " dropped", id);
+        }
+}
+
+
+void ZigBeeTerminal::set_capture_status(const Glib::ustring &msg)
+{
+        guint id = status.get_context_id("capture");
+        
+        status.pop(id);
+        
+        if (msg.size() > 0)
+                status.push(msg, id);
+}
+
+
+void ZigBeeTerminal::on_file_capture_start_activate()
+{
+        std::string filename;
+        
+        if (!choose_capture_file("Start Capture", true, filename))
+                return;
+                
+        if (!capture.open(filename, zb_int.get_escaped() ? CaptureFile::CF_Escaped : 0))
+        {
+                set_capture_status("Unable to create capture file");
+                return;
+        }
+        
+        set_capture_status("Capturing to " + Glib::filename_display_basename(filename));
+}
+
+
+void ZigBeeTerminal::on_file_capture_stop_activate()
+{
+        if (!capture.is_open())
+                return;
+                
+        capture.close();
+        set_capture_status("");
+}
+
+
+void ZigBeeTerminal::on_file_capture_open_activate()
+{
+        std::string filename;
+        
+        if (!choose_capture_file("Open Capture", false, filename))
+                return;
+                
+        load_capture(filename);
+}
+
+
+void ZigBeeTerminal::on_file_replay_start_activate()
+{
+        std::string filename;
+        
+        if (ser_int->is_open())
+        {
+                set_capture_status("Close the port before replaying a capture");
+                return;
+        }
+        
+        if (!choose_capture_file("Replay Capture", false, filename))
+                return;
+                
+        on_file_replay_stop_activate();
+        
+        if (!replay.open(filename))
+        {
+                set_capture_status("Unable to open capture file");
+                return;
+        }
+        
+        // replay in the format the data was captured in
+        config_api_escaped.set_active(replay.get_flags() & CaptureFile::CF_Escaped);
+        replay_tx_parser.reset();
+        replay_tx_parser.set_escaped(replay.get_flags() & CaptureFile::CF_Escaped);
+        
+        replay.set_realtime(file_replay_realtime.get_active());
+        
+        set_capture_status("Replaying " + Glib::filename_display_basename(filename));
+        
+        c_replay_timeout = Glib::signal_timeout().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_replay_timeout), 0 );
+}
+
+
+void ZigBeeTerminal::on_file_replay_stop_activate()
+{
+        if (!replay.is_open())
+                return;
+                
+        c_replay_timeout.disconnect();
+        replay.close();
+        set_capture_status("");
+}
+
+
+void ZigBeeTerminal::on_file_replay_realtime_toggle()
+{
+        replay.set_realtime(file_replay_realtime.get_active());
+}
+
+
+bool ZigBeeTerminal::on_replay_timeout()
+{
+        int delay = replay.run(CaptureFile::get_timestamp());
+        
+        if (delay < 0)
+        {
+                set_capture_status("");
+                return false;
+        }
+        
+        c_replay_timeout = Glib::signal_timeout().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_replay_timeout), delay );
+        return false;
+}
+
+
+void ZigBeeTerminal::on_replay_data(CaptureFile::CaptureDirection dir, const char *data, size_t len)
+{
+        if (dir == CaptureFile::CD_RX)
+        {
+                // goes through the parser and back out the receive signals
+                zb_int.inject_receive_data(data, len);
+        }
+        else
+        {
+                on_send_raw_data(data, len);
+                
+                if (config_api_mode.get_active())
+                {
+                        log_frames(replay_tx_parser, PacketLogStore::PLD_TX, data, len);
+                        queue_pkt_log_scroll();
+                }
+        }
+}
+
+
+void ZigBeeTerminal::load_capture(const std::string &filename)
+{
+        CaptureAnalyzer analyzer;
+        CaptureReader reader;
+        CaptureFile::Record rec;
+        
+        if (!reader.open(filename) || !analyzer.open(filename))
+        {
+                set_capture_status("Unable to open capture file");
+                return;
+        }
+        
+        on_view_clear_activate();
+        
+        // detach the model so the view doesn't track every row inserted
+        tv_pkt_log.unset_model();
+        
+        while (reader.read_record(rec))
+                raw_data_log.append((const char *)rec.data, rec.length, rec.direction == CaptureFile::CD_TX ? ByteLog::BLD_TX : ByteLog::BLD_RX);
+        
+        // frames are decoded on all processors and logged here in capture order
+        analyzer.signal_frames().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_capture_frames) );
+        analyzer.run();
+        
+        tv_pkt_log.set_model(tv_pkt_log_tm);
+        
+        update_raw_log();
+        queue_pkt_log_scroll();
+}
+
+
+void ZigBeeTerminal::on_capture_frames(const std::vector<CaptureAnalyzer::Frame> &frames)
+{
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+                const CaptureAnalyzer::Frame &f = frames[i];
+                PacketLogStore::PacketLogDirection dir = f.direction == CaptureFile::CD_TX ? PacketLogStore::PLD_TX : PacketLogStore::PLD_RX;
+                uint32_t time = f.timestamp / 1000000;
+                
+                tv_pkt_log_tm->append(dir, f.view.get_payload(), f.view.get_payload_length(), time);
+                nodes.add(f.view, dir, time);
+        }
+}
+
+
+void ZigBeeTerminal::log_frames(ZigBeeFrameParser &parser, PacketLogStore::PacketLogDirection dir, const char *data, size_t len, uint32_t time)
+{
+        const uint8_t *frame;
+        size_t frame_len;
+        size_t num;
+        bool got_frame;
+        
+        while (len > 0)
+        {
+                num = parser.get_buffer().write((const uint8_t *)data, len);
+                got_frame = false;
+                
+                while (parser.read_frame(frame, frame_len))
+                {
+                        tv_pkt_log_tm->append(dir, frame, frame_len, time);
+                        nodes.add(ZigBeePacketView(frame, frame_len), dir, time);
+                        got_frame = true;
+                }
+                
+                if (num == 0 && !got_frame)
+                        break;
+                        
+                data += num;
+                len -= num;
+        }
+}
+
+
 void ZigBeeTerminal::on_config_port_item_activate()
 {
+        PortConfig &dlg = get_port_dialog();
         int response;
         
-        dlgPort.set_port(port);
-        dlgPort.set_baud(baud);
-        dlgPort.set_parity(parity);
-        dlgPort.set_bits(bits);
-        dlgPort.set_stop_bits(stop_bits);
-        dlgPort.set_flow_control(flow_control);
-        response = dlgPort.run();
+        dlg.set_port(port);
+        dlg.set_baud(baud);
+        dlg.set_parity(parity);
+        dlg.set_bits(bits);
+        dlg.set_stop_bits(stop_bits);
+        dlg.set_flow_control(flow_control);
+        dlg.set_low_latency(low_latency);
+        dlg.set_read_min(read_min);
+        dlg.set_read_timeout(read_timeout);
+        response = dlg.run();
         
         if (response == Gtk::RESPONSE_OK)
         {
                 close_port();
                 
-                port = dlgPort.get_port();
-                baud = dlgPort.get_baud();
-                parity = dlgPort.get_parity();
-                bits = dlgPort.get_bits();
-                stop_bits = dlgPort.get_stop_bits();
-                flow_control = dlgPort.get_flow_control();
+                port = dlg.get_port();
+                baud = dlg.get_baud();
+                parity = dlg.get_parity();
+                bits = dlg.get_bits();
+                stop_bits = dlg.get_stop_bits();
+                flow_control = dlg.get_flow_control();
+                low_latency = dlg.get_low_latency();
+                read_min = dlg.get_read_min();
+                read_timeout = dlg.get_read_timeout();
                 
                 open_port();
         }
@@ -293,7 +777,8 @@ void ZigBeeTerminal::on_config_close_port_item_activate()
 void ZigBeeTerminal::on_view_hex_terminal_toggle()
 {
         tv_term.get_buffer()->set_text("");
-        data_log_ptr = 0;
+        data_log_ptr = data_log.get_begin();
+        data_log_text_begin = data_log_ptr;
         update_log();
 }
 
@@ -301,7 +786,8 @@ void ZigBeeTerminal::on_view_hex_terminal_toggle()
 void ZigBeeTerminal::on_view_hex_log_toggle()
 {
         tv_raw_log.get_buffer()->set_text("");
-        raw_data_log_ptr = 0;
+        raw_data_log_ptr = raw_data_log.get_begin();
+        raw_data_log_text_begin = raw_data_log_ptr;
         update_raw_log();
 }
 
@@ -310,12 +796,22 @@ void ZigBeeTerminal::on_view_clear_activate()
 {
         read_data_queue.clear();
         data_log.clear();
-        data_log_ptr = 0;
+        data_log_ptr = data_log.get_begin();
+        data_log_text_begin = data_log_ptr;
         raw_data_log.clear();
-        raw_data_log_ptr = 0;
+        raw_data_log_ptr = raw_data_log.get_begin();
+        raw_data_log_text_begin = raw_data_log_ptr;
         tv_term.get_buffer()->set_text("");
         tv_raw_log.get_buffer()->set_text("");
         tv_pkt_log_tm->clear();
+        nodes.clear();
+        update_nodes();
+}
+
+
+void ZigBeeTerminal::on_config_api_escaped_toggle()
+{
+        zb_int.set_escaped(config_api_escaped.get_active());
 }
 
 
@@ -323,7 +819,7 @@ bool ZigBeeTerminal::on_tv_key_press(GdkEventKey *key)
 {
         guint u = gdk_keyval_to_unicode(key->keyval);
         Glib::ustring str = "";
-        gsize num;
+        size_t num;
         
         if (u > 0)
         {
@@ -347,10 +843,7 @@ bool ZigBeeTerminal::on_tv_key_press(GdkEventKey *key)
                         
                         if (config_local_echo.get_active())
                         {
-                                for (int i = 0; i < str.size(); i++)
-                                {
-                                        data_log.push_back(0x1000 | ((int)str[i] & 0x00FF));
-                                }
+                                data_log.append(str.c_str(), str.size(), ByteLog::BLD_TX);
                                 
                                 update_log();
                         }
@@ -362,18 +855,101 @@ bool ZigBeeTerminal::on_tv_key_press(GdkEventKey *key)
 void ZigBeeTerminal::on_tv_pkt_log_cursor_changed()
 {
         Gtk::TreeModel::iterator it = tv_pkt_log.get_selection()->get_selected();
-        Gtk::TreeModel::Row row = *it;
-        ZigBeePacket pkt = (ZigBeePacket)row[cPacketLogModel.Packet];
+        
+        if (!it)
+                return;
+                
+        ZigBeePacket pkt = tv_pkt_log_tm->get_packet(it);
         
         tv2_pkt_log.get_buffer()->set_text(pkt.get_desc());
         
-        pkt_builder.set_packet(pkt);
+        get_pkt_builder().set_packet(pkt);
+}
+
+
+void ZigBeeTerminal::on_pkt_log_filter_activate()
+{
+        PacketLogIndex::Query q;
+        std::string error;
+        size_t rows;
+        
+        if (!PacketLogIndex::parse_query(ent_pkt_log_filter.get_text(), q, error))
+        {
+                lbl_pkt_log_count.set_text(error);
+                return;
+        }
+        
+        // the model emits no row signals for a new filter, reattach instead
+        tv_pkt_log.unset_model();
+        rows = tv_pkt_log_tm->set_filter(q);
+        tv_pkt_log.set_model(tv_pkt_log_tm);
+        
+        if (tv_pkt_log_tm->is_filtered())
+                lbl_pkt_log_count.set_text(Glib::ustring::format(rows) + " of " + Glib::ustring::format(tv_pkt_log_tm->get_count()));
+        else
+                lbl_pkt_log_count.set_text("");
+                
+        queue_pkt_log_scroll();
 }
 
 
 void ZigBeeTerminal::on_pkt_builder_change()
 {
-        tv_pkt_builder.get_buffer()->set_text(pkt_builder.get_packet().get_hex_packet());
+        // "7e ll ll" and the checksum change with most edits, patch them
+        // apart from the payload so a small edit stays a small patch
+        static const size_t head = 8;
+        static const size_t tail = 2;
+        Glib::RefPtr<Gtk::TextBuffer> buffer = tv_pkt_builder.get_buffer();
+        std::string hex = pkt_builder->get_packet().get_hex_packet();
+        const char *o = pkt_builder_hex.data();
+        const char *n = hex.data();
+        size_t old_len = pkt_builder_hex.size();
+        size_t new_len = hex.size();
+        
+        if (old_len < head + tail || new_len < head + tail)
+        {
+                patch_text(buffer, 0, o, old_len, n, new_len);
+        }
+        else
+        {
+                // back to front, so earlier offsets stay put
+                patch_text(buffer, old_len - tail, o + old_len - tail, tail, n + new_len - tail, tail);
+                patch_text(buffer, head, o + head, old_len - head - tail, n + head, new_len - head - tail);
+                patch_text(buffer, 0, o, head, n, head);
+        }
+        
+        pkt_builder_hex.swap(hex);
+}
+
+
+void ZigBeeTerminal::patch_text(Glib::RefPtr<Gtk::TextBuffer> buffer, size_t offset, const char *old_text, size_t old_len, const char *new_text, size_t new_len)
+{
+        size_t begin = 0;
+        
+        // replace only what lies between the common prefix and suffix,
+        // text is ASCII so byte and character offsets agree
+        while (begin < old_len && begin < new_len && old_text[begin] == new_text[begin])
+                begin++;
+        
+        while (old_len > begin && new_len > begin && old_text[old_len-1] == new_text[new_len-1])
+        {
+                old_len--;
+                new_len--;
+        }
+        
+        if (old_len > begin)
+                buffer->erase(buffer->get_iter_at_offset(offset + begin), buffer->get_iter_at_offset(offset + old_len));
+        
+        if (new_len > begin)
+                buffer->insert(buffer->get_iter_at_offset(offset + begin), new_text + begin, new_text + new_len);
+}
+
+
+void ZigBeeTerminal::on_btn_pkt_builder_load_click()
+{
+        // the builder frame is the template for the sweep
+        dlg_load_test.set_template(pkt_builder->get_packet());
+        dlg_load_test.present();
 }
 
 
@@ -384,7 +960,7 @@ void ZigBeeTerminal::on_btn_pkt_builder_send_click()
         int len;
         char *ptr;
         
-        ZigBeePacket pkt = pkt_builder.get_packet();
+        ZigBeePacket pkt = pkt_builder->get_packet();
         
         if (config_api_mode.get_active())
         {
@@ -395,24 +971,18 @@ void ZigBeeTerminal::on_btn_pkt_builder_send_click()
                         pkt.identifier == ZigBeePacket::ZBPID_RxPacket ||
                         pkt.identifier == ZigBeePacket::ZBPID_EARxPacket)
                 {
-                        for (int i = 0; i < pkt.data.size(); i++)
-                        {
-                                data_log.push_back(0x1000 | ((int)pkt.data[i] & 0x00FF));
-                        }
+                        if (pkt.data.size() > 0)
+                                data_log.append((const char *)&pkt.data[0], pkt.data.size(), ByteLog::BLD_TX);
                 }
                 
                 update_log();
                 update_raw_log();
                 
-                Gtk::TreeModel::iterator it = tv_pkt_log_tm->append();
-                Gtk::TreePath path = Gtk::TreePath(it);
-                Gtk::TreeModel::Row row = *it;
-                row[cPacketLogModel.Packet] = pkt;
-                row[cPacketLogModel.Direction] = "TX";
-                row[cPacketLogModel.Type] = pkt.get_type_desc();
-                row[cPacketLogModel.Size] = pkt.get_length();
-                row[cPacketLogModel.Data] = pkt.get_hex_packet();
-                tv_pkt_log.scroll_to_row(path);
+                tv_pkt_log_tm->append(PacketLogStore::PLD_TX, pkt);
+                queue_pkt_log_scroll();
+                
+                if (pkt.payload.size() > 0)
+                        nodes.add(ZigBeePacketView(&pkt.payload[0], pkt.payload.size()), PacketLogStore::PLD_TX);
         }
         
 }
@@ -439,31 +1009,41 @@ void ZigBeeTerminal::on_port_close()
 }
 
 
-void ZigBeeTerminal::on_receive_packet(ZigBeePacket pkt)
+void ZigBeeTerminal::on_receive_frames(const std::vector<ZigBeePacketView> &frames)
 {
+        const uint8_t *data;
+        size_t count;
+        
+        update_overflow_status();
+        
         if (config_api_mode.get_active())
         {
-                Gtk::TreeModel::iterator it = tv_pkt_log_tm->append();
-                Gtk::TreePath path = Gtk::TreePath(it);
-                Gtk::TreeModel::Row row = *it;
-                row[cPacketLogModel.Packet] = pkt;
-                row[cPacketLogModel.Direction] = "RX";
-                row[cPacketLogModel.Type] = pkt.get_type_desc();
-                row[cPacketLogModel.Size] = pkt.get_length();
-                row[cPacketLogModel.Data] = pkt.get_hex_packet();
-                tv_pkt_log.scroll_to_row(path);
+                if (render_pending_since == 0 && frames.size() > 0)
+                        render_pending_since = Metrics::now();
                 
-                if (pkt.identifier == ZigBeePacket::ZBPID_TxRequest ||
-                        pkt.identifier == ZigBeePacket::ZBPID_EATxRequest ||
-                        pkt.identifier == ZigBeePacket::ZBPID_RxPacket ||
-                        pkt.identifier == ZigBeePacket::ZBPID_EARxPacket)
+                tv_pkt_log_tm->append(PacketLogStore::PLD_RX, frames);
+                
+                for (size_t n = 0; n < frames.size(); n++)
                 {
-                        for (int i = 0; i < pkt.data.size(); i++)
+                        const ZigBeePacketView &frame = frames[n];
+                        int identifier = frame.get_identifier();
+                        
+                        nodes.add(frame, PacketLogStore::PLD_RX);
+                        
+                        if (identifier == ZigBeePacket::ZBPID_TxRequest ||
+                                identifier == ZigBeePacket::ZBPID_EATxRequest ||
+                                identifier == ZigBeePacket::ZBPID_RxPacket ||
+                                identifier == ZigBeePacket::ZBPID_EARxPacket)
                         {
-                                data_log.push_back(((int)pkt.data[i] & 0x00FF));
+                                data = frame.get_data(count);
+                                if (count > 0)
+                                        data_log.append((const char *)data, count, ByteLog::BLD_RX);
                         }
                 }
                 
+                if (frames.size() > 0)
+                        queue_pkt_log_scroll();
+                        
                 update_log();
         }
 }
@@ -471,17 +1051,14 @@ void ZigBeeTerminal::on_receive_packet(ZigBeePacket pkt)
 
 void ZigBeeTerminal::on_receive_raw_data(const char *data, size_t len)
 {
-        for (size_t i = 0; i < len; i++)
-        {
-                raw_data_log.push_back(((int)data[i] & 0x00FF));
-        }
+        if (capture.is_open())
+                capture.write(CaptureFile::CD_RX, data, len);
+                
+        raw_data_log.append(data, len, ByteLog::BLD_RX);
         
         if (!config_api_mode.get_active())
         {
-                for (size_t i = 0; i < len; i++)
-                {
-                        data_log.push_back(((int)data[i] & 0x00FF));
-                }
+                data_log.append(data, len, ByteLog::BLD_RX);
         }
         
         update_log();
@@ -491,126 +1068,336 @@ void ZigBeeTerminal::on_receive_raw_data(const char *data, size_t len)
 
 void ZigBeeTerminal::on_send_raw_data(const char *data, size_t len)
 {
-        for (size_t i = 0; i < len; i++)
+        if (capture.is_open())
+                capture.write(CaptureFile::CD_TX, data, len);
+                
+        raw_data_log.append(data, len, ByteLog::BLD_TX);
+        
+        update_raw_log();
+}
+
+
+void ZigBeeTerminal::queue_pkt_log_scroll()
+{
+        if (pkt_log_scroll_pending)
+                return;
+                
+        pkt_log_scroll_pending = true;
+        Glib::signal_timeout().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_pkt_log_scroll_timeout), 16 );
+}
+
+
+bool ZigBeeTerminal::on_pkt_log_scroll_timeout()
+{
+        pkt_log_scroll_pending = false;
+        
+        if (tv_pkt_log_tm->get_count() > 0)
+                tv_pkt_log.scroll_to_row(tv_pkt_log_tm->get_last_path());
+        
+        // received frames are on screen as of this scroll
+        if (render_pending_since != 0)
         {
-                raw_data_log.push_back(0x1000 | ((int)data[i] & 0x00FF));
+                zb_int.get_metrics().record(Metrics::MS_DeliveredToRendered, Metrics::now() - render_pending_since);
+                render_pending_since = 0;
         }
+                
+        return false;
+}
+
+
+bool ZigBeeTerminal::on_port_registry_io(Glib::IOCondition cond)
+{
+        port_registry->dispatch();
         
-        update_raw_log();
+        return true;
 }
 
 
-void ZigBeeTerminal::update_log()
+bool ZigBeeTerminal::on_stats_timeout()
 {
-        Glib::RefPtr<Gtk::TextBuffer> buffer = tv_term.get_buffer();
+        if (note.get_current_page() == stats_page)
+                tv_stats.get_buffer()->set_text(zb_int.get_metrics().get_report());
         
-        if (view_hex_terminal.get_active())
+        return true;
+}
+
+
+bool ZigBeeTerminal::on_nodes_timeout()
+{
+        // keeps running; cheap when the tab is not shown
+        if (note.get_current_page() == nodes_page)
+                update_nodes();
+        
+        return true;
+}
+
+
+void ZigBeeTerminal::update_nodes()
+{
+        // block characters from one to eight eighths high
+        static const gunichar bars[] = {0x2581, 0x2582, 0x2583, 0x2584, 0x2585, 0x2586, 0x2587, 0x2588};
+        uint32_t now = time(0);
+        bool changed = nodes.get_stamp() != nodes_stamp || topology.get_stamp() != topology_stamp;
+        const NodeAddressMap &addresses = nodes.get_addresses();
+        std::vector<uint16_t> hops;
+        size_t old_rows;
+        
+        if (nodes.get_count() < nodes_rows.size())
         {
-                for (unsigned int i = data_log_ptr; i < data_log.size(); i++)
+                tv_nodes_tm->clear();
+                nodes_rows.clear();
+        }
+        
+        // rows are appended as nodes are first seen and keep their
+        // iterators when sorted, so each refresh only rewrites the cells
+        old_rows = nodes_rows.size();
+        while (nodes_rows.size() < nodes.get_count())
+                nodes_rows.push_back(tv_nodes_tm->append());
+        
+        for (size_t i = 0; i < nodes.get_count(); i++)
+        {
+                const NodeTable::Node &node = nodes.get_node(i);
+                Gtk::TreeModel::Row row = *nodes_rows[i];
+                uint32_t hist_max = 0;
+                Glib::ustring hist;
+                
+                if (node.rx_frames == 0)
+                        row[nodes_columns.LastSeen] = "never";
+                else if (now >= node.last_seen)
+                        row[nodes_columns.LastSeen] = Glib::ustring::format(now - node.last_seen) + " s ago";
+                else
+                        row[nodes_columns.LastSeen] = "0 s ago";
+                
+                // only the age moves on between frames
+                if (!changed && i < old_rows)
+                        continue;
+                
+                row[nodes_columns.LastSeenSort] = node.last_seen;
+                
+                uint64_t addr64 = addresses.get_addr64(i);
+                uint16_t addr16 = addresses.get_addr16(i);
+                
+                if (addresses.is_key16(i))
+                        row[nodes_columns.Address64] = "-";
+                else
+                        row[nodes_columns.Address64] = Glib::ustring::format(std::hex, std::setfill(L'0'), std::setw(16), addr64);
+                
+                if (addr16 == NodeAddressMap::addr16_unknown)
+                        row[nodes_columns.Address16] = "-";
+                else
+                        row[nodes_columns.Address16] = Glib::ustring::format(std::hex, std::setfill(L'0'), std::setw(4), addr16);
+                
+                row[nodes_columns.RxFrames] = node.rx_frames;
+                row[nodes_columns.TxFrames] = node.tx_frames;
+                row[nodes_columns.RxBytes] = node.rx_bytes;
+                row[nodes_columns.TxBytes] = node.tx_bytes;
+                
+                for (int b = 0; b < NodeTable::rssi_bins; b++)
+                        if (node.rssi_hist[b] > hist_max)
+                                hist_max = node.rssi_hist[b];
+                
+                if (node.rssi_count > 0)
                 {
-                        std::stringstream ss;
+                        row[nodes_columns.Rssi] = Glib::ustring::format(std::fixed, std::setprecision(1), -(node.rssi_avg / 16.0)) + " dBm";
+                        row[nodes_columns.RssiSort] = node.rssi_avg;
                         
-                        if (i > 0)
+                        for (int b = 0; b < NodeTable::rssi_bins; b++)
                         {
-                                if (i % 16 == 0)
-                                        ss << "\n";
+                                if (node.rssi_hist[b] == 0)
+                                        hist += ' ';
                                 else
-                                        ss << " ";
-                        }
-                        
-                        ss << std::setfill('0') << std::setw(2) << std::hex << (data_log[i] & 0x00FF);
-                        
-                        if (data_log[i] & 0x1000)
-                        {
-                                buffer->insert_with_tag(buffer->end(), ss.str(), "xmit");
-                        }
-                        else
-                        {
-                                buffer->insert_with_tag(buffer->end(), ss.str(), "recv");
+                                        hist += bars[(uint64_t)node.rssi_hist[b] * 7 / hist_max];
                         }
                 }
-        }
-        else
-        {
-                for (unsigned int i = data_log_ptr; i < data_log.size(); i++)
+                else
                 {
-                        std::stringstream ss;
-                        
-                        ss << (uint8_t)data_log[i];
-                        
-                        if (data_log[i] & 0x1000)
-                        {
-                                buffer->insert_with_tag(buffer->end(), Glib::convert(ss.str(), "utf-8", "iso-8859-1"), "xmit");
-                        }
-                        else
+                        row[nodes_columns.Rssi] = "-";
+                        row[nodes_columns.RssiSort] = G_MAXUINT;
+                }
+                row[nodes_columns.RssiHist] = hist;
+                
+                row[nodes_columns.Retries] = node.retries;
+                row[nodes_columns.TxStatus] = node.tx_status;
+                row[nodes_columns.Failures] = node.failures;
+                
+                // shown from the local radio out
+                long index = topology.find(addr64);
+                if (index < 0 || !topology.get_route(index, hops))
+                {
+                        row[nodes_columns.Route] = "-";
+                }
+                else if (hops.empty())
+                {
+                        row[nodes_columns.Route] = "direct";
+                }
+                else
+                {
+                        Glib::ustring route;
+                        for (size_t h = hops.size(); h > 0; h--)
                         {
-                                buffer->insert_with_tag(buffer->end(), Glib::convert(ss.str(), "utf-8", "iso-8859-1"), "recv");
+                                if (h < hops.size())
+                                        route += " > ";
+                                route += Glib::ustring::format(std::hex, std::setfill(L'0'), std::setw(4), hops[h - 1]);
                         }
+                        row[nodes_columns.Route] = route;
                 }
         }
         
-        Glib::RefPtr<Gtk::TextMark> end_mark = buffer->create_mark (buffer->end()); 
-        tv_term.scroll_to(end_mark);
-        buffer->delete_mark(end_mark);
-        
-        data_log_ptr = data_log.size();
+        nodes_stamp = nodes.get_stamp();
+        topology_stamp = topology.get_stamp();
+}
+
+
+void ZigBeeTerminal::update_log()
+{
+        queue_log_render();
 }
 
 
 void ZigBeeTerminal::update_raw_log()
 {
-        Glib::RefPtr<Gtk::TextBuffer> buffer = tv_raw_log.get_buffer();
+        queue_log_render();
+}
+
+
+void ZigBeeTerminal::queue_log_render()
+{
+        if (log_render_pending)
+                return;
         
-        if (view_hex_log.get_active())
+        log_render_pending = true;
+        Glib::signal_timeout().connect( sigc::mem_fun(*this, &ZigBeeTerminal::on_log_render_timeout), log_render_interval );
+}
+
+
+bool ZigBeeTerminal::on_log_render_timeout()
+{
+        bool more = false;
+        
+        if (render_log(tv_term, term_end_mark, data_log, data_log_ptr, data_log_text_begin, view_hex_terminal.get_active()))
+                more = true;
+        
+        if (render_log(tv_raw_log, raw_log_end_mark, raw_data_log, raw_data_log_ptr, raw_data_log_text_begin, view_hex_log.get_active()))
+                more = true;
+        
+        // keep ticking until the backlog is drawn
+        log_render_pending = more;
+        return more;
+}
+
+
+bool ZigBeeTerminal::render_log(Gtk::TextView &tv, Glib::RefPtr<Gtk::TextMark> &end_mark, ByteLog &log, size_t &ptr, size_t &text_begin, bool hex)
+{
+        Glib::RefPtr<Gtk::TextBuffer> buffer = tv.get_buffer();
+        size_t end = log.get_end();
+        size_t max = log.get_max_size();
+        size_t run_end;
+        ByteLog::ByteLogDirection dir;
+        const uint8_t *data;
+        std::string run;
+        
+        if (ptr < log.get_begin())
+        {
+                // log was trimmed past text not yet drawn, start over
+                buffer->set_text("");
+                ptr = log.get_begin();
+                text_begin = ptr;
+        }
+        
+        if (ptr >= end)
+                return false;
+                
+        // bound the work done per tick
+        if (end - ptr > log_render_chunk)
+                end = ptr + log_render_chunk;
+                
+        run.reserve((end - ptr) * 3);
+        
+        // one insert per run of bytes with the same direction
+        while (ptr < end)
         {
-                for (unsigned int i = raw_data_log_ptr; i < raw_data_log.size(); i++)
+                dir = log.get_direction(ptr, run_end);
+                if (run_end > end)
+                        run_end = end;
+                
+                data = log.get_data(ptr);
+                run.clear();
+                
+                // hex goes a line of up to 16 bytes at a time
+                for (size_t i = ptr; hex && i < run_end; )
                 {
-                        std::stringstream ss;
+                        size_t line_end = std::min(run_end, (i / 16 + 1) * 16);
                         
-                        if (i > 0)
-                        {
-                                if (i % 16 == 0)
-                                        ss << "\n";
-                                else
-                                        ss << " ";
-                        }
-                        
-                        ss << std::setfill('0') << std::setw(2) << std::hex << (raw_data_log[i] & 0x00FF);
+                        if (i > text_begin)
+                                run += (i % 16 == 0) ? '\n' : ' ';
                         
-                        if (raw_data_log[i] & 0x1000)
-                        {
-                                buffer->insert_with_tag(buffer->end(), ss.str(), "xmit");
-                        }
-                        else
-                        {
-                                buffer->insert_with_tag(buffer->end(), ss.str(), "recv");
-                        }
+                        HexCodec::append(run, data, line_end - i);
+                        data += line_end - i;
+                        i = line_end;
                 }
-        }
-        else
-        {
-                for (unsigned int i = raw_data_log_ptr; i < raw_data_log.size(); i++)
+                
+                for (size_t i = ptr; !hex && i < run_end; i++)
                 {
-                        std::stringstream ss;
-                        
-                        ss << (uint8_t)raw_data_log[i];
+                        int b = *data++;
                         
-                        if (raw_data_log[i] & 0x1000)
+                        if (b == 0)
                         {
-                                buffer->insert_with_tag(buffer->end(), Glib::convert(ss.str(), "utf-8", "iso-8859-1"), "xmit");
+                                // text buffer rejects nul, show U+2400 instead
+                                run += "\xe2\x90\x80";
+                        }
+                        else if (b < 0x80)
+                        {
+                                run += (char)b;
                         }
                         else
                         {
-                                buffer->insert_with_tag(buffer->end(), Glib::convert(ss.str(), "utf-8", "iso-8859-1"), "recv");
+                                // ISO-8859-1 to UTF-8
+                                run += (char)(0xC0 | (b >> 6));
+                                run += (char)(0x80 | (b & 0x3F));
                         }
                 }
+                
+                buffer->insert_with_tag(buffer->end(), run, dir == ByteLog::BLD_TX ? "xmit" : "recv");
+                
+                ptr = run_end;
+        }
+        
+        // trim scrollback, every byte is one character or three in hex
+        if (max > 0 && ptr - text_begin > max + max / 4)
+        {
+                size_t count = ptr - text_begin - max;
+                
+                buffer->erase(buffer->begin(), buffer->get_iter_at_offset(hex ? count * 3 : count));
+                text_begin += count;
         }
         
-        Glib::RefPtr<Gtk::TextMark> end_mark = buffer->create_mark (buffer->end()); 
-        tv_raw_log.scroll_to(end_mark);
-        buffer->delete_mark(end_mark);
+        tv.scroll_to(end_mark);
+        
+        return ptr < log.get_end();
+}
+
+
+void ZigBeeTerminal::set_scrollback(size_t s)
+{
+        data_log.set_max_size(s);
+        raw_data_log.set_max_size(s);
         
-        raw_data_log_ptr = raw_data_log.size();
+        // trim text on the next tick
+        update_log();
+        update_raw_log();
+}
+
+
+void ZigBeeTerminal::on_view_scrollback_toggle()
+{
+        if (view_scrollback_64k.get_active())
+                set_scrollback(65536);
+        else if (view_scrollback_1m.get_active())
+                set_scrollback(1048576);
+        else if (view_scrollback_16m.get_active())
+                set_scrollback(16777216);
+        else if (view_scrollback_unlimited.get_active())
+                set_scrollback(0);
 }
 
 
@@ -625,6 +1412,9 @@ void ZigBeeTerminal::open_port()
         ser_int->set_bits(bits);
         ser_int->set_stop(stop_bits);
         ser_int->set_flow(flow_control);
+        ser_int->set_low_latency(low_latency);
+        ser_int->set_read_min(read_min);
+        ser_int->set_read_timeout(read_timeout);
         ser_int->open_port();
 }
 
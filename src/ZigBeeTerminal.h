@@ -39,66 +39,141 @@
 #include <tr1/memory>
 
 #include "PortConfig.h"
+#include "PortRegistry.h"
 #include "SerialInterface.h"
+#include "GlibNotifier.h"
 #include "ZigBeePacket.h"
 #include "ZigBeeInterface.h"
 #include "ZigBeePacketBuilder.h"
+#include "PacketLogModel.h"
+#include "ByteLog.h"
+#include "CaptureWriter.h"
+#include "CaptureReader.h"
+#include "CaptureReplay.h"
+#include "CaptureAnalyzer.h"
+#include "ZigBeeFrameParser.h"
+#include "NodeTable.h"
+#include "NetworkTopology.h"
+#include "LoadTestDialog.h"
+
+#include <string>
 
 // ZigBeeTerminal class
 class ZigBeeTerminal : public Gtk::Window
 {
 public:
-        ZigBeeTerminal();
+        // port is opened before the window is built when given
+        ZigBeeTerminal(const Glib::ustring &p = "", unsigned long b = 115200);
         virtual ~ZigBeeTerminal();
         
+        // scrollback limit in bytes for terminal and raw log, 0 for none
+        void set_scrollback(size_t s);
+        
 protected:
         //Signal handlers:
         void on_file_quit_item_activate();
+        void on_file_capture_start_activate();
+        void on_file_capture_stop_activate();
+        void on_file_capture_open_activate();
+        void on_file_replay_start_activate();
+        void on_file_replay_stop_activate();
+        void on_file_replay_realtime_toggle();
         void on_config_port_item_activate();
         void on_config_close_port_item_activate();
         
+        void on_note_switch_page(GtkNotebookPage *page, guint page_num);
+        
         void on_view_hex_terminal_toggle();
         void on_view_hex_log_toggle();
         void on_view_clear_activate();
+        void on_view_scrollback_toggle();
+        void on_config_api_escaped_toggle();
         
         bool on_tv_key_press(GdkEventKey *key);
         
         void on_tv_pkt_log_cursor_changed();
+        void on_pkt_log_filter_activate();
         
         void on_pkt_builder_change();
         void on_btn_pkt_builder_send_click();
+        void on_btn_pkt_builder_load_click();
+        void patch_text(Glib::RefPtr<Gtk::TextBuffer> buffer, size_t offset, const char *old_text, size_t old_len, const char *new_text, size_t new_len);
         
         void on_port_open();
         void on_port_close();
         
-        void on_receive_packet(ZigBeePacket pkt);
+        void on_receive_frames(const std::vector<ZigBeePacketView> &frames);
         void on_receive_raw_data(const char *data, size_t len);
         void on_send_raw_data(const char *data, size_t len);
         
         void update_log();
         void update_raw_log();
         
+        void queue_log_render();
+        bool on_log_render_timeout();
+        bool render_log(Gtk::TextView &tv, Glib::RefPtr<Gtk::TextMark> &end_mark, ByteLog &log, size_t &ptr, size_t &text_begin, bool hex);
+        
+        void queue_pkt_log_scroll();
+        bool on_pkt_log_scroll_timeout();
+        
+        // tabs not shown at startup are built the first time they are
+        void build_pkt_builder_page();
+        void build_nodes_page();
+        void build_stats_page();
+        ZigBeePacketBuilder &get_pkt_builder();
+        PortConfig &get_port_dialog();
+        
+        bool on_nodes_timeout();
+        void update_nodes();
+        
+        bool on_stats_timeout();
+        
+        bool on_port_registry_io(Glib::IOCondition cond);
+        
         void open_port();
         void close_port();
+        void update_overflow_status();
+        
+        // capture and replay
+        void set_capture_status(const Glib::ustring &msg);
+        bool choose_capture_file(const Glib::ustring &title, bool save, std::string &filename);
+        void load_capture(const std::string &filename);
+        void log_frames(ZigBeeFrameParser &parser, PacketLogStore::PacketLogDirection dir, const char *data, size_t len, uint32_t time = 0);
+        void on_capture_frames(const std::vector<CaptureAnalyzer::Frame> &frames);
+        bool on_replay_timeout();
+        void on_replay_data(CaptureFile::CaptureDirection dir, const char *data, size_t len);
         
-        // Tree model columns
-        class PacketLogModel : public Gtk::TreeModel::ColumnRecord
+        // packet log model
+        Glib::RefPtr<PacketLogModel> tv_pkt_log_tm;
+        
+        // scroll to the newest packet at most once per tick
+        bool pkt_log_scroll_pending;
+        
+        // node table columns
+        class NodeColumns : public Gtk::TreeModel::ColumnRecord
         {
         public:
-                PacketLogModel()
-                { add(Packet); add(Direction); add(Type); add(Size); add(Data); }
+                NodeColumns()
+                { add(Address64); add(Address16); add(RxFrames); add(TxFrames); add(RxBytes); add(TxBytes);
+                  add(Rssi); add(RssiSort); add(RssiHist); add(TxStatus); add(Retries); add(Failures); add(LastSeen); add(LastSeenSort); add(Route); }
                 
-                Gtk::TreeModelColumn<ZigBeePacket> Packet;
-                Gtk::TreeModelColumn<Glib::ustring> Direction;
-                Gtk::TreeModelColumn<Glib::ustring> Type;
-                Gtk::TreeModelColumn<int> Size;
-                Gtk::TreeModelColumn<Glib::ustring> Data;
+                Gtk::TreeModelColumn<Glib::ustring> Address64;
+                Gtk::TreeModelColumn<Glib::ustring> Address16;
+                Gtk::TreeModelColumn<guint> RxFrames;
+                Gtk::TreeModelColumn<guint> TxFrames;
+                Gtk::TreeModelColumn<guint64> RxBytes;
+                Gtk::TreeModelColumn<guint64> TxBytes;
+                Gtk::TreeModelColumn<Glib::ustring> Rssi;
+                Gtk::TreeModelColumn<guint> RssiSort;
+                Gtk::TreeModelColumn<Glib::ustring> RssiHist;
+                Gtk::TreeModelColumn<guint> TxStatus;
+                Gtk::TreeModelColumn<guint> Retries;
+                Gtk::TreeModelColumn<guint> Failures;
+                Gtk::TreeModelColumn<Glib::ustring> LastSeen;
+                Gtk::TreeModelColumn<guint> LastSeenSort;
+                Gtk::TreeModelColumn<Glib::ustring> Route;
         };
         
-        PacketLogModel cPacketLogModel;
-        
-        Glib::RefPtr<Gtk::ListStore> tv_pkt_log_tm;
-        
         //Child widgets:
         // window
         Gtk::VBox vbox1;
@@ -106,11 +181,25 @@ protected:
         Gtk::MenuBar main_menu;
         Gtk::MenuItem file_menu_item;
         Gtk::Menu file_menu;
+        Gtk::MenuItem file_capture_start_item;
+        Gtk::MenuItem file_capture_stop_item;
+        Gtk::SeparatorMenuItem file_sep1;
+        Gtk::MenuItem file_capture_open_item;
+        Gtk::MenuItem file_replay_start_item;
+        Gtk::MenuItem file_replay_stop_item;
+        Gtk::CheckMenuItem file_replay_realtime;
+        Gtk::SeparatorMenuItem file_sep2;
         Gtk::ImageMenuItem file_quit_item;
         Gtk::MenuItem view_menu_item;
         Gtk::Menu view_menu;
         Gtk::CheckMenuItem view_hex_terminal;
         Gtk::CheckMenuItem view_hex_log;
+        Gtk::MenuItem view_scrollback_item;
+        Gtk::Menu view_scrollback_menu;
+        Gtk::RadioMenuItem view_scrollback_64k;
+        Gtk::RadioMenuItem view_scrollback_1m;
+        Gtk::RadioMenuItem view_scrollback_16m;
+        Gtk::RadioMenuItem view_scrollback_unlimited;
         Gtk::SeparatorMenuItem view_sep1;
         Gtk::ImageMenuItem view_clear_item;
         Gtk::MenuItem config_menu_item;
@@ -120,6 +209,7 @@ protected:
         Gtk::SeparatorMenuItem config_sep1;
         Gtk::CheckMenuItem config_local_echo;
         Gtk::CheckMenuItem config_api_mode;
+        Gtk::CheckMenuItem config_api_escaped;
         // tabs
         Gtk::Notebook note;
         // terminal
@@ -131,8 +221,12 @@ protected:
         Gtk::ScrolledWindow sw_raw_log;
         Gtk::TextView tv_raw_log;
         // packet log
+        Gtk::VBox vbox_pkt_log;
+        Gtk::HBox hbox_pkt_log_filter;
+        Gtk::Label lbl_pkt_log_filter;
+        Gtk::Entry ent_pkt_log_filter;
+        Gtk::Label lbl_pkt_log_count;
         Gtk::VPaned vpane_pkt_log;
-        //Gtk::VBox vbox_pkt_log;
         Gtk::ScrolledWindow sw_pkt_log;
         Gtk::TreeView tv_pkt_log;
         Gtk::ScrolledWindow sw2_pkt_log;
@@ -142,14 +236,29 @@ protected:
         Gtk::VPaned vpane_pkt_builder;
         Gtk::HButtonBox bbox_pkt_builder;
         Gtk::Button btn_pkt_builder_send;
+        Gtk::Button btn_pkt_builder_load;
         Gtk::ScrolledWindow sw_pkt_builder;
-        ZigBeePacketBuilder pkt_builder;
+        std::tr1::shared_ptr<ZigBeePacketBuilder> pkt_builder;
+        int pkt_builder_page;
         Gtk::ScrolledWindow sw2_pkt_builder;
         Gtk::TextView tv_pkt_builder;
+        // hex text shown in tv_pkt_builder, patched rather than replaced
+        std::string pkt_builder_hex;
+        // nodes
+        Gtk::ScrolledWindow sw_nodes;
+        Gtk::TreeView tv_nodes;
+        // stats
+        Gtk::ScrolledWindow sw_stats;
+        Gtk::TextView tv_stats;
         // status bar
         Gtk::Statusbar status;
         
-        PortConfig dlgPort;
+        // built with the port registry the first time it is opened
+        std::tr1::shared_ptr<PortConfig> dlgPort;
+        LoadTestDialog dlg_load_test;
+        
+        // ports scanned once, then kept current from hotplug events
+        std::tr1::shared_ptr<PortRegistry> port_registry;
         
         Glib::ustring port;
         unsigned long baud;
@@ -157,18 +266,65 @@ protected:
         int bits;
         int stop_bits;
         SerialInterface::SerialFlow flow_control;
+        bool low_latency;
+        int read_min;
+        int read_timeout;
         
         std::tr1::shared_ptr<SerialInterface> ser_int;
         
+        // routes learned from route records, source routing what we send
+        NetworkTopology topology;
+        uint32_t topology_stamp;
+        
         ZigBeeInterface zb_int;
         
         std::deque<char> read_data_queue;
         
-        std::vector<int> data_log;
-        std::vector<int> raw_data_log;
+        ByteLog data_log;
+        ByteLog raw_data_log;
+        
+        // next byte to draw and first byte still in each text view
+        size_t data_log_ptr;
+        size_t raw_data_log_ptr;
+        size_t data_log_text_begin;
+        size_t raw_data_log_text_begin;
+        
+        CaptureWriter capture;
+        CaptureReplay replay;
+        ZigBeeFrameParser replay_tx_parser;
+        sigc::connection c_replay_timeout;
+        
+        // text views are drawn from the logs on a timer
+        static const unsigned int log_render_interval = 40;
+        static const unsigned int log_render_chunk = 65536;
+        
+        Glib::RefPtr<Gtk::TextMark> term_end_mark;
+        Glib::RefPtr<Gtk::TextMark> raw_log_end_mark;
+        bool log_render_pending;
+        
+        // receive overflows last shown in the status bar
+        size_t rx_overflows;
+        
+        // per node statistics, shown on a slow timer while the tab is up
+        static const unsigned int nodes_refresh_interval = 1000;
+        
+        NodeTable nodes;
+        NodeColumns nodes_columns;
+        Glib::RefPtr<Gtk::ListStore> tv_nodes_tm;
+        std::vector<Gtk::TreeModel::iterator> nodes_rows;
+        uint32_t nodes_stamp;
+        int nodes_page;
+        bool nodes_built;
+        
+        // receive path metrics, shown on the same slow timer
+        static const unsigned int stats_refresh_interval = 1000;
+        
+        int stats_page;
+        bool stats_built;
         
-        unsigned int data_log_ptr;
-        unsigned int raw_data_log_ptr;
+        // delivery time of the oldest frames not yet in the packet log
+        // view, 0 if none
+        uint64_t render_pending_since;
         
 };
 
@@ -0,0 +1,775 @@
+/************************************************************************/
+/* ZigBeeTerminalCli                                                    */
+/*                                                                      */
+/* ZigBee Terminal - Command Line Interface                             */
+/*                                                                      */
+/* ZigBeeTerminalCli.cpp                                                */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#include "ZigBeeTerminalCli.h"
+#include "CaptureAnalyzer.h"
+#include "HexCodec.h"
+
+#include <iostream>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+// set by the signal handlers, checked by the poll loop
+static volatile sig_atomic_t interrupted = 0;
+static volatile sig_atomic_t dump_requested = 0;
+
+// options with no short form
+enum
+{
+        OPT_Dest = 256,
+        OPT_Count,
+        OPT_Rate,
+        OPT_Pattern,
+        OPT_Payload,
+        OPT_Window,
+        OPT_Timeout,
+        OPT_ExportFormat
+};
+
+static void on_signal(int sig)
+{
+        if (sig == SIGUSR1)
+                dump_requested = 1;
+        else
+                interrupted = 1;
+}
+
+ZigBeeTerminalCli::ZigBeeTerminalCli() :
+        forward(0),
+        running(false),
+        show_port(-1),
+        baud(115200),
+        escaped(false),
+        reconnect(false),
+        low_latency(false),
+        read_min(1),
+        debug(false),
+        output(CO_Summary),
+        jobs(0),
+        export_format(PacketExporter::EF_Csv),
+        generate(false),
+        source_routes(false)
+{
+        // nothing
+}
+
+
+ZigBeeTerminalCli::~ZigBeeTerminalCli()
+{
+        manager.reset();
+        
+        if (forward && forward != stdout)
+                fclose(forward);
+}
+
+
+void ZigBeeTerminalCli::print_usage(const char *name)
+{
+        std::cout << "Usage: " << name << " [options]" << std::endl
+                << "  -p, --port PORT       serial port or tcp:// or udp:// address, repeat for more" << std::endl
+                << "  -s, --show ID         only show port ID (0 for the first -p), default all" << std::endl
+                << "  -b, --baud BAUD       baud rate (default 115200)" << std::endl
+                << "  -e, --escaped         API mode 2 (escaped)" << std::endl
+                << "  -R, --reconnect       reopen ports when they are plugged back in" << std::endl
+                << "  -l, --low-latency     set ASYNC_LOW_LATENCY on the port" << std::endl
+                << "  -m, --read-min BYTES  bytes to collect before waking (VMIN, default 1)" << std::endl
+                << "  -w, --write FILE      record a capture file" << std::endl
+                << "  -r, --read FILE       decode a capture file instead of a port" << std::endl
+                << "  -j, --jobs N          threads decoding a capture file (default one per processor)" << std::endl
+                << "  -f, --forward FILE    forward received API frames to FILE, - for stdout" << std::endl
+                << "  -x, --export FILE     export decoded fields of every frame to FILE" << std::endl
+                << "      --export-format F csv or columnar (default csv)" << std::endl
+                << "  -o, --output FORMAT   print frames as none, summary, hex or desc" << std::endl
+                << "  -d, --debug           print serial debug output" << std::endl
+                << "  -h, --help            show this help" << std::endl
+                << "Load generator, through the --show port or the first:" << std::endl
+                << "  -g, --generate FRAME  send copies of a hex API frame, report and exit" << std::endl
+                << "      --dest LIST       destinations, 64-bit[:16-bit] hex, comma separated" << std::endl
+                << "      --count N         frames to send (default 1000)" << std::endl
+                << "      --rate FPS        frames per second, 0 for full speed (default)" << std::endl
+                << "      --pattern NAME    payload template, counter, increment or random" << std::endl
+                << "      --payload BYTES   payload bytes (default the frame's)" << std::endl
+                << "      --window N        frames awaiting status, 0 for no status (default 255)" << std::endl
+                << "      --timeout MS      status timeout (default 5000)" << std::endl
+                << "Bridge, sharing the --show port or the first:" << std::endl
+                << "  -B, --bridge [HOST:]PORT  accept TCP clients speaking the port's API mode" << std::endl
+                << "Source routing, on the --show port or the first:" << std::endl
+                << "  -S, --source-routes   learn routes from route records and send Create Source" << std::endl
+                << "                        Route ahead of transmit requests from bridge clients" << std::endl
+                << "Send SIGUSR1 to print receive path counters and latencies." << std::endl;
+}
+
+
+bool ZigBeeTerminalCli::parse_args(int argc, char *argv[])
+{
+        static const struct option long_options[] = {
+                {"port", required_argument, 0, 'p'},
+                {"show", required_argument, 0, 's'},
+                {"baud", required_argument, 0, 'b'},
+                {"escaped", no_argument, 0, 'e'},
+                {"reconnect", no_argument, 0, 'R'},
+                {"low-latency", no_argument, 0, 'l'},
+                {"read-min", required_argument, 0, 'm'},
+                {"write", required_argument, 0, 'w'},
+                {"read", required_argument, 0, 'r'},
+                {"jobs", required_argument, 0, 'j'},
+                {"forward", required_argument, 0, 'f'},
+                {"export", required_argument, 0, 'x'},
+                {"export-format", required_argument, 0, OPT_ExportFormat},
+                {"output", required_argument, 0, 'o'},
+                {"debug", no_argument, 0, 'd'},
+                {"help", no_argument, 0, 'h'},
+                {"generate", required_argument, 0, 'g'},
+                {"bridge", required_argument, 0, 'B'},
+                {"source-routes", no_argument, 0, 'S'},
+                {"dest", required_argument, 0, OPT_Dest},
+                {"count", required_argument, 0, OPT_Count},
+                {"rate", required_argument, 0, OPT_Rate},
+                {"pattern", required_argument, 0, OPT_Pattern},
+                {"payload", required_argument, 0, OPT_Payload},
+                {"window", required_argument, 0, OPT_Window},
+                {"timeout", required_argument, 0, OPT_Timeout},
+                {0, 0, 0, 0}
+        };
+        std::vector<uint8_t> bytes;
+        std::string error;
+        size_t num;
+        int c;
+        
+        while ((c = getopt_long(argc, argv, "p:s:b:eRlm:w:r:j:f:x:o:dhg:B:S", long_options, 0)) != -1)
+        {
+                switch (c)
+                {
+                        case 'p':
+                                ports.push_back(optarg);
+                                break;
+                        case 's':
+                                show_port = atoi(optarg);
+                                break;
+                        case 'b':
+                                baud = strtoul(optarg, 0, 10);
+                                break;
+                        case 'e':
+                                escaped = true;
+                                break;
+                        case 'R':
+                                reconnect = true;
+                                break;
+                        case 'l':
+                                low_latency = true;
+                                break;
+                        case 'm':
+                                read_min = atoi(optarg);
+                                break;
+                        case 'w':
+                                capture_file = optarg;
+                                break;
+                        case 'r':
+                                read_file = optarg;
+                                break;
+                        case 'j':
+                                jobs = atoi(optarg);
+                                break;
+                        case 'f':
+                                forward_file = optarg;
+                                break;
+                        case 'x':
+                                export_file = optarg;
+                                break;
+                        case OPT_ExportFormat:
+                                if (!PacketExporter::parse_format(optarg, export_format))
+                                {
+                                        std::cerr << "Unknown export format: " << optarg << std::endl;
+                                        return false;
+                                }
+                                break;
+                        case 'o':
+                                if (strcmp(optarg, "none") == 0)
+                                        output = CO_None;
+                                else if (strcmp(optarg, "summary") == 0)
+                                        output = CO_Summary;
+                                else if (strcmp(optarg, "hex") == 0)
+                                        output = CO_Hex;
+                                else if (strcmp(optarg, "desc") == 0)
+                                        output = CO_Desc;
+                                else
+                                {
+                                        std::cerr << "Unknown output format: " << optarg << std::endl;
+                                        return false;
+                                }
+                                break;
+                        case 'd':
+                                debug = true;
+                                break;
+                        case 'g':
+                                HexCodec::decode(optarg, bytes);
+                                if (!generate_template.read_packet(bytes, num) || !generate_template.decode_packet())
+                                {
+                                        std::cerr << "Bad frame: " << optarg << std::endl;
+                                        return false;
+                                }
+                                generate = true;
+                                break;
+                        case OPT_Dest:
+                                if (!LoadGenerator::parse_destinations(optarg, sweep.destinations, error))
+                                {
+                                        std::cerr << error << std::endl;
+                                        return false;
+                                }
+                                break;
+                        case OPT_Count:
+                                sweep.count = strtoul(optarg, 0, 10);
+                                break;
+                        case OPT_Rate:
+                                sweep.rate = strtod(optarg, 0);
+                                break;
+                        case OPT_Pattern:
+                                if (!LoadGenerator::parse_pattern(optarg, sweep.pattern))
+                                {
+                                        std::cerr << "Unknown pattern: " << optarg << std::endl;
+                                        return false;
+                                }
+                                break;
+                        case OPT_Payload:
+                                sweep.payload_length = strtoul(optarg, 0, 10);
+                                break;
+                        case OPT_Window:
+                                sweep.window = strtoul(optarg, 0, 10);
+                                break;
+                        case OPT_Timeout:
+                                sweep.timeout = strtoul(optarg, 0, 10);
+                                break;
+                        case 'B':
+                                bridge_address = optarg;
+                                break;
+                        case 'S':
+                                source_routes = true;
+                                break;
+                        case 'h':
+                        default:
+                                print_usage(argv[0]);
+                                return false;
+                }
+        }
+        
+        if (ports.empty() && read_file.empty())
+        {
+                print_usage(argv[0]);
+                return false;
+        }
+        
+        if (generate && ports.empty())
+        {
+                std::cerr << "Generating a load needs a port" << std::endl;
+                return false;
+        }
+        
+        if (!bridge_address.empty() && ports.empty())
+        {
+                std::cerr << "Bridging needs a port" << std::endl;
+                return false;
+        }
+        
+        if (source_routes && ports.empty())
+        {
+                std::cerr << "Source routing needs a port" << std::endl;
+                return false;
+        }
+        
+        if (show_port >= (int)ports.size())
+        {
+                std::cerr << "No port " << show_port << std::endl;
+                return false;
+        }
+        
+        // a capture file holds a single stream
+        if (!capture_file.empty() && ports.size() > 1 && show_port < 0)
+        {
+                std::cerr << "Recording more than one port needs --show" << std::endl;
+                return false;
+        }
+        
+        return true;
+}
+
+
+int ZigBeeTerminalCli::run()
+{
+        struct sigaction sa;
+        struct pollfd pfd[3];
+        nfds_t nfds = 1;
+        int registry_pfd = -1;
+        int bridge_pfd = -1;
+        
+        // printing is the hot path, buffer it and flush once per wake up
+        setvbuf(stdout, 0, _IOFBF, 65536);
+        
+        if (!forward_file.empty())
+        {
+                forward = forward_file == "-" ? stdout : fopen(forward_file.c_str(), "wb");
+                
+                if (!forward)
+                {
+                        std::cerr << "Unable to open " << forward_file << std::endl;
+                        return 1;
+                }
+        }
+        
+        if (!export_file.empty() && !exporter.open(export_file, export_format))
+                return 1;
+                
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_signal;
+        sigaction(SIGINT, &sa, 0);
+        sigaction(SIGTERM, &sa, 0);
+        sigaction(SIGUSR1, &sa, 0);
+        
+        if (!read_file.empty())
+                return run_capture();
+                
+        notifier = std::tr1::shared_ptr<FdNotifier>(new FdNotifier());
+        
+        manager = std::tr1::shared_ptr<PortManager>(new PortManager(notifier));
+        
+        for (size_t i = 0; i < ports.size(); i++)
+        {
+                int id = manager->add_port(ports[i], baud, escaped);
+                std::tr1::shared_ptr<SerialInterface> ser_int = manager->get_serial_interface(id);
+                
+                manager->get_transport(id)->set_debug(debug);
+                
+                if (ser_int)
+                {
+                        ser_int->set_low_latency(low_latency);
+                        ser_int->set_read_min(read_min);
+                }
+        }
+        
+        manager->signal_receive_frames().connect( sigc::mem_fun(*this, &ZigBeeTerminalCli::on_receive_frames) );
+        manager->signal_receive_raw_data().connect( sigc::mem_fun(*this, &ZigBeeTerminalCli::on_receive_raw_data) );
+        manager->signal_error().connect( sigc::mem_fun(*this, &ZigBeeTerminalCli::on_error) );
+        manager->signal_port_opened().connect( sigc::mem_fun(*this, &ZigBeeTerminalCli::on_port_opened) );
+        manager->signal_port_closed().connect( sigc::mem_fun(*this, &ZigBeeTerminalCli::on_port_closed) );
+        
+        if (reconnect)
+        {
+                registry = std::tr1::shared_ptr<PortRegistry>(new PortRegistry());
+                
+                if (!registry->start_monitor())
+                        std::cerr << "Hotplug events not available, ports will not be reopened" << std::endl;
+                
+                manager->set_port_registry(registry);
+                manager->set_reconnect(true);
+        }
+        
+        if (!capture_file.empty() && !capture.open(capture_file, escaped ? CaptureFile::CF_Escaped : 0))
+                return 1;
+                
+        if (source_routes)
+                manager->get_zigbee_interface(show_port >= 0 ? show_port : 0)->set_topology(&topology);
+                
+        if (manager->open_ports() > 0)
+        {
+                manager->close_ports();
+                return 1;
+        }
+        
+        for (size_t i = 0; i < ports.size(); i++)
+                std::cerr << "Opened " << i << ": " << manager->get_transport(i)->get_status_string() << std::endl;
+        
+        if (generate)
+        {
+                std::string error;
+                
+                // encoded in full before the first frame goes out
+                generator.set_zigbee_interface(manager->get_zigbee_interface(show_port >= 0 ? show_port : 0));
+                generator.signal_finished().connect( sigc::mem_fun(*this, &ZigBeeTerminalCli::on_generator_finished) );
+                
+                if (!generator.prepare(generate_template, sweep, escaped, error))
+                {
+                        std::cerr << error << std::endl;
+                        manager->close_ports();
+                        return 1;
+                }
+                
+                std::cerr << "Sending " << generator.get_batch_count() << " frames, " << generator.get_batch_bytes() << " bytes" << std::endl;
+        }
+        
+        if (!bridge_address.empty())
+        {
+                std::string error;
+                
+                bridge.set_escaped(escaped);
+                bridge.set_zigbee_interface(manager->get_zigbee_interface(show_port >= 0 ? show_port : 0));
+                bridge.signal_client_connected().connect( sigc::mem_fun(*this, &ZigBeeTerminalCli::on_client_connected) );
+                bridge.signal_client_disconnected().connect( sigc::mem_fun(*this, &ZigBeeTerminalCli::on_client_disconnected) );
+                
+                if (!bridge.listen(bridge_address, error))
+                {
+                        std::cerr << error << std::endl;
+                        manager->close_ports();
+                        return 1;
+                }
+                
+                std::cerr << "Bridging on " << bridge_address << std::endl;
+        }
+        
+        running = true;
+        render_pending_since.assign(ports.size(), 0);
+        
+        pfd[0].fd = notifier->get_fd();
+        pfd[0].events = POLLIN;
+        
+        if (registry && registry->get_fd() >= 0)
+        {
+                registry_pfd = nfds++;
+                pfd[registry_pfd].fd = registry->get_fd();
+                pfd[registry_pfd].events = POLLIN;
+        }
+        
+        if (bridge.is_listening())
+        {
+                bridge_pfd = nfds++;
+                pfd[bridge_pfd].fd = bridge.get_fd();
+                pfd[bridge_pfd].events = POLLIN;
+        }
+        
+        if (generate && !generator.start())
+        {
+                std::cerr << "Unable to start load generator" << std::endl;
+                running = false;
+        }
+        
+        while (running && !interrupted)
+        {
+                int timeout;
+                int wait;
+                
+                // SIGUSR1 breaks the poll with EINTR
+                if (dump_requested)
+                {
+                        dump_requested = 0;
+                        dump_metrics();
+                }
+                
+                // wake up in time to expire requests in flight and to send
+                // generated frames that are due
+                timeout = manager->check_timeouts();
+                wait = generator.dispatch();
+                if (wait >= 0 && (timeout < 0 || wait < timeout))
+                        timeout = wait;
+                
+                int n = poll(pfd, nfds, timeout);
+                
+                if (n < 0)
+                {
+                        if (errno == EINTR)
+                                continue;
+                                
+                        std::cerr << "poll failed (errno " << errno << ")" << std::endl;
+                        break;
+                }
+                
+                if (pfd[0].revents & POLLIN)
+                        notifier->dispatch();
+                
+                if (registry_pfd >= 0 && (pfd[registry_pfd].revents & POLLIN))
+                        registry->dispatch();
+                        
+                if (bridge_pfd >= 0 && (pfd[bridge_pfd].revents & POLLIN))
+                        bridge.dispatch();
+                        
+                fflush(stdout);
+                if (forward)
+                        fflush(forward);
+                
+                // frames delivered this wake up are printed now
+                for (size_t i = 0; i < render_pending_since.size(); i++)
+                {
+                        if (render_pending_since[i] == 0)
+                                continue;
+                        
+                        manager->get_zigbee_interface(i)->get_metrics().record(Metrics::MS_DeliveredToRendered, Metrics::now() - render_pending_since[i]);
+                        render_pending_since[i] = 0;
+                }
+        }
+        
+        if (generator.is_running())
+        {
+                generator.stop();
+                std::cerr << generator.get_report();
+        }
+        
+        running = false;
+        generator.set_zigbee_interface(0);
+        bridge.close();
+        bridge.set_zigbee_interface(0);
+        manager->close_ports();
+        capture.close();
+        exporter.close();
+        
+        for (size_t i = 0; i < ports.size(); i++)
+        {
+                size_t n = manager->get_zigbee_interface(i)->get_receive_overflows();
+                
+                if (n > 0)
+                        std::cerr << "Port " << i << ": " << n << " receive overflows" << std::endl;
+        }
+        
+        return 0;
+}
+
+
+int ZigBeeTerminalCli::run_capture()
+{
+        if (!analyzer.open(read_file))
+                return 1;
+                
+        analyzer.set_thread_count(jobs);
+        
+        // formatting is most of the work, so it runs on the pool along with the decoding
+        if (output != CO_None)
+                analyzer.set_format_slot( sigc::mem_fun(*this, &ZigBeeTerminalCli::format_capture_frame) );
+        
+        analyzer.signal_frames().connect( sigc::mem_fun(*this, &ZigBeeTerminalCli::on_capture_frames) );
+        
+        analyzer.run();
+        
+        fflush(stdout);
+        exporter.close();
+        
+        std::cerr << "Decoded " << analyzer.get_frame_count() << " frames from " << analyzer.get_chunk_count() << " chunks, "
+                << analyzer.get_redecode_count() << " decoded again, " << analyzer.get_junk_bytes() << " junk bytes, "
+                << analyzer.get_checksum_errors() << " checksum errors" << std::endl;
+        
+        return 0;
+}
+
+
+void ZigBeeTerminalCli::on_receive_frames(int id, const std::vector<ZigBeePacketView> &frames)
+{
+        uint64_t timestamp;
+        
+        if (show_port >= 0 && id != show_port)
+                return;
+        
+        if (render_pending_since[id] == 0)
+                render_pending_since[id] = Metrics::now();
+        
+        // one batch came from one read, so it shares a timestamp
+        timestamp = CaptureFile::get_timestamp();
+        
+        for (size_t i = 0; i < frames.size(); i++)
+                output_frame(id, timestamp, CaptureFile::CD_RX, frames[i]);
+}
+
+
+void ZigBeeTerminalCli::on_receive_raw_data(int id, const char *data, size_t len)
+{
+        if (show_port >= 0 && id != show_port)
+                return;
+                
+        if (capture.is_open())
+                capture.write(CaptureFile::CD_RX, data, len);
+}
+
+
+void ZigBeeTerminalCli::on_error(int id)
+{
+        std::cerr << "Port error on " << manager->get_transport(id)->get_port() << std::endl;
+}
+
+
+void ZigBeeTerminalCli::on_generator_finished()
+{
+        std::cerr << generator.get_report();
+        
+        running = false;
+}
+
+
+void ZigBeeTerminalCli::on_port_opened(int id)
+{
+        // only reopens get here, the first open is before the loop runs
+        if (running)
+                std::cerr << "Reopened " << id << ": " << manager->get_transport(id)->get_status_string() << std::endl;
+}
+
+
+void ZigBeeTerminalCli::on_port_closed(int id)
+{
+        if (!running)
+                return;
+        
+        // keep going while any port is left, or waiting for any to return
+        if (manager->get_reconnect())
+                std::cerr << "Lost " << id << ", waiting for " << manager->get_transport(id)->get_port() << std::endl;
+        else if (manager->get_open_count() == 0)
+                running = false;
+}
+
+
+void ZigBeeTerminalCli::on_client_connected(std::string peer)
+{
+        std::cerr << "Bridge client " << peer << " connected, " << bridge.get_client_count() << " total" << std::endl;
+}
+
+
+void ZigBeeTerminalCli::on_client_disconnected(std::string peer)
+{
+        std::cerr << "Bridge client " << peer << " disconnected, " << bridge.get_client_count() << " total" << std::endl;
+}
+
+
+void ZigBeeTerminalCli::dump_metrics()
+{
+        for (size_t i = 0; i < ports.size(); i++)
+        {
+                std::cerr << "Port " << i << " (" << ports[i] << ")" << std::endl
+                        << manager->get_zigbee_interface(i)->get_metrics().get_report();
+        }
+        
+        if (source_routes)
+        {
+                size_t routes = 0;
+                for (size_t i = 0; i < topology.get_count(); i++)
+                {
+                        if (topology.get_node(i).link != NetworkTopology::link_unknown)
+                                routes++;
+                }
+                
+                std::cerr << "Topology: " << topology.get_count() << " nodes, " << routes << " routes known, "
+                        << topology.get_sent_count() << " source routes sent" << std::endl;
+        }
+}
+
+
+void ZigBeeTerminalCli::output_frame(int id, uint64_t timestamp, CaptureFile::CaptureDirection dir, const ZigBeePacketView &frame)
+{
+        char tag[16] = "";
+        
+        // tag frames with their port when ports are merged
+        if (id >= 0 && ports.size() > 1 && show_port < 0)
+                snprintf(tag, sizeof(tag), "%d ", id);
+                
+        text.clear();
+        format_frame(output, tag, dir, frame, pkt, text);
+        write_frame(timestamp, dir, frame, text.data(), text.size());
+}
+
+
+void ZigBeeTerminalCli::write_frame(uint64_t timestamp, CaptureFile::CaptureDirection dir, const ZigBeePacketView &frame, const char *line, size_t len)
+{
+        if (len > 0)
+                fwrite(line, 1, len, stdout);
+                
+        if (exporter.is_open())
+                exporter.add(timestamp, dir, frame);
+                
+        if (forward && dir == CaptureFile::CD_RX)
+        {
+                if (escaped)
+                {
+                        frame.decode(pkt);
+                        std::vector<uint8_t> raw = pkt.get_escaped_raw_packet();
+                        fwrite(&raw[0], 1, raw.size(), forward);
+                }
+                else
+                {
+                        size_t len = frame.get_payload_length();
+                        uint8_t header[3] = {ZIGBEE_IDENTIFIER, (uint8_t)(len >> 8), (uint8_t)len};
+                        uint8_t sum = frame.get_checksum();
+                        
+                        fwrite(header, 1, sizeof(header), forward);
+                        fwrite(frame.get_payload(), 1, len, forward);
+                        fwrite(&sum, 1, 1, forward);
+                }
+        }
+}
+
+
+void ZigBeeTerminalCli::format_capture_frame(CaptureFile::CaptureDirection dir, const ZigBeePacketView &frame, std::string &line)
+{
+        // runs on the decoding threads, so it has a packet of its own
+        ZigBeePacket p;
+        
+        format_frame(output, "", dir, frame, p, line);
+}
+
+
+void ZigBeeTerminalCli::on_capture_frames(const std::vector<CaptureAnalyzer::Frame> &frames)
+{
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+                const CaptureAnalyzer::Frame &f = frames[i];
+                
+                write_frame(f.timestamp, f.direction, f.view, f.text, f.text_length);
+        }
+        
+        if (interrupted)
+                analyzer.stop();
+}
+
+
+// Static
+void ZigBeeTerminalCli::format_frame(CliOutput output, const char *tag, CaptureFile::CaptureDirection dir, const ZigBeePacketView &frame, ZigBeePacket &pkt, std::string &line)
+{
+        const char *d = dir == CaptureFile::CD_TX ? "TX" : "RX";
+        char len[24];
+        
+        // the summary comes straight from the frame, only decode for the rest
+        switch (output)
+        {
+                case CO_None:
+                        return;
+                case CO_Summary:
+                        snprintf(len, sizeof(len), " (%d bytes)", (int)frame.get_length());
+                        line.append(tag).append(d).append(" ").append(frame.get_type_desc()).append(len);
+                        break;
+                case CO_Hex:
+                        frame.decode(pkt);
+                        line.append(tag).append(d).append(" ").append(pkt.get_hex_packet());
+                        break;
+                case CO_Desc:
+                        frame.decode(pkt);
+                        line.append(tag).append(d).append(" ").append(pkt.get_desc());
+                        break;
+        }
+        
+        line.append("\n");
+}
+
@@ -0,0 +1,296 @@
+/************************************************************************/
+/* ZigBeeTerminalCli                                                    */
+/*                                                                      */
+/* ZigBee Terminal - Command Line Interface                             */
+/*                                                                      */
+/* ZigBeeTerminalCli.h                                                  */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef __ZIGBEE_TERMINAL_CLI_H
+#define __ZIGBEE_TERMINAL_CLI_H
+
+#include <tr1/memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+#include "PortManager.h"
+#include "PortRegistry.h"
+#include "ZigBeePacket.h"
+#include "ZigBeePacketView.h"
+#include "FdNotifier.h"
+#include "CaptureWriter.h"
+#include "CaptureFile.h"
+#include "LoadGenerator.h"
+#include "NetworkBridge.h"
+#include "PacketExporter.h"
+#include "CaptureAnalyzer.h"
+#include "NetworkTopology.h"
+
+/** ZigBee Terminal CLI
+ * 
+ * Headless terminal.  Receives frames from one or more serial ports, or
+ * decodes a capture file, and prints them, records them to a capture file,
+ * exports their fields as CSV or columnar rows, and/or forwards them as
+ * raw API frames to a file or pipe.  All ports
+ * share one I/O thread; frames are shown merged or for a single port.
+ * Can also send a generated load through one port and report on it.
+ * Runs its own poll loop; no GTK or glib.  
+ */
+class ZigBeeTerminalCli
+{
+public:
+        /**
+         * Output format.
+         */
+        typedef enum
+        {
+                CO_None = 0,
+                CO_Summary = 1,
+                CO_Hex = 2,
+                CO_Desc = 3,
+        }
+        CliOutput;
+        
+        /**
+         * Create a ZigBee Terminal CLI.
+         */
+        ZigBeeTerminalCli();
+        virtual ~ZigBeeTerminalCli();
+        
+        /**
+         * Parse command line arguments.
+         * @param argc argument count
+         * @param argv arguments
+         * @return true to run, false to exit
+         */
+        bool parse_args(int argc, char *argv[]);
+        
+        /**
+         * Run until the port closes or the process is interrupted.
+         * @return exit status
+         */
+        int run();
+        
+        /**
+         * Print usage.
+         * @param name program name
+         */
+        static void print_usage(const char *name);
+        
+protected:
+        /**
+         * Decode capture file named by read_file.
+         * @return exit status
+         */
+        int run_capture();
+        
+        /**
+         * Capture frames event handler.
+         */
+        void on_capture_frames(const std::vector<CaptureAnalyzer::Frame> &frames);
+        
+        /**
+         * Format a capture frame, on a decoding thread.
+         * @see CaptureAnalyzer::FormatSlot
+         */
+        void format_capture_frame(CaptureFile::CaptureDirection dir, const ZigBeePacketView &frame, std::string &line);
+        
+        /**
+         * Receive frames event handler.
+         */
+        void on_receive_frames(int id, const std::vector<ZigBeePacketView> &frames);
+        
+        /**
+         * Receive raw data event handler.
+         */
+        void on_receive_raw_data(int id, const char *data, size_t len);
+        
+        /**
+         * Error event handler.
+         */
+        void on_error(int id);
+        
+        /**
+         * Print metrics of every port to stderr.
+         */
+        void dump_metrics();
+        
+        /**
+         * Load generator finished event handler.
+         */
+        void on_generator_finished();
+        
+        /**
+         * Port opened event handler.
+         */
+        void on_port_opened(int id);
+        
+        /**
+         * Port closed event handler.
+         */
+        void on_port_closed(int id);
+        
+        /**
+         * Bridge client connected handler.
+         * @param peer client address
+         */
+        void on_client_connected(std::string peer);
+        
+        /**
+         * Bridge client disconnected handler.
+         * @param peer client address
+         */
+        void on_client_disconnected(std::string peer);
+        
+        /**
+         * Print, export and forward a frame.
+         * @param id port ID, -1 for a capture file
+         * @param timestamp microseconds since the epoch
+         * @param dir direction
+         * @param frame frame
+         */
+        void output_frame(int id, uint64_t timestamp, CaptureFile::CaptureDirection dir, const ZigBeePacketView &frame);
+        
+        /**
+         * Print a formatted frame, then export and forward it.
+         * @param timestamp microseconds since the epoch
+         * @param dir direction
+         * @param frame frame
+         * @param line formatted text
+         * @param len text length
+         */
+        void write_frame(uint64_t timestamp, CaptureFile::CaptureDirection dir, const ZigBeePacketView &frame, const char *line, size_t len);
+        
+        /**
+         * Format a frame for printing.
+         * @param output output format
+         * @param tag port tag
+         * @param dir direction
+         * @param frame frame
+         * @param pkt scratch packet for formats that need a full decode
+         * @param line string to append a line to
+         */
+        static void format_frame(CliOutput output, const char *tag, CaptureFile::CaptureDirection dir, const ZigBeePacketView &frame, ZigBeePacket &pkt, std::string &line);
+        
+        /**
+         * Notifier polled by run().
+         */
+        std::tr1::shared_ptr<FdNotifier> notifier;
+        
+        /**
+         * Serial and ZigBee interfaces, one pair per port.
+         */
+        std::tr1::shared_ptr<PortManager> manager;
+        
+        /**
+         * Port registry, for reconnecting.
+         */
+        std::tr1::shared_ptr<PortRegistry> registry;
+        
+        /**
+         * Delivery time of the oldest frames not yet flushed, by port, 0
+         * if none.
+         */
+        std::vector<uint64_t> render_pending_since;
+        
+        /**
+         * Scratch packet for output formats that need a full decode.
+         */
+        ZigBeePacket pkt;
+        
+        /**
+         * Scratch line for printing.
+         */
+        std::string text;
+        
+        /**
+         * Capture file decoder.
+         */
+        CaptureAnalyzer analyzer;
+        
+        /**
+         * Capture file writer.
+         */
+        CaptureWriter capture;
+        
+        /**
+         * Decoded field exporter.
+         */
+        PacketExporter exporter;
+        
+        /**
+         * Forwarding output, or 0.
+         */
+        FILE *forward;
+        
+        /**
+         * Load generator, sending through the shown port.
+         */
+        LoadGenerator generator;
+        
+        /**
+         * Network bridge, sharing the shown port.
+         */
+        NetworkBridge bridge;
+        
+        /**
+         * Routes learned on the shown port, used to source route
+         * transmit requests sent through it.
+         */
+        NetworkTopology topology;
+        
+        /**
+         * Run flag, cleared to stop run().
+         */
+        bool running;
+        
+        // options
+        std::vector<std::string> ports;
+        int show_port;
+        unsigned long baud;
+        bool escaped;
+        bool reconnect;
+        bool low_latency;
+        int read_min;
+        bool debug;
+        CliOutput output;
+        std::string capture_file;
+        std::string read_file;
+        int jobs;
+        std::string forward_file;
+        std::string export_file;
+        PacketExporter::ExportFormat export_format;
+        bool generate;
+        ZigBeePacket generate_template;
+        LoadGenerator::Sweep sweep;
+        std::string bridge_address;
+        bool source_routes;
+};
+
+#endif //__ZIGBEE_TERMINAL_CLI_H
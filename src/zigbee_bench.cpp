@@ -0,0 +1,571 @@
+/************************************************************************/
+/* zigbee_bench                                                         */
+/*                                                                      */
+/* ZigBee Terminal - Benchmark                                          */
+/*                                                                      */
+/* zigbee_bench.cpp                                                     */
+/*                                                                      */
+/* Alex Forencich <alex@alexforencich.com>                              */
+/*                                                                      */
+/* Copyright (c) 2011 Alex Forencich                                    */
+/*                                                                      */
+/* Permission is hereby granted, free of charge, to any person          */
+/* obtaining a copy of this software and associated documentation       */
+/* files(the "Software"), to deal in the Software without restriction,  */
+/* including without limitation the rights to use, copy, modify, merge, */
+/* publish, distribute, sublicense, and/or sell copies of the Software, */
+/* and to permit persons to whom the Software is furnished to do so,    */
+/* subject to the following conditions:                                 */
+/*                                                                      */
+/* The above copyright notice and this permission notice shall be       */
+/* included in all copies or substantial portions of the Software.      */
+/*                                                                      */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,      */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF   */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND                */
+/* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS  */
+/* BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN   */
+/* ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN    */
+/* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE     */
+/* SOFTWARE.                                                            */
+/*                                                                      */
+/************************************************************************/
+
+/*
+ * Frame codec and receive path benchmark.  Not installed; build with
+ * "make zigbee-bench" and run from the build directory.
+ *
+ * Each benchmark runs passes over the same synthetic data set until the
+ * minimum run time is reached and reports frames and bytes per second.
+ * The stream mixes frame types, puts junk between frames, cuts some
+ * frames short and ends with a truncated frame, like a real capture
+ * taken part way through.
+ */
+ 
+#include "SerialInterface.h"
+#include "ZigBeeInterface.h"
+#include "ZigBeePacket.h"
+#include "ZigBeeFrameParser.h"
+#include "FrameBufferPool.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Data shared by all benchmarks.
+ */
+struct BenchData
+{
+        std::vector<ZigBeePacket> packets;      ///< Decoded packets
+        std::vector<uint8_t> stream;            ///< Unescaped stream
+        std::vector<uint8_t> escaped_stream;    ///< Escaped stream
+        size_t stream_frames;                   ///< Complete frames in the streams
+        size_t chunk;                           ///< Receive path read size
+        size_t sink;                            ///< Keeps results alive
+        FrameBufferPool pool;                   ///< Encode buffers
+};
+
+typedef void (*BenchFunc)(BenchData &d, size_t &frames, size_t &bytes);
+
+/** Bench Serial Interface
+ * 
+ * Serial interface that is never opened.  feed() hands data to the
+ * receiver the same way the I/O thread does and emits the receive data
+ * signal in place of the notifier.  
+ */
+class BenchSerialInterface : public SerialInterface
+{
+public:
+        void feed(const uint8_t *data, size_t count, size_t chunk)
+        {
+                size_t space;
+                char *ptr;
+                bool wake = false;
+                
+                while (count > 0)
+                {
+                        ptr = receiver->get_receive_space(space);
+                        
+                        if (space == 0)
+                                break;
+                                
+                        if (space > chunk)
+                                space = chunk;
+                                
+                        if (space > count)
+                                space = count;
+                                
+                        memcpy(ptr, data, space);
+                        wake = receiver->receive(space);
+                        
+                        if (wake)
+                                m_port_receive_data.emit();
+                                
+                        data += space;
+                        count -= space;
+                }
+                
+                if (!wake)
+                        m_port_receive_data.emit();
+        }
+};
+
+static uint32_t rand_state = 12345;
+
+static uint32_t bench_rand()
+{
+        // fixed LCG so that runs are comparable
+        rand_state = rand_state * 1103515245 + 12345;
+        return rand_state >> 8;
+}
+
+static double get_time()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void fill_data(std::vector<uint8_t> &data, size_t len)
+{
+        data.resize(len);
+        for (size_t i = 0; i < len; i++)
+                data[i] = bench_rand();
+}
+
+static ZigBeePacket make_packet(int n)
+{
+        ZigBeePacket pkt;
+        
+        pkt.frame_id = n;
+        pkt.dest64 = 0x0013a20040000000ULL | bench_rand();
+        pkt.src64 = 0x0013a20040000000ULL | bench_rand();
+        pkt.dest16 = bench_rand();
+        pkt.src16 = bench_rand();
+        
+        // roughly the mix seen on a busy network: mostly received data
+        switch (n % 10)
+        {
+                case 0:
+                case 1:
+                case 2:
+                case 3:
+                        pkt.identifier = ZigBeePacket::ZBPID_RxPacket;
+                        pkt.options = 0x01;
+                        fill_data(pkt.data, 8 + bench_rand() % 64);
+                        break;
+                case 4:
+                        pkt.identifier = ZigBeePacket::ZBPID_EARxPacket;
+                        pkt.src_ep = 0xe8;
+                        pkt.dest_ep = 0xe8;
+                        pkt.cluster_id = 0x0011;
+                        pkt.profile_id = 0xc105;
+                        fill_data(pkt.data, 8 + bench_rand() % 64);
+                        break;
+                case 5:
+                        pkt.identifier = ZigBeePacket::ZBPID_TxStatusS2;
+                        pkt.transmit_retries = bench_rand() % 3;
+                        break;
+                case 6:
+                        pkt.identifier = ZigBeePacket::ZBPID_ATCommandResponse;
+                        pkt.at_cmd[0] = 'N';
+                        pkt.at_cmd[1] = 'D';
+                        fill_data(pkt.data, 20 + bench_rand() % 10);
+                        break;
+                case 7:
+                        pkt.identifier = ZigBeePacket::ZBPID_RouteRecord;
+                        pkt.route_records.resize(1 + bench_rand() % 4);
+                        for (size_t i = 0; i < pkt.route_records.size(); i++)
+                                pkt.route_records[i] = bench_rand();
+                        break;
+                case 8:
+                        pkt.identifier = ZigBeePacket::ZBPID_TxRequest;
+                        pkt.radius = 0;
+                        fill_data(pkt.data, 8 + bench_rand() % 64);
+                        break;
+                default:
+                        pkt.identifier = ZigBeePacket::ZBPID_ModemStatus;
+                        pkt.status = bench_rand() % 3;
+                        break;
+        }
+        
+        pkt.build_packet();
+        
+        return pkt;
+}
+
+static void append_junk(std::vector<uint8_t> &stream)
+{
+        int n = 1 + bench_rand() % 8;
+        
+        for (int i = 0; i < n; i++)
+        {
+                uint8_t b = bench_rand();
+                if (b == 0x7e)
+                        b = 0;
+                stream.push_back(b);
+        }
+}
+
+static void make_data(BenchData &d, size_t count)
+{
+        std::vector<uint8_t> raw;
+        
+        d.packets.clear();
+        d.stream.clear();
+        d.escaped_stream.clear();
+        d.stream_frames = 0;
+        
+        for (size_t i = 0; i < count; i++)
+        {
+                d.packets.push_back(make_packet(i));
+                
+                switch (bench_rand() % 16)
+                {
+                        case 0:
+                        case 1:
+                        case 2:
+                                // junk between frames
+                                append_junk(d.stream);
+                                append_junk(d.escaped_stream);
+                                break;
+                        case 3:
+                                // frame cut short by a dropped byte run
+                                raw = d.packets[i].get_raw_packet();
+                                d.stream.insert(d.stream.end(), raw.begin(), raw.begin() + raw.size() / 2);
+                                raw = d.packets[i].get_escaped_raw_packet();
+                                d.escaped_stream.insert(d.escaped_stream.end(), raw.begin(), raw.begin() + raw.size() / 2);
+                                continue;
+                }
+                
+                raw = d.packets[i].get_raw_packet();
+                d.stream.insert(d.stream.end(), raw.begin(), raw.end());
+                raw = d.packets[i].get_escaped_raw_packet();
+                d.escaped_stream.insert(d.escaped_stream.end(), raw.begin(), raw.end());
+                d.stream_frames++;
+        }
+        
+        // truncated tail
+        raw = d.packets[0].get_raw_packet();
+        d.stream.insert(d.stream.end(), raw.begin(), raw.begin() + raw.size() - 1);
+        raw = d.packets[0].get_escaped_raw_packet();
+        d.escaped_stream.insert(d.escaped_stream.end(), raw.begin(), raw.begin() + raw.size() - 1);
+}
+
+static void bench_read_packet(BenchData &d, size_t &frames, size_t &bytes)
+{
+        ZigBeePacket pkt;
+        const uint8_t *ptr = &d.stream[0];
+        size_t count = d.stream.size();
+        size_t bytes_read;
+        
+        while (count > 0)
+        {
+                if (pkt.read_packet(ptr, count, bytes_read))
+                        frames++;
+                else if (bytes_read == 0)
+                        break;
+                        
+                ptr += bytes_read;
+                count -= bytes_read;
+        }
+        
+        bytes += d.stream.size();
+}
+
+static void bench_frame_parser(BenchData &d, size_t &frames, size_t &bytes)
+{
+        ZigBeeFrameParser parser;
+        const uint8_t *ptr = &d.stream[0];
+        size_t count = d.stream.size();
+        const uint8_t *frame;
+        size_t len;
+        size_t num;
+        
+        while (count > 0)
+        {
+                num = parser.get_buffer().write(ptr, count);
+                
+                while (parser.read_frame(frame, len))
+                        frames++;
+                        
+                if (num == 0)
+                        break;
+                        
+                ptr += num;
+                count -= num;
+        }
+        
+        bytes += d.stream.size();
+}
+
+static void bench_decode_packet(BenchData &d, size_t &frames, size_t &bytes)
+{
+        ZigBeePacket pkt;
+        
+        for (size_t i = 0; i < d.packets.size(); i++)
+        {
+                pkt.zero();
+                pkt.set_payload(&d.packets[i].payload[0], d.packets[i].payload.size());
+                pkt.decode_packet();
+                d.sink += pkt.identifier;
+                bytes += pkt.payload.size();
+        }
+        
+        frames += d.packets.size();
+}
+
+static void bench_build_packet(BenchData &d, size_t &frames, size_t &bytes)
+{
+        for (size_t i = 0; i < d.packets.size(); i++)
+        {
+                d.packets[i].build_packet();
+                bytes += d.packets[i].payload.size();
+        }
+        
+        frames += d.packets.size();
+}
+
+static void bench_get_raw_packet(BenchData &d, size_t &frames, size_t &bytes)
+{
+        for (size_t i = 0; i < d.packets.size(); i++)
+                bytes += d.packets[i].get_raw_packet().size();
+                
+        frames += d.packets.size();
+}
+
+static void bench_get_escaped_raw_packet(BenchData &d, size_t &frames, size_t &bytes)
+{
+        for (size_t i = 0; i < d.packets.size(); i++)
+                bytes += d.packets[i].get_escaped_raw_packet().size();
+                
+        frames += d.packets.size();
+}
+
+static void bench_encode(BenchData &d, size_t &frames, size_t &bytes, bool escaped)
+{
+        FrameBufferPool::Buffer *buf;
+        
+        for (size_t i = 0; i < d.packets.size(); i++)
+        {
+                buf = d.pool.acquire(d.packets[i].get_max_encoded_length(escaped));
+                buf->length = d.packets[i].encode(&buf->data[0], buf->data.size(), escaped);
+                bytes += buf->length;
+                d.pool.release(buf);
+        }
+        
+        frames += d.packets.size();
+}
+
+static void bench_encode_raw(BenchData &d, size_t &frames, size_t &bytes)
+{
+        bench_encode(d, frames, bytes, false);
+}
+
+static void bench_encode_escaped(BenchData &d, size_t &frames, size_t &bytes)
+{
+        bench_encode(d, frames, bytes, true);
+}
+
+static void bench_get_hex_packet(BenchData &d, size_t &frames, size_t &bytes)
+{
+        for (size_t i = 0; i < d.packets.size(); i++)
+        {
+                d.sink += d.packets[i].get_hex_packet().size();
+                bytes += d.packets[i].payload.size();
+        }
+        
+        frames += d.packets.size();
+}
+
+static void bench_get_desc(BenchData &d, size_t &frames, size_t &bytes)
+{
+        for (size_t i = 0; i < d.packets.size(); i++)
+        {
+                d.sink += d.packets[i].get_desc().size();
+                bytes += d.packets[i].payload.size();
+        }
+        
+        frames += d.packets.size();
+}
+
+static size_t received_frames = 0;
+
+static void on_receive_packets(std::vector<ZigBeePacket> &pkts)
+{
+        received_frames += pkts.size();
+}
+
+static size_t matched_frames = 0;
+
+static void on_receive_frames(const std::vector<ZigBeePacketView> &frames)
+{
+        received_frames += frames.size();
+        
+        // what a filter on type and source would do
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+                if (frames[i].get_identifier() == ZigBeePacket::ZBPID_RxPacket && (frames[i].get_src64() & 1))
+                        matched_frames++;
+        }
+}
+
+static void bench_receive(BenchData &d, const std::vector<uint8_t> &stream, bool escaped, bool views, size_t &frames, size_t &bytes)
+{
+        std::tr1::shared_ptr<BenchSerialInterface> si(new BenchSerialInterface());
+        ZigBeeInterface zb_int;
+        
+        zb_int.set_escaped(escaped);
+        zb_int.set_transport(si);
+        
+        if (views)
+                zb_int.signal_receive_frames().connect( sigc::ptr_fun(&on_receive_frames) );
+        else
+                zb_int.signal_receive_packets().connect( sigc::ptr_fun(&on_receive_packets) );
+        
+        received_frames = 0;
+        si->feed(&stream[0], stream.size(), d.chunk);
+        
+        frames += received_frames;
+        bytes += stream.size();
+}
+
+static void bench_receive_path(BenchData &d, size_t &frames, size_t &bytes)
+{
+        bench_receive(d, d.stream, false, false, frames, bytes);
+}
+
+static void bench_receive_path_escaped(BenchData &d, size_t &frames, size_t &bytes)
+{
+        bench_receive(d, d.escaped_stream, true, false, frames, bytes);
+}
+
+static void bench_receive_path_views(BenchData &d, size_t &frames, size_t &bytes)
+{
+        bench_receive(d, d.stream, false, true, frames, bytes);
+}
+
+static void run_bench(const char *name, BenchFunc func, BenchData &d, double min_time)
+{
+        size_t frames = 0;
+        size_t bytes = 0;
+        size_t passes = 0;
+        double start = get_time();
+        double elapsed;
+        
+        do
+        {
+                func(d, frames, bytes);
+                passes++;
+                elapsed = get_time() - start;
+        }
+        while (elapsed < min_time);
+        
+        printf("%-28s %12.0f frames/s %10.2f MB/s %8lu frames/pass\n", name,
+                frames / elapsed, bytes / elapsed / 1e6, (unsigned long)(frames / passes));
+}
+
+static void print_usage(const char *name)
+{
+        std::cout << "Usage: " << name << " [options] [benchmark...]" << std::endl
+                << "  -n, --frames N        frames in the data set (default 10000)" << std::endl
+                << "  -t, --time SECONDS    minimum time per benchmark (default 1)" << std::endl
+                << "  -c, --chunk BYTES     receive path read size (default 4096)" << std::endl
+                << "  -h, --help            show this help" << std::endl
+                << "Benchmarks: read_packet frame_parser decode_packet build_packet get_raw_packet" << std::endl
+                << "  get_escaped_raw_packet encode encode_escaped get_hex_packet get_desc receive" << std::endl
+                << "  receive_escaped receive_views" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+        static const struct option long_options[] = {
+                {"frames", required_argument, 0, 'n'},
+                {"time", required_argument, 0, 't'},
+                {"chunk", required_argument, 0, 'c'},
+                {"help", no_argument, 0, 'h'},
+                {0, 0, 0, 0}
+        };
+        static const struct
+        {
+                const char *name;
+                BenchFunc func;
+        }
+        benches[] = {
+                {"read_packet", bench_read_packet},
+                {"frame_parser", bench_frame_parser},
+                {"decode_packet", bench_decode_packet},
+                {"build_packet", bench_build_packet},
+                {"get_raw_packet", bench_get_raw_packet},
+                {"get_escaped_raw_packet", bench_get_escaped_raw_packet},
+                {"encode", bench_encode_raw},
+                {"encode_escaped", bench_encode_escaped},
+                {"get_hex_packet", bench_get_hex_packet},
+                {"get_desc", bench_get_desc},
+                {"receive", bench_receive_path},
+                {"receive_escaped", bench_receive_path_escaped},
+                {"receive_views", bench_receive_path_views},
+        };
+        const size_t num_benches = sizeof(benches) / sizeof(benches[0]);
+        BenchData d;
+        size_t count = 10000;
+        double min_time = 1.0;
+        int c;
+        
+        d.chunk = 4096;
+        d.sink = 0;
+        
+        while ((c = getopt_long(argc, argv, "n:t:c:h", long_options, 0)) != -1)
+        {
+                switch (c)
+                {
+                        case 'n':
+                                count = strtoul(optarg, 0, 10);
+                                break;
+                        case 't':
+                                min_time = strtod(optarg, 0);
+                                break;
+                        case 'c':
+                                d.chunk = strtoul(optarg, 0, 10);
+                                break;
+                        case 'h':
+                        default:
+                                print_usage(argv[0]);
+                                return 1;
+                }
+        }
+        
+        if (count == 0 || d.chunk == 0)
+        {
+                print_usage(argv[0]);
+                return 1;
+        }
+        
+        make_data(d, count);
+        
+        printf("%lu frames, %lu complete in stream, %lu stream bytes, %lu escaped stream bytes\n",
+                (unsigned long)d.packets.size(), (unsigned long)d.stream_frames,
+                (unsigned long)d.stream.size(), (unsigned long)d.escaped_stream.size());
+                
+        for (size_t i = 0; i < num_benches; i++)
+        {
+                bool run = optind >= argc;
+                
+                for (int j = optind; j < argc; j++)
+                        if (strcmp(argv[j], benches[i].name) == 0)
+                                run = true;
+                                
+                if (run)
+                        run_bench(benches[i].name, benches[i].func, d, min_time);
+        }
+        
+        // keep the optimizer from dropping the formatting benchmarks
+        return d.sink + matched_frames == 1 ? 2 : 0;
+}
+
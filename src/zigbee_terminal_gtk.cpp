@@ -35,13 +35,49 @@
 
 #include "ZigBeeTerminal.h"
 
+#include <iostream>
+#include <getopt.h>
+#include <stdlib.h>
+
 int main (int argc, char *argv[])
 {
+        static struct option long_options[] = {
+                {"port", required_argument, 0, 'p'},
+                {"baud", required_argument, 0, 'b'},
+                {"help", no_argument, 0, 'h'},
+                {0, 0, 0, 0}
+        };
+        
+        Glib::ustring port;
+        unsigned long baud = 115200;
+        int c;
+        
         if(!Glib::thread_supported()) Glib::thread_init();
         
+        // takes the GTK options out of argv
         Gtk::Main kit(argc, argv);
         
-        ZigBeeTerminal t;
+        while ((c = getopt_long(argc, argv, "p:b:h", long_options, 0)) != -1)
+        {
+                switch (c)
+                {
+                        case 'p':
+                                port = optarg;
+                                break;
+                        case 'b':
+                                baud = strtoul(optarg, 0, 10);
+                                break;
+                        case 'h':
+                        default:
+                                std::cerr << "Usage: " << argv[0] << " [-p PORT] [-b BAUD]" << std::endl
+                                        << "  -p, --port PORT       open PORT at startup" << std::endl
+                                        << "  -b, --baud BAUD       baud rate (default 115200)" << std::endl;
+                                return 1;
+                }
+        }
+        
+        // the port is opened first, the window is built behind it
+        ZigBeeTerminal t(port, baud);
         
         kit.run(t);
         